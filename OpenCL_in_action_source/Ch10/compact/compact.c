@@ -0,0 +1,356 @@
+#define _CRT_SECURE_NO_WARNINGS
+#define PROGRAM_FILE "compact.cl"
+
+#define ARRAY_SIZE 4194304
+#define THRESHOLD 0.75f
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef MAC
+#include <OpenCL/cl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+/* Find a GPU or CPU associated with the first available platform */
+cl_device_id create_device() {
+
+   cl_platform_id platform;
+   cl_device_id dev;
+   int err;
+
+   /* Identify a platform */
+   err = clGetPlatformIDs(1, &platform, NULL);
+   if(err < 0) {
+      perror("Couldn't identify a platform");
+      exit(1);
+   } 
+
+   /* Access a device */
+   err = clGetDeviceIDs(platform, CL_DEVICE_TYPE_GPU, 1, &dev, NULL);
+   if(err == CL_DEVICE_NOT_FOUND) {
+      err = clGetDeviceIDs(platform, CL_DEVICE_TYPE_CPU, 1, &dev, NULL);
+   }
+   if(err < 0) {
+      perror("Couldn't access any devices");
+      exit(1);   
+   }
+
+   return dev;
+}
+
+/* Create program from a file and compile it */
+cl_program build_program(cl_context ctx, cl_device_id dev, const char* filename) {
+
+   cl_program program;
+   FILE *program_handle;
+   char *program_buffer, *program_log;
+   size_t program_size, log_size;
+   int err;
+
+   /* Read program file and place content into buffer */
+   program_handle = fopen(filename, "r");
+   if(program_handle == NULL) {
+      perror("Couldn't find the program file");
+      exit(1);
+   }
+   fseek(program_handle, 0, SEEK_END);
+   program_size = ftell(program_handle);
+   rewind(program_handle);
+   program_buffer = (char*)malloc(program_size + 1);
+   program_buffer[program_size] = '\0';
+   fread(program_buffer, sizeof(char), program_size, program_handle);
+   fclose(program_handle);
+
+   /* Create program from file */
+   program = clCreateProgramWithSource(ctx, 1, 
+      (const char**)&program_buffer, &program_size, &err);
+   if(err < 0) {
+      perror("Couldn't create the program");
+      exit(1);
+   }
+   free(program_buffer);
+
+   /* Build program */
+   err = clBuildProgram(program, 0, NULL, NULL, NULL, NULL);
+   if(err < 0) {
+
+      /* Find size of log and print to std output */
+      clGetProgramBuildInfo(program, dev, CL_PROGRAM_BUILD_LOG, 
+            0, NULL, &log_size);
+      program_log = (char*) malloc(log_size + 1);
+      program_log[log_size] = '\0';
+      clGetProgramBuildInfo(program, dev, CL_PROGRAM_BUILD_LOG, 
+            log_size + 1, program_log, NULL);
+      printf("%s\n", program_log);
+      free(program_log);
+      exit(1);
+   }
+
+   return program;
+}
+
+/* Return the elapsed time of an event in nanoseconds */
+cl_ulong event_time(cl_event event) {
+
+   cl_ulong time_start, time_end;
+
+   clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_START,
+         sizeof(time_start), &time_start, NULL);
+   clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_END,
+         sizeof(time_end), &time_end, NULL);
+   clReleaseEvent(event);
+   return time_end - time_start;
+}
+
+int main() {
+
+   /* OpenCL structures */
+   cl_device_id device;
+   cl_context context;
+   cl_program program;
+   cl_kernel count_kernel, scan_kernel, values_kernel, indices_kernel,
+         partition_kernel;
+   cl_command_queue queue;
+   cl_event prof_event, scan_event;
+   cl_int i, j, err, check;
+   size_t local_size, global_size;
+
+   /* Data and buffers */
+   float *data, *output;
+   cl_uchar *flags;
+   cl_uint *indices, num_elements, num_groups;
+   int num_selected;
+   cl_mem data_buffer, flags_buffer, counts_buffer, offsets_buffer,
+         output_buffer, indices_buffer;
+   cl_ulong scan_time, values_time, indices_time, partition_time;
+
+   /* Initialize data and flags */
+   data = (float*) malloc(ARRAY_SIZE * sizeof(float));
+   output = (float*) malloc(ARRAY_SIZE * sizeof(float));
+   indices = (cl_uint*) malloc(ARRAY_SIZE * sizeof(cl_uint));
+   flags = (cl_uchar*) malloc(ARRAY_SIZE * sizeof(cl_uchar));
+   srand(time(NULL));
+   for(i=0; i<ARRAY_SIZE; i++) {
+      data[i] = 1.0f * rand()/RAND_MAX;
+      flags[i] = data[i] > THRESHOLD;
+   }
+
+   /* Create device and context */
+   device = create_device();
+   context = clCreateContext(NULL, 1, &device, NULL, NULL, &err);
+   if(err < 0) {
+      perror("Couldn't create a context");
+      exit(1);   
+   }
+
+   /* Build program and create kernels */
+   program = build_program(context, device, PROGRAM_FILE);
+   count_kernel = clCreateKernel(program, "compact_count", &err);
+   if(err < 0) {
+      perror("Couldn't create a kernel");
+      exit(1);
+   };
+   scan_kernel = clCreateKernel(program, "compact_scan", &err);
+   if(err < 0) {
+      perror("Couldn't create a kernel");
+      exit(1);
+   };
+   values_kernel = clCreateKernel(program, "compact_values", &err);
+   if(err < 0) {
+      perror("Couldn't create a kernel");
+      exit(1);
+   };
+   indices_kernel = clCreateKernel(program, "compact_indices", &err);
+   if(err < 0) {
+      perror("Couldn't create a kernel");
+      exit(1);
+   };
+   partition_kernel = clCreateKernel(program, "compact_partition", &err);
+   if(err < 0) {
+      perror("Couldn't create a kernel");
+      exit(1);
+   };
+
+   /* Determine a power-of-two local size */
+   err = clGetKernelWorkGroupInfo(values_kernel, device, 
+         CL_KERNEL_WORK_GROUP_SIZE, sizeof(local_size), &local_size, NULL);
+   if(err < 0) {
+      perror("Couldn't obtain device information");
+      exit(1);   
+   }
+   local_size = (size_t)pow(2, trunc(log2(local_size)));
+   num_elements = ARRAY_SIZE;
+   num_groups = (num_elements + local_size - 1)/local_size;
+   global_size = num_groups * local_size;
+
+   /* Create buffers */
+   data_buffer = clCreateBuffer(context, CL_MEM_READ_ONLY |
+         CL_MEM_COPY_HOST_PTR, ARRAY_SIZE * sizeof(float), data, &err);
+   flags_buffer = clCreateBuffer(context, CL_MEM_READ_ONLY |
+         CL_MEM_COPY_HOST_PTR, ARRAY_SIZE * sizeof(cl_uchar), flags, &err);
+   counts_buffer = clCreateBuffer(context, CL_MEM_READ_WRITE, 
+         num_groups * sizeof(int), NULL, &err);
+   offsets_buffer = clCreateBuffer(context, CL_MEM_READ_WRITE, 
+         (num_groups + 1) * sizeof(int), NULL, &err);
+   output_buffer = clCreateBuffer(context, CL_MEM_WRITE_ONLY, 
+         ARRAY_SIZE * sizeof(float), NULL, &err);
+   indices_buffer = clCreateBuffer(context, CL_MEM_WRITE_ONLY, 
+         ARRAY_SIZE * sizeof(cl_uint), NULL, &err);
+   if(err < 0) {
+      perror("Couldn't create a buffer");
+      exit(1);   
+   };
+
+   /* Create a command queue */
+   queue = clCreateCommandQueue(context, device, 
+         CL_QUEUE_PROFILING_ENABLE, &err);
+   if(err < 0) {
+      perror("Couldn't create a command queue");
+      exit(1);   
+   };
+
+   /* Set kernel arguments */
+   err = clSetKernelArg(count_kernel, 0, sizeof(cl_mem), &flags_buffer);
+   err |= clSetKernelArg(count_kernel, 1, sizeof(cl_uint), &num_elements);
+   err |= clSetKernelArg(count_kernel, 2, local_size * sizeof(int), NULL);
+   err |= clSetKernelArg(count_kernel, 3, sizeof(cl_mem), &counts_buffer);
+   err |= clSetKernelArg(scan_kernel, 0, sizeof(cl_mem), &counts_buffer);
+   err |= clSetKernelArg(scan_kernel, 1, sizeof(cl_uint), &num_groups);
+   err |= clSetKernelArg(scan_kernel, 2, local_size * sizeof(int), NULL);
+   err |= clSetKernelArg(scan_kernel, 3, sizeof(cl_mem), &offsets_buffer);
+   err |= clSetKernelArg(values_kernel, 0, sizeof(cl_mem), &data_buffer);
+   err |= clSetKernelArg(values_kernel, 1, sizeof(cl_mem), &flags_buffer);
+   err |= clSetKernelArg(values_kernel, 2, sizeof(cl_uint), &num_elements);
+   err |= clSetKernelArg(values_kernel, 3, sizeof(cl_mem), &offsets_buffer);
+   err |= clSetKernelArg(values_kernel, 4, local_size * sizeof(int), NULL);
+   err |= clSetKernelArg(values_kernel, 5, sizeof(cl_mem), &output_buffer);
+   err |= clSetKernelArg(indices_kernel, 0, sizeof(cl_mem), &flags_buffer);
+   err |= clSetKernelArg(indices_kernel, 1, sizeof(cl_uint), &num_elements);
+   err |= clSetKernelArg(indices_kernel, 2, sizeof(cl_mem), &offsets_buffer);
+   err |= clSetKernelArg(indices_kernel, 3, local_size * sizeof(int), NULL);
+   err |= clSetKernelArg(indices_kernel, 4, sizeof(cl_mem), &indices_buffer);
+   err |= clSetKernelArg(partition_kernel, 0, sizeof(cl_mem), &data_buffer);
+   err |= clSetKernelArg(partition_kernel, 1, sizeof(cl_mem), &flags_buffer);
+   err |= clSetKernelArg(partition_kernel, 2, sizeof(cl_uint), &num_elements);
+   err |= clSetKernelArg(partition_kernel, 3, sizeof(cl_mem), &offsets_buffer);
+   err |= clSetKernelArg(partition_kernel, 4, local_size * sizeof(int), NULL);
+   err |= clSetKernelArg(partition_kernel, 5, sizeof(cl_mem), &output_buffer);
+   if(err < 0) {
+      perror("Couldn't create a kernel argument");
+      exit(1);   
+   }
+
+   /* Count selected elements per group and scan the counts */
+   err = clEnqueueNDRangeKernel(queue, count_kernel, 1, NULL, &global_size, 
+         &local_size, 0, NULL, &prof_event);
+   err |= clEnqueueNDRangeKernel(queue, scan_kernel, 1, NULL, &local_size, 
+         &local_size, 0, NULL, &scan_event);
+   if(err < 0) {
+      perror("Couldn't enqueue the kernel");
+      exit(1);   
+   }
+   clFinish(queue);
+   scan_time = event_time(prof_event) + event_time(scan_event);
+   err = clEnqueueReadBuffer(queue, offsets_buffer, CL_TRUE, 
+         num_groups * sizeof(int), sizeof(int), &num_selected, 0, NULL, NULL);
+   if(err < 0) {
+      perror("Couldn't read the buffer");
+      exit(1);   
+   }
+   printf("Selected %d of %d elements\n", num_selected, ARRAY_SIZE);
+
+   /* Compact the selected values and check them */
+   err = clEnqueueNDRangeKernel(queue, values_kernel, 1, NULL, &global_size, 
+         &local_size, 0, NULL, &prof_event);
+   err |= clEnqueueReadBuffer(queue, output_buffer, CL_TRUE, 0, 
+         num_selected * sizeof(float), output, 0, NULL, NULL);
+   if(err < 0) {
+      perror("Couldn't compact the values");
+      exit(1);   
+   }
+   values_time = event_time(prof_event);
+   check = 1;
+   for(i=0, j=0; i<ARRAY_SIZE; i++) {
+      if(flags[i] && (j >= num_selected || output[j++] != data[i])) {
+         check = 0;
+         break;
+      }
+   }
+   check = check && (j == num_selected);
+   printf("compact_values: %s\n", check ? "Check passed." : "Check failed.");
+
+   /* Compact the selected indices and check them */
+   err = clEnqueueNDRangeKernel(queue, indices_kernel, 1, NULL, &global_size, 
+         &local_size, 0, NULL, &prof_event);
+   err |= clEnqueueReadBuffer(queue, indices_buffer, CL_TRUE, 0, 
+         num_selected * sizeof(cl_uint), indices, 0, NULL, NULL);
+   if(err < 0) {
+      perror("Couldn't compact the indices");
+      exit(1);   
+   }
+   indices_time = event_time(prof_event);
+   check = 1;
+   for(i=0, j=0; i<ARRAY_SIZE; i++) {
+      if(flags[i] && (j >= num_selected || indices[j++] != (cl_uint)i)) {
+         check = 0;
+         break;
+      }
+   }
+   printf("compact_indices: %s\n", check ? "Check passed." : "Check failed.");
+
+   /* Partition the data and check both halves */
+   err = clEnqueueNDRangeKernel(queue, partition_kernel, 1, NULL, 
+         &global_size, &local_size, 0, NULL, &prof_event);
+   err |= clEnqueueReadBuffer(queue, output_buffer, CL_TRUE, 0, 
+         ARRAY_SIZE * sizeof(float), output, 0, NULL, NULL);
+   if(err < 0) {
+      perror("Couldn't partition the data");
+      exit(1);   
+   }
+   partition_time = event_time(prof_event);
+   check = 1;
+   for(i=0, j=0; i<ARRAY_SIZE; i++) {
+      if(flags[i] && output[j++] != data[i]) {
+         check = 0;
+         break;
+      }
+   }
+   for(i=0; check && i<ARRAY_SIZE; i++) {
+      if(!flags[i] && output[j++] != data[i]) {
+         check = 0;
+      }
+   }
+   printf("compact_partition: %s\n", check ? "Check passed." : "Check failed.");
+
+   /* Display timing */
+   printf("Count and scan time = %lu\n", scan_time);
+   printf("Values time = %lu\n", values_time);
+   printf("Indices time = %lu\n", indices_time);
+   printf("Partition time = %lu\n", partition_time);
+
+   /* Deallocate resources */
+   clReleaseMemObject(data_buffer);
+   clReleaseMemObject(flags_buffer);
+   clReleaseMemObject(counts_buffer);
+   clReleaseMemObject(offsets_buffer);
+   clReleaseMemObject(output_buffer);
+   clReleaseMemObject(indices_buffer);
+   clReleaseKernel(count_kernel);
+   clReleaseKernel(scan_kernel);
+   clReleaseKernel(values_kernel);
+   clReleaseKernel(indices_kernel);
+   clReleaseKernel(partition_kernel);
+   clReleaseCommandQueue(queue);
+   clReleaseProgram(program);
+   clReleaseContext(context);
+   free(data);
+   free(output);
+   free(indices);
+   free(flags);
+   return 0;
+}
@@ -0,0 +1,121 @@
+/* Count the selected elements in each work-group */
+__kernel void compact_count(__global uchar* flags, uint num_elements,
+      __local int* partial_counts, __global int* group_counts) {
+
+   uint gid = get_global_id(0);
+   int lid = get_local_id(0);
+   int group_size = get_local_size(0);
+
+   partial_counts[lid] = (gid < num_elements) && flags[gid];
+   barrier(CLK_LOCAL_MEM_FENCE);
+
+   for(int i = group_size/2; i>0; i >>= 1) {
+      if(lid < i) {
+         partial_counts[lid] += partial_counts[lid + i];
+      }
+      barrier(CLK_LOCAL_MEM_FENCE);
+   }
+
+   if(lid == 0) {
+      group_counts[get_group_id(0)] = partial_counts[0];
+   }
+}
+
+/* Exclusive scan of the group counts in a single work-group */
+__kernel void compact_scan(__global int* group_counts, uint num_groups,
+      __local int* partial_sums, __global int* offsets) {
+
+   int lid = get_local_id(0);
+   int group_size = get_local_size(0);
+   int running_total = 0, value, i;
+
+   for(uint start = 0; start < num_groups; start += group_size) {
+
+      value = (start + lid < num_groups) ? group_counts[start + lid] : 0;
+      partial_sums[lid] = value;
+      barrier(CLK_LOCAL_MEM_FENCE);
+
+      /* Inclusive scan of this chunk */
+      for(int d = 1; d < group_size; d <<= 1) {
+         i = (lid >= d) ? partial_sums[lid - d] : 0;
+         barrier(CLK_LOCAL_MEM_FENCE);
+         partial_sums[lid] += i;
+         barrier(CLK_LOCAL_MEM_FENCE);
+      }
+
+      if(start + lid < num_groups) {
+         offsets[start + lid] = running_total + partial_sums[lid] - value;
+      }
+      running_total += partial_sums[group_size-1];
+      barrier(CLK_LOCAL_MEM_FENCE);
+   }
+
+   if(lid == 0) {
+      offsets[num_groups] = running_total;
+   }
+}
+
+/* Return the number of selected elements before this work-item */
+int local_position(int flag, __local int* partial_sums) {
+
+   int lid = get_local_id(0);
+   int group_size = get_local_size(0);
+   int i;
+
+   partial_sums[lid] = flag;
+   barrier(CLK_LOCAL_MEM_FENCE);
+
+   for(int d = 1; d < group_size; d <<= 1) {
+      i = (lid >= d) ? partial_sums[lid - d] : 0;
+      barrier(CLK_LOCAL_MEM_FENCE);
+      partial_sums[lid] += i;
+      barrier(CLK_LOCAL_MEM_FENCE);
+   }
+   return partial_sums[lid] - flag;
+}
+
+/* Copy the selected elements to a dense output */
+__kernel void compact_values(__global float* data, __global uchar* flags,
+      uint num_elements, __global int* offsets, 
+      __local int* partial_sums, __global float* output) {
+
+   uint gid = get_global_id(0);
+   int flag = (gid < num_elements) && flags[gid];
+   int pos = offsets[get_group_id(0)] + local_position(flag, partial_sums);
+
+   if(flag) {
+      output[pos] = data[gid];
+   }
+}
+
+/* Write the indices of the selected elements to a dense output */
+__kernel void compact_indices(__global uchar* flags, uint num_elements, 
+      __global int* offsets, __local int* partial_sums, 
+      __global uint* output) {
+
+   uint gid = get_global_id(0);
+   int flag = (gid < num_elements) && flags[gid];
+   int pos = offsets[get_group_id(0)] + local_position(flag, partial_sums);
+
+   if(flag) {
+      output[pos] = gid;
+   }
+}
+
+/* Stable partition: selected elements first, the rest after them */
+__kernel void compact_partition(__global float* data, __global uchar* flags,
+      uint num_elements, __global int* offsets, 
+      __local int* partial_sums, __global float* output) {
+
+   uint gid = get_global_id(0);
+   uint num_groups = get_num_groups(0);
+   int flag = (gid < num_elements) && flags[gid];
+   int pos = offsets[get_group_id(0)] + local_position(flag, partial_sums);
+
+   if(gid < num_elements) {
+      if(flag)
+         output[pos] = data[gid];
+      else
+         output[offsets[num_groups] + gid - pos] = data[gid];
+   }
+}
@@ -0,0 +1,280 @@
+#define _CRT_SECURE_NO_WARNINGS
+#define PROGRAM_FILE "histogram.cl"
+
+#define DATA_SIZE 67108864
+#define MAX_COPIES 16
+#define NUM_TESTS 6
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef MAC
+#include <OpenCL/cl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+/* Find a GPU or CPU associated with the first available platform */
+cl_device_id create_device() {
+
+   cl_platform_id platform;
+   cl_device_id dev;
+   int err;
+
+   /* Identify a platform */
+   err = clGetPlatformIDs(1, &platform, NULL);
+   if(err < 0) {
+      perror("Couldn't identify a platform");
+      exit(1);
+   } 
+
+   /* Access a device */
+   err = clGetDeviceIDs(platform, CL_DEVICE_TYPE_GPU, 1, &dev, NULL);
+   if(err == CL_DEVICE_NOT_FOUND) {
+      err = clGetDeviceIDs(platform, CL_DEVICE_TYPE_CPU, 1, &dev, NULL);
+   }
+   if(err < 0) {
+      perror("Couldn't access any devices");
+      exit(1);   
+   }
+
+   return dev;
+}
+
+/* Create program from a file and compile it */
+cl_program build_program(cl_context ctx, cl_device_id dev, const char* filename) {
+
+   cl_program program;
+   FILE *program_handle;
+   char *program_buffer, *program_log;
+   size_t program_size, log_size;
+   int err;
+
+   /* Read program file and place content into buffer */
+   program_handle = fopen(filename, "r");
+   if(program_handle == NULL) {
+      perror("Couldn't find the program file");
+      exit(1);
+   }
+   fseek(program_handle, 0, SEEK_END);
+   program_size = ftell(program_handle);
+   rewind(program_handle);
+   program_buffer = (char*)malloc(program_size + 1);
+   program_buffer[program_size] = '\0';
+   fread(program_buffer, sizeof(char), program_size, program_handle);
+   fclose(program_handle);
+
+   /* Create program from file */
+   program = clCreateProgramWithSource(ctx, 1, 
+      (const char**)&program_buffer, &program_size, &err);
+   if(err < 0) {
+      perror("Couldn't create the program");
+      exit(1);
+   }
+   free(program_buffer);
+
+   /* Build program */
+   err = clBuildProgram(program, 0, NULL, NULL, NULL, NULL);
+   if(err < 0) {
+
+      /* Find size of log and print to std output */
+      clGetProgramBuildInfo(program, dev, CL_PROGRAM_BUILD_LOG, 
+            0, NULL, &log_size);
+      program_log = (char*) malloc(log_size + 1);
+      program_log[log_size] = '\0';
+      clGetProgramBuildInfo(program, dev, CL_PROGRAM_BUILD_LOG, 
+            log_size + 1, program_log, NULL);
+      printf("%s\n", program_log);
+      free(program_log);
+      exit(1);
+   }
+
+   return program;
+}
+
+/* Compute a histogram on the device, check it and display the throughput */
+void run_histogram(cl_context context, cl_command_queue queue, 
+      cl_program program, cl_mem data_buffer, unsigned char *data, 
+      int bits, cl_uint num_bins, size_t local_size, size_t global_size,
+      cl_ulong local_mem_size) {
+
+   cl_kernel kernel;
+   cl_mem hist_buffer;
+   cl_event prof_event;
+   cl_uint i, num_elements, num_copies, *hist, *check_hist, value;
+   cl_ulong time_start, time_end, total_time;
+   char kernel_name[32];
+   int err, check;
+
+   /* Choose the local kernel if at least one copy fits in local memory */
+   num_elements = DATA_SIZE/(bits/8);
+   num_copies = local_mem_size/(num_bins * sizeof(cl_uint));
+   if(num_copies > MAX_COPIES)
+      num_copies = MAX_COPIES;
+   if(num_copies > local_size)
+      num_copies = local_size;
+   sprintf(kernel_name, "histogram%d_%s", bits, 
+         num_copies > 0 ? "local" : "global");
+
+   /* Create the kernel and the zeroed histogram */
+   kernel = clCreateKernel(program, kernel_name, &err);
+   if(err < 0) {
+      perror("Couldn't create a kernel");
+      exit(1);
+   };
+   hist = (cl_uint*) calloc(num_bins, sizeof(cl_uint));
+   check_hist = (cl_uint*) calloc(num_bins, sizeof(cl_uint));
+   hist_buffer = clCreateBuffer(context, CL_MEM_READ_WRITE |
+         CL_MEM_COPY_HOST_PTR, num_bins * sizeof(cl_uint), hist, &err);
+   if(err < 0) {
+      perror("Couldn't create a buffer");
+      exit(1);   
+   };
+
+   /* Set kernel arguments */
+   err = clSetKernelArg(kernel, 0, sizeof(cl_mem), &data_buffer);
+   err |= clSetKernelArg(kernel, 1, sizeof(cl_uint), &num_elements);
+   err |= clSetKernelArg(kernel, 2, sizeof(cl_uint), &num_bins);
+   if(num_copies > 0) {
+      err |= clSetKernelArg(kernel, 3, sizeof(cl_uint), &num_copies);
+      err |= clSetKernelArg(kernel, 4, 
+            num_bins * num_copies * sizeof(cl_uint), NULL);
+      err |= clSetKernelArg(kernel, 5, sizeof(cl_mem), &hist_buffer);
+   }
+   else {
+      err |= clSetKernelArg(kernel, 3, sizeof(cl_mem), &hist_buffer);
+   }
+   if(err < 0) {
+      perror("Couldn't create a kernel argument");
+      exit(1);   
+   }
+
+   /* Enqueue kernel and read the histogram */
+   err = clEnqueueNDRangeKernel(queue, kernel, 1, NULL, &global_size, 
+         &local_size, 0, NULL, &prof_event);
+   if(err < 0) {
+      perror("Couldn't enqueue the kernel");
+      exit(1);   
+   }
+   err = clEnqueueReadBuffer(queue, hist_buffer, CL_TRUE, 0, 
+         num_bins * sizeof(cl_uint), hist, 0, NULL, NULL);
+   if(err < 0) {
+      perror("Couldn't read the buffer");
+      exit(1);   
+   }
+   clGetEventProfilingInfo(prof_event, CL_PROFILING_COMMAND_START,
+         sizeof(time_start), &time_start, NULL);
+   clGetEventProfilingInfo(prof_event, CL_PROFILING_COMMAND_END,
+         sizeof(time_end), &time_end, NULL);
+   total_time = time_end - time_start;
+
+   /* Check the result against a host histogram */
+   for(i=0; i<num_elements; i++) {
+      if(bits == 8)
+         value = data[i];
+      else
+         value = ((unsigned short*)data)[i];
+      check_hist[(value * num_bins) >> bits]++;
+   }
+   check = 1;
+   for(i=0; i<num_bins; i++) {
+      if(hist[i] != check_hist[i]) {
+         check = 0;
+         break;
+      }
+   }
+   printf("%s, %u bins, %u copies: %s %.2f GB/s\n", kernel_name, num_bins,
+         num_copies, check ? "Check passed." : "Check failed.", 
+         1.0 * DATA_SIZE/total_time);
+
+   /* Deallocate resources */
+   clReleaseEvent(prof_event);
+   clReleaseMemObject(hist_buffer);
+   clReleaseKernel(kernel);
+   free(hist);
+   free(check_hist);
+}
+
+int main() {
+
+   /* OpenCL structures */
+   cl_device_id device;
+   cl_context context;
+   cl_program program;
+   cl_command_queue queue;
+   cl_int i, err;
+   size_t local_size, global_size;
+   cl_uint compute_units;
+   cl_ulong local_mem_size;
+
+   /* Data and buffers */
+   unsigned char *data;
+   cl_mem data_buffer;
+   int test_bits[NUM_TESTS] = {8, 8, 8, 16, 16, 16};
+   cl_uint test_bins[NUM_TESTS] = {256, 64, 100, 4096, 1000, 65536};
+
+   /* Initialize data */
+   data = (unsigned char*) malloc(DATA_SIZE);
+   srand(time(NULL));
+   for(i=0; i<DATA_SIZE; i++) {
+      data[i] = rand();
+   }
+
+   /* Create device and determine sizes */
+   device = create_device();
+   err = clGetDeviceInfo(device, CL_DEVICE_MAX_WORK_GROUP_SIZE, 	
+         sizeof(local_size), &local_size, NULL);	
+   err |= clGetDeviceInfo(device, CL_DEVICE_MAX_COMPUTE_UNITS, 	
+         sizeof(compute_units), &compute_units, NULL);	
+   err |= clGetDeviceInfo(device, CL_DEVICE_LOCAL_MEM_SIZE, 
+         sizeof(local_mem_size), &local_mem_size, NULL);
+   if(err < 0) {
+      perror("Couldn't obtain device information");
+      exit(1);   
+   }
+   global_size = compute_units * 8 * local_size;
+
+   /* Create a context */
+   context = clCreateContext(NULL, 1, &device, NULL, NULL, &err);
+   if(err < 0) {
+      perror("Couldn't create a context");
+      exit(1);   
+   }
+
+   /* Build program */
+   program = build_program(context, device, PROGRAM_FILE);
+
+   /* Create data buffer */
+   data_buffer = clCreateBuffer(context, CL_MEM_READ_ONLY |
+         CL_MEM_COPY_HOST_PTR, DATA_SIZE, data, &err);
+   if(err < 0) {
+      perror("Couldn't create a buffer");
+      exit(1);   
+   };
+
+   /* Create a command queue */
+   queue = clCreateCommandQueue(context, device, 
+         CL_QUEUE_PROFILING_ENABLE, &err);
+   if(err < 0) {
+      perror("Couldn't create a command queue");
+      exit(1);   
+   };
+
+   /* Run each bit width and bin count */
+   for(i=0; i<NUM_TESTS; i++) {
+      run_histogram(context, queue, program, data_buffer, data, 
+            test_bits[i], test_bins[i], local_size, global_size, 
+            local_mem_size);
+   }
+
+   /* Deallocate resources */
+   clReleaseMemObject(data_buffer);
+   clReleaseCommandQueue(queue);
+   clReleaseProgram(program);
+   clReleaseContext(context);
+   free(data);
+   return 0;
+}
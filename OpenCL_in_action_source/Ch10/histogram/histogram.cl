@@ -0,0 +1,106 @@
+/* Map an n-bit value onto one of num_bins equal-width bins */
+#define BIN(value, bits) (((uint)(value) * num_bins) >> bits)
+
+/* Clear the local histogram copies */
+void clear_local(__local uint* l_hist, uint num_entries) {
+
+   for(uint i = get_local_id(0); i < num_entries; i += get_local_size(0)) {
+      l_hist[i] = 0;
+   }
+   barrier(CLK_LOCAL_MEM_FENCE);
+}
+
+/* Merge the local copies and perform one global add per bin */
+void merge_local(__local uint* l_hist, uint num_bins, uint num_copies,
+      __global uint* g_hist) {
+
+   uint sum;
+
+   barrier(CLK_LOCAL_MEM_FENCE);
+   for(uint bin = get_local_id(0); bin < num_bins; bin += get_local_size(0)) {
+      sum = 0;
+      for(uint c = 0; c < num_copies; c++) {
+         sum += l_hist[bin * num_copies + c];
+      }
+      if(sum > 0) {
+         atomic_add(g_hist + bin, sum);
+      }
+   }
+}
+
+/* 8-bit histogram with per-work-group copies in local memory */
+__kernel void histogram8_local(__global uchar* data, uint num_elements,
+      uint num_bins, uint num_copies, __local uint* l_hist, 
+      __global uint* g_hist) {
+
+   uint i, num_vectors = num_elements/4;
+   uchar4 input;
+
+   /* Work-items sharing a copy are spread apart in the work-group */
+   __local uint* copy = l_hist + get_local_id(0) % num_copies;
+
+   clear_local(l_hist, num_bins * num_copies);
+
+   /* Process four values per iteration */
+   for(i = get_global_id(0); i < num_vectors; i += get_global_size(0)) {
+      input = vload4(i, data);
+      atomic_inc(copy + BIN(input.s0, 8) * num_copies);
+      atomic_inc(copy + BIN(input.s1, 8) * num_copies);
+      atomic_inc(copy + BIN(input.s2, 8) * num_copies);
+      atomic_inc(copy + BIN(input.s3, 8) * num_copies);
+   }
+
+   /* Process the remaining values */
+   i = num_vectors * 4 + get_global_id(0);
+   if(i < num_elements) {
+      atomic_inc(copy + BIN(data[i], 8) * num_copies);
+   }
+
+   merge_local(l_hist, num_bins, num_copies, g_hist);
+}
+
+/* 16-bit histogram with per-work-group copies in local memory */
+__kernel void histogram16_local(__global ushort* data, uint num_elements,
+      uint num_bins, uint num_copies, __local uint* l_hist, 
+      __global uint* g_hist) {
+
+   uint i, num_vectors = num_elements/4;
+   ushort4 input;
+
+   __local uint* copy = l_hist + get_local_id(0) % num_copies;
+
+   clear_local(l_hist, num_bins * num_copies);
+
+   for(i = get_global_id(0); i < num_vectors; i += get_global_size(0)) {
+      input = vload4(i, data);
+      atomic_inc(copy + BIN(input.s0, 16) * num_copies);
+      atomic_inc(copy + BIN(input.s1, 16) * num_copies);
+      atomic_inc(copy + BIN(input.s2, 16) * num_copies);
+      atomic_inc(copy + BIN(input.s3, 16) * num_copies);
+   }
+
+   i = num_vectors * 4 + get_global_id(0);
+   if(i < num_elements) {
+      atomic_inc(copy + BIN(data[i], 16) * num_copies);
+   }
+
+   merge_local(l_hist, num_bins, num_copies, g_hist);
+}
+
+/* 8-bit histogram updated directly in global memory */
+__kernel void histogram8_global(__global uchar* data, uint num_elements,
+      uint num_bins, __global uint* g_hist) {
+
+   for(uint i = get_global_id(0); i < num_elements; i += get_global_size(0)) {
+      atomic_inc(g_hist + BIN(data[i], 8));
+   }
+}
+
+/* 16-bit histogram updated directly in global memory */
+__kernel void histogram16_global(__global ushort* data, uint num_elements,
+      uint num_bins, __global uint* g_hist) {
+
+   for(uint i = get_global_id(0); i < num_elements; i += get_global_size(0)) {
+      atomic_inc(g_hist + BIN(data[i], 16));
+   }
+}
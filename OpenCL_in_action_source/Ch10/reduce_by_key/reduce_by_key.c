@@ -0,0 +1,394 @@
+#define _CRT_SECURE_NO_WARNINGS
+#define PROGRAM_FILE "reduce_by_key.cl"
+
+#define ARRAY_SIZE 4194304
+#define MAX_RUN 64
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef MAC
+#include <OpenCL/cl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+/* Find a GPU or CPU associated with the first available platform */
+cl_device_id create_device() {
+
+   cl_platform_id platform;
+   cl_device_id dev;
+   int err;
+
+   /* Identify a platform */
+   err = clGetPlatformIDs(1, &platform, NULL);
+   if(err < 0) {
+      perror("Couldn't identify a platform");
+      exit(1);
+   } 
+
+   /* Access a device */
+   err = clGetDeviceIDs(platform, CL_DEVICE_TYPE_GPU, 1, &dev, NULL);
+   if(err == CL_DEVICE_NOT_FOUND) {
+      err = clGetDeviceIDs(platform, CL_DEVICE_TYPE_CPU, 1, &dev, NULL);
+   }
+   if(err < 0) {
+      perror("Couldn't access any devices");
+      exit(1);   
+   }
+
+   return dev;
+}
+
+/* Create program from a file and compile it */
+cl_program build_program(cl_context ctx, cl_device_id dev, const char* filename) {
+
+   cl_program program;
+   FILE *program_handle;
+   char *program_buffer, *program_log;
+   size_t program_size, log_size;
+   int err;
+
+   /* Read program file and place content into buffer */
+   program_handle = fopen(filename, "r");
+   if(program_handle == NULL) {
+      perror("Couldn't find the program file");
+      exit(1);
+   }
+   fseek(program_handle, 0, SEEK_END);
+   program_size = ftell(program_handle);
+   rewind(program_handle);
+   program_buffer = (char*)malloc(program_size + 1);
+   program_buffer[program_size] = '\0';
+   fread(program_buffer, sizeof(char), program_size, program_handle);
+   fclose(program_handle);
+
+   /* Create program from file */
+   program = clCreateProgramWithSource(ctx, 1, 
+      (const char**)&program_buffer, &program_size, &err);
+   if(err < 0) {
+      perror("Couldn't create the program");
+      exit(1);
+   }
+   free(program_buffer);
+
+   /* Build program */
+   err = clBuildProgram(program, 0, NULL, NULL, NULL, NULL);
+   if(err < 0) {
+
+      /* Find size of log and print to std output */
+      clGetProgramBuildInfo(program, dev, CL_PROGRAM_BUILD_LOG, 
+            0, NULL, &log_size);
+      program_log = (char*) malloc(log_size + 1);
+      program_log[log_size] = '\0';
+      clGetProgramBuildInfo(program, dev, CL_PROGRAM_BUILD_LOG, 
+            log_size + 1, program_log, NULL);
+      printf("%s\n", program_log);
+      free(program_log);
+      exit(1);
+   }
+
+   return program;
+}
+
+/* Reduce sorted keys on the host, one run at a time */
+int host_reduce_by_key(int *keys, float *values, int num, int *out_keys, 
+      float *out_sum, cl_uint *out_count, float *out_min, float *out_max) {
+
+   int i, num_unique = -1;
+
+   for(i=0; i<num; i++) {
+      if(i == 0 || keys[i] != keys[i-1]) {
+         num_unique++;
+         out_keys[num_unique] = keys[i];
+         out_sum[num_unique] = 0.0f;
+         out_count[num_unique] = 0;
+         out_min[num_unique] = values[i];
+         out_max[num_unique] = values[i];
+      }
+      out_sum[num_unique] += values[i];
+      out_count[num_unique]++;
+      if(values[i] < out_min[num_unique])
+         out_min[num_unique] = values[i];
+      if(values[i] > out_max[num_unique])
+         out_max[num_unique] = values[i];
+   }
+   return num_unique + 1;
+}
+
+int main() {
+
+   /* OpenCL structures */
+   cl_device_id device;
+   cl_context context;
+   cl_program program;
+   cl_kernel count_kernel, scan_kernel, reduce_kernel, fixup_kernel;
+   cl_command_queue queue;
+   cl_event start_event, end_event;
+   cl_int i, err, check;
+   size_t local_size, global_size, num_groups_size;
+   cl_ulong local_mem_size;
+
+   /* Data and buffers */
+   int *keys, *host_keys, *dev_keys;
+   float *values, *host_sum, *host_min, *host_max;
+   float *dev_sum, *dev_min, *dev_max;
+   cl_uint *host_count, *dev_count, num_elements, num_groups, group_size;
+   int host_unique, dev_unique, key;
+   cl_mem keys_buffer, values_buffer, head_counts_buffer, offsets_buffer,
+         out_keys_buffer, out_sum_buffer, out_count_buffer, out_min_buffer,
+         out_max_buffer, carries_buffer;
+   cl_ulong time_start, time_end, total_time;
+   clock_t host_start, host_time;
+
+   /* Initialize sorted keys with random run lengths */
+   keys = (int*) malloc(ARRAY_SIZE * sizeof(int));
+   values = (float*) malloc(ARRAY_SIZE * sizeof(float));
+   srand(time(NULL));
+   key = 0;
+   for(i=0; i<ARRAY_SIZE; i++) {
+      if(rand() % MAX_RUN == 0)
+         key += 1 + rand() % 4;
+      keys[i] = key;
+      values[i] = 1.0f * (rand() % 16);
+   }
+
+   /* Allocate output arrays */
+   host_keys = (int*) malloc(ARRAY_SIZE * sizeof(int));
+   host_sum = (float*) malloc(ARRAY_SIZE * sizeof(float));
+   host_count = (cl_uint*) malloc(ARRAY_SIZE * sizeof(cl_uint));
+   host_min = (float*) malloc(ARRAY_SIZE * sizeof(float));
+   host_max = (float*) malloc(ARRAY_SIZE * sizeof(float));
+   dev_keys = (int*) malloc(ARRAY_SIZE * sizeof(int));
+   dev_sum = (float*) malloc(ARRAY_SIZE * sizeof(float));
+   dev_count = (cl_uint*) malloc(ARRAY_SIZE * sizeof(cl_uint));
+   dev_min = (float*) malloc(ARRAY_SIZE * sizeof(float));
+   dev_max = (float*) malloc(ARRAY_SIZE * sizeof(float));
+
+   /* Compute the reference result on the host */
+   host_start = clock();
+   host_unique = host_reduce_by_key(keys, values, ARRAY_SIZE, host_keys, 
+         host_sum, host_count, host_min, host_max);
+   host_time = clock() - host_start;
+
+   /* Create device and context */
+   device = create_device();
+   context = clCreateContext(NULL, 1, &device, NULL, NULL, &err);
+   if(err < 0) {
+      perror("Couldn't create a context");
+      exit(1);   
+   }
+
+   /* Build program and create kernels */
+   program = build_program(context, device, PROGRAM_FILE);
+   count_kernel = clCreateKernel(program, "rbk_count", &err);
+   if(err < 0) {
+      perror("Couldn't create a kernel");
+      exit(1);
+   };
+   scan_kernel = clCreateKernel(program, "rbk_scan", &err);
+   if(err < 0) {
+      perror("Couldn't create a kernel");
+      exit(1);
+   };
+   reduce_kernel = clCreateKernel(program, "rbk_reduce", &err);
+   if(err < 0) {
+      perror("Couldn't create a kernel");
+      exit(1);
+   };
+   fixup_kernel = clCreateKernel(program, "rbk_fixup", &err);
+   if(err < 0) {
+      perror("Couldn't create a kernel");
+      exit(1);
+   };
+
+   /* Determine a power-of-two local size that fits in local memory */
+   err = clGetKernelWorkGroupInfo(reduce_kernel, device, 
+         CL_KERNEL_WORK_GROUP_SIZE, sizeof(local_size), &local_size, NULL);
+   err |= clGetDeviceInfo(device, CL_DEVICE_LOCAL_MEM_SIZE, 
+         sizeof(local_mem_size), &local_mem_size, NULL);
+   if(err < 0) {
+      perror("Couldn't obtain device information");
+      exit(1);   
+   }
+   local_size = (size_t)pow(2, trunc(log2(local_size)));
+   while(local_size * (4 * sizeof(float) + 2 * sizeof(int)) > local_mem_size)
+      local_size >>= 1;
+   num_elements = ARRAY_SIZE;
+   num_groups = (num_elements + local_size - 1)/local_size;
+   num_groups_size = num_groups;
+   group_size = (cl_uint)local_size;
+   global_size = num_groups * local_size;
+
+   /* Create buffers */
+   keys_buffer = clCreateBuffer(context, CL_MEM_READ_ONLY |
+         CL_MEM_COPY_HOST_PTR, ARRAY_SIZE * sizeof(int), keys, &err);
+   values_buffer = clCreateBuffer(context, CL_MEM_READ_ONLY |
+         CL_MEM_COPY_HOST_PTR, ARRAY_SIZE * sizeof(float), values, &err);
+   head_counts_buffer = clCreateBuffer(context, CL_MEM_READ_WRITE, 
+         num_groups * sizeof(int), NULL, &err);
+   offsets_buffer = clCreateBuffer(context, CL_MEM_READ_WRITE, 
+         (num_groups + 1) * sizeof(int), NULL, &err);
+   carries_buffer = clCreateBuffer(context, CL_MEM_READ_WRITE, 
+         num_groups * 4 * sizeof(float), NULL, &err);
+   out_keys_buffer = clCreateBuffer(context, CL_MEM_WRITE_ONLY, 
+         ARRAY_SIZE * sizeof(int), NULL, &err);
+   out_sum_buffer = clCreateBuffer(context, CL_MEM_READ_WRITE, 
+         ARRAY_SIZE * sizeof(float), NULL, &err);
+   out_count_buffer = clCreateBuffer(context, CL_MEM_READ_WRITE, 
+         ARRAY_SIZE * sizeof(cl_uint), NULL, &err);
+   out_min_buffer = clCreateBuffer(context, CL_MEM_READ_WRITE, 
+         ARRAY_SIZE * sizeof(float), NULL, &err);
+   out_max_buffer = clCreateBuffer(context, CL_MEM_READ_WRITE, 
+         ARRAY_SIZE * sizeof(float), NULL, &err);
+   if(err < 0) {
+      perror("Couldn't create a buffer");
+      exit(1);   
+   };
+
+   /* Create a command queue */
+   queue = clCreateCommandQueue(context, device, 
+         CL_QUEUE_PROFILING_ENABLE, &err);
+   if(err < 0) {
+      perror("Couldn't create a command queue");
+      exit(1);   
+   };
+
+   /* Set arguments for the count kernel */
+   err = clSetKernelArg(count_kernel, 0, sizeof(cl_mem), &keys_buffer);
+   err |= clSetKernelArg(count_kernel, 1, sizeof(cl_uint), &num_elements);
+   err |= clSetKernelArg(count_kernel, 2, local_size * sizeof(int), NULL);
+   err |= clSetKernelArg(count_kernel, 3, sizeof(cl_mem), &head_counts_buffer);
+
+   /* Set arguments for the scan kernel */
+   err |= clSetKernelArg(scan_kernel, 0, sizeof(cl_mem), &head_counts_buffer);
+   err |= clSetKernelArg(scan_kernel, 1, sizeof(cl_uint), &num_groups);
+   err |= clSetKernelArg(scan_kernel, 2, local_size * sizeof(int), NULL);
+   err |= clSetKernelArg(scan_kernel, 3, sizeof(cl_mem), &offsets_buffer);
+
+   /* Set arguments for the reduce kernel */
+   err |= clSetKernelArg(reduce_kernel, 0, sizeof(cl_mem), &keys_buffer);
+   err |= clSetKernelArg(reduce_kernel, 1, sizeof(cl_mem), &values_buffer);
+   err |= clSetKernelArg(reduce_kernel, 2, sizeof(cl_uint), &num_elements);
+   err |= clSetKernelArg(reduce_kernel, 3, sizeof(cl_mem), &offsets_buffer);
+   err |= clSetKernelArg(reduce_kernel, 4, local_size * 4 * sizeof(float), NULL);
+   err |= clSetKernelArg(reduce_kernel, 5, local_size * sizeof(int), NULL);
+   err |= clSetKernelArg(reduce_kernel, 6, local_size * sizeof(int), NULL);
+   err |= clSetKernelArg(reduce_kernel, 7, sizeof(cl_mem), &out_keys_buffer);
+   err |= clSetKernelArg(reduce_kernel, 8, sizeof(cl_mem), &out_sum_buffer);
+   err |= clSetKernelArg(reduce_kernel, 9, sizeof(cl_mem), &out_count_buffer);
+   err |= clSetKernelArg(reduce_kernel, 10, sizeof(cl_mem), &out_min_buffer);
+   err |= clSetKernelArg(reduce_kernel, 11, sizeof(cl_mem), &out_max_buffer);
+   err |= clSetKernelArg(reduce_kernel, 12, sizeof(cl_mem), &carries_buffer);
+
+   /* Set arguments for the fixup kernel */
+   err |= clSetKernelArg(fixup_kernel, 0, sizeof(cl_mem), &keys_buffer);
+   err |= clSetKernelArg(fixup_kernel, 1, sizeof(cl_uint), &group_size);
+   err |= clSetKernelArg(fixup_kernel, 2, sizeof(cl_mem), &head_counts_buffer);
+   err |= clSetKernelArg(fixup_kernel, 3, sizeof(cl_mem), &offsets_buffer);
+   err |= clSetKernelArg(fixup_kernel, 4, sizeof(cl_mem), &out_sum_buffer);
+   err |= clSetKernelArg(fixup_kernel, 5, sizeof(cl_mem), &out_count_buffer);
+   err |= clSetKernelArg(fixup_kernel, 6, sizeof(cl_mem), &out_min_buffer);
+   err |= clSetKernelArg(fixup_kernel, 7, sizeof(cl_mem), &out_max_buffer);
+   err |= clSetKernelArg(fixup_kernel, 8, sizeof(cl_mem), &carries_buffer);
+   if(err < 0) {
+      perror("Couldn't create a kernel argument");
+      exit(1);   
+   }
+
+   /* Enqueue kernels */
+   err = clEnqueueNDRangeKernel(queue, count_kernel, 1, NULL, &global_size, 
+         &local_size, 0, NULL, &start_event);
+   err |= clEnqueueNDRangeKernel(queue, scan_kernel, 1, NULL, &local_size, 
+         &local_size, 0, NULL, NULL);
+   err |= clEnqueueNDRangeKernel(queue, reduce_kernel, 1, NULL, &global_size, 
+         &local_size, 0, NULL, NULL);
+   err |= clEnqueueNDRangeKernel(queue, fixup_kernel, 1, NULL, 
+         &num_groups_size, NULL, 0, NULL, &end_event);
+   if(err < 0) {
+      perror("Couldn't enqueue the kernel");
+      exit(1);   
+   }
+
+   /* Finish processing the queue and get profiling information */
+   clFinish(queue);
+   clGetEventProfilingInfo(start_event, CL_PROFILING_COMMAND_START,
+         sizeof(time_start), &time_start, NULL);
+   clGetEventProfilingInfo(end_event, CL_PROFILING_COMMAND_END,
+         sizeof(time_end), &time_end, NULL);
+   total_time = time_end - time_start;
+
+   /* Read the number of unique keys and the aggregates */
+   err = clEnqueueReadBuffer(queue, offsets_buffer, CL_TRUE, 
+         num_groups * sizeof(int), sizeof(int), &dev_unique, 0, NULL, NULL);
+   err |= clEnqueueReadBuffer(queue, out_keys_buffer, CL_TRUE, 0, 
+         dev_unique * sizeof(int), dev_keys, 0, NULL, NULL);
+   err |= clEnqueueReadBuffer(queue, out_sum_buffer, CL_TRUE, 0, 
+         dev_unique * sizeof(float), dev_sum, 0, NULL, NULL);
+   err |= clEnqueueReadBuffer(queue, out_count_buffer, CL_TRUE, 0, 
+         dev_unique * sizeof(cl_uint), dev_count, 0, NULL, NULL);
+   err |= clEnqueueReadBuffer(queue, out_min_buffer, CL_TRUE, 0, 
+         dev_unique * sizeof(float), dev_min, 0, NULL, NULL);
+   err |= clEnqueueReadBuffer(queue, out_max_buffer, CL_TRUE, 0, 
+         dev_unique * sizeof(float), dev_max, 0, NULL, NULL);
+   if(err < 0) {
+      perror("Couldn't read the buffer");
+      exit(1);   
+   }
+
+   /* Check result against the host reduction */
+   check = (dev_unique == host_unique);
+   for(i=0; check && i<host_unique; i++) {
+      if(dev_keys[i] != host_keys[i] || dev_sum[i] != host_sum[i] ||
+         dev_count[i] != host_count[i] || dev_min[i] != host_min[i] ||
+         dev_max[i] != host_max[i]) {
+         check = 0;
+      }
+   }
+   printf("Unique keys: %d\n", dev_unique);
+   if(check)
+      printf("Check passed.\n");
+   else
+      printf("Check failed.\n");
+   printf("Device time = %lu ns (%.2f GB/s)\n", total_time, 
+         2.0 * ARRAY_SIZE * sizeof(float)/total_time);
+   printf("Host time = %lu ns\n", 
+         (cl_ulong)(1.0e9 * host_time/CLOCKS_PER_SEC));
+
+   /* Deallocate resources */
+   clReleaseEvent(start_event);
+   clReleaseEvent(end_event);
+   clReleaseMemObject(keys_buffer);
+   clReleaseMemObject(values_buffer);
+   clReleaseMemObject(head_counts_buffer);
+   clReleaseMemObject(offsets_buffer);
+   clReleaseMemObject(carries_buffer);
+   clReleaseMemObject(out_keys_buffer);
+   clReleaseMemObject(out_sum_buffer);
+   clReleaseMemObject(out_count_buffer);
+   clReleaseMemObject(out_min_buffer);
+   clReleaseMemObject(out_max_buffer);
+   clReleaseKernel(count_kernel);
+   clReleaseKernel(scan_kernel);
+   clReleaseKernel(reduce_kernel);
+   clReleaseKernel(fixup_kernel);
+   clReleaseCommandQueue(queue);
+   clReleaseProgram(program);
+   clReleaseContext(context);
+   free(keys);
+   free(values);
+   free(host_keys);
+   free(host_sum);
+   free(host_count);
+   free(host_min);
+   free(host_max);
+   free(dev_keys);
+   free(dev_sum);
+   free(dev_count);
+   free(dev_min);
+   free(dev_max);
+   return 0;
+}
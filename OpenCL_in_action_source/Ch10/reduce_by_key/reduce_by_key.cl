@@ -0,0 +1,157 @@
+/* Aggregates are kept as (sum, min, max, count) */
+#define COMBINE(a, b) (float4)(a.x + b.x, fmin(a.y, b.y), fmax(a.z, b.z), a.w + b.w)
+
+/* Count segment heads in each work-group */
+__kernel void rbk_count(__global int* keys, uint num_elements,
+      __local int* partial_counts, __global int* head_counts) {
+
+   uint gid = get_global_id(0);
+   int lid = get_local_id(0);
+   int group_size = get_local_size(0);
+
+   partial_counts[lid] = (gid < num_elements) && 
+         (gid == 0 || keys[gid] != keys[gid-1]);
+   barrier(CLK_LOCAL_MEM_FENCE);
+
+   for(int i = group_size/2; i>0; i >>= 1) {
+      if(lid < i) {
+         partial_counts[lid] += partial_counts[lid + i];
+      }
+      barrier(CLK_LOCAL_MEM_FENCE);
+   }
+
+   if(lid == 0) {
+      head_counts[get_group_id(0)] = partial_counts[0];
+   }
+}
+
+/* Exclusive scan of the head counts in a single work-group */
+__kernel void rbk_scan(__global int* head_counts, uint num_groups,
+      __local int* partial_sums, __global int* offsets) {
+
+   int lid = get_local_id(0);
+   int group_size = get_local_size(0);
+   int running_total = 0, value, i;
+
+   for(uint start = 0; start < num_groups; start += group_size) {
+
+      value = (start + lid < num_groups) ? head_counts[start + lid] : 0;
+      partial_sums[lid] = value;
+      barrier(CLK_LOCAL_MEM_FENCE);
+
+      /* Inclusive scan of this chunk */
+      for(int d = 1; d < group_size; d <<= 1) {
+         i = (lid >= d) ? partial_sums[lid - d] : 0;
+         barrier(CLK_LOCAL_MEM_FENCE);
+         partial_sums[lid] += i;
+         barrier(CLK_LOCAL_MEM_FENCE);
+      }
+
+      if(start + lid < num_groups) {
+         offsets[start + lid] = running_total + partial_sums[lid] - value;
+      }
+      running_total += partial_sums[group_size-1];
+      barrier(CLK_LOCAL_MEM_FENCE);
+   }
+
+   if(lid == 0) {
+      offsets[num_groups] = running_total;
+   }
+}
+
+/* Segmented reduction of each work-group's keys and values */
+__kernel void rbk_reduce(__global int* keys, __global float* values,
+      uint num_elements, __global int* offsets, 
+      __local float4* partial_aggs, __local int* partial_flags,
+      __local int* partial_heads, __global int* out_keys, 
+      __global float* out_sum, __global uint* out_count, 
+      __global float* out_min, __global float* out_max, 
+      __global float4* carries) {
+
+   uint gid = get_global_id(0);
+   int lid = get_local_id(0);
+   int group_size = get_local_size(0);
+   int active = gid < num_elements;
+   int head = active && (gid == 0 || keys[gid] != keys[gid-1]);
+   int flag, heads, last, pos;
+   float4 agg;
+
+   /* Inactive items start their own empty segment */
+   partial_aggs[lid] = active ? 
+         (float4)(values[gid], values[gid], values[gid], 1.0f) : 
+         (float4)(0.0f, INFINITY, -INFINITY, 0.0f);
+   partial_flags[lid] = head || !active;
+   partial_heads[lid] = head;
+   barrier(CLK_LOCAL_MEM_FENCE);
+
+   /* Segmented inclusive scan of aggregates and scan of head counts */
+   for(int d = 1; d < group_size; d <<= 1) {
+      if(lid >= d) {
+         agg = partial_aggs[lid - d];
+         flag = partial_flags[lid - d];
+         heads = partial_heads[lid - d];
+      }
+      barrier(CLK_LOCAL_MEM_FENCE);
+      if(lid >= d) {
+         if(!partial_flags[lid]) {
+            partial_aggs[lid] = COMBINE(agg, partial_aggs[lid]);
+         }
+         partial_flags[lid] |= flag;
+         partial_heads[lid] += heads;
+      }
+      barrier(CLK_LOCAL_MEM_FENCE);
+   }
+
+   /* The last item of each segment in the group writes its aggregate */
+   last = (lid == group_size-1) || (gid+1 >= num_elements) || 
+          (keys[gid+1] != keys[gid]);
+   if(active && last) {
+      agg = partial_aggs[lid];
+      if(partial_heads[lid] > 0) {
+         pos = offsets[get_group_id(0)] + partial_heads[lid] - 1;
+         out_keys[pos] = keys[gid];
+         out_sum[pos] = agg.x;
+         out_min[pos] = agg.y;
+         out_max[pos] = agg.z;
+         out_count[pos] = (uint)agg.w;
+      }
+      else {
+         /* Leading items continue a segment from an earlier group */
+         carries[get_group_id(0)] = agg;
+      }
+   }
+}
+
+/* Add carries to segments that span several work-groups */
+__kernel void rbk_fixup(__global int* keys, uint group_size, 
+      __global int* head_counts, __global int* offsets, 
+      __global float* out_sum, __global uint* out_count, 
+      __global float* out_min, __global float* out_max, 
+      __global float4* carries) {
+
+   uint g = get_global_id(0);
+   uint num_groups = get_global_size(0);
+   uint h, start;
+   int pos;
+   float4 carry;
+
+   /* Groups without a head don't own an output segment */
+   if(head_counts[g] == 0) {
+      return;
+   }
+
+   /* Walk forward while the next group continues the last segment */
+   pos = offsets[g+1] - 1;
+   for(h = g+1; h < num_groups; h++) {
+      start = h * group_size;
+      if(keys[start] != keys[start-1])
+         break;
+      carry = carries[h];
+      out_sum[pos] += carry.x;
+      out_min[pos] = fmin(out_min[pos], carry.y);
+      out_max[pos] = fmax(out_max[pos], carry.z);
+      out_count[pos] += (uint)carry.w;
+      if(head_counts[h] > 0)
+         break;
+   }
+}
@@ -0,0 +1,262 @@
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdlib.h>
+#include <time.h>
+#include "host_reduce.h"
+
+/* The vector paths are compiled with function target attributes and
+   chosen at run time, so the binary runs on any x86 processor */
+#if (defined(__GNUC__) || defined(__clang__)) && \
+      (defined(__x86_64__) || defined(__i386__))
+#define HOST_REDUCE_X86
+#include <immintrin.h>
+#endif
+
+#ifdef UNIX
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+#define MAX_THREADS 64
+
+/* Sum one slice with an unrolled loop and eight accumulators */
+static float reduce_scalar(const float *data, size_t num) {
+
+   float acc[8] = {0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f};
+   float sum = 0.0f;
+   size_t i = 0;
+   int j;
+
+   for(; i + 8 <= num; i += 8) {
+      for(j=0; j<8; j++) {
+         acc[j] += data[i + j];
+      }
+   }
+   for(j=0; j<8; j++) {
+      sum += acc[j];
+   }
+   for(; i < num; i++) {
+      sum += data[i];
+   }
+   return sum;
+}
+
+#ifdef HOST_REDUCE_X86
+
+/* Sum one slice with AVX-512 and four accumulators */
+__attribute__((target("avx512f")))
+static float reduce_avx512(const float *data, size_t num) {
+
+   __m512 acc0 = _mm512_setzero_ps(), acc1 = _mm512_setzero_ps();
+   __m512 acc2 = _mm512_setzero_ps(), acc3 = _mm512_setzero_ps();
+   size_t i = 0;
+   float sum;
+
+   for(; i + 64 <= num; i += 64) {
+      acc0 = _mm512_add_ps(acc0, _mm512_loadu_ps(data + i));
+      acc1 = _mm512_add_ps(acc1, _mm512_loadu_ps(data + i + 16));
+      acc2 = _mm512_add_ps(acc2, _mm512_loadu_ps(data + i + 32));
+      acc3 = _mm512_add_ps(acc3, _mm512_loadu_ps(data + i + 48));
+   }
+   acc0 = _mm512_add_ps(_mm512_add_ps(acc0, acc1), _mm512_add_ps(acc2, acc3));
+   sum = _mm512_reduce_add_ps(acc0);
+   for(; i < num; i++) {
+      sum += data[i];
+   }
+   return sum;
+}
+
+/* Sum one slice with AVX and four accumulators */
+__attribute__((target("avx")))
+static float reduce_avx(const float *data, size_t num) {
+
+   __m256 acc0 = _mm256_setzero_ps(), acc1 = _mm256_setzero_ps();
+   __m256 acc2 = _mm256_setzero_ps(), acc3 = _mm256_setzero_ps();
+   __m128 half;
+   size_t i = 0;
+   float sum;
+
+   for(; i + 32 <= num; i += 32) {
+      acc0 = _mm256_add_ps(acc0, _mm256_loadu_ps(data + i));
+      acc1 = _mm256_add_ps(acc1, _mm256_loadu_ps(data + i + 8));
+      acc2 = _mm256_add_ps(acc2, _mm256_loadu_ps(data + i + 16));
+      acc3 = _mm256_add_ps(acc3, _mm256_loadu_ps(data + i + 24));
+   }
+   acc0 = _mm256_add_ps(_mm256_add_ps(acc0, acc1), _mm256_add_ps(acc2, acc3));
+   half = _mm_add_ps(_mm256_castps256_ps128(acc0), 
+         _mm256_extractf128_ps(acc0, 1));
+   half = _mm_add_ps(half, _mm_movehl_ps(half, half));
+   half = _mm_add_ss(half, _mm_shuffle_ps(half, half, 1));
+   sum = _mm_cvtss_f32(half);
+   for(; i < num; i++) {
+      sum += data[i];
+   }
+   return sum;
+}
+
+#endif
+
+/* The slice reduction chosen by select_reduce */
+static float (*reduce_slice)(const float*, size_t) = reduce_scalar;
+
+/* Pick the widest vector path the processor supports */
+static void select_reduce(void) {
+
+#ifdef HOST_REDUCE_X86
+   __builtin_cpu_init();
+   if(__builtin_cpu_supports("avx512f"))
+      reduce_slice = reduce_avx512;
+   else if(__builtin_cpu_supports("avx"))
+      reduce_slice = reduce_avx;
+   else
+      reduce_slice = reduce_scalar;
+#else
+   reduce_slice = reduce_scalar;
+#endif
+}
+
+#ifdef UNIX
+
+unsigned long long host_time_ns(void) {
+
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* Pool state shared by the worker threads */
+static struct {
+   pthread_t threads[MAX_THREADS];
+   pthread_mutex_t lock;
+   pthread_cond_t start_cond, done_cond;
+   int num_threads, generation, remaining, quit;
+   const float *data;
+   size_t num;
+   float partial[MAX_THREADS];
+} pool;
+
+/* Sum slice id of the current job */
+static void reduce_part(int id) {
+
+   size_t start = pool.num * id/pool.num_threads;
+   size_t end = pool.num * (id + 1)/pool.num_threads;
+
+   pool.partial[id] = reduce_slice(pool.data + start, end - start);
+}
+
+/* Wait for a job, sum its slice and report back */
+static void* worker(void *arg) {
+
+   int id = (int)(size_t)arg;
+   int generation = 0;
+
+   pthread_mutex_lock(&pool.lock);
+   while(1) {
+      while(pool.generation == generation && !pool.quit)
+         pthread_cond_wait(&pool.start_cond, &pool.lock);
+      if(pool.quit)
+         break;
+      generation = pool.generation;
+      pthread_mutex_unlock(&pool.lock);
+
+      reduce_part(id);
+
+      pthread_mutex_lock(&pool.lock);
+      if(--pool.remaining == 0)
+         pthread_cond_signal(&pool.done_cond);
+   }
+   pthread_mutex_unlock(&pool.lock);
+   return NULL;
+}
+
+int host_reduce_init(int num_threads) {
+
+   int i;
+
+   if(num_threads <= 0)
+      num_threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+   if(num_threads <= 0)
+      num_threads = 1;
+   if(num_threads > MAX_THREADS)
+      num_threads = MAX_THREADS;
+   select_reduce();
+
+   pthread_mutex_init(&pool.lock, NULL);
+   pthread_cond_init(&pool.start_cond, NULL);
+   pthread_cond_init(&pool.done_cond, NULL);
+   pool.num_threads = num_threads;
+   pool.generation = 0;
+   pool.quit = 0;
+
+   /* The calling thread handles slice 0 */
+   for(i=1; i<num_threads; i++) {
+      pthread_create(&pool.threads[i], NULL, worker, (void*)(size_t)i);
+   }
+   return num_threads;
+}
+
+float host_reduce(const float *data, size_t num) {
+
+   float sum = 0.0f;
+   int i;
+
+   /* Publish the job and wake the workers */
+   pthread_mutex_lock(&pool.lock);
+   pool.data = data;
+   pool.num = num;
+   pool.remaining = pool.num_threads - 1;
+   pool.generation++;
+   pthread_cond_broadcast(&pool.start_cond);
+   pthread_mutex_unlock(&pool.lock);
+
+   reduce_part(0);
+
+   /* Wait for the other slices */
+   pthread_mutex_lock(&pool.lock);
+   while(pool.remaining > 0)
+      pthread_cond_wait(&pool.done_cond, &pool.lock);
+   pthread_mutex_unlock(&pool.lock);
+
+   for(i=0; i<pool.num_threads; i++) {
+      sum += pool.partial[i];
+   }
+   return sum;
+}
+
+void host_reduce_release(void) {
+
+   int i;
+
+   pthread_mutex_lock(&pool.lock);
+   pool.quit = 1;
+   pthread_cond_broadcast(&pool.start_cond);
+   pthread_mutex_unlock(&pool.lock);
+   for(i=1; i<pool.num_threads; i++) {
+      pthread_join(pool.threads[i], NULL);
+   }
+   pthread_mutex_destroy(&pool.lock);
+   pthread_cond_destroy(&pool.start_cond);
+   pthread_cond_destroy(&pool.done_cond);
+}
+
+#else
+
+unsigned long long host_time_ns(void) {
+   return (unsigned long long)(1.0e9 * clock()/CLOCKS_PER_SEC);
+}
+
+/* Without pthreads the whole array is summed by the calling thread */
+int host_reduce_init(int num_threads) {
+   select_reduce();
+   return 1;
+}
+
+float host_reduce(const float *data, size_t num) {
+   return reduce_slice(data, num);
+}
+
+void host_reduce_release(void) {
+}
+
+#endif
@@ -0,0 +1,25 @@
+/*
+*   Host reduction used to verify and stand in for the reduction kernels.
+*   The array is split across a pool of threads and each slice is summed
+*   with AVX-512, AVX or plain unrolled code, depending on what the
+*   processor supports.
+*/
+
+#ifndef HOST_REDUCE_H
+#define HOST_REDUCE_H
+
+#include <stddef.h>
+
+/* Start the thread pool; num_threads = 0 uses every online processor */
+int host_reduce_init(int num_threads);
+
+/* Sum num elements of data */
+float host_reduce(const float *data, size_t num);
+
+/* Wall-clock time in nanoseconds, for measuring the threaded reduction */
+unsigned long long host_time_ns(void);
+
+/* Stop the thread pool */
+void host_reduce_release(void);
+
+#endif
@@ -1,7 +1,8 @@
 #define _CRT_SECURE_NO_WARNINGS
 #define PROGRAM_FILE "reduction.cl"
 
-#define ARRAY_SIZE 1048576
+#define MIN_SIZE 65536
+#define ARRAY_SIZE 16777216
 #define NUM_KERNELS 2
 
 #include <math.h>
@@ -9,6 +10,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#include "host_reduce.h"
 
 #ifdef MAC
 #include <OpenCL/cl.h>
@@ -16,7 +18,8 @@
 #include <CL/cl.h>
 #endif
 
-/* Find a GPU or CPU associated with the first available platform */
+/* Find a GPU or CPU associated with the first available platform,
+   or return NULL so that the host reduction can be used instead */
 cl_device_id create_device() {
 
    cl_platform_id platform;
@@ -27,7 +30,7 @@ cl_device_id create_device() {
    err = clGetPlatformIDs(1, &platform, NULL);
    if(err < 0) {
       perror("Couldn't identify a platform");
-      exit(1);
+      return NULL;
    } 
 
    /* Access a device */
@@ -37,12 +40,20 @@ cl_device_id create_device() {
    }
    if(err < 0) {
       perror("Couldn't access any devices");
-      exit(1);   
+      return NULL;
    }
 
    return dev;
 }
 
+/* Return the host reduction time in nanoseconds */
+cl_ulong time_host_reduce(float *data, size_t num, float *sum) {
+
+   cl_ulong start = host_time_ns();
+   *sum = host_reduce(data, num);
+   return host_time_ns() - start;
+}
+
 /* Create program from a file and compile it */
 cl_program build_program(cl_context ctx, cl_device_id dev, const char* filename) {
 
@@ -104,41 +115,47 @@ int main() {
    cl_command_queue queue;
    cl_event prof_event;
    cl_int i, j, err;
-   size_t local_size, global_size;
+   size_t local_size, global_size, size;
    char kernel_names[NUM_KERNELS][20] = 
          {"reduction_scalar", "reduction_vector"};
 
    /* Data and buffers */
-   float data[ARRAY_SIZE];
-   float sum, actual_sum, *scalar_sum, *vector_sum;
-   cl_mem data_buffer, scalar_sum_buffer, vector_sum_buffer;
+   float *data, *partial_sums;
+   float sum, host_sum;
+   cl_mem data_buffer, sum_buffer;
    cl_int num_groups;
-   cl_ulong time_start, time_end, total_time;
+   cl_ulong time_start, time_end, total_time, host_time;
+   int num_threads;
 
    /* Initialize data */
+   data = (float*) malloc(ARRAY_SIZE * sizeof(float));
    for(i=0; i<ARRAY_SIZE; i++) {
-      data[i] = 1.0f*i;
+      data[i] = 1.0f*(i % 1024);
    }
+   num_threads = host_reduce_init(0);
+   printf("Host reduction uses %d threads\n\n", num_threads);
 
-   /* Create device and determine local size */
+   /* Fall back to the host reduction if there is no device */
    device = create_device();
+   if(device == NULL) {
+      for(size=MIN_SIZE; size<=ARRAY_SIZE; size*=4) {
+         host_time = time_host_reduce(data, size, &host_sum);
+         printf("Size %zu: host sum = %f, host %.2f GB/s\n", size, 
+               host_sum, 1.0 * size * sizeof(float)/host_time);
+      }
+      host_reduce_release();
+      free(data);
+      return 0;
+   }
+
+   /* Determine local size */
    err = clGetDeviceInfo(device, CL_DEVICE_MAX_WORK_GROUP_SIZE, 	
          sizeof(local_size), &local_size, NULL);	
    if(err < 0) {
       perror("Couldn't obtain device information");
       exit(1);   
    }
-
-   /* Allocate and initialize output arrays */
-   num_groups = ARRAY_SIZE/local_size;
-   scalar_sum = (float*) malloc(num_groups * sizeof(float));
-   vector_sum = (float*) malloc(num_groups/4 * sizeof(float));
-   for(i=0; i<num_groups; i++) {
-      scalar_sum[i] = 0.0f;
-   }
-   for(i=0; i<num_groups/4; i++) {
-      vector_sum[i] = 0.0f;
-   }
+   partial_sums = (float*) malloc(ARRAY_SIZE/local_size * sizeof(float));
 
    /* Create a context */
    context = clCreateContext(NULL, 1, &device, NULL, NULL, &err);
@@ -153,10 +170,8 @@ int main() {
    /* Create data buffer */
    data_buffer = clCreateBuffer(context, CL_MEM_READ_ONLY |
          CL_MEM_COPY_HOST_PTR, ARRAY_SIZE * sizeof(float), data, &err);
-   scalar_sum_buffer = clCreateBuffer(context, CL_MEM_READ_WRITE |
-         CL_MEM_COPY_HOST_PTR, num_groups * sizeof(float), scalar_sum, &err);
-   vector_sum_buffer = clCreateBuffer(context, CL_MEM_READ_WRITE |
-         CL_MEM_COPY_HOST_PTR, num_groups * sizeof(float), vector_sum, &err);
+   sum_buffer = clCreateBuffer(context, CL_MEM_READ_WRITE, 
+         ARRAY_SIZE/local_size * sizeof(float), NULL, &err);
    if(err < 0) {
       perror("Couldn't create a buffer");
       exit(1);   
@@ -170,95 +185,84 @@ int main() {
       exit(1);   
    };
 
+   /* Create kernels */
    for(i=0; i<NUM_KERNELS; i++) {
-
-      /* Create a kernel */
       kernel[i] = clCreateKernel(program, kernel_names[i], &err);
       if(err < 0) {
          perror("Couldn't create a kernel");
          exit(1);
       };
-
-      /* Create kernel arguments */
       err = clSetKernelArg(kernel[i], 0, sizeof(cl_mem), &data_buffer);
-      if(i == 0) {
-         global_size = ARRAY_SIZE;
-         err |= clSetKernelArg(kernel[i], 1, local_size * sizeof(float), NULL);
-         err |= clSetKernelArg(kernel[i], 2, sizeof(cl_mem), &scalar_sum_buffer);
-      }
-      else {
-         global_size = ARRAY_SIZE/4;
-         err |= clSetKernelArg(kernel[i], 1, local_size * 4 * sizeof(float), NULL);
-         err |= clSetKernelArg(kernel[i], 2, sizeof(cl_mem), &vector_sum_buffer);
-      }
+      err |= clSetKernelArg(kernel[i], 1, 
+            local_size * (i == 0 ? 1 : 4) * sizeof(float), NULL);
+      err |= clSetKernelArg(kernel[i], 2, sizeof(cl_mem), &sum_buffer);
       if(err < 0) {
          perror("Couldn't create a kernel argument");
          exit(1);   
       }
+   }
 
-      /* Enqueue kernel */
-      err = clEnqueueNDRangeKernel(queue, kernel[i], 1, NULL, &global_size, 
-            &local_size, 0, NULL, &prof_event); 
-      if(err < 0) {
-         perror("Couldn't enqueue the kernel");
-         exit(1);   
-      }
+   /* Compare each kernel with the host reduction at every size */
+   for(size=MIN_SIZE; size<=ARRAY_SIZE; size*=4) {
+
+      host_time = time_host_reduce(data, size, &host_sum);
+      printf("Size %zu: host %.2f GB/s\n", size, 
+            1.0 * size * sizeof(float)/host_time);
 
-      /* Finish processing the queue and get profiling information */
-      clFinish(queue);
-      clGetEventProfilingInfo(prof_event, CL_PROFILING_COMMAND_START,
-            sizeof(time_start), &time_start, NULL);
-      clGetEventProfilingInfo(prof_event, CL_PROFILING_COMMAND_END,
-            sizeof(time_end), &time_end, NULL);
-      total_time = time_end - time_start;
-
-      /* Read the result */
-      if(i == 0) {
-         err = clEnqueueReadBuffer(queue, scalar_sum_buffer, CL_TRUE, 0, 
-            num_groups * sizeof(float), scalar_sum, 0, NULL, NULL);
+      for(i=0; i<NUM_KERNELS; i++) {
+
+         /* Enqueue kernel */
+         global_size = (i == 0) ? size : size/4;
+         num_groups = global_size/local_size;
+         err = clEnqueueNDRangeKernel(queue, kernel[i], 1, NULL, 
+               &global_size, &local_size, 0, NULL, &prof_event); 
          if(err < 0) {
-            perror("Couldn't read the buffer");
+            perror("Couldn't enqueue the kernel");
             exit(1);   
          }
-         sum = 0.0f;
-         for(j=0; j<num_groups; j++) {
-            sum += scalar_sum[j];
-         }
-      }
-      else {
-         err = clEnqueueReadBuffer(queue, vector_sum_buffer, CL_TRUE, 0, 
-            num_groups/4 * sizeof(float), vector_sum, 0, NULL, NULL);
+
+         /* Finish processing the queue and get profiling information */
+         clFinish(queue);
+         clGetEventProfilingInfo(prof_event, CL_PROFILING_COMMAND_START,
+               sizeof(time_start), &time_start, NULL);
+         clGetEventProfilingInfo(prof_event, CL_PROFILING_COMMAND_END,
+               sizeof(time_end), &time_end, NULL);
+         total_time = time_end - time_start;
+
+         /* Read the partial sums and add them */
+         err = clEnqueueReadBuffer(queue, sum_buffer, CL_TRUE, 0, 
+            num_groups * sizeof(float), partial_sums, 0, NULL, NULL);
          if(err < 0) {
             perror("Couldn't read the buffer");
             exit(1);   
          }
          sum = 0.0f;
-         for(j=0; j<num_groups/4; j++) {
-            sum += vector_sum[j];
+         for(j=0; j<num_groups; j++) {
+            sum += partial_sums[j];
          }
-      }
 
-      /* Check result */
-      printf("%s: ", kernel_names[i]);
-      actual_sum = 1.0f * ARRAY_SIZE/2*(ARRAY_SIZE-1);
-      if(fabs(sum - actual_sum) > 0.01*fabs(sum))
-         printf("Check failed.\n");
-      else
-         printf("Check passed.\n");
-      printf("Total time = %lu\n\n", total_time);
-
-      /* Deallocate event */
-      clReleaseEvent(prof_event);
+         /* Check result against the host reduction */
+         printf("   %s: ", kernel_names[i]);
+         if(fabs(sum - host_sum) > 0.01*fabs(host_sum))
+            printf("Check failed.");
+         else
+            printf("Check passed.");
+         printf(" device %.2f GB/s\n", 1.0 * size * sizeof(float)/total_time);
+
+         /* Deallocate event */
+         clReleaseEvent(prof_event);
+      }
+      printf("\n");
    }
 
    /* Deallocate resources */
-   free(scalar_sum);
-   free(vector_sum);
+   host_reduce_release();
+   free(data);
+   free(partial_sums);
    for(i=0; i<NUM_KERNELS; i++) {
       clReleaseKernel(kernel[i]);
    }
-   clReleaseMemObject(scalar_sum_buffer);
-   clReleaseMemObject(vector_sum_buffer);
+   clReleaseMemObject(sum_buffer);
    clReleaseMemObject(data_buffer);
    clReleaseCommandQueue(queue);
    clReleaseProgram(program);
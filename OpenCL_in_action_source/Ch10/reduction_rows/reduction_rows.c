@@ -0,0 +1,300 @@
+#define _CRT_SECURE_NO_WARNINGS
+#define PROGRAM_FILE "reduction_rows.cl"
+
+#define MATRIX_SIZE 4194304
+#define NUM_LAYOUTS 4
+#define NUM_OPS 3
+#define ITEMS_PER_LANE 4
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef MAC
+#include <OpenCL/cl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+/* Find a GPU or CPU associated with the first available platform */
+cl_device_id create_device() {
+
+   cl_platform_id platform;
+   cl_device_id dev;
+   int err;
+
+   /* Identify a platform */
+   err = clGetPlatformIDs(1, &platform, NULL);
+   if(err < 0) {
+      perror("Couldn't identify a platform");
+      exit(1);
+   } 
+
+   /* Access a device */
+   err = clGetDeviceIDs(platform, CL_DEVICE_TYPE_GPU, 1, &dev, NULL);
+   if(err == CL_DEVICE_NOT_FOUND) {
+      err = clGetDeviceIDs(platform, CL_DEVICE_TYPE_CPU, 1, &dev, NULL);
+   }
+   if(err < 0) {
+      perror("Couldn't access any devices");
+      exit(1);   
+   }
+
+   return dev;
+}
+
+/* Create program from a file and compile it */
+cl_program build_program(cl_context ctx, cl_device_id dev, const char* filename) {
+
+   cl_program program;
+   FILE *program_handle;
+   char *program_buffer, *program_log;
+   size_t program_size, log_size;
+   int err;
+
+   /* Read program file and place content into buffer */
+   program_handle = fopen(filename, "r");
+   if(program_handle == NULL) {
+      perror("Couldn't find the program file");
+      exit(1);
+   }
+   fseek(program_handle, 0, SEEK_END);
+   program_size = ftell(program_handle);
+   rewind(program_handle);
+   program_buffer = (char*)malloc(program_size + 1);
+   program_buffer[program_size] = '\0';
+   fread(program_buffer, sizeof(char), program_size, program_handle);
+   fclose(program_handle);
+
+   /* Create program from file */
+   program = clCreateProgramWithSource(ctx, 1, 
+      (const char**)&program_buffer, &program_size, &err);
+   if(err < 0) {
+      perror("Couldn't create the program");
+      exit(1);
+   }
+   free(program_buffer);
+
+   /* Build program */
+   err = clBuildProgram(program, 0, NULL, NULL, NULL, NULL);
+   if(err < 0) {
+
+      /* Find size of log and print to std output */
+      clGetProgramBuildInfo(program, dev, CL_PROGRAM_BUILD_LOG, 
+            0, NULL, &log_size);
+      program_log = (char*) malloc(log_size + 1);
+      program_log[log_size] = '\0';
+      clGetProgramBuildInfo(program, dev, CL_PROGRAM_BUILD_LOG, 
+            log_size + 1, program_log, NULL);
+      printf("%s\n", program_log);
+      free(program_log);
+      exit(1);
+   }
+
+   return program;
+}
+
+/* Matrix layouts: rows, columns, row pitch and column stride in floats */
+typedef struct layout {
+   const char* name;
+   cl_uint num_rows, num_cols, row_pitch, col_stride;
+} layout;
+
+/* Choose how many work-items share a row: enough for ITEMS_PER_LANE
+   elements each, up to one work-group per row */
+size_t threads_per_row(cl_uint num_cols, size_t local_size) {
+
+   size_t threads = 1;
+   while(threads < local_size && threads * ITEMS_PER_LANE < num_cols)
+      threads <<= 1;
+   return threads;
+}
+
+/* Reduce every row with the host for checking */
+void host_reduce_rows(const float* data, layout* l, int op, float* result) {
+
+   cl_uint row, col;
+   double sum;
+   float value, max;
+
+   for(row=0; row<l->num_rows; row++) {
+      sum = 0.0;
+      max = -INFINITY;
+      for(col=0; col<l->num_cols; col++) {
+         value = data[row * l->row_pitch + col * l->col_stride];
+         sum += (op == 1) ? value * value : value;
+         if(value > max)
+            max = value;
+      }
+      result[row] = (op == 2) ? max : (float)sum;
+   }
+}
+
+int main() {
+
+   /* OpenCL structures */
+   cl_device_id device;
+   cl_context context;
+   cl_program program;
+   cl_kernel kernel[NUM_OPS];
+   cl_command_queue queue;
+   cl_event prof_event;
+   cl_int i, j, op, err, check;
+   cl_uint threads;
+   size_t local_size, global_size, rows_per_group;
+   cl_ulong time_start, time_end, total_time;
+
+   /* Data and buffers */
+   float *data, *result, *actual;
+   cl_mem data_buffer, output_buffer;
+   const char* kernel_names[NUM_OPS] = {"reduce_rows_sum", 
+         "reduce_rows_sum_squares", "reduce_rows_max"};
+
+   /* Short rows, padded rows, square rows, and the columns of a 
+      4096x1024 row-major matrix reduced as strided rows */
+   layout layouts[NUM_LAYOUTS] = {
+      {"short rows", 131072, 32, 32, 1},
+      {"padded rows", 1024, 4000, 4096, 1},
+      {"square rows", 2048, 2048, 2048, 1},
+      {"columns", 1024, 4096, 1, 1024}};
+
+   /* Initialize data */
+   data = (float*) malloc(MATRIX_SIZE * sizeof(float));
+   result = (float*) malloc(MATRIX_SIZE * sizeof(float));
+   actual = (float*) malloc(MATRIX_SIZE * sizeof(float));
+   srand(time(NULL));
+   for(i=0; i<MATRIX_SIZE; i++) {
+      data[i] = 2.0f * rand()/RAND_MAX - 1.0f;
+   }
+
+   /* Create device and context */
+   device = create_device();
+   err = clGetDeviceInfo(device, CL_DEVICE_MAX_WORK_GROUP_SIZE, 	
+         sizeof(local_size), &local_size, NULL);	
+   if(err < 0) {
+      perror("Couldn't obtain device information");
+      exit(1);   
+   }
+   local_size = (size_t)pow(2, trunc(log2(local_size)));
+   context = clCreateContext(NULL, 1, &device, NULL, NULL, &err);
+   if(err < 0) {
+      perror("Couldn't create a context");
+      exit(1);   
+   }
+
+   /* Build program */
+   program = build_program(context, device, PROGRAM_FILE);
+
+   /* Create data buffer */
+   data_buffer = clCreateBuffer(context, CL_MEM_READ_ONLY |
+         CL_MEM_COPY_HOST_PTR, MATRIX_SIZE * sizeof(float), data, &err);
+   output_buffer = clCreateBuffer(context, CL_MEM_WRITE_ONLY, 
+         MATRIX_SIZE * sizeof(float), NULL, &err);
+   if(err < 0) {
+      perror("Couldn't create a buffer");
+      exit(1);   
+   };
+
+   /* Create a command queue */
+   queue = clCreateCommandQueue(context, device, 
+         CL_QUEUE_PROFILING_ENABLE, &err);
+   if(err < 0) {
+      perror("Couldn't create a command queue");
+      exit(1);   
+   };
+
+   /* Create kernels */
+   for(op=0; op<NUM_OPS; op++) {
+      kernel[op] = clCreateKernel(program, kernel_names[op], &err);
+      if(err < 0) {
+         perror("Couldn't create a kernel");
+         exit(1);
+      };
+   }
+
+   for(i=0; i<NUM_LAYOUTS; i++) {
+
+      /* Assign rows to work-items */
+      threads = (cl_uint)threads_per_row(layouts[i].num_cols, local_size);
+      rows_per_group = local_size/threads;
+      global_size = (layouts[i].num_rows + rows_per_group - 1)/
+            rows_per_group * local_size;
+      printf("%s: %u x %u, pitch %u, stride %u, %u work-items per row\n",
+            layouts[i].name, layouts[i].num_rows, layouts[i].num_cols, 
+            layouts[i].row_pitch, layouts[i].col_stride, threads);
+
+      for(op=0; op<NUM_OPS; op++) {
+
+         /* Set kernel arguments */
+         err = clSetKernelArg(kernel[op], 0, sizeof(cl_mem), &data_buffer);
+         err |= clSetKernelArg(kernel[op], 1, sizeof(cl_uint), 
+               &layouts[i].num_rows);
+         err |= clSetKernelArg(kernel[op], 2, sizeof(cl_uint), 
+               &layouts[i].num_cols);
+         err |= clSetKernelArg(kernel[op], 3, sizeof(cl_uint), 
+               &layouts[i].row_pitch);
+         err |= clSetKernelArg(kernel[op], 4, sizeof(cl_uint), 
+               &layouts[i].col_stride);
+         err |= clSetKernelArg(kernel[op], 5, sizeof(cl_uint), &threads);
+         err |= clSetKernelArg(kernel[op], 6, local_size * sizeof(float), 
+               NULL);
+         err |= clSetKernelArg(kernel[op], 7, sizeof(cl_mem), 
+               &output_buffer);
+         if(err < 0) {
+            perror("Couldn't create a kernel argument");
+            exit(1);   
+         }
+
+         /* Reduce every row in a single launch */
+         err = clEnqueueNDRangeKernel(queue, kernel[op], 1, NULL, 
+               &global_size, &local_size, 0, NULL, &prof_event);
+         if(err < 0) {
+            perror("Couldn't enqueue the kernel");
+            exit(1);   
+         }
+         err = clEnqueueReadBuffer(queue, output_buffer, CL_TRUE, 0, 
+               layouts[i].num_rows * sizeof(float), result, 0, NULL, NULL);
+         if(err < 0) {
+            perror("Couldn't read the buffer");
+            exit(1);   
+         }
+         clGetEventProfilingInfo(prof_event, CL_PROFILING_COMMAND_START,
+               sizeof(time_start), &time_start, NULL);
+         clGetEventProfilingInfo(prof_event, CL_PROFILING_COMMAND_END,
+               sizeof(time_end), &time_end, NULL);
+         total_time = time_end - time_start;
+         clReleaseEvent(prof_event);
+
+         /* Check result */
+         host_reduce_rows(data, &layouts[i], op, actual);
+         check = 1;
+         for(j=0; j<layouts[i].num_rows; j++) {
+            if(fabs(result[j] - actual[j]) > 
+                  1.0e-5 * (fabs(actual[j]) + layouts[i].num_cols)) {
+               check = 0;
+               break;
+            }
+         }
+         printf("   %-24s%s %.2f GB/s\n", kernel_names[op], 
+               check ? "Check passed." : "Check failed.",
+               1.0 * layouts[i].num_rows * layouts[i].num_cols * 
+               sizeof(float)/total_time);
+      }
+   }
+
+   /* Deallocate resources */
+   for(op=0; op<NUM_OPS; op++) {
+      clReleaseKernel(kernel[op]);
+   }
+   clReleaseMemObject(data_buffer);
+   clReleaseMemObject(output_buffer);
+   clReleaseCommandQueue(queue);
+   clReleaseProgram(program);
+   clReleaseContext(context);
+   free(data);
+   free(result);
+   free(actual);
+   return 0;
+}
@@ -0,0 +1,71 @@
+#define OP_SUM 0
+#define OP_SUM_SQUARES 1
+#define OP_MAX 2
+
+/* Reduce rows with threads_per_row work-items each, so a work-group
+   covers one long row or several short rows */
+void reduce_rows(__global float* data, uint num_rows, uint num_cols, 
+      uint row_pitch, uint col_stride, uint threads_per_row, 
+      __local float* partial, __global float* output, int op) {
+
+   uint lid = get_local_id(0);
+   uint lane = lid % threads_per_row;
+   uint row = get_group_id(0) * (get_local_size(0)/threads_per_row) +
+              lid/threads_per_row;
+   float value, result = (op == OP_MAX) ? -INFINITY : 0.0f;
+
+   /* Each lane handles every threads_per_row-th element of its row */
+   if(row < num_rows) {
+      __global float* row_data = data + row * row_pitch;
+      for(uint col = lane; col < num_cols; col += threads_per_row) {
+         value = row_data[col * col_stride];
+         if(op == OP_SUM)
+            result += value;
+         else if(op == OP_SUM_SQUARES)
+            result += value * value;
+         else
+            result = fmax(result, value);
+      }
+   }
+   partial[lid] = result;
+   barrier(CLK_LOCAL_MEM_FENCE);
+
+   /* Tree reduction inside each row's segment of local memory */
+   for(uint i = threads_per_row/2; i>0; i >>= 1) {
+      if(lane < i) {
+         if(op == OP_MAX)
+            partial[lid] = fmax(partial[lid], partial[lid + i]);
+         else
+            partial[lid] += partial[lid + i];
+      }
+      barrier(CLK_LOCAL_MEM_FENCE);
+   }
+
+   if(lane == 0 && row < num_rows) {
+      output[row] = partial[lid];
+   }
+}
+
+__kernel void reduce_rows_sum(__global float* data, uint num_rows, 
+      uint num_cols, uint row_pitch, uint col_stride, uint threads_per_row,
+      __local float* partial, __global float* output) {
+
+   reduce_rows(data, num_rows, num_cols, row_pitch, col_stride, 
+         threads_per_row, partial, output, OP_SUM);
+}
+
+__kernel void reduce_rows_sum_squares(__global float* data, uint num_rows, 
+      uint num_cols, uint row_pitch, uint col_stride, uint threads_per_row,
+      __local float* partial, __global float* output) {
+
+   reduce_rows(data, num_rows, num_cols, row_pitch, col_stride, 
+         threads_per_row, partial, output, OP_SUM_SQUARES);
+}
+
+__kernel void reduce_rows_max(__global float* data, uint num_rows, 
+      uint num_cols, uint row_pitch, uint col_stride, uint threads_per_row,
+      __local float* partial, __global float* output) {
+
+   reduce_rows(data, num_rows, num_cols, row_pitch, col_stride, 
+         threads_per_row, partial, output, OP_MAX);
+}
@@ -0,0 +1,310 @@
+#define _CRT_SECURE_NO_WARNINGS
+#define PROGRAM_FILE "reduction_stats.cl"
+
+#define ARRAY_SIZE 16777216
+#define OFFSET 1000.0f
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef MAC
+#include <OpenCL/cl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+/* Find a GPU or CPU associated with the first available platform */
+cl_device_id create_device() {
+
+   cl_platform_id platform;
+   cl_device_id dev;
+   int err;
+
+   /* Identify a platform */
+   err = clGetPlatformIDs(1, &platform, NULL);
+   if(err < 0) {
+      perror("Couldn't identify a platform");
+      exit(1);
+   } 
+
+   /* Access a device */
+   err = clGetDeviceIDs(platform, CL_DEVICE_TYPE_GPU, 1, &dev, NULL);
+   if(err == CL_DEVICE_NOT_FOUND) {
+      err = clGetDeviceIDs(platform, CL_DEVICE_TYPE_CPU, 1, &dev, NULL);
+   }
+   if(err < 0) {
+      perror("Couldn't access any devices");
+      exit(1);   
+   }
+
+   return dev;
+}
+
+/* Create program from a file and compile it */
+cl_program build_program(cl_context ctx, cl_device_id dev, const char* filename) {
+
+   cl_program program;
+   FILE *program_handle;
+   char *program_buffer, *program_log;
+   size_t program_size, log_size;
+   int err;
+
+   /* Read program file and place content into buffer */
+   program_handle = fopen(filename, "r");
+   if(program_handle == NULL) {
+      perror("Couldn't find the program file");
+      exit(1);
+   }
+   fseek(program_handle, 0, SEEK_END);
+   program_size = ftell(program_handle);
+   rewind(program_handle);
+   program_buffer = (char*)malloc(program_size + 1);
+   program_buffer[program_size] = '\0';
+   fread(program_buffer, sizeof(char), program_size, program_handle);
+   fclose(program_handle);
+
+   /* Create program from file */
+   program = clCreateProgramWithSource(ctx, 1, 
+      (const char**)&program_buffer, &program_size, &err);
+   if(err < 0) {
+      perror("Couldn't create the program");
+      exit(1);
+   }
+   free(program_buffer);
+
+   /* Build program */
+   err = clBuildProgram(program, 0, NULL, NULL, NULL, NULL);
+   if(err < 0) {
+
+      /* Find size of log and print to std output */
+      clGetProgramBuildInfo(program, dev, CL_PROGRAM_BUILD_LOG, 
+            0, NULL, &log_size);
+      program_log = (char*) malloc(log_size + 1);
+      program_log[log_size] = '\0';
+      clGetProgramBuildInfo(program, dev, CL_PROGRAM_BUILD_LOG, 
+            log_size + 1, program_log, NULL);
+      printf("%s\n", program_log);
+      free(program_log);
+      exit(1);
+   }
+
+   return program;
+}
+
+/* Compute statistics of one or four columns and check them */
+void run_stats(cl_context context, cl_command_queue queue, 
+      cl_program program, cl_mem data_buffer, float *data, int columns, 
+      size_t local_size, size_t global_size) {
+
+   cl_kernel stats_kernel, complete_kernel;
+   cl_mem buffers[5];
+   cl_event start_event, end_event;
+   cl_uint num_partials, num_items;
+   cl_int i, j, err, check, combine_lanes;
+   cl_ulong time_start, time_end, total_time;
+   size_t sizes[5] = {sizeof(cl_uint4), sizeof(cl_float4), 
+         sizeof(cl_float4), sizeof(cl_float4), sizeof(cl_float4)};
+   cl_uint4 count;
+   cl_float4 mean, m2, min, max;
+   double sum, sum_sq, actual_mean, actual_var, var;
+   float actual_min, actual_max;
+
+   /* Create kernels */
+   stats_kernel = clCreateKernel(program, 
+         columns == 1 ? "stats_float" : "stats_float4", &err);
+   if(err < 0) {
+      perror("Couldn't create a kernel");
+      exit(1);
+   };
+   complete_kernel = clCreateKernel(program, "stats_complete", &err);
+   if(err < 0) {
+      perror("Couldn't create a kernel");
+      exit(1);
+   };
+
+   /* Create buffers for the per-group statistics */
+   num_partials = global_size/local_size;
+   for(i=0; i<5; i++) {
+      buffers[i] = clCreateBuffer(context, CL_MEM_READ_WRITE, 
+            num_partials * sizes[i], NULL, &err);
+      if(err < 0) {
+         perror("Couldn't create a buffer");
+         exit(1);   
+      };
+   }
+
+   /* Set kernel arguments */
+   num_items = ARRAY_SIZE/columns;
+   combine_lanes = (columns == 1);
+   err = clSetKernelArg(stats_kernel, 0, sizeof(cl_mem), &data_buffer);
+   err |= clSetKernelArg(stats_kernel, 1, sizeof(cl_uint), &num_items);
+   err |= clSetKernelArg(complete_kernel, 0, sizeof(cl_uint), &num_partials);
+   err |= clSetKernelArg(complete_kernel, 1, sizeof(cl_int), &combine_lanes);
+   for(i=0; i<5; i++) {
+      err |= clSetKernelArg(stats_kernel, i+2, local_size * sizes[i], NULL);
+      err |= clSetKernelArg(stats_kernel, i+7, sizeof(cl_mem), &buffers[i]);
+      err |= clSetKernelArg(complete_kernel, i+2, local_size * sizes[i], NULL);
+      err |= clSetKernelArg(complete_kernel, i+7, sizeof(cl_mem), &buffers[i]);
+   }
+   if(err < 0) {
+      perror("Couldn't create a kernel argument");
+      exit(1);   
+   }
+
+   /* Enqueue kernels */
+   err = clEnqueueNDRangeKernel(queue, stats_kernel, 1, NULL, &global_size, 
+         &local_size, 0, NULL, &start_event);
+   err |= clEnqueueNDRangeKernel(queue, complete_kernel, 1, NULL, &local_size, 
+         &local_size, 0, NULL, &end_event);
+   if(err < 0) {
+      perror("Couldn't enqueue the kernel");
+      exit(1);   
+   }
+
+   /* Read the result */
+   err = clEnqueueReadBuffer(queue, buffers[0], CL_TRUE, 0, 
+         sizeof(count), &count, 0, NULL, NULL);
+   err |= clEnqueueReadBuffer(queue, buffers[1], CL_TRUE, 0, 
+         sizeof(mean), &mean, 0, NULL, NULL);
+   err |= clEnqueueReadBuffer(queue, buffers[2], CL_TRUE, 0, 
+         sizeof(m2), &m2, 0, NULL, NULL);
+   err |= clEnqueueReadBuffer(queue, buffers[3], CL_TRUE, 0, 
+         sizeof(min), &min, 0, NULL, NULL);
+   err |= clEnqueueReadBuffer(queue, buffers[4], CL_TRUE, 0, 
+         sizeof(max), &max, 0, NULL, NULL);
+   if(err < 0) {
+      perror("Couldn't read the buffer");
+      exit(1);   
+   }
+   clGetEventProfilingInfo(start_event, CL_PROFILING_COMMAND_START,
+         sizeof(time_start), &time_start, NULL);
+   clGetEventProfilingInfo(end_event, CL_PROFILING_COMMAND_END,
+         sizeof(time_end), &time_end, NULL);
+   total_time = time_end - time_start;
+
+   /* Check each column against a two-pass host computation */
+   check = 1;
+   for(j=0; j<columns; j++) {
+      sum = 0.0;
+      actual_min = data[j];
+      actual_max = data[j];
+      for(i=j; i<num_items*columns; i+=columns) {
+         sum += data[i];
+         if(data[i] < actual_min)
+            actual_min = data[i];
+         if(data[i] > actual_max)
+            actual_max = data[i];
+      }
+      actual_mean = sum/num_items;
+      sum_sq = 0.0;
+      for(i=j; i<num_items*columns; i+=columns) {
+         sum_sq += (data[i] - actual_mean) * (data[i] - actual_mean);
+      }
+      actual_var = sum_sq/(num_items - 1);
+      var = m2.s[j]/(count.s[j] - 1);
+      printf("Column %d: count %u, mean %f, variance %f, min %f, max %f\n",
+            j, count.s[j], mean.s[j], var, min.s[j], max.s[j]);
+      if(count.s[j] != num_items || min.s[j] != actual_min || 
+         max.s[j] != actual_max ||
+         fabs(mean.s[j] - actual_mean) > 1.0e-5 * fabs(actual_mean) ||
+         fabs(var - actual_var) > 1.0e-3 * actual_var) {
+         check = 0;
+      }
+   }
+   printf("%s: %s %.2f GB/s\n\n", columns == 1 ? "stats_float" : 
+         "stats_float4", check ? "Check passed." : "Check failed.",
+         1.0 * num_items * columns * sizeof(float)/total_time);
+
+   /* Deallocate resources */
+   clReleaseEvent(start_event);
+   clReleaseEvent(end_event);
+   for(i=0; i<5; i++) {
+      clReleaseMemObject(buffers[i]);
+   }
+   clReleaseKernel(stats_kernel);
+   clReleaseKernel(complete_kernel);
+}
+
+int main() {
+
+   /* OpenCL structures */
+   cl_device_id device;
+   cl_context context;
+   cl_program program;
+   cl_command_queue queue;
+   cl_int i, err;
+   size_t local_size, global_size;
+   cl_uint compute_units;
+   cl_ulong local_mem_size;
+
+   /* Data and buffers */
+   float *data;
+   cl_mem data_buffer;
+
+   /* Initialize data around a large offset */
+   data = (float*) malloc(ARRAY_SIZE * sizeof(float));
+   srand(time(NULL));
+   for(i=0; i<ARRAY_SIZE; i++) {
+      data[i] = OFFSET + 1.0f * rand()/RAND_MAX;
+   }
+
+   /* Create device and determine sizes */
+   device = create_device();
+   err = clGetDeviceInfo(device, CL_DEVICE_MAX_WORK_GROUP_SIZE, 	
+         sizeof(local_size), &local_size, NULL);	
+   err |= clGetDeviceInfo(device, CL_DEVICE_MAX_COMPUTE_UNITS, 	
+         sizeof(compute_units), &compute_units, NULL);	
+   err |= clGetDeviceInfo(device, CL_DEVICE_LOCAL_MEM_SIZE, 
+         sizeof(local_mem_size), &local_mem_size, NULL);
+   if(err < 0) {
+      perror("Couldn't obtain device information");
+      exit(1);   
+   }
+   local_size = (size_t)pow(2, trunc(log2(local_size)));
+   while(local_size * 5 * sizeof(cl_float4) > local_mem_size)
+      local_size >>= 1;
+   global_size = compute_units * 8 * local_size;
+
+   /* Create a context */
+   context = clCreateContext(NULL, 1, &device, NULL, NULL, &err);
+   if(err < 0) {
+      perror("Couldn't create a context");
+      exit(1);   
+   }
+
+   /* Build program */
+   program = build_program(context, device, PROGRAM_FILE);
+
+   /* Create data buffer */
+   data_buffer = clCreateBuffer(context, CL_MEM_READ_ONLY |
+         CL_MEM_COPY_HOST_PTR, ARRAY_SIZE * sizeof(float), data, &err);
+   if(err < 0) {
+      perror("Couldn't create a buffer");
+      exit(1);   
+   };
+
+   /* Create a command queue */
+   queue = clCreateCommandQueue(context, device, 
+         CL_QUEUE_PROFILING_ENABLE, &err);
+   if(err < 0) {
+      perror("Couldn't create a command queue");
+      exit(1);   
+   };
+
+   /* Treat the data as one float column, then as four float columns */
+   run_stats(context, queue, program, data_buffer, data, 1, 
+         local_size, global_size);
+   run_stats(context, queue, program, data_buffer, data, 4, 
+         local_size, global_size);
+
+   /* Deallocate resources */
+   clReleaseMemObject(data_buffer);
+   clReleaseCommandQueue(queue);
+   clReleaseProgram(program);
+   clReleaseContext(context);
+   free(data);
+   return 0;
+}
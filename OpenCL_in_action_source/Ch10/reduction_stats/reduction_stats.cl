@@ -0,0 +1,160 @@
+/* Each lane holds count, mean, M2 (sum of squared deviations), min, max */
+typedef struct {
+   uint4 count;
+   float4 mean, m2, min, max;
+} stats4;
+
+/* Start with empty statistics */
+stats4 stats_init() {
+
+   stats4 s;
+   s.count = (uint4)(0);
+   s.mean = (float4)(0.0f);
+   s.m2 = (float4)(0.0f);
+   s.min = (float4)(INFINITY);
+   s.max = (float4)(-INFINITY);
+   return s;
+}
+
+/* Add one value to each lane (Welford) */
+stats4 stats_add(stats4 s, float4 x) {
+
+   float4 delta = x - s.mean;
+
+   s.count += 1;
+   s.mean += delta / convert_float4(s.count);
+   s.m2 += delta * (x - s.mean);
+   s.min = fmin(s.min, x);
+   s.max = fmax(s.max, x);
+   return s;
+}
+
+/* Combine two sets of statistics lane by lane (Chan et al.) */
+stats4 stats_merge(stats4 a, stats4 b) {
+
+   float4 na = convert_float4(a.count);
+   float4 nb = convert_float4(b.count);
+   float4 n = fmax(na + nb, 1.0f);
+   float4 delta = b.mean - a.mean;
+
+   a.count += b.count;
+   a.mean += delta * nb / n;
+   a.m2 += b.m2 + delta * delta * na * nb / n;
+   a.min = fmin(a.min, b.min);
+   a.max = fmax(a.max, b.max);
+   return a;
+}
+
+/* Store statistics in local or global memory */
+#define STATS_STORE(s, c, mu, q, lo, hi, i)                        \
+   c[i] = s.count; mu[i] = s.mean; q[i] = s.m2;                   \
+   lo[i] = s.min; hi[i] = s.max;                                  \
+
+#define STATS_LOAD(s, c, mu, q, lo, hi, i)                         \
+   s.count = c[i]; s.mean = mu[i]; s.m2 = q[i];                   \
+   s.min = lo[i]; s.max = hi[i];                                  \
+
+/* Merge the statistics of a work-group and write them to index out */
+void stats_group(stats4 s, __local uint4* l_count, __local float4* l_mean,
+      __local float4* l_m2, __local float4* l_min, __local float4* l_max,
+      __global uint4* g_count, __global float4* g_mean, 
+      __global float4* g_m2, __global float4* g_min, __global float4* g_max,
+      uint out) {
+
+   int lid = get_local_id(0);
+   int group_size = get_local_size(0);
+   stats4 other;
+
+   STATS_STORE(s, l_count, l_mean, l_m2, l_min, l_max, lid)
+   barrier(CLK_LOCAL_MEM_FENCE);
+
+   for(int i = group_size/2; i>0; i >>= 1) {
+      if(lid < i) {
+         STATS_LOAD(other, l_count, l_mean, l_m2, l_min, l_max, lid + i)
+         s = stats_merge(s, other);
+         STATS_STORE(s, l_count, l_mean, l_m2, l_min, l_max, lid)
+      }
+      barrier(CLK_LOCAL_MEM_FENCE);
+   }
+
+   if(lid == 0) {
+      STATS_STORE(s, g_count, g_mean, g_m2, g_min, g_max, out)
+   }
+}
+
+/* Per-group statistics of a float column, four lanes at a time */
+__kernel void stats_float(__global float* data, uint num_elements,
+      __local uint4* l_count, __local float4* l_mean, __local float4* l_m2,
+      __local float4* l_min, __local float4* l_max, 
+      __global uint4* g_count, __global float4* g_mean, 
+      __global float4* g_m2, __global float4* g_min, __global float4* g_max) {
+
+   uint i, num_vectors = num_elements/4;
+   stats4 s = stats_init(), tail;
+
+   for(i = get_global_id(0); i < num_vectors; i += get_global_size(0)) {
+      s = stats_add(s, vload4(i, data));
+   }
+
+   /* The first work-item adds the remaining values to lane 0 */
+   if(get_global_id(0) == 0) {
+      for(i = num_vectors * 4; i < num_elements; i++) {
+         tail = stats_init();
+         tail.count.s0 = 1;
+         tail.mean.s0 = data[i];
+         tail.min.s0 = data[i];
+         tail.max.s0 = data[i];
+         s = stats_merge(s, tail);
+      }
+   }
+
+   stats_group(s, l_count, l_mean, l_m2, l_min, l_max, 
+         g_count, g_mean, g_m2, g_min, g_max, get_group_id(0));
+}
+
+/* Per-group statistics of four interleaved float columns */
+__kernel void stats_float4(__global float4* data, uint num_vectors,
+      __local uint4* l_count, __local float4* l_mean, __local float4* l_m2,
+      __local float4* l_min, __local float4* l_max, 
+      __global uint4* g_count, __global float4* g_mean, 
+      __global float4* g_m2, __global float4* g_min, __global float4* g_max) {
+
+   stats4 s = stats_init();
+
+   for(uint i = get_global_id(0); i < num_vectors; i += get_global_size(0)) {
+      s = stats_add(s, data[i]);
+   }
+
+   stats_group(s, l_count, l_mean, l_m2, l_min, l_max, 
+         g_count, g_mean, g_m2, g_min, g_max, get_group_id(0));
+}
+
+/* Merge the per-group statistics into index 0, combining lanes if asked */
+__kernel void stats_complete(uint num_partials, int combine_lanes,
+      __local uint4* l_count, __local float4* l_mean, __local float4* l_m2,
+      __local float4* l_min, __local float4* l_max, 
+      __global uint4* g_count, __global float4* g_mean, 
+      __global float4* g_m2, __global float4* g_min, __global float4* g_max) {
+
+   stats4 s = stats_init(), other;
+
+   for(uint i = get_local_id(0); i < num_partials; i += get_local_size(0)) {
+      STATS_LOAD(other, g_count, g_mean, g_m2, g_min, g_max, i)
+      s = stats_merge(s, other);
+   }
+
+   /* Make sure every partial has been read before index 0 is replaced */
+   barrier(CLK_GLOBAL_MEM_FENCE);
+
+   if(combine_lanes) {
+      other.count = s.count.zwxy; other.mean = s.mean.zwxy; 
+      other.m2 = s.m2.zwxy; other.min = s.min.zwxy; other.max = s.max.zwxy;
+      s = stats_merge(s, other);
+      other.count = s.count.yxwz; other.mean = s.mean.yxwz; 
+      other.m2 = s.m2.yxwz; other.min = s.min.yxwz; other.max = s.max.yxwz;
+      s = stats_merge(s, other);
+   }
+
+   stats_group(s, l_count, l_mean, l_m2, l_min, l_max, 
+         g_count, g_mean, g_m2, g_min, g_max, 0);
+}
@@ -0,0 +1,686 @@
+#define _CRT_SECURE_NO_WARNINGS
+#define _POSIX_C_SOURCE 200112L
+#define PROGRAM_FILE "aho_corasick.cl"
+#define SEARCH_FILE "../string_search/string_search.cl"
+#define TEXT_FILE "../string_search/kafka.txt"
+
+#define NUM_PATTERNS 4096
+#define MIN_WORD 2
+#define GROUPS_PER_UNIT 8
+#define MAX_LOCAL_SIZE 256
+
+/* The text is TEXT_COPIES copies of the text file, about 4 GB, searched
+   in chunks of CHUNK_SIZE characters as in string_search. Each chunk is
+   uploaded with the first OVERLAP characters of the next, which
+   string_search reads past the end of the chunk */
+#define TEXT_COPIES 32768
+#define CHUNK_SIZE 67108864
+#define OVERLAP 4
+
+#include <ctype.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef MAC
+#include <OpenCL/cl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+/* Aho-Corasick automaton. transitions holds num_classes entries per
+   state and outputs holds two ints per state: the pattern ending at the
+   state (or -1) and the next state on the failure chain that ends a
+   pattern (or 0) */
+typedef struct automaton {
+   cl_uchar char_class[256];
+   cl_uint num_classes, num_states, max_states, num_patterns, max_length;
+   cl_uint *transitions;
+   cl_int *outputs;
+   const char *patterns[NUM_PATTERNS];
+   cl_uint lengths[NUM_PATTERNS];
+} automaton;
+
+/* A text made of copies of a file. copies holds enough of them that
+   every chunk, with the characters around it, can be read from a
+   position within the first copy */
+typedef struct repeated_text {
+   cl_ulong size;
+   int num_chunks;
+   size_t file_size;
+   char *copies;
+} repeated_text;
+
+/* Find a GPU or CPU associated with the first available platform */
+cl_device_id create_device() {
+
+   cl_platform_id platform;
+   cl_device_id dev;
+   int err;
+
+   /* Identify a platform */
+   err = clGetPlatformIDs(1, &platform, NULL);
+   if(err < 0) {
+      perror("Couldn't identify a platform");
+      exit(1);
+   } 
+
+   /* Access a device */
+   err = clGetDeviceIDs(platform, CL_DEVICE_TYPE_GPU, 1, &dev, NULL);
+   if(err == CL_DEVICE_NOT_FOUND) {
+      err = clGetDeviceIDs(platform, CL_DEVICE_TYPE_CPU, 1, &dev, NULL);
+   }
+   if(err < 0) {
+      perror("Couldn't access any devices");
+      exit(1);   
+   }
+
+   return dev;
+}
+
+/* Create program from a file and compile it */
+cl_program build_program(cl_context ctx, cl_device_id dev, const char* filename,
+      const char* options) {
+
+   cl_program program;
+   FILE *program_handle;
+   char *program_buffer, *program_log;
+   size_t program_size, log_size;
+   int err;
+
+   /* Read program file and place content into buffer */
+   program_handle = fopen(filename, "r");
+   if(program_handle == NULL) {
+      perror("Couldn't find the program file");
+      exit(1);
+   }
+   fseek(program_handle, 0, SEEK_END);
+   program_size = ftell(program_handle);
+   rewind(program_handle);
+   program_buffer = (char*)malloc(program_size + 1);
+   program_buffer[program_size] = '\0';
+   fread(program_buffer, sizeof(char), program_size, program_handle);
+   fclose(program_handle);
+
+   /* Create program from file */
+   program = clCreateProgramWithSource(ctx, 1, 
+      (const char**)&program_buffer, &program_size, &err);
+   if(err < 0) {
+      perror("Couldn't create the program");
+      exit(1);
+   }
+   free(program_buffer);
+
+   /* Build program */
+   err = clBuildProgram(program, 0, NULL, options, NULL, NULL);
+   if(err < 0) {
+
+      /* Find size of log and print to std output */
+      clGetProgramBuildInfo(program, dev, CL_PROGRAM_BUILD_LOG, 
+            0, NULL, &log_size);
+      program_log = (char*) malloc(log_size + 1);
+      program_log[log_size] = '\0';
+      clGetProgramBuildInfo(program, dev, CL_PROGRAM_BUILD_LOG, 
+            log_size + 1, program_log, NULL);
+      printf("%s\n", program_log);
+      free(program_log);
+      exit(1);
+   }
+
+   return program;
+}
+
+/* Read the wall clock in nanoseconds */
+unsigned long long wall_time_ns(void) {
+
+#ifdef UNIX
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#else
+   return (unsigned long long)(1.0e9 * clock()/CLOCKS_PER_SEC);
+#endif
+}
+
+/* Give every byte of the candidate patterns its own column in the 
+   transition table. All other bytes share column 0 */
+void init_automaton(automaton *ac, const char **candidates, 
+      const cl_uint *lengths, int num_candidates) {
+
+   int i;
+   cl_uint j;
+   unsigned char c;
+
+   memset(ac->char_class, 0, sizeof(ac->char_class));
+   ac->num_classes = 1;
+   for(i=0; i<num_candidates; i++) {
+      for(j=0; j<lengths[i]; j++) {
+         c = (unsigned char)candidates[i][j];
+         if(ac->char_class[c] == 0)
+            ac->char_class[c] = ac->num_classes++;
+      }
+   }
+   ac->num_states = 1;
+   ac->max_states = 1024;
+   ac->num_patterns = 0;
+   ac->max_length = 1;
+   ac->transitions = (cl_uint*) calloc(ac->max_states * ac->num_classes,
+         sizeof(cl_uint));
+   ac->outputs = (cl_int*) malloc(ac->max_states * 2 * sizeof(cl_int));
+   ac->outputs[0] = -1;
+   ac->outputs[1] = 0;
+}
+
+/* Insert a pattern into the trie. Returns 0 for a duplicate */
+int add_pattern(automaton *ac, const char *pattern, cl_uint length) {
+
+   cl_uint i, state = 0, *next;
+
+   for(i=0; i<length; i++) {
+      next = &ac->transitions[state * ac->num_classes + 
+            ac->char_class[(unsigned char)pattern[i]]];
+      if(*next == 0) {
+         if(ac->num_states == ac->max_states) {
+            ac->max_states *= 2;
+            ac->transitions = (cl_uint*) realloc(ac->transitions, 
+                  ac->max_states * ac->num_classes * sizeof(cl_uint));
+            ac->outputs = (cl_int*) realloc(ac->outputs, 
+                  ac->max_states * 2 * sizeof(cl_int));
+            memset(ac->transitions + ac->num_states * ac->num_classes, 0,
+                  (ac->max_states - ac->num_states) * ac->num_classes * 
+                  sizeof(cl_uint));
+            next = &ac->transitions[state * ac->num_classes + 
+                  ac->char_class[(unsigned char)pattern[i]]];
+         }
+         ac->outputs[ac->num_states * 2] = -1;
+         ac->outputs[ac->num_states * 2 + 1] = 0;
+         *next = ac->num_states++;
+      }
+      state = *next;
+   }
+   if(ac->outputs[state * 2] >= 0)
+      return 0;
+
+   ac->outputs[state * 2] = ac->num_patterns;
+   ac->patterns[ac->num_patterns] = pattern;
+   ac->lengths[ac->num_patterns] = length;
+   ac->num_patterns++;
+   if(length > ac->max_length)
+      ac->max_length = length;
+   return 1;
+}
+
+/* Compute failure links breadth-first, replace every missing edge with 
+   the edge of the failure state, and renumber the states in
+   breadth-first order so the shallow states that most characters visit
+   share cache lines at the start of the table */
+void finish_automaton(automaton *ac) {
+
+   cl_uint *queue, *fail, *rank, *transitions;
+   cl_uint head, tail, state, next, c, C = ac->num_classes;
+   cl_int *outputs;
+
+   queue = (cl_uint*) malloc(ac->num_states * sizeof(cl_uint));
+   fail = (cl_uint*) malloc(ac->num_states * sizeof(cl_uint));
+   rank = (cl_uint*) malloc(ac->num_states * sizeof(cl_uint));
+
+   head = 0; tail = 0;
+   queue[tail++] = 0;
+   fail[0] = 0;
+   while(head < tail) {
+      state = queue[head++];
+      for(c=0; c<C; c++) {
+         next = ac->transitions[state * C + c];
+         if(next != 0) {
+            fail[next] = (state == 0) ? 0 : 
+                  ac->transitions[fail[state] * C + c];
+            ac->outputs[next * 2 + 1] = 
+                  (ac->outputs[fail[next] * 2] >= 0) ? 
+                  (cl_int)fail[next] : ac->outputs[fail[next] * 2 + 1];
+            queue[tail++] = next;
+         }
+         else if(state != 0) {
+            ac->transitions[state * C + c] = 
+                  ac->transitions[fail[state] * C + c];
+         }
+      }
+   }
+
+   /* Renumber the states */
+   for(state=0; state<ac->num_states; state++) {
+      rank[queue[state]] = state;
+   }
+   transitions = (cl_uint*) malloc(ac->num_states * C * sizeof(cl_uint));
+   outputs = (cl_int*) malloc(ac->num_states * 2 * sizeof(cl_int));
+   for(state=0; state<ac->num_states; state++) {
+      for(c=0; c<C; c++) {
+         transitions[rank[state] * C + c] = 
+               rank[ac->transitions[state * C + c]];
+      }
+      outputs[rank[state] * 2] = ac->outputs[state * 2];
+      outputs[rank[state] * 2 + 1] = rank[ac->outputs[state * 2 + 1]];
+   }
+   free(ac->transitions);
+   free(ac->outputs);
+   ac->transitions = transitions;
+   ac->outputs = outputs;
+   ac->max_states = ac->num_states;
+
+   free(queue);
+   free(fail);
+   free(rank);
+}
+
+/* Count the patterns in the text on the host */
+void host_search(const automaton *ac, const unsigned char *text, 
+      size_t text_size, cl_uint *counts) {
+
+   size_t i;
+   cl_uint state = 0, out;
+
+   for(i=0; i<text_size; i++) {
+      state = ac->transitions[state * ac->num_classes + 
+            ac->char_class[text[i]]];
+      out = state;
+      if(ac->outputs[out * 2] < 0)
+         out = ac->outputs[out * 2 + 1];
+      while(ac->outputs[out * 2] >= 0) {
+         counts[ac->outputs[out * 2]]++;
+         out = ac->outputs[out * 2 + 1];
+      }
+   }
+}
+
+/* Find the characters of a chunk, the readable characters after them
+   and up to warmup characters before them, and return a pointer to the
+   first of those */
+const char* read_chunk(const repeated_text *text, int chunk, int warmup,
+      int *num_chars, int *readable, int *before) {
+
+   cl_ulong offset = (cl_ulong)chunk * CHUNK_SIZE;
+
+   *num_chars = (int)(text->size - offset < CHUNK_SIZE ? 
+         text->size - offset : CHUNK_SIZE);
+   *readable = (int)(text->size - offset < CHUNK_SIZE + OVERLAP ? 
+         text->size - offset : CHUNK_SIZE + OVERLAP);
+   *before = offset < (cl_ulong)warmup ? (int)offset : warmup;
+   return text->copies + (offset - *before) % text->file_size;
+}
+
+/* Search the text with a kernel that takes its chunk, sizes and counts
+   at the positions string_search uses, and whose other arguments are
+   set. Each chunk is uploaded with warmup characters before it while 
+   the device searches the previous one. The first chunk is preceded by
+   zeros, which match nothing, and the last is followed by them. The
+   num_counts counts of both slots are added into counts. Returns the
+   wall time in nanoseconds */
+unsigned long long stream_search(const repeated_text *text, 
+      cl_command_queue *queues, cl_kernel kernel, cl_mem *text_mems, 
+      cl_mem *count_mems, size_t global_size, size_t local_size, 
+      int warmup, cl_uint *counts, int num_counts) {
+
+   unsigned long long start;
+   const char *source, *zeros;
+   cl_uint *slot_counts;
+   int i, j, slot, err, num_chars, readable, before, chars_per_item;
+
+   zeros = (const char*) calloc(warmup + OVERLAP, sizeof(char));
+   slot_counts = (cl_uint*) calloc(num_counts, sizeof(cl_uint));
+   for(slot=0; slot<2; slot++) {
+      err = clEnqueueWriteBuffer(queues[slot], count_mems[slot], CL_TRUE,
+            0, num_counts * sizeof(cl_uint), slot_counts, 0, NULL, NULL);
+      if(err < 0) {
+         perror("Couldn't write the buffer");
+         exit(1);   
+      }
+   }
+
+   start = wall_time_ns();
+   for(i=0; i<=text->num_chunks; i++) {
+
+      /* Start the next chunk */
+      if(i < text->num_chunks) {
+         slot = i%2;
+         source = read_chunk(text, i, warmup, &num_chars, &readable, 
+               &before);
+         err = clEnqueueWriteBuffer(queues[slot], text_mems[slot], 
+               CL_FALSE, warmup - before, before + readable, source, 
+               0, NULL, NULL);
+         if(before < warmup)
+            err |= clEnqueueWriteBuffer(queues[slot], text_mems[slot], 
+                  CL_FALSE, 0, warmup - before, zeros, 0, NULL, NULL);
+         if(readable < num_chars + OVERLAP)
+            err |= clEnqueueWriteBuffer(queues[slot], text_mems[slot], 
+                  CL_FALSE, warmup + readable, num_chars + OVERLAP - 
+                  readable, zeros, 0, NULL, NULL);
+         if(err < 0) {
+            perror("Couldn't write the buffer");
+            exit(1);   
+         }
+
+         chars_per_item = (int)((num_chars + global_size - 1)/global_size);
+         err = clSetKernelArg(kernel, 1, sizeof(cl_mem), &text_mems[slot]);
+         err |= clSetKernelArg(kernel, 2, sizeof(int), &chars_per_item);
+         err |= clSetKernelArg(kernel, 3, sizeof(int), &num_chars);
+         err |= clSetKernelArg(kernel, 5, sizeof(cl_mem), &count_mems[slot]);
+         if(err < 0) {
+            perror("Couldn't create a kernel argument");
+            exit(1);   
+         };
+         err = clEnqueueNDRangeKernel(queues[slot], kernel, 1, NULL, 
+               &global_size, &local_size, 0, NULL, NULL); 
+         if(err < 0) {
+            perror("Couldn't enqueue the kernel");
+            exit(1);   
+         }
+         clFlush(queues[slot]);
+      }
+
+      /* Finish the previous chunk before its buffer is reused */
+      if(i > 0)
+         clFinish(queues[(i-1)%2]);
+   }
+   start = wall_time_ns() - start;
+
+   /* Read and combine the counts of both slots */
+   for(j=0; j<num_counts; j++) {
+      counts[j] = 0;
+   }
+   for(slot=0; slot<2; slot++) {
+      err = clEnqueueReadBuffer(queues[slot], count_mems[slot], CL_TRUE, 
+            0, num_counts * sizeof(cl_uint), slot_counts, 0, NULL, NULL);
+      if(err < 0) {
+         perror("Couldn't read the buffer");
+         exit(1);   
+      }
+      for(j=0; j<num_counts; j++) {
+         counts[j] += slot_counts[j];
+      }
+   }
+   free((void*)zeros);
+   free(slot_counts);
+   return start;
+}
+
+/* Collect the words of the text and the pairs of words joined by a 
+   single space as candidate patterns */
+int collect_candidates(const char *text, size_t text_size, 
+      const char **candidates, cl_uint *lengths, int max_candidates) {
+
+   size_t i = 0, start, end;
+   int num_candidates = 0;
+
+   while(i < text_size && num_candidates < max_candidates - 1) {
+      while(i < text_size && !isalpha((unsigned char)text[i]))
+         i++;
+      start = i;
+      while(i < text_size && isalpha((unsigned char)text[i]))
+         i++;
+      if(i - start < MIN_WORD)
+         continue;
+      candidates[num_candidates] = text + start;
+      lengths[num_candidates++] = (cl_uint)(i - start);
+
+      /* Add the following word, if it's separated by one space */
+      end = i + 1;
+      if(i < text_size && text[i] == ' ' && end < text_size && 
+            isalpha((unsigned char)text[end])) {
+         while(end < text_size && isalpha((unsigned char)text[end]))
+            end++;
+         candidates[num_candidates] = text + start;
+         lengths[num_candidates++] = (cl_uint)(end - start);
+      }
+   }
+   return num_candidates;
+}
+
+int main() {
+
+   /* OpenCL structures */
+   cl_device_id device;
+   cl_context context;
+   cl_program program, search_program;
+   cl_kernel kernel, search_kernel;
+   cl_command_queue queues[2];
+   cl_int i, err, slot, check;
+   cl_uint compute_units, warmup;
+   cl_ulong local_mem_size;
+   size_t local_size, search_local_size, global_size, search_global_size;
+   unsigned long long ac_time, search_time;
+   char options[32];
+
+   /* Data and buffers */
+   static const char *search_words[4] = {"that", "with", "have", "from"};
+   char pattern[16] = {'t','h','a','t','w','i','t','h',
+         'h','a','v','e','f','r','o','m'}, previous = 0;
+   automaton ac;
+   repeated_text text;
+   FILE *text_handle;
+   char *file_text;
+   const char **candidates;
+   cl_uint *candidate_lengths, *counts, *check_counts, *pair_counts, 
+         result[4];
+   size_t file_size, copies_size, j;
+   int num_candidates;
+   cl_mem text_mems[2], count_mems[2], result_mems[2], class_buffer, 
+         transitions_buffer, outputs_buffer;
+
+   /* Create device and context */
+   device = create_device();
+   err = clGetDeviceInfo(device, CL_DEVICE_MAX_COMPUTE_UNITS, 
+         sizeof(compute_units), &compute_units, NULL);
+   err |= clGetDeviceInfo(device, CL_DEVICE_LOCAL_MEM_SIZE, 
+         sizeof(local_mem_size), &local_mem_size, NULL);
+   if(err < 0) {
+      perror("Couldn't obtain device information");
+      exit(1);   
+   }
+   context = clCreateContext(NULL, 1, &device, NULL, NULL, &err);
+   if(err < 0) {
+      perror("Couldn't create a context");
+      exit(1);   
+   }
+
+   /* Read text file and place content into buffer */
+   text_handle = fopen(TEXT_FILE, "rb");
+   if(text_handle == NULL) {
+      perror("Couldn't find the text file");
+      exit(1);
+   }
+   fseek(text_handle, 0, SEEK_END);
+   file_size = ftell(text_handle);
+   rewind(text_handle);
+   file_text = (char*)malloc(file_size);
+   fread(file_text, sizeof(char), file_size, text_handle);
+   fclose(text_handle);
+
+   /* Build the automaton from the string_search words and the words and
+      word pairs of the text */
+   candidates = (const char**) malloc(file_size * sizeof(const char*));
+   candidate_lengths = (cl_uint*) malloc(file_size * sizeof(cl_uint));
+   for(i=0; i<4; i++) {
+      candidates[i] = search_words[i];
+      candidate_lengths[i] = 4;
+   }
+   num_candidates = 4 + collect_candidates(file_text, file_size, 
+         candidates + 4, candidate_lengths + 4, (int)file_size - 4);
+   init_automaton(&ac, candidates, candidate_lengths, num_candidates);
+   for(i=0; i<num_candidates && ac.num_patterns < NUM_PATTERNS; i++) {
+      add_pattern(&ac, candidates[i], candidate_lengths[i]);
+   }
+   finish_automaton(&ac);
+   warmup = ac.max_length - 1;
+   printf("Patterns: %u, longest: %u, states: %u, classes: %u\n", 
+         ac.num_patterns, ac.max_length, ac.num_states, ac.num_classes);
+   printf("Transition table: %lu bytes\n", (unsigned long)
+         (ac.num_states * ac.num_classes * sizeof(cl_uint)));
+
+   /* Repeat the file TEXT_COPIES times. Only the copies that a chunk
+      and its surroundings can span are held in memory */
+   text.file_size = file_size;
+   text.size = (cl_ulong)file_size * TEXT_COPIES;
+   text.num_chunks = (int)((text.size + CHUNK_SIZE - 1)/CHUNK_SIZE);
+   copies_size = 2 * file_size + warmup + CHUNK_SIZE + OVERLAP;
+   text.copies = (char*)malloc(copies_size);
+   for(j=0; j<copies_size; j++) {
+      text.copies[j] = file_text[j % file_size];
+   }
+   printf("Text: %d copies of %s, %llu bytes in %d chunks\n", TEXT_COPIES,
+         TEXT_FILE, (unsigned long long)text.size, text.num_chunks);
+
+   /* Build programs and create kernels. The counts go to global memory
+      if they don't fit in local memory */
+   options[0] = '\0';
+   if(ac.num_patterns * sizeof(cl_uint) > local_mem_size)
+      sprintf(options, "-DGLOBAL_COUNTS");
+   program = build_program(context, device, PROGRAM_FILE, options);
+   search_program = build_program(context, device, SEARCH_FILE, NULL);
+   kernel = clCreateKernel(program, "ac_search", &err);
+   if(err < 0) {
+      perror("Couldn't create a kernel");
+      exit(1);
+   };
+   search_kernel = clCreateKernel(search_program, "string_search", &err);
+   if(err < 0) {
+      perror("Couldn't create a kernel");
+      exit(1);
+   };
+
+   /* Determine work sizes */
+   err = clGetKernelWorkGroupInfo(kernel, device, 
+         CL_KERNEL_WORK_GROUP_SIZE, sizeof(local_size), &local_size, NULL);
+   err |= clGetKernelWorkGroupInfo(search_kernel, device, 
+         CL_KERNEL_WORK_GROUP_SIZE, sizeof(search_local_size), 
+         &search_local_size, NULL);
+   if(err < 0) {
+      perror("Couldn't obtain device information");
+      exit(1);   
+   }
+   if(local_size > MAX_LOCAL_SIZE)
+      local_size = MAX_LOCAL_SIZE;
+   global_size = compute_units * GROUPS_PER_UNIT * local_size;
+   search_local_size = (size_t)pow(2, trunc(log2(search_local_size)));
+   search_global_size = compute_units * search_local_size;
+
+   /* Create buffers, and a queue and buffers for each of the two chunks
+      in flight */
+   counts = (cl_uint*) calloc(ac.num_patterns, sizeof(cl_uint));
+   check_counts = (cl_uint*) calloc(ac.num_patterns, sizeof(cl_uint));
+   pair_counts = (cl_uint*) calloc(ac.num_patterns, sizeof(cl_uint));
+   class_buffer = clCreateBuffer(context, CL_MEM_READ_ONLY |
+         CL_MEM_COPY_HOST_PTR, sizeof(ac.char_class), ac.char_class, &err);
+   transitions_buffer = clCreateBuffer(context, CL_MEM_READ_ONLY |
+         CL_MEM_COPY_HOST_PTR, ac.num_states * ac.num_classes * 
+         sizeof(cl_uint), ac.transitions, &err);
+   outputs_buffer = clCreateBuffer(context, CL_MEM_READ_ONLY |
+         CL_MEM_COPY_HOST_PTR, ac.num_states * 2 * sizeof(cl_int), 
+         ac.outputs, &err);
+   if(err < 0) {
+      perror("Couldn't create a buffer");
+      exit(1);   
+   };
+   for(slot=0; slot<2; slot++) {
+      queues[slot] = clCreateCommandQueue(context, device, 0, &err);
+      if(err < 0) {
+         perror("Couldn't create a command queue");
+         exit(1);   
+      };
+      text_mems[slot] = clCreateBuffer(context, CL_MEM_READ_ONLY, 
+            warmup + CHUNK_SIZE + OVERLAP, NULL, &err);
+      count_mems[slot] = clCreateBuffer(context, CL_MEM_READ_WRITE, 
+            ac.num_patterns * sizeof(cl_uint), NULL, &err);
+      result_mems[slot] = clCreateBuffer(context, CL_MEM_READ_WRITE, 
+            sizeof(result), NULL, &err);
+      if(err < 0) {
+         perror("Couldn't create a buffer");
+         exit(1);   
+      };
+   }
+
+   /* Create kernel arguments. string_search is built without 
+      -DWHOLE_WORD, so it never reads previous */
+   err = clSetKernelArg(kernel, 0, sizeof(cl_mem), &class_buffer);
+   err |= clSetKernelArg(kernel, 4, options[0] ? sizeof(cl_uint) : 
+         ac.num_patterns * sizeof(cl_uint), NULL);
+   err |= clSetKernelArg(kernel, 6, sizeof(cl_uint), &warmup);
+   err |= clSetKernelArg(kernel, 7, sizeof(cl_mem), &transitions_buffer);
+   err |= clSetKernelArg(kernel, 8, sizeof(cl_uint), &ac.num_classes);
+   err |= clSetKernelArg(kernel, 9, sizeof(cl_mem), &outputs_buffer);
+   err |= clSetKernelArg(kernel, 10, sizeof(cl_uint), &ac.num_patterns);
+   err |= clSetKernelArg(search_kernel, 0, sizeof(pattern), pattern);
+   err |= clSetKernelArg(search_kernel, 4, 
+         search_local_size * 4 * sizeof(int), NULL);
+   err |= clSetKernelArg(search_kernel, 6, sizeof(char), &previous);
+   if(err < 0) {
+      perror("Couldn't create a kernel argument");
+      exit(1);   
+   }
+
+   /* Search for the four words of string_search, then for every pattern
+      of the automaton */
+   search_time = stream_search(&text, queues, search_kernel, text_mems, 
+         result_mems, search_global_size, search_local_size, 0, result, 4);
+   ac_time = stream_search(&text, queues, kernel, text_mems, count_mems, 
+         global_size, local_size, warmup, counts, ac.num_patterns);
+
+   /* Count the patterns in one and two copies on the host. Every copy
+      holds the matches of one copy and every boundary between copies
+      adds the matches that span it */
+   host_search(&ac, (unsigned char*)text.copies, file_size, check_counts);
+   host_search(&ac, (unsigned char*)text.copies, 2 * file_size, 
+         pair_counts);
+   for(i=0; i<(cl_int)ac.num_patterns; i++) {
+      check_counts[i] = TEXT_COPIES * check_counts[i] + (TEXT_COPIES - 1) * 
+            (pair_counts[i] - 2 * check_counts[i]);
+   }
+
+   /* Check every count against the host and the first four against 
+      string_search */
+   check = 1;
+   for(i=0; i<(cl_int)ac.num_patterns; i++) {
+      if(counts[i] != check_counts[i])
+         check = 0;
+   }
+   for(i=0; i<4; i++) {
+      printf("Number of occurrences of '%s': %u (string_search: %u)\n", 
+            search_words[i], counts[i], result[i]);
+      if(counts[i] != result[i])
+         check = 0;
+   }
+   printf("%s\n", check ? "Check passed." : "Check failed.");
+
+   /* Display timing */
+   printf("string_search, 4 patterns: %llu ns, %.3f GB/s\n", search_time,
+         (double)text.size/search_time);
+   printf("Aho-Corasick, %u patterns: %llu ns, %.3f GB/s\n", 
+         ac.num_patterns, ac_time, (double)text.size/ac_time);
+
+   /* Deallocate resources */
+   for(slot=0; slot<2; slot++) {
+      clReleaseMemObject(text_mems[slot]);
+      clReleaseMemObject(count_mems[slot]);
+      clReleaseMemObject(result_mems[slot]);
+      clReleaseCommandQueue(queues[slot]);
+   }
+   clReleaseMemObject(class_buffer);
+   clReleaseMemObject(transitions_buffer);
+   clReleaseMemObject(outputs_buffer);
+   clReleaseKernel(kernel);
+   clReleaseKernel(search_kernel);
+   clReleaseProgram(program);
+   clReleaseProgram(search_program);
+   clReleaseContext(context);
+   free(ac.transitions);
+   free(ac.outputs);
+   free(candidates);
+   free(candidate_lengths);
+   free(counts);
+   free(check_counts);
+   free(pair_counts);
+   free(file_text);
+   free(text.copies);
+   return 0;
+}
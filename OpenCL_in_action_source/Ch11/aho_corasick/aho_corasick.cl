@@ -0,0 +1,65 @@
+/* Matches are counted in local memory and flushed once per pattern per
+   group, unless the pattern counts don't fit and the host builds with
+   -DGLOBAL_COUNTS */
+#ifdef GLOBAL_COUNTS
+#define COUNT(id) atomic_inc(&counts[id])
+#else
+#define COUNT(id) atomic_inc(&l_counts[id])
+#endif
+
+/* Each work-item runs the automaton over chars_per_item characters of
+   the chunk. The chunk in text starts with warmup characters from
+   before it, the length of the longest pattern minus one, so the state
+   is correct when a work-item's slice begins without counting anything
+   that ends before it. Every match is counted by the work-item holding
+   its last character.
+
+   transitions holds num_classes states per row, in breadth-first order,
+   and char_class maps each byte to its column. outputs[state].x is the
+   pattern ending at the state or -1, and outputs[state].y is the next
+   state on the failure chain that ends a pattern, or 0 */
+__kernel void ac_search(__constant uchar *char_class, __global uchar *text,
+                        int chars_per_item, int num_chars,
+                        __local uint *l_counts, __global uint *counts,
+                        uint warmup, __global uint *transitions, 
+                        uint num_classes, __global int2 *outputs, 
+                        uint num_patterns) {
+
+   uint lid, j, state = 0;
+   int i, first, end;
+   int2 output;
+
+   lid = get_local_id(0);
+#ifndef GLOBAL_COUNTS
+   for(j = lid; j < num_patterns; j += get_local_size(0))
+      l_counts[j] = 0;
+   barrier(CLK_LOCAL_MEM_FENCE);
+#endif
+
+   first = min((int)get_global_id(0) * chars_per_item, num_chars);
+   end = min(first + chars_per_item, num_chars);
+
+   /* Bring the automaton up to date without counting */
+   for(i = first - (int)warmup; i < first; i++)
+      state = transitions[state * num_classes + char_class[text[i + warmup]]];
+
+   /* Count every pattern that ends in the slice */
+   for(; i < end; i++) {
+      state = transitions[state * num_classes + char_class[text[i + warmup]]];
+      output = outputs[state];
+      if(output.x < 0)
+         output = outputs[output.y];
+      while(output.x >= 0) {
+         COUNT(output.x);
+         output = outputs[output.y];
+      }
+   }
+
+#ifndef GLOBAL_COUNTS
+   barrier(CLK_LOCAL_MEM_FENCE);
+   for(j = lid; j < num_patterns; j += get_local_size(0)) {
+      if(l_counts[j] > 0)
+         atomic_add(&counts[j], l_counts[j]);
+   }
+#endif
+}
@@ -0,0 +1,452 @@
+#define _CRT_SECURE_NO_WARNINGS
+#define PROGRAM_FILE "argsort.cl"
+#define RADIX_FILE "../radix_sort/radix_sort.cl"
+
+#define NUM_ROWS 1000003
+#define NUM_COLUMNS 4
+#define GROUPS_PER_UNIT 8
+#define MAX_LOCAL_SIZE 256
+#define RADIX_BITS 4
+#define RADIX (1 << RADIX_BITS)
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef MAC
+#include <OpenCL/cl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+/* Find a GPU or CPU associated with the first available platform */
+cl_device_id create_device() {
+
+   cl_platform_id platform;
+   cl_device_id dev;
+   int err;
+
+   /* Identify a platform */
+   err = clGetPlatformIDs(1, &platform, NULL);
+   if(err < 0) {
+      perror("Couldn't identify a platform");
+      exit(1);
+   } 
+
+   /* Access a device */
+   err = clGetDeviceIDs(platform, CL_DEVICE_TYPE_GPU, 1, &dev, NULL);
+   if(err == CL_DEVICE_NOT_FOUND) {
+      err = clGetDeviceIDs(platform, CL_DEVICE_TYPE_CPU, 1, &dev, NULL);
+   }
+   if(err < 0) {
+      perror("Couldn't access any devices");
+      exit(1);   
+   }
+
+   return dev;
+}
+
+/* Create program from a file and compile it */
+cl_program build_program(cl_context ctx, cl_device_id dev, const char* filename,
+      const char* options) {
+
+   cl_program program;
+   FILE *program_handle;
+   char *program_buffer, *program_log;
+   size_t program_size, log_size;
+   int err;
+
+   /* Read program file and place content into buffer */
+   program_handle = fopen(filename, "r");
+   if(program_handle == NULL) {
+      perror("Couldn't find the program file");
+      exit(1);
+   }
+   fseek(program_handle, 0, SEEK_END);
+   program_size = ftell(program_handle);
+   rewind(program_handle);
+   program_buffer = (char*)malloc(program_size + 1);
+   program_buffer[program_size] = '\0';
+   fread(program_buffer, sizeof(char), program_size, program_handle);
+   fclose(program_handle);
+
+   /* Create program from file */
+   program = clCreateProgramWithSource(ctx, 1, 
+      (const char**)&program_buffer, &program_size, &err);
+   if(err < 0) {
+      perror("Couldn't create the program");
+      exit(1);
+   }
+   free(program_buffer);
+
+   /* Build program */
+   err = clBuildProgram(program, 0, NULL, options, NULL, NULL);
+   if(err < 0) {
+
+      /* Find size of log and print to std output */
+      clGetProgramBuildInfo(program, dev, CL_PROGRAM_BUILD_LOG, 
+            0, NULL, &log_size);
+      program_log = (char*) malloc(log_size + 1);
+      program_log[log_size] = '\0';
+      clGetProgramBuildInfo(program, dev, CL_PROGRAM_BUILD_LOG, 
+            log_size + 1, program_log, NULL);
+      printf("%s\n", program_log);
+      free(program_log);
+      exit(1);
+   }
+
+   return program;
+}
+
+/* A key and its row, for the stable sort on the host */
+typedef struct row_key {
+   double key;
+   cl_uint row;
+} row_key;
+
+/* Compare keys for qsort, breaking ties by row to keep the sort stable */
+int compare_rows(const void* a, const void* b) {
+
+   const row_key *row_a = (const row_key*)a, *row_b = (const row_key*)b;
+   if(row_a->key != row_b->key)
+      return (row_a->key > row_b->key) - (row_a->key < row_b->key);
+   return (row_a->row > row_b->row) - (row_a->row < row_b->row);
+}
+
+/* Sort the keys with the radix sort of Ch11/radix_sort, built with 
+   KEY_VALUE, carrying each key's row. The sort is stable, so rows with
+   equal keys keep their order. The keys end up sorted in keys_buffers[0]
+   and the permutation in perm_buffers[0]. Returns the device time */
+cl_ulong argsort(cl_command_queue queue, cl_kernel iota_kernel, 
+      cl_kernel* kernels, cl_mem* keys_buffers, cl_mem* perm_buffers, 
+      cl_mem hist_buffer, cl_uint num_rows, size_t local_size, 
+      cl_uint max_groups) {
+
+   cl_event start_event, end_event;
+   cl_uint shift, num_tiles, tiles_per_group, num_groups, num_entries;
+   cl_ulong time_start, time_end;
+   size_t global_size;
+   int pass, err;
+
+   /* Start from the identity permutation */
+   global_size = (num_rows + local_size - 1)/local_size * local_size;
+   err = clSetKernelArg(iota_kernel, 0, sizeof(cl_mem), &perm_buffers[0]);
+   err |= clSetKernelArg(iota_kernel, 1, sizeof(cl_uint), &num_rows);
+   err |= clEnqueueNDRangeKernel(queue, iota_kernel, 1, NULL, &global_size, 
+         &local_size, 0, NULL, &start_event);
+   if(err < 0) {
+      perror("Couldn't enqueue the kernel");
+      exit(1);   
+   }
+
+   /* Give every work-group a contiguous range of whole tiles */
+   num_tiles = (num_rows + local_size - 1)/local_size;
+   tiles_per_group = (num_tiles + max_groups - 1)/max_groups;
+   num_groups = (num_tiles + tiles_per_group - 1)/tiles_per_group;
+   num_entries = RADIX * num_groups;
+   global_size = num_groups * local_size;
+
+   for(shift = 0; shift < 32; shift += RADIX_BITS) {
+      pass = shift/RADIX_BITS;
+
+      /* Set kernel arguments */
+      err = clSetKernelArg(kernels[0], 0, sizeof(cl_mem), 
+            &keys_buffers[pass%2]);
+      err |= clSetKernelArg(kernels[0], 1, sizeof(cl_uint), &num_rows);
+      err |= clSetKernelArg(kernels[0], 2, sizeof(cl_uint), &shift);
+      err |= clSetKernelArg(kernels[0], 3, sizeof(cl_uint), &tiles_per_group);
+      err |= clSetKernelArg(kernels[0], 4, sizeof(cl_mem), &hist_buffer);
+      err |= clSetKernelArg(kernels[1], 0, sizeof(cl_mem), &hist_buffer);
+      err |= clSetKernelArg(kernels[1], 1, sizeof(cl_uint), &num_entries);
+      err |= clSetKernelArg(kernels[1], 2, local_size * sizeof(cl_uint), NULL);
+      err |= clSetKernelArg(kernels[2], 0, sizeof(cl_mem), 
+            &keys_buffers[pass%2]);
+      err |= clSetKernelArg(kernels[2], 1, sizeof(cl_uint), &num_rows);
+      err |= clSetKernelArg(kernels[2], 2, sizeof(cl_uint), &shift);
+      err |= clSetKernelArg(kernels[2], 3, sizeof(cl_uint), &tiles_per_group);
+      err |= clSetKernelArg(kernels[2], 4, sizeof(cl_mem), &hist_buffer);
+      err |= clSetKernelArg(kernels[2], 5, local_size * sizeof(cl_uint), NULL);
+      err |= clSetKernelArg(kernels[2], 6, local_size * sizeof(cl_uint), NULL);
+      err |= clSetKernelArg(kernels[2], 7, sizeof(cl_mem), 
+            &keys_buffers[(pass+1)%2]);
+      err |= clSetKernelArg(kernels[2], 8, sizeof(cl_mem), 
+            &perm_buffers[pass%2]);
+      err |= clSetKernelArg(kernels[2], 9, local_size * sizeof(cl_uint), NULL);
+      err |= clSetKernelArg(kernels[2], 10, sizeof(cl_mem), 
+            &perm_buffers[(pass+1)%2]);
+      if(err < 0) {
+         perror("Couldn't create a kernel argument");
+         exit(1);   
+      }
+
+      /* Count digits, scan the histograms and scatter keys and rows */
+      err = clEnqueueNDRangeKernel(queue, kernels[0], 1, NULL, &global_size, 
+            &local_size, 0, NULL, NULL);
+      err |= clEnqueueNDRangeKernel(queue, kernels[1], 1, NULL, &local_size, 
+            &local_size, 0, NULL, NULL);
+      err |= clEnqueueNDRangeKernel(queue, kernels[2], 1, NULL, &global_size, 
+            &local_size, 0, NULL, 
+            shift + RADIX_BITS >= 32 ? &end_event : NULL);
+      if(err < 0) {
+         perror("Couldn't enqueue the kernel");
+         exit(1);   
+      }
+   }
+   clFinish(queue);
+
+   clGetEventProfilingInfo(start_event, CL_PROFILING_COMMAND_START,
+         sizeof(time_start), &time_start, NULL);
+   clGetEventProfilingInfo(end_event, CL_PROFILING_COMMAND_END,
+         sizeof(time_end), &time_end, NULL);
+   clReleaseEvent(start_event);
+   clReleaseEvent(end_event);
+   return time_end - time_start;
+}
+
+int main() {
+
+   /* OpenCL structures */
+   cl_device_id device;
+   cl_context context;
+   cl_program program, radix_programs[2];
+   cl_kernel iota_kernel, gather_kernel, radix_kernels[2][3];
+   cl_command_queue queue;
+   cl_event event;
+   cl_int i, j, type, err, check;
+   cl_uint compute_units, max_groups, num_rows, num_columns, column_pitch;
+   cl_ulong max_alloc, sort_time, time_start, time_end;
+   size_t local_size, global_size;
+   clock_t host_start;
+   double host_time;
+   const char* radix_names[3] = {"radix_count", "radix_scan", 
+         "radix_scatter"};
+   const char* type_names[2] = {"float", "int"};
+   const char* type_options[2] = {"-DKEY_FLOAT -DKEY_VALUE", 
+         "-DKEY_INT -DKEY_VALUE"};
+
+   /* Data and buffers */
+   float *float_keys;
+   int *int_keys;
+   cl_uint *perm, *columns, *gathered;
+   row_key *rows;
+   cl_mem keys_buffers[2], perm_buffers[2], hist_buffer, columns_buffer,
+         gathered_buffer;
+
+   /* Create device and context */
+   device = create_device();
+   err = clGetDeviceInfo(device, CL_DEVICE_MAX_COMPUTE_UNITS, 
+         sizeof(compute_units), &compute_units, NULL);
+   err |= clGetDeviceInfo(device, CL_DEVICE_MAX_MEM_ALLOC_SIZE, 
+         sizeof(max_alloc), &max_alloc, NULL);
+   if(err < 0) {
+      perror("Couldn't obtain device information");
+      exit(1);   
+   }
+   context = clCreateContext(NULL, 1, &device, NULL, NULL, &err);
+   if(err < 0) {
+      perror("Couldn't create a context");
+      exit(1);   
+   }
+
+   /* Build the gather program and a radix sort for each key type */
+   program = build_program(context, device, PROGRAM_FILE, NULL);
+   iota_kernel = clCreateKernel(program, "iota", &err);
+   if(err < 0) {
+      perror("Couldn't create a kernel");
+      exit(1);
+   };
+   gather_kernel = clCreateKernel(program, "gather_columns", &err);
+   if(err < 0) {
+      perror("Couldn't create a kernel");
+      exit(1);
+   };
+   for(type=0; type<2; type++) {
+      radix_programs[type] = build_program(context, device, RADIX_FILE, 
+            type_options[type]);
+      for(i=0; i<3; i++) {
+         radix_kernels[type][i] = clCreateKernel(radix_programs[type], 
+               radix_names[i], &err);
+         if(err < 0) {
+            perror("Couldn't create a kernel");
+            exit(1);
+         };
+      }
+   }
+
+   /* Determine the work-group size */
+   err = clGetKernelWorkGroupInfo(radix_kernels[0][2], device, 
+         CL_KERNEL_WORK_GROUP_SIZE, sizeof(local_size), &local_size, NULL);
+   if(err < 0) {
+      perror("Couldn't find the maximum work-group size");
+      exit(1);   
+   };
+   local_size = (size_t)pow(2, trunc(log2(local_size)));
+   if(local_size > MAX_LOCAL_SIZE)
+      local_size = MAX_LOCAL_SIZE;
+   if(local_size < RADIX) {
+      printf("The radix sort needs %d work-items per group\n", RADIX);
+      exit(1);
+   }
+   max_groups = compute_units * GROUPS_PER_UNIT;
+
+   /* Keys with many ties, and columns of random values */
+   num_rows = NUM_ROWS;
+   num_columns = NUM_COLUMNS;
+   column_pitch = num_rows;
+   if(num_columns * column_pitch * sizeof(cl_uint) > max_alloc) {
+      printf("The columns don't fit in one buffer\n");
+      exit(1);
+   }
+   srand(time(NULL));
+   float_keys = (float*) malloc(num_rows * sizeof(float));
+   int_keys = (int*) malloc(num_rows * sizeof(int));
+   perm = (cl_uint*) malloc(num_rows * sizeof(cl_uint));
+   rows = (row_key*) malloc(num_rows * sizeof(row_key));
+   columns = (cl_uint*) malloc(num_columns * column_pitch * sizeof(cl_uint));
+   gathered = (cl_uint*) malloc(num_columns * column_pitch * 
+         sizeof(cl_uint));
+   for(i=0; i<num_rows; i++) {
+      float_keys[i] = (rand() % 1000) * 0.5f - 250.0f;
+      int_keys[i] = rand() % 1000 - 500;
+   }
+   for(i=0; i<num_columns * column_pitch; i++) {
+      columns[i] = ((cl_uint)rand() << 16) ^ (cl_uint)rand();
+   }
+
+   /* Create a command queue and buffers */
+   queue = clCreateCommandQueue(context, device, 
+         CL_QUEUE_PROFILING_ENABLE, &err);
+   if(err < 0) {
+      perror("Couldn't create a command queue");
+      exit(1);   
+   };
+   hist_buffer = clCreateBuffer(context, CL_MEM_READ_WRITE, 
+         RADIX * max_groups * sizeof(cl_uint), NULL, &err);
+   for(i=0; i<2; i++) {
+      keys_buffers[i] = clCreateBuffer(context, CL_MEM_READ_WRITE, 
+            num_rows * sizeof(cl_uint), NULL, &err);
+      perm_buffers[i] = clCreateBuffer(context, CL_MEM_READ_WRITE, 
+            num_rows * sizeof(cl_uint), NULL, &err);
+   }
+   columns_buffer = clCreateBuffer(context, CL_MEM_READ_ONLY | 
+         CL_MEM_COPY_HOST_PTR, num_columns * column_pitch * sizeof(cl_uint), 
+         columns, &err);
+   gathered_buffer = clCreateBuffer(context, CL_MEM_WRITE_ONLY, 
+         num_columns * column_pitch * sizeof(cl_uint), NULL, &err);
+   if(err < 0) {
+      perror("Couldn't create a buffer");
+      exit(1);   
+   };
+
+   /* Argsort each key type and compare with a stable host sort */
+   printf("Keys    Argsort   Check   qsort\n");
+   for(type=0; type<2; type++) {
+      err = clEnqueueWriteBuffer(queue, keys_buffers[0], CL_TRUE, 0, 
+            num_rows * sizeof(cl_uint), 
+            type ? (void*)int_keys : (void*)float_keys, 0, NULL, NULL);
+      if(err < 0) {
+         perror("Couldn't write the buffer");
+         exit(1);   
+      }
+      sort_time = argsort(queue, iota_kernel, radix_kernels[type], 
+            keys_buffers, perm_buffers, hist_buffer, num_rows, local_size, 
+            max_groups);
+      err = clEnqueueReadBuffer(queue, perm_buffers[0], CL_TRUE, 0, 
+            num_rows * sizeof(cl_uint), perm, 0, NULL, NULL);
+      if(err < 0) {
+         perror("Couldn't read the buffer");
+         exit(1);   
+      }
+
+      host_start = clock();
+      for(i=0; i<num_rows; i++) {
+         rows[i].key = type ? (double)int_keys[i] : (double)float_keys[i];
+         rows[i].row = i;
+      }
+      qsort(rows, num_rows, sizeof(row_key), compare_rows);
+      host_time = 1.0e3 * (clock() - host_start)/CLOCKS_PER_SEC;
+
+      check = 1;
+      for(i=0; i<num_rows; i++) {
+         if(perm[i] != rows[i].row) {
+            check = 0;
+            break;
+         }
+      }
+      printf("%-8s%-10.3f%-8s%.3f\n", type_names[type], 1.0e-6 * sort_time, 
+            check ? "passed" : "failed", host_time);
+   }
+
+   printf("Times in milliseconds\n");
+
+   /* Apply the last permutation to every column in one launch */
+   global_size = (num_rows + local_size - 1)/local_size * local_size;
+   err = clSetKernelArg(gather_kernel, 0, sizeof(cl_mem), &columns_buffer);
+   err |= clSetKernelArg(gather_kernel, 1, sizeof(cl_uint), &num_rows);
+   err |= clSetKernelArg(gather_kernel, 2, sizeof(cl_uint), &num_columns);
+   err |= clSetKernelArg(gather_kernel, 3, sizeof(cl_uint), &column_pitch);
+   err |= clSetKernelArg(gather_kernel, 4, sizeof(cl_mem), &perm_buffers[0]);
+   err |= clSetKernelArg(gather_kernel, 5, sizeof(cl_mem), &gathered_buffer);
+   if(err < 0) {
+      perror("Couldn't create a kernel argument");
+      exit(1);   
+   }
+   err = clEnqueueNDRangeKernel(queue, gather_kernel, 1, NULL, &global_size, 
+         &local_size, 0, NULL, &event);
+   err |= clEnqueueReadBuffer(queue, gathered_buffer, CL_TRUE, 0, 
+         num_columns * column_pitch * sizeof(cl_uint), gathered, 
+         0, NULL, NULL);
+   if(err < 0) {
+      perror("Couldn't gather the columns");
+      exit(1);   
+   }
+   clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_START,
+         sizeof(time_start), &time_start, NULL);
+   clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_END,
+         sizeof(time_end), &time_end, NULL);
+   clReleaseEvent(event);
+
+   check = 1;
+   for(j=0; j<num_columns; j++) {
+      for(i=0; i<num_rows; i++) {
+         if(gathered[j * column_pitch + i] != 
+               columns[j * column_pitch + perm[i]]) {
+            check = 0;
+            break;
+         }
+      }
+   }
+   printf("Gather of %u columns: %.3f ms, %.1f GB/s, %s\n", num_columns, 
+         1.0e-6 * (time_end - time_start), 
+         (2.0 * num_columns + 1) * num_rows * sizeof(cl_uint)/
+         (time_end - time_start), check ? "passed" : "failed");
+
+   /* Deallocate resources */
+   for(i=0; i<2; i++) {
+      clReleaseMemObject(keys_buffers[i]);
+      clReleaseMemObject(perm_buffers[i]);
+   }
+   clReleaseMemObject(hist_buffer);
+   clReleaseMemObject(columns_buffer);
+   clReleaseMemObject(gathered_buffer);
+   for(type=0; type<2; type++) {
+      for(i=0; i<3; i++) {
+         clReleaseKernel(radix_kernels[type][i]);
+      }
+      clReleaseProgram(radix_programs[type]);
+   }
+   clReleaseKernel(iota_kernel);
+   clReleaseKernel(gather_kernel);
+   clReleaseCommandQueue(queue);
+   clReleaseProgram(program);
+   clReleaseContext(context);
+   free(float_keys);
+   free(int_keys);
+   free(perm);
+   free(rows);
+   free(columns);
+   free(gathered);
+   return 0;
+}
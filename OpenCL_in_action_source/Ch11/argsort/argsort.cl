@@ -0,0 +1,26 @@
+/* Start the permutation as the identity */
+__kernel void iota(__global uint *perm, uint num_rows) {
+
+   uint row = get_global_id(0);
+
+   if(row < num_rows)
+      perm[row] = row;
+}
+
+/* Reorder num_columns columns of 32-bit values, stored column_pitch
+   elements apart, so that output row i holds input row perm[i]. Each
+   work-item reads its permutation entry once for every column */
+__kernel void gather_columns(__global uint *columns, uint num_rows,
+                             uint num_columns, uint column_pitch,
+                             __global uint *perm, __global uint *output) {
+
+   uint row = get_global_id(0), source, column;
+
+   if(row >= num_rows)
+      return;
+   source = perm[row];
+   for(column = 0; column < num_columns; column++) {
+      output[column * column_pitch + row] =
+            columns[column * column_pitch + source];
+   }
+}
@@ -0,0 +1,466 @@
+#define _CRT_SECURE_NO_WARNINGS
+#define _POSIX_C_SOURCE 200112L
+#define _FILE_OFFSET_BITS 64
+#define PROGRAM_FILE "bitap.cl"
+#define KERNEL_FUNC "bitap_search"
+#define TEXT_FILE "../string_search/kafka.txt"
+#define PATTERN "the chief clerk"
+
+/* Files are searched in chunks of CHUNK_SIZE characters, as in
+   string_search. Each chunk is uploaded after the pattern length plus
+   the number of errors characters before it, which bring the state up
+   to date */
+#define CHUNK_SIZE 67108864
+#define MAX_LENGTH 64
+#define MAX_ERRORS 4
+#define MAX_WARMUP (MAX_LENGTH + MAX_ERRORS)
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef UNIX
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef MAC
+#include <OpenCL/cl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+/* Find a GPU or CPU associated with the first available platform */
+cl_device_id create_device() {
+
+   cl_platform_id platform;
+   cl_device_id dev;
+   int err;
+
+   /* Identify a platform */
+   err = clGetPlatformIDs(1, &platform, NULL);
+   if(err < 0) {
+      perror("Couldn't identify a platform");
+      exit(1);
+   } 
+
+   /* Access a device */
+   err = clGetDeviceIDs(platform, CL_DEVICE_TYPE_GPU, 1, &dev, NULL);
+   if(err == CL_DEVICE_NOT_FOUND) {
+      err = clGetDeviceIDs(platform, CL_DEVICE_TYPE_CPU, 1, &dev, NULL);
+   }
+   if(err < 0) {
+      perror("Couldn't access any devices");
+      exit(1);   
+   }
+
+   return dev;
+}
+
+/* Create program from a file and compile it */
+cl_program build_program(cl_context ctx, cl_device_id dev, const char* filename,
+      const char* options) {
+
+   cl_program program;
+   FILE *program_handle;
+   char *program_buffer, *program_log;
+   size_t program_size, log_size;
+   int err;
+
+   /* Read program file and place content into buffer */
+   program_handle = fopen(filename, "r");
+   if(program_handle == NULL) {
+      perror("Couldn't find the program file");
+      exit(1);
+   }
+   fseek(program_handle, 0, SEEK_END);
+   program_size = ftell(program_handle);
+   rewind(program_handle);
+   program_buffer = (char*)malloc(program_size + 1);
+   program_buffer[program_size] = '\0';
+   fread(program_buffer, sizeof(char), program_size, program_handle);
+   fclose(program_handle);
+
+   /* Create program from file */
+   program = clCreateProgramWithSource(ctx, 1, 
+      (const char**)&program_buffer, &program_size, &err);
+   if(err < 0) {
+      perror("Couldn't create the program");
+      exit(1);
+   }
+   free(program_buffer);
+
+   /* Build program */
+   err = clBuildProgram(program, 0, NULL, options, NULL, NULL);
+   if(err < 0) {
+
+      /* Find size of log and print to std output */
+      clGetProgramBuildInfo(program, dev, CL_PROGRAM_BUILD_LOG, 
+            0, NULL, &log_size);
+      program_log = (char*) malloc(log_size + 1);
+      program_log[log_size] = '\0';
+      clGetProgramBuildInfo(program, dev, CL_PROGRAM_BUILD_LOG, 
+            log_size + 1, program_log, NULL);
+      printf("%s\n", program_log);
+      free(program_log);
+      exit(1);
+   }
+
+   return program;
+}
+
+/* Read the wall clock in nanoseconds */
+unsigned long long wall_time_ns(void) {
+
+#ifdef UNIX
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#else
+   return (unsigned long long)(1.0e9 * clock()/CLOCKS_PER_SEC);
+#endif
+}
+
+/* A text file read in chunks, through a mapping where available */
+typedef struct text_file {
+   cl_ulong size;
+   int num_chunks;
+   char *buffers[2];
+#ifdef UNIX
+   int fd;
+   const char *mapping;
+#else
+   FILE *handle;
+#endif
+} text_file;
+
+void open_text(text_file *file, const char *name) {
+
+   FILE *handle;
+#ifdef UNIX
+   struct stat file_stat;
+#endif
+
+   handle = fopen(name, "rb");
+   if(handle == NULL) {
+      perror("Couldn't find the text file");
+      exit(1);
+   }
+#ifdef UNIX
+   fclose(handle);
+   file->fd = open(name, O_RDONLY);
+   if(file->fd < 0 || fstat(file->fd, &file_stat) < 0) {
+      perror("Couldn't open the text file");
+      exit(1);
+   }
+   file->size = file_stat.st_size;
+   file->mapping = (const char*) mmap(NULL, file->size, PROT_READ, 
+         MAP_PRIVATE, file->fd, 0);
+   if(file->mapping == MAP_FAILED) {
+      perror("Couldn't map the text file");
+      exit(1);
+   }
+   posix_madvise((void*)file->mapping, file->size, POSIX_MADV_SEQUENTIAL);
+#else
+   file->handle = handle;
+   fseek(handle, 0, SEEK_END);
+   file->size = ftell(handle);
+   rewind(handle);
+#endif
+   file->num_chunks = (int)((file->size + CHUNK_SIZE - 1)/CHUNK_SIZE);
+   file->buffers[0] = (char*) malloc(CHUNK_SIZE + MAX_WARMUP);
+   file->buffers[1] = (char*) malloc(CHUNK_SIZE + MAX_WARMUP);
+}
+
+/* Find the characters of a chunk and return a pointer to the warmup
+   characters before it, or to as many as the file holds. Without a
+   mapping, chunks alternate between the two buffers so one can be read
+   while the other is being written to the device */
+const char* read_chunk(text_file *file, int chunk, int warmup,
+      int *num_chars, int *before) {
+
+   cl_ulong offset = (cl_ulong)chunk * CHUNK_SIZE;
+
+   *num_chars = (int)(file->size - offset < CHUNK_SIZE ? 
+         file->size - offset : CHUNK_SIZE);
+   *before = offset < (cl_ulong)warmup ? (int)offset : warmup;
+#ifdef UNIX
+   return file->mapping + offset - *before;
+#else
+   fseek(file->handle, (long)(offset - *before), SEEK_SET);
+   fread(file->buffers[chunk%2], sizeof(char), *before + *num_chars, 
+         file->handle);
+   return file->buffers[chunk%2];
+#endif
+}
+
+void close_text(text_file *file) {
+
+#ifdef UNIX
+   munmap((void*)file->mapping, file->size);
+   close(file->fd);
+#else
+   fclose(file->handle);
+#endif
+   free(file->buffers[0]);
+   free(file->buffers[1]);
+}
+
+/* Search the file with a kernel whose masks, local memory, pattern 
+   length and warmup are set. Each chunk is uploaded while the device 
+   searches the previous one. The first chunk is preceded by zeros, which
+   don't change the count. Returns the wall time in nanoseconds */
+unsigned long long stream_search(text_file *file, cl_command_queue *queues,
+      cl_kernel kernel, cl_mem *text_mems, cl_mem *result_mems, 
+      size_t global_size, size_t local_size, int warmup, int *result) {
+
+   static const char zeros[MAX_WARMUP] = {0};
+   unsigned long long start;
+   const char *source;
+   int i, slot, err, num_chars, before, chars_per_item, results = 0;
+
+   for(slot=0; slot<2; slot++) {
+      err = clEnqueueWriteBuffer(queues[slot], result_mems[slot], CL_TRUE,
+            0, sizeof(results), &results, 0, NULL, NULL);
+      if(err < 0) {
+         perror("Couldn't write the buffer");
+         exit(1);   
+      }
+   }
+
+   start = wall_time_ns();
+   for(i=0; i<=file->num_chunks; i++) {
+
+      /* Start the next chunk */
+      if(i < file->num_chunks) {
+         slot = i%2;
+         source = read_chunk(file, i, warmup, &num_chars, &before);
+         err = clEnqueueWriteBuffer(queues[slot], text_mems[slot], 
+               CL_FALSE, warmup - before, before + num_chars, source, 
+               0, NULL, NULL);
+         if(before < warmup)
+            err |= clEnqueueWriteBuffer(queues[slot], text_mems[slot], 
+                  CL_FALSE, 0, warmup - before, zeros, 0, NULL, NULL);
+         if(err < 0) {
+            perror("Couldn't write the buffer");
+            exit(1);   
+         }
+
+         chars_per_item = (int)((num_chars + global_size - 1)/global_size);
+         err = clSetKernelArg(kernel, 1, sizeof(cl_mem), &text_mems[slot]);
+         err |= clSetKernelArg(kernel, 2, sizeof(int), &chars_per_item);
+         err |= clSetKernelArg(kernel, 3, sizeof(int), &num_chars);
+         err |= clSetKernelArg(kernel, 5, sizeof(cl_mem), &result_mems[slot]);
+         if(err < 0) {
+            perror("Couldn't create a kernel argument");
+            exit(1);   
+         };
+         err = clEnqueueNDRangeKernel(queues[slot], kernel, 1, NULL, 
+               &global_size, &local_size, 0, NULL, NULL); 
+         if(err < 0) {
+            perror("Couldn't enqueue the kernel");
+            printf("Error code: %d\n", err);
+            exit(1);   
+         }
+         clFlush(queues[slot]);
+      }
+
+      /* Finish the previous chunk before its buffer is reused */
+      if(i > 0)
+         clFinish(queues[(i-1)%2]);
+   }
+   start = wall_time_ns() - start;
+
+   /* Read and combine the results of both slots */
+   *result = 0;
+   for(slot=0; slot<2; slot++) {
+      err = clEnqueueReadBuffer(queues[slot], result_mems[slot], CL_TRUE, 
+            0, sizeof(results), &results, 0, NULL, NULL);
+      if(err < 0) {
+         perror("Couldn't read the buffer");
+         exit(1);   
+      }
+      *result += results;
+   }
+   return start;
+}
+
+/* Count the positions where the pattern ends with at most k errors, for
+   every k up to max_errors, with Sellers' dynamic programming. column
+   holds the edit distance of each prefix of the pattern */
+void host_search(text_file *file, const char *pattern, int length, 
+      int max_errors, int *counts) {
+
+   const char *text;
+   int i, j, k, num_chars, before, column[MAX_LENGTH + 1], diagonal, up;
+
+   for(k=0; k<=max_errors; k++) {
+      counts[k] = 0;
+   }
+   for(j=0; j<=length; j++) {
+      column[j] = j;
+   }
+   for(i=0; i<file->num_chunks; i++) {
+      text = read_chunk(file, i, 0, &num_chars, &before);
+      for(k=0; k<num_chars; k++) {
+         diagonal = column[0];
+         for(j=1; j<=length; j++) {
+            up = column[j];
+            column[j] = diagonal + (pattern[j-1] != text[k]);
+            if(up + 1 < column[j])
+               column[j] = up + 1;
+            if(column[j-1] + 1 < column[j])
+               column[j] = column[j-1] + 1;
+            diagonal = up;
+         }
+         for(j=column[length]; j<=max_errors; j++) {
+            counts[j]++;
+         }
+      }
+   }
+}
+
+int main(int argc, char** argv) {
+
+   /* Host/device data structures */
+   cl_device_id device;
+   cl_context context;
+   cl_command_queue queues[2];
+   cl_int i, err, slot, check, num_errors;
+
+   /* Program/kernel data structures */
+   cl_program programs[MAX_ERRORS + 1];
+   cl_kernel kernels[MAX_ERRORS + 1];
+   size_t global_size, local_size, max_local_size;
+   cl_uint compute_units, length, warmup;
+   unsigned long long search_time;
+   char options[32];
+
+   /* Data and buffers */
+   const char *pattern;
+   text_file file;
+   cl_ulong masks[256];
+   int result, check_counts[MAX_ERRORS + 1];
+   cl_mem masks_buffer, text_mems[2], result_mems[2];
+
+   /* Open the text file and build the character masks of the pattern */
+   open_text(&file, argc > 1 ? argv[1] : TEXT_FILE);
+   pattern = argc > 2 ? argv[2] : PATTERN;
+   length = (cl_uint)strlen(pattern);
+   if(length == 0 || length > MAX_LENGTH) {
+      printf("The pattern must have 1 to %d characters\n", MAX_LENGTH);
+      exit(1);
+   }
+   memset(masks, 0, sizeof(masks));
+   for(i=0; i<(cl_int)length; i++) {
+      masks[(unsigned char)pattern[i]] |= (cl_ulong)1 << i;
+   }
+   num_errors = (length - 1 < MAX_ERRORS) ? length - 1 : MAX_ERRORS;
+
+   /* Create device and context */
+   device = create_device();
+   err = clGetDeviceInfo(device, CL_DEVICE_MAX_COMPUTE_UNITS, 
+         sizeof(compute_units), &compute_units, NULL);
+   if(err < 0) {
+      perror("Couldn't obtain device information");
+      exit(1);   
+   }
+   context = clCreateContext(NULL, 1, &device, NULL, NULL, &err);
+   if(err < 0) {
+      perror("Couldn't create a context");
+      exit(1);   
+   }
+
+   /* Build one program for each number of errors */
+   local_size = 0;
+   for(i=0; i<=num_errors; i++) {
+      sprintf(options, "-DERRORS=%d", i);
+      programs[i] = build_program(context, device, PROGRAM_FILE, options);
+      kernels[i] = clCreateKernel(programs[i], KERNEL_FUNC, &err);
+      if(err < 0) {
+         perror("Couldn't create a kernel");
+         exit(1);
+      };
+      err = clGetKernelWorkGroupInfo(kernels[i], device, 
+            CL_KERNEL_WORK_GROUP_SIZE, sizeof(max_local_size), 
+            &max_local_size, NULL);
+      if(err < 0) {
+         perror("Couldn't obtain device information");
+         exit(1);   
+      }
+      if(local_size == 0 || max_local_size < local_size)
+         local_size = max_local_size;
+   }
+
+   /* Determine global size and a power-of-two local size */
+   local_size = (size_t)pow(2, trunc(log2(local_size)));
+   global_size = compute_units * local_size;
+
+   /* Create a queue and buffers for each of the two chunks in flight */
+   masks_buffer = clCreateBuffer(context, CL_MEM_READ_ONLY |
+         CL_MEM_COPY_HOST_PTR, sizeof(masks), masks, &err);
+   if(err < 0) {
+      perror("Couldn't create a buffer");
+      exit(1);   
+   };
+   for(slot=0; slot<2; slot++) {
+      queues[slot] = clCreateCommandQueue(context, device, 0, &err);
+      if(err < 0) {
+         perror("Couldn't create a command queue");
+         exit(1);   
+      };
+      text_mems[slot] = clCreateBuffer(context, CL_MEM_READ_ONLY, 
+            CHUNK_SIZE + MAX_WARMUP, NULL, &err);
+      result_mems[slot] = clCreateBuffer(context, CL_MEM_READ_WRITE, 
+            sizeof(result), NULL, &err);
+      if(err < 0) {
+         perror("Couldn't create a buffer");
+         exit(1);   
+      };
+   }
+
+   /* Search with each number of errors */
+   host_search(&file, pattern, length, num_errors, check_counts);
+   printf("Searching %llu bytes for '%s'\n", 
+         (unsigned long long)file.size, pattern);
+   printf("Errors   Matches     GB/s\n");
+   check = 1;
+   for(i=0; i<=num_errors; i++) {
+      warmup = length + i;
+      err = clSetKernelArg(kernels[i], 0, sizeof(cl_mem), &masks_buffer);
+      err |= clSetKernelArg(kernels[i], 4, local_size * sizeof(int), NULL);
+      err |= clSetKernelArg(kernels[i], 6, sizeof(cl_uint), &length);
+      err |= clSetKernelArg(kernels[i], 7, sizeof(cl_uint), &warmup);
+      if(err < 0) {
+         perror("Couldn't create a kernel argument");
+         exit(1);   
+      };
+      search_time = stream_search(&file, queues, kernels[i], text_mems, 
+            result_mems, global_size, local_size, warmup, &result);
+      printf("%6d %9d %8.3f\n", i, result, 
+            (double)file.size/search_time);
+      if(result != check_counts[i])
+         check = 0;
+   }
+   printf("%s\n", check ? "Check passed." : "Check failed.");
+
+   /* Deallocate resources */
+   for(slot=0; slot<2; slot++) {
+      clReleaseMemObject(result_mems[slot]);
+      clReleaseMemObject(text_mems[slot]);
+      clReleaseCommandQueue(queues[slot]);
+   }
+   clReleaseMemObject(masks_buffer);
+   for(i=0; i<=num_errors; i++) {
+      clReleaseKernel(kernels[i]);
+      clReleaseProgram(programs[i]);
+   }
+   clReleaseContext(context);
+   close_text(&file);
+   return 0;
+}
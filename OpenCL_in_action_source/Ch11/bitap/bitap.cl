@@ -0,0 +1,60 @@
+/* The number of errors is set at build time with -DERRORS=k, so the
+   state of every error level stays in registers */
+#ifndef ERRORS
+#define ERRORS 0
+#endif
+
+/* Count the positions where the pattern ends with at most ERRORS
+   substitutions, insertions or deletions. masks[c] has bit i set if
+   character i of the pattern is c, and bit d of state[e] is set if the
+   first d+1 characters of the pattern end at the current character with
+   at most e errors.
+
+   The chunk in text starts with warmup characters from before it, so
+   the state is exact once a work-item reaches its slice. Each match is
+   counted by the work-item holding the character where it ends. Counts
+   are added with a tree reduction in local_result, which holds one int
+   per work-item, and one global atomic per group. The local size must
+   be a power of two */
+__kernel void bitap_search(__constant ulong *masks, __global uchar *text,
+     int chars_per_item, int num_chars, __local int *local_result, 
+     __global int *global_result, uint pattern_length, uint warmup) {
+
+   ulong state[ERRORS + 1], previous, current, mask, match;
+   uint lid = get_local_id(0);
+   int count = 0, e;
+
+   int item_offset = get_global_id(0) * chars_per_item;
+   int item_end = min(item_offset + chars_per_item, num_chars);
+
+   /* Start with the prefixes that e deletions can match */
+   for(e = 0; e <= ERRORS; e++)
+      state[e] = (1UL << e) - 1;
+   match = 1UL << (pattern_length - 1);
+
+   for(int i = item_offset - (int)warmup; i < item_end; i++) {
+      mask = masks[text[i + warmup]];
+
+      previous = state[0];
+      state[0] = ((state[0] << 1) | 1) & mask;
+      for(e = 1; e <= ERRORS; e++) {
+         current = state[e];
+
+         /* Match, insertion, then substitution and deletion */
+         state[e] = (((current << 1) | 1) & mask) | previous |
+               ((previous | state[e-1]) << 1) | 1;
+         previous = current;
+      }
+      count += (i >= item_offset && (state[ERRORS] & match));
+   }
+
+   /* Add the counts of the group */
+   local_result[lid] = count;
+   for(uint stride = get_local_size(0)/2; stride > 0; stride >>= 1) {
+      barrier(CLK_LOCAL_MEM_FENCE);
+      if(lid < stride)
+         local_result[lid] += local_result[lid + stride];
+   }
+   if(lid == 0)
+      atomic_add(global_result, local_result[0]);
+}
@@ -8,7 +8,7 @@
 
 /* Ascending: 0, Descending: -1 */
 #define DIRECTION 0
-#define NUM_FLOATS 1048576
+#define NUM_SIZES 4
 
 #include <math.h>
 #include <stdio.h>
@@ -100,6 +100,13 @@ cl_program build_program(cl_context ctx, cl_device_id dev, const char* filename)
    return program;
 }
 
+/* Compare floats for qsort */
+int compare_floats(const void* a, const void* b) {
+
+   float value_a = *(const float*)a, value_b = *(const float*)b;
+   return (value_a > value_b) - (value_a < value_b);
+}
+
 int main() {
 
    /* Host/device data structures */
@@ -109,19 +116,19 @@ int main() {
    cl_program program;
    cl_kernel kernel_init, kernel_stage_0, kernel_stage_n, kernel_merge,
          kernel_merge_last;
+   cl_event start_event, end_event;
    cl_int i, err, check, direction;
+   cl_ulong time_start, time_end;
 
    /* Data and buffers */
-   float data[NUM_FLOATS];
+   float *data, *reference;
    cl_mem data_buffer;
-   cl_uint stage, high_stage, num_stages;
-   size_t local_size, global_size;
+   cl_uint num_floats, padded_size, stage, high_stage, num_stages;
+   size_t max_local_size, local_size, global_size;
+   int s;
 
-   /* Initialize data */
-   srand(time(NULL));
-   for(i=0; i<NUM_FLOATS; i++) {
-      data[i] = rand();
-   }
+   /* Sizes need not be powers of two */
+   cl_uint sizes[NUM_SIZES] = {1048576, 1000003, 3145728, 1000};
 
    /* Create a device and context */
    device = create_device();
@@ -163,83 +170,116 @@ int main() {
 
    /* Determine maximum work-group size */
    err = clGetKernelWorkGroupInfo(kernel_init, device, CL_KERNEL_WORK_GROUP_SIZE,
-      sizeof(local_size), &local_size, NULL);
+      sizeof(max_local_size), &max_local_size, NULL);
    if(err < 0) {
       perror("Couldn't find the maximum work-group size");
       exit(1);   
    };
-   local_size = (int)pow(2, trunc(log2(local_size))); 
-
-
-   /* Create buffer */
-   data_buffer = clCreateBuffer(context, CL_MEM_READ_WRITE |
-         CL_MEM_COPY_HOST_PTR, sizeof(data), data, &err);
-   if(err < 0) {
-      perror("Couldn't create a buffer");
-      exit(1);   
-   };
-
-   /* Create kernel argument */
-   err = clSetKernelArg(kernel_init, 0, sizeof(cl_mem), &data_buffer);
-   err |= clSetKernelArg(kernel_stage_0, 0, sizeof(cl_mem), &data_buffer);
-   err |= clSetKernelArg(kernel_stage_n, 0, sizeof(cl_mem), &data_buffer);
-   err |= clSetKernelArg(kernel_merge, 0, sizeof(cl_mem), &data_buffer);
-   err |= clSetKernelArg(kernel_merge_last, 0, sizeof(cl_mem), &data_buffer);
-   if(err < 0) {
-      printf("Couldn't set a kernel argument");
-      exit(1);
-   };
-
-   /* Create kernel argument */
-   err = clSetKernelArg(kernel_init, 1, 8*local_size*sizeof(float), NULL);
-   err |= clSetKernelArg(kernel_stage_0, 1, 8*local_size*sizeof(float), NULL);
-   err |= clSetKernelArg(kernel_stage_n, 1, 8*local_size*sizeof(float), NULL);
-   err |= clSetKernelArg(kernel_merge, 1, 8*local_size*sizeof(float), NULL);
-   err |= clSetKernelArg(kernel_merge_last, 1, 8*local_size*sizeof(float), NULL);
-   if(err < 0) {
-      printf("Couldn't set a kernel argument");
-      exit(1);
-   };
+   max_local_size = (int)pow(2, trunc(log2(max_local_size))); 
 
    /* Create a command queue */
-   queue = clCreateCommandQueue(context, device, 0, &err);
+   queue = clCreateCommandQueue(context, device, 
+         CL_QUEUE_PROFILING_ENABLE, &err);
    if(err < 0) {
       perror("Couldn't create a command queue");
       exit(1);   
    };
 
-   /* Enqueue initial sorting kernel */
-   global_size = NUM_FLOATS/8;
-   if(global_size < local_size) {
-      local_size = global_size;
-   }
-   err = clEnqueueNDRangeKernel(queue, kernel_init, 1, NULL, &global_size, 
-         &local_size, 0, NULL, NULL); 
-   if(err < 0) {
-      perror("Couldn't enqueue the kernel");
-      exit(1);   
-   }
+   direction = DIRECTION;
+   srand(time(NULL));
+   for(s=0; s<NUM_SIZES; s++) {
+
+      /* Initialize data */
+      num_floats = sizes[s];
+      data = (float*) malloc(num_floats * sizeof(float));
+      reference = (float*) malloc(num_floats * sizeof(float));
+      for(i=0; i<num_floats; i++) {
+         data[i] = rand();
+         reference[i] = data[i];
+      }
+      qsort(reference, num_floats, sizeof(float), compare_floats);
 
-   /* Execute further stages */
-   num_stages = global_size/local_size;
-   for(high_stage = 2; high_stage < num_stages; high_stage <<= 1) {
+      /* Create buffer with no room for padding */
+      data_buffer = clCreateBuffer(context, CL_MEM_READ_WRITE |
+            CL_MEM_COPY_HOST_PTR, num_floats * sizeof(float), data, &err);
+      if(err < 0) {
+         perror("Couldn't create a buffer");
+         exit(1);   
+      };
+
+      /* Sort as if the data were padded to a power of two */
+      padded_size = 8;
+      while(padded_size < num_floats) {
+         padded_size <<= 1;
+      }
+      global_size = padded_size/8;
+      local_size = max_local_size;
+      if(global_size < local_size) {
+         local_size = global_size;
+      }
 
-      err = clSetKernelArg(kernel_stage_0, 2, sizeof(int), &high_stage);      
-      err |= clSetKernelArg(kernel_stage_n, 3, sizeof(int), &high_stage);
+      /* Create kernel arguments */
+      err = clSetKernelArg(kernel_init, 0, sizeof(cl_mem), &data_buffer);
+      err |= clSetKernelArg(kernel_stage_0, 0, sizeof(cl_mem), &data_buffer);
+      err |= clSetKernelArg(kernel_stage_n, 0, sizeof(cl_mem), &data_buffer);
+      err |= clSetKernelArg(kernel_merge, 0, sizeof(cl_mem), &data_buffer);
+      err |= clSetKernelArg(kernel_merge_last, 0, sizeof(cl_mem), &data_buffer);
+      err |= clSetKernelArg(kernel_init, 1, 8*local_size*sizeof(float), NULL);
+      err |= clSetKernelArg(kernel_stage_0, 1, 8*local_size*sizeof(float), NULL);
+      err |= clSetKernelArg(kernel_stage_n, 1, 8*local_size*sizeof(float), NULL);
+      err |= clSetKernelArg(kernel_merge, 1, 8*local_size*sizeof(float), NULL);
+      err |= clSetKernelArg(kernel_merge_last, 1, 8*local_size*sizeof(float), NULL);
+      err |= clSetKernelArg(kernel_init, 2, sizeof(cl_uint), &num_floats);
+      err |= clSetKernelArg(kernel_init, 3, sizeof(int), &direction);
+      err |= clSetKernelArg(kernel_stage_0, 3, sizeof(cl_uint), &num_floats);
+      err |= clSetKernelArg(kernel_stage_0, 4, sizeof(int), &direction);
+      err |= clSetKernelArg(kernel_stage_n, 4, sizeof(cl_uint), &num_floats);
+      err |= clSetKernelArg(kernel_stage_n, 5, sizeof(int), &direction);
+      err |= clSetKernelArg(kernel_merge, 3, sizeof(int), &direction);
+      err |= clSetKernelArg(kernel_merge, 4, sizeof(cl_uint), &num_floats);
+      err |= clSetKernelArg(kernel_merge_last, 2, sizeof(int), &direction);
+      err |= clSetKernelArg(kernel_merge_last, 3, sizeof(cl_uint), &num_floats);
       if(err < 0) {
          printf("Couldn't set a kernel argument");
          exit(1);
       };
 
-      for(stage = high_stage; stage > 1; stage >>= 1) {
+      /* Enqueue initial sorting kernel */
+      err = clEnqueueNDRangeKernel(queue, kernel_init, 1, NULL, &global_size, 
+            &local_size, 0, NULL, &start_event); 
+      if(err < 0) {
+         perror("Couldn't enqueue the kernel");
+         exit(1);   
+      }
+
+      /* Execute further stages */
+      num_stages = global_size/local_size;
+      for(high_stage = 2; high_stage < num_stages; high_stage <<= 1) {
 
-         err = clSetKernelArg(kernel_stage_n, 2, sizeof(int), &stage);
+         err = clSetKernelArg(kernel_stage_0, 2, sizeof(int), &high_stage);      
+         err |= clSetKernelArg(kernel_stage_n, 3, sizeof(int), &high_stage);
          if(err < 0) {
             printf("Couldn't set a kernel argument");
             exit(1);
          };
 
-         err = clEnqueueNDRangeKernel(queue, kernel_stage_n, 1, NULL, 
+         for(stage = high_stage; stage > 1; stage >>= 1) {
+
+            err = clSetKernelArg(kernel_stage_n, 2, sizeof(int), &stage);
+            if(err < 0) {
+               printf("Couldn't set a kernel argument");
+               exit(1);
+            };
+
+            err = clEnqueueNDRangeKernel(queue, kernel_stage_n, 1, NULL, 
+                  &global_size, &local_size, 0, NULL, NULL); 
+            if(err < 0) {
+               perror("Couldn't enqueue the kernel");
+               exit(1);   
+            }
+         }
+
+         err = clEnqueueNDRangeKernel(queue, kernel_stage_0, 1, NULL, 
                &global_size, &local_size, 0, NULL, NULL); 
          if(err < 0) {
             perror("Couldn't enqueue the kernel");
@@ -247,85 +287,69 @@ int main() {
          }
       }
 
-      err = clEnqueueNDRangeKernel(queue, kernel_stage_0, 1, NULL, 
-            &global_size, &local_size, 0, NULL, NULL); 
+      /* Perform the bitonic merge */
+      for(stage = num_stages; stage > 1; stage >>= 1) {
+
+         err = clSetKernelArg(kernel_merge, 2, sizeof(int), &stage);
+         if(err < 0) {
+            printf("Couldn't set a kernel argument");
+            exit(1);
+         };
+
+         err = clEnqueueNDRangeKernel(queue, kernel_merge, 1, NULL, 
+               &global_size, &local_size, 0, NULL, NULL); 
+         if(err < 0) {
+            perror("Couldn't enqueue the kernel");
+            exit(1);   
+         }
+      }
+      err = clEnqueueNDRangeKernel(queue, kernel_merge_last, 1, NULL, 
+            &global_size, &local_size, 0, NULL, &end_event); 
       if(err < 0) {
          perror("Couldn't enqueue the kernel");
          exit(1);   
       }
-   }
-
-   /* Set the sort direction */
-   direction = DIRECTION;
-   err = clSetKernelArg(kernel_merge, 3, sizeof(int), &direction);
-   err |= clSetKernelArg(kernel_merge_last, 2, sizeof(int), &direction);
-   if(err < 0) {
-      printf("Couldn't set a kernel argument");
-      exit(1);
-   };
-
-   /* Perform the bitonic merge */
-   for(stage = num_stages; stage > 1; stage >>= 1) {
-
-      err = clSetKernelArg(kernel_merge, 2, sizeof(int), &stage);
-      if(err < 0) {
-         printf("Couldn't set a kernel argument");
-         exit(1);
-      };
 
-      err = clEnqueueNDRangeKernel(queue, kernel_merge, 1, NULL, 
-            &global_size, &local_size, 0, NULL, NULL); 
+      /* Read the result */
+      err = clEnqueueReadBuffer(queue, data_buffer, CL_TRUE, 0, 
+         num_floats * sizeof(float), data, 0, NULL, NULL);
       if(err < 0) {
-         perror("Couldn't enqueue the kernel");
+         perror("Couldn't read the buffer");
          exit(1);   
       }
-   }
-   err = clEnqueueNDRangeKernel(queue, kernel_merge_last, 1, NULL, 
-         &global_size, &local_size, 0, NULL, NULL); 
-   if(err < 0) {
-      perror("Couldn't enqueue the kernel");
-      exit(1);   
-   }
-
-   /* Read the result */
-   err = clEnqueueReadBuffer(queue, data_buffer, CL_TRUE, 0, 
-      sizeof(data), &data, 0, NULL, NULL);
-   if(err < 0) {
-      perror("Couldn't read the buffer");
-      exit(1);   
-   }
+      clGetEventProfilingInfo(start_event, CL_PROFILING_COMMAND_START,
+            sizeof(time_start), &time_start, NULL);
+      clGetEventProfilingInfo(end_event, CL_PROFILING_COMMAND_END,
+            sizeof(time_end), &time_end, NULL);
 
-   check = 1;
+      check = 1;
 
-   /* Check ascending sort */
-   if(direction == 0) {
-      for(i=1; i<NUM_FLOATS; i++) {
-         if(data[i] < data[i-1]) {
-            check = 0;
-            break;
-         }
-      }
-   }
-   /* Check descending sort */
-   if(direction == -1) {
-      for(i=1; i<NUM_FLOATS; i++) {
-         if(data[i] > data[i-1]) {
+      /* Check the sort against qsort, so lost data can't go unnoticed */
+      for(i=0; i<num_floats; i++) {
+         if(data[i] != reference[direction ? num_floats-1-i : i]) {
             check = 0;
             break;
          }
       }
-   }
 
-   /* Display check result */
-   printf("Local size: %zu\n", local_size);
-   printf("Global size: %zu\n", global_size);
-   if(check)
-      printf("Bitonic sort succeeded.\n");
-   else
-      printf("Bitonic sort failed.\n");
+      /* Display check result */
+      printf("Floats: %u (sorted as %u)\n", num_floats, padded_size);
+      printf("Local size: %zu\n", local_size);
+      printf("Global size: %zu\n", global_size);
+      printf("Total time = %lu\n", (unsigned long)(time_end - time_start));
+      if(check)
+         printf("Bitonic sort succeeded.\n\n");
+      else
+         printf("Bitonic sort failed.\n\n");
+
+      clReleaseEvent(start_event);
+      clReleaseEvent(end_event);
+      clReleaseMemObject(data_buffer);
+      free(data);
+      free(reference);
+   }
 
    /* Deallocate resources */
-   clReleaseMemObject(data_buffer);
    clReleaseKernel(kernel_init);
    clReleaseKernel(kernel_stage_0);
    clReleaseKernel(kernel_stage_n);
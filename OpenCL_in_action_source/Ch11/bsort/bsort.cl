@@ -11,11 +11,58 @@
    input1 = shuffle2(input1, input2, as_uint4(comp));             \
    input2 = shuffle2(input2, temp, as_uint4(comp));               \
 
+/* Read a vector, padding positions past the end of the data */
+float4 load_data(__global float4 *g_data, uint index, uint num_floats, 
+                 float pad) {
+
+   __global float *data = (__global float*)g_data;
+   uint start = index * 4;
+   float4 value;
+
+   if(start + 4 <= num_floats)
+      return g_data[index];
+   value.s0 = (start < num_floats) ? data[start] : pad;
+   value.s1 = (start + 1 < num_floats) ? data[start + 1] : pad;
+   value.s2 = (start + 2 < num_floats) ? data[start + 2] : pad;
+   value.s3 = pad;
+   return value;
+}
+
+/* Write a vector, dropping positions past the end of the data */
+void store_data(float4 value, __global float4 *g_data, uint index, 
+                uint num_floats) {
+
+   __global float *data = (__global float*)g_data;
+   uint start = index * 4;
+
+   if(start + 4 <= num_floats) {
+      g_data[index] = value;
+      return;
+   }
+   if(start < num_floats) data[start] = value.s0;
+   if(start + 1 < num_floats) data[start + 1] = value.s1;
+   if(start + 2 < num_floats) data[start + 2] = value.s2;
+}
+
+/* Find the direction of a block of block_size floats. The block holding 
+   the first padded position always sorts in the final direction, so the 
+   padding stays at the end and never displaces data */
+int block_dir(uint block, uint block_size, uint num_floats, int direction) {
+
+   if(block == num_floats/block_size)
+      return direction;
+   if((block ^ 1) == num_floats/block_size)
+      return -1 - direction;
+   return (block & 1) * -1;
+}
+
 /* Perform initial sort */
-__kernel void bsort_init(__global float4 *g_data, __local float4 *l_data) {
+__kernel void bsort_init(__global float4 *g_data, __local float4 *l_data,
+                         uint num_floats, int direction) {
 
-   int dir;
-   uint id, global_start, size, stride;
+   int dir, dir1, dir2;
+   uint id, global_id, global_start, size, stride;
+   float pad = direction ? -INFINITY : INFINITY;
    float4 input1, input2, temp;
    int4 comp;
 
@@ -27,31 +74,38 @@ __kernel void bsort_init(__global float4 *g_data, __local float4 *l_data) {
    int4 add2 = (int4)(2, 3, 2, 3);
    int4 add3 = (int4)(1, 2, 2, 3);
 
+   /* Skip work-groups that only hold padding */
+   if(get_group_id(0) * get_local_size(0) * 8 >= num_floats)
+      return;
+
    id = get_local_id(0) * 2;
+   global_id = get_global_id(0);
    global_start = get_group_id(0) * get_local_size(0) * 2 + id;
 
-   input1 = g_data[global_start]; 
-   input2 = g_data[global_start+1];
+   input1 = load_data(g_data, global_start, num_floats, pad); 
+   input2 = load_data(g_data, global_start+1, num_floats, pad);
 
-   /* Sort input 1 - ascending */
-   comp = input1 < shuffle(input1, mask1);
+   /* Sort input 1 - usually ascending */
+   dir1 = block_dir(global_id * 2, 4, num_floats, direction);
+   comp = input1 < shuffle(input1, mask1) ^ dir1;
    input1 = shuffle(input1, as_uint4(comp + add1));
-   comp = input1 < shuffle(input1, mask2);
+   comp = input1 < shuffle(input1, mask2) ^ dir1;
    input1 = shuffle(input1, as_uint4(comp * 2 + add2));
-   comp = input1 < shuffle(input1, mask3);
+   comp = input1 < shuffle(input1, mask3) ^ dir1;
    input1 = shuffle(input1, as_uint4(comp + add3));
 
-   /* Sort input 2 - descending */
-   comp = input2 > shuffle(input2, mask1);
+   /* Sort input 2 - usually descending */
+   dir2 = block_dir(global_id * 2 + 1, 4, num_floats, direction);
+   comp = input2 < shuffle(input2, mask1) ^ dir2;
    input2 = shuffle(input2, as_uint4(comp + add1));
-   comp = input2 > shuffle(input2, mask2);
+   comp = input2 < shuffle(input2, mask2) ^ dir2;
    input2 = shuffle(input2, as_uint4(comp * 2 + add2));
-   comp = input2 > shuffle(input2, mask3);
+   comp = input2 < shuffle(input2, mask3) ^ dir2;
    input2 = shuffle(input2, as_uint4(comp + add3));     
 
    /* Swap corresponding elements of input 1 and 2 */
    add3 = (int4)(4, 5, 6, 7);
-   dir = get_local_id(0) % 2 * -1;
+   dir = block_dir(global_id, 8, num_floats, direction);
    temp = input1;
    comp = (input1 < input2 ^ dir) * 4 + add3;
    input1 = shuffle2(input1, input2, as_uint4(comp));
@@ -65,7 +119,7 @@ __kernel void bsort_init(__global float4 *g_data, __local float4 *l_data) {
 
    /* Create bitonic set */
    for(size = 2; size < get_local_size(0); size <<= 1) {
-      dir = (get_local_id(0)/size & 1) * -1;
+      dir = block_dir(global_id/size, size * 8, num_floats, direction);
 
       for(stride = size; stride > 1; stride >>= 1) {
          barrier(CLK_LOCAL_MEM_FENCE);
@@ -87,7 +141,8 @@ __kernel void bsort_init(__global float4 *g_data, __local float4 *l_data) {
    }
 
    /* Perform bitonic merge */
-   dir = (get_group_id(0) % 2) * -1;
+   dir = block_dir(get_group_id(0), get_local_size(0) * 8, num_floats, 
+                   direction);
    for(stride = get_local_size(0); stride > 1; stride >>= 1) {
       barrier(CLK_LOCAL_MEM_FENCE);
       id = get_local_id(0) + (get_local_id(0)/stride)*stride;
@@ -104,16 +159,17 @@ __kernel void bsort_init(__global float4 *g_data, __local float4 *l_data) {
    input2 = shuffle2(input2, temp, as_uint4(comp));
    VECTOR_SORT(input1, dir);
    VECTOR_SORT(input2, dir);
-   g_data[global_start] = input1;
-   g_data[global_start+1] = input2;
+   store_data(input1, g_data, global_start, num_floats);
+   store_data(input2, g_data, global_start+1, num_floats);
 }
 
 /* Perform lowest stage of the bitonic sort */
 __kernel void bsort_stage_0(__global float4 *g_data, __local float4 *l_data, 
-                            uint high_stage) {
+                            uint high_stage, uint num_floats, int direction) {
 
    int dir;
    uint id, global_start, stride;
+   float pad = direction ? -INFINITY : INFINITY;
    float4 input1, input2, temp;
    int4 comp;
 
@@ -125,14 +181,20 @@ __kernel void bsort_stage_0(__global float4 *g_data, __local float4 *l_data,
    int4 add2 = (int4)(2, 3, 2, 3);
    int4 add3 = (int4)(4, 5, 6, 7);
 
+   /* Skip work-groups that only hold padding */
+   if(get_group_id(0) * get_local_size(0) * 8 >= num_floats)
+      return;
+
    /* Determine data location in global memory */
    id = get_local_id(0);
-   dir = (get_group_id(0)/high_stage & 1) * -1;
+   dir = block_dir(get_group_id(0)/high_stage, 
+                   high_stage * get_local_size(0) * 8, num_floats, direction);
    global_start = get_group_id(0) * get_local_size(0) * 2 + id;
 
    /* Perform initial swap */
-   input1 = g_data[global_start];
-   input2 = g_data[global_start + get_local_size(0)];
+   input1 = load_data(g_data, global_start, num_floats, pad);
+   input2 = load_data(g_data, global_start + get_local_size(0), 
+                      num_floats, pad);
    comp = (input1 < input2 ^ dir) * 4 + add3;
    l_data[id] = shuffle2(input1, input2, as_uint4(comp));
    l_data[id + get_local_size(0)] = shuffle2(input2, input1, as_uint4(comp));
@@ -156,15 +218,18 @@ __kernel void bsort_stage_0(__global float4 *g_data, __local float4 *l_data,
    VECTOR_SORT(input2, dir);
 
    /* Store output in global memory */
-   g_data[global_start + get_local_id(0)] = input1;
-   g_data[global_start + get_local_id(0) + 1] = input2;
+   store_data(input1, g_data, global_start + get_local_id(0), num_floats);
+   store_data(input2, g_data, global_start + get_local_id(0) + 1, 
+              num_floats);
 }
 
 /* Perform successive stages of the bitonic sort */
 __kernel void bsort_stage_n(__global float4 *g_data, __local float4 *l_data, 
-                            uint stage, uint high_stage) {
+                            uint stage, uint high_stage, uint num_floats,
+                            int direction) {
 
    int dir;
+   float pad = direction ? -INFINITY : INFINITY;
    float4 input1, input2;
    int4 comp, add;
    uint global_start, global_offset;
@@ -172,23 +237,30 @@ __kernel void bsort_stage_n(__global float4 *g_data, __local float4 *l_data,
    add = (int4)(4, 5, 6, 7);
 
    /* Determine location of data in global memory */
-   dir = (get_group_id(0)/high_stage & 1) * -1;
+   dir = block_dir(get_group_id(0)/high_stage, 
+                   high_stage * get_local_size(0) * 8, num_floats, direction);
    global_start = (get_group_id(0) + (get_group_id(0)/stage)*stage) *
                    get_local_size(0) + get_local_id(0);
    global_offset = stage * get_local_size(0);
+   if(global_start * 4 >= num_floats)
+      return;
 
    /* Perform swap */
-   input1 = g_data[global_start];
-   input2 = g_data[global_start + global_offset];
+   input1 = load_data(g_data, global_start, num_floats, pad);
+   input2 = load_data(g_data, global_start + global_offset, num_floats, pad);
    comp = (input1 < input2 ^ dir) * 4 + add;
-   g_data[global_start] = shuffle2(input1, input2, as_uint4(comp));
-   g_data[global_start + global_offset] = shuffle2(input2, input1, as_uint4(comp));
+   store_data(shuffle2(input1, input2, as_uint4(comp)), g_data, 
+              global_start, num_floats);
+   store_data(shuffle2(input2, input1, as_uint4(comp)), g_data, 
+              global_start + global_offset, num_floats);
 }
 
 /* Sort the bitonic set */
-__kernel void bsort_merge(__global float4 *g_data, __local float4 *l_data, uint stage, int dir) {
+__kernel void bsort_merge(__global float4 *g_data, __local float4 *l_data, uint stage, int dir,
+                          uint num_floats) {
 
    float4 input1, input2;
+   float pad;
    int4 comp, add;
    uint global_start, global_offset;
 
@@ -198,20 +270,27 @@ __kernel void bsort_merge(__global float4 *g_data, __local float4 *l_data, uint
    global_start = (get_group_id(0) + (get_group_id(0)/stage)*stage) *
                    get_local_size(0) + get_local_id(0);
    global_offset = stage * get_local_size(0);
+   if(global_start * 4 >= num_floats)
+      return;
 
    /* Perform swap */
-   input1 = g_data[global_start];
-   input2 = g_data[global_start + global_offset];
+   pad = dir ? -INFINITY : INFINITY;
+   input1 = load_data(g_data, global_start, num_floats, pad);
+   input2 = load_data(g_data, global_start + global_offset, num_floats, pad);
    comp = (input1 < input2 ^ dir) * 4 + add;
-   g_data[global_start] = shuffle2(input1, input2, as_uint4(comp));
-   g_data[global_start + global_offset] = shuffle2(input2, input1, as_uint4(comp));
+   store_data(shuffle2(input1, input2, as_uint4(comp)), g_data, 
+              global_start, num_floats);
+   store_data(shuffle2(input2, input1, as_uint4(comp)), g_data, 
+              global_start + global_offset, num_floats);
 }
 
 /* Perform final step of the bitonic merge */
-__kernel void bsort_merge_last(__global float4 *g_data, __local float4 *l_data, int dir) {
+__kernel void bsort_merge_last(__global float4 *g_data, __local float4 *l_data, int dir,
+                               uint num_floats) {
 
    uint id, global_start, stride;
    float4 input1, input2, temp;
+   float pad = dir ? -INFINITY : INFINITY;
    int4 comp;
 
    uint4 mask1 = (uint4)(1, 0, 3, 2);
@@ -222,13 +301,18 @@ __kernel void bsort_merge_last(__global float4 *g_data, __local float4 *l_data,
    int4 add2 = (int4)(2, 3, 2, 3);
    int4 add3 = (int4)(4, 5, 6, 7);
 
+   /* Skip work-groups that only hold padding */
+   if(get_group_id(0) * get_local_size(0) * 8 >= num_floats)
+      return;
+
    /* Determine location of data in global memory */
    id = get_local_id(0);
    global_start = get_group_id(0) * get_local_size(0) * 2 + id;
 
    /* Perform initial swap */
-   input1 = g_data[global_start];
-   input2 = g_data[global_start + get_local_size(0)];
+   input1 = load_data(g_data, global_start, num_floats, pad);
+   input2 = load_data(g_data, global_start + get_local_size(0), 
+                      num_floats, pad);
    comp = (input1 < input2 ^ dir) * 4 + add3;
    l_data[id] = shuffle2(input1, input2, as_uint4(comp));
    l_data[id + get_local_size(0)] = shuffle2(input2, input1, as_uint4(comp));
@@ -252,6 +336,7 @@ __kernel void bsort_merge_last(__global float4 *g_data, __local float4 *l_data,
    VECTOR_SORT(input2, dir);
 
    /* Store the result to global memory */
-   g_data[global_start + get_local_id(0)] = input1;
-   g_data[global_start + get_local_id(0) + 1] = input2;
+   store_data(input1, g_data, global_start + get_local_id(0), num_floats);
+   store_data(input2, g_data, global_start + get_local_id(0) + 1, 
+              num_floats);
 }
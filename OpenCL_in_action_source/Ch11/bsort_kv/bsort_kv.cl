@@ -0,0 +1,316 @@
+/* Order pairs by key, then by value, so equal keys never duplicate
+   a payload inside the shuffle network */
+#define KV_LESS(k1, v1, k2, v2) ((k1) < (k2) | ((k1) == (k2) & (v1) < (v2)))
+
+/* Sort elements within a vector */
+#define VECTOR_SORT(keys, values, dir)                                      \
+   comp = KV_LESS(keys, values, shuffle(keys, mask2),                       \
+                  shuffle(values, mask2)) ^ dir;                            \
+   keys = shuffle(keys, as_uint4(comp * 2 + add2));                         \
+   values = shuffle(values, as_uint4(comp * 2 + add2));                     \
+   comp = KV_LESS(keys, values, shuffle(keys, mask1),                       \
+                  shuffle(values, mask1)) ^ dir;                            \
+   keys = shuffle(keys, as_uint4(comp + add1));                             \
+   values = shuffle(values, as_uint4(comp + add1));                         \
+
+#define VECTOR_SWAP(keys1, values1, keys2, values2, dir)                    \
+   temp = keys1;                                                            \
+   v_temp = values1;                                                        \
+   comp = (KV_LESS(keys1, values1, keys2, values2) ^ dir) * 4 + add3;       \
+   keys1 = shuffle2(keys1, keys2, as_uint4(comp));                          \
+   values1 = shuffle2(values1, values2, as_uint4(comp));                    \
+   keys2 = shuffle2(keys2, temp, as_uint4(comp));                           \
+   values2 = shuffle2(values2, v_temp, as_uint4(comp));                     \
+
+/* Perform initial sort */
+__kernel void bsort_kv_init(__global float4 *g_keys, __global uint4 *g_values,
+                            __local float4 *l_keys, __local uint4 *l_values) {
+
+   int dir;
+   uint id, global_start, size, stride;
+   float4 input1, input2, temp;
+   uint4 values1, values2, v_temp;
+   int4 comp;
+
+   uint4 mask1 = (uint4)(1, 0, 3, 2);
+   uint4 mask2 = (uint4)(2, 3, 0, 1);
+   uint4 mask3 = (uint4)(3, 2, 1, 0);
+
+   int4 add1 = (int4)(1, 1, 3, 3);
+   int4 add2 = (int4)(2, 3, 2, 3);
+   int4 add3 = (int4)(1, 2, 2, 3);
+
+   id = get_local_id(0) * 2;
+   global_start = get_group_id(0) * get_local_size(0) * 2 + id;
+
+   input1 = g_keys[global_start];
+   input2 = g_keys[global_start+1];
+   values1 = g_values[global_start];
+   values2 = g_values[global_start+1];
+
+   /* Sort input 1 - ascending */
+   comp = KV_LESS(input1, values1, shuffle(input1, mask1),
+                  shuffle(values1, mask1));
+   input1 = shuffle(input1, as_uint4(comp + add1));
+   values1 = shuffle(values1, as_uint4(comp + add1));
+   comp = KV_LESS(input1, values1, shuffle(input1, mask2),
+                  shuffle(values1, mask2));
+   input1 = shuffle(input1, as_uint4(comp * 2 + add2));
+   values1 = shuffle(values1, as_uint4(comp * 2 + add2));
+   comp = KV_LESS(input1, values1, shuffle(input1, mask3),
+                  shuffle(values1, mask3));
+   input1 = shuffle(input1, as_uint4(comp + add3));
+   values1 = shuffle(values1, as_uint4(comp + add3));
+
+   /* Sort input 2 - descending */
+   comp = KV_LESS(shuffle(input2, mask1), shuffle(values2, mask1),
+                  input2, values2);
+   input2 = shuffle(input2, as_uint4(comp + add1));
+   values2 = shuffle(values2, as_uint4(comp + add1));
+   comp = KV_LESS(shuffle(input2, mask2), shuffle(values2, mask2),
+                  input2, values2);
+   input2 = shuffle(input2, as_uint4(comp * 2 + add2));
+   values2 = shuffle(values2, as_uint4(comp * 2 + add2));
+   comp = KV_LESS(shuffle(input2, mask3), shuffle(values2, mask3),
+                  input2, values2);
+   input2 = shuffle(input2, as_uint4(comp + add3));
+   values2 = shuffle(values2, as_uint4(comp + add3));
+
+   /* Swap corresponding elements of input 1 and 2 */
+   add3 = (int4)(4, 5, 6, 7);
+   dir = get_local_id(0) % 2 * -1;
+   VECTOR_SWAP(input1, values1, input2, values2, dir)
+
+   /* Sort data and store in local memory */
+   VECTOR_SORT(input1, values1, dir);
+   VECTOR_SORT(input2, values2, dir);
+   l_keys[id] = input1;
+   l_keys[id+1] = input2;
+   l_values[id] = values1;
+   l_values[id+1] = values2;
+
+   /* Create bitonic set */
+   for(size = 2; size < get_local_size(0); size <<= 1) {
+      dir = (get_local_id(0)/size & 1) * -1;
+
+      for(stride = size; stride > 1; stride >>= 1) {
+         barrier(CLK_LOCAL_MEM_FENCE);
+         id = get_local_id(0) + (get_local_id(0)/stride)*stride;
+         VECTOR_SWAP(l_keys[id], l_values[id], l_keys[id + stride],
+                     l_values[id + stride], dir)
+      }
+
+      barrier(CLK_LOCAL_MEM_FENCE);
+      id = get_local_id(0) * 2;
+      input1 = l_keys[id]; input2 = l_keys[id+1];
+      values1 = l_values[id]; values2 = l_values[id+1];
+      VECTOR_SWAP(input1, values1, input2, values2, dir)
+      VECTOR_SORT(input1, values1, dir);
+      VECTOR_SORT(input2, values2, dir);
+      l_keys[id] = input1;
+      l_keys[id+1] = input2;
+      l_values[id] = values1;
+      l_values[id+1] = values2;
+   }
+
+   /* Perform bitonic merge */
+   dir = (get_group_id(0) % 2) * -1;
+   for(stride = get_local_size(0); stride > 1; stride >>= 1) {
+      barrier(CLK_LOCAL_MEM_FENCE);
+      id = get_local_id(0) + (get_local_id(0)/stride)*stride;
+      VECTOR_SWAP(l_keys[id], l_values[id], l_keys[id + stride],
+                  l_values[id + stride], dir)
+   }
+   barrier(CLK_LOCAL_MEM_FENCE);
+
+   /* Perform final sort */
+   id = get_local_id(0) * 2;
+   input1 = l_keys[id]; input2 = l_keys[id+1];
+   values1 = l_values[id]; values2 = l_values[id+1];
+   VECTOR_SWAP(input1, values1, input2, values2, dir)
+   VECTOR_SORT(input1, values1, dir);
+   VECTOR_SORT(input2, values2, dir);
+   g_keys[global_start] = input1;
+   g_keys[global_start+1] = input2;
+   g_values[global_start] = values1;
+   g_values[global_start+1] = values2;
+}
+
+/* Perform lowest stage of the bitonic sort */
+__kernel void bsort_kv_stage_0(__global float4 *g_keys,
+                               __global uint4 *g_values,
+                               __local float4 *l_keys,
+                               __local uint4 *l_values, uint high_stage) {
+
+   int dir;
+   uint id, global_start, stride;
+   float4 input1, input2, temp;
+   uint4 values1, values2, v_temp;
+   int4 comp;
+
+   uint4 mask1 = (uint4)(1, 0, 3, 2);
+   uint4 mask2 = (uint4)(2, 3, 0, 1);
+
+   int4 add1 = (int4)(1, 1, 3, 3);
+   int4 add2 = (int4)(2, 3, 2, 3);
+   int4 add3 = (int4)(4, 5, 6, 7);
+
+   /* Determine data location in global memory */
+   id = get_local_id(0);
+   dir = (get_group_id(0)/high_stage & 1) * -1;
+   global_start = get_group_id(0) * get_local_size(0) * 2 + id;
+
+   /* Perform initial swap */
+   input1 = g_keys[global_start];
+   input2 = g_keys[global_start + get_local_size(0)];
+   values1 = g_values[global_start];
+   values2 = g_values[global_start + get_local_size(0)];
+   VECTOR_SWAP(input1, values1, input2, values2, dir)
+   l_keys[id] = input1;
+   l_keys[id + get_local_size(0)] = input2;
+   l_values[id] = values1;
+   l_values[id + get_local_size(0)] = values2;
+
+   /* Perform bitonic merge */
+   for(stride = get_local_size(0)/2; stride > 1; stride >>= 1) {
+      barrier(CLK_LOCAL_MEM_FENCE);
+      id = get_local_id(0) + (get_local_id(0)/stride)*stride;
+      VECTOR_SWAP(l_keys[id], l_values[id], l_keys[id + stride],
+                  l_values[id + stride], dir)
+   }
+   barrier(CLK_LOCAL_MEM_FENCE);
+
+   /* Perform final sort */
+   id = get_local_id(0) * 2;
+   input1 = l_keys[id]; input2 = l_keys[id+1];
+   values1 = l_values[id]; values2 = l_values[id+1];
+   VECTOR_SWAP(input1, values1, input2, values2, dir)
+   VECTOR_SORT(input1, values1, dir);
+   VECTOR_SORT(input2, values2, dir);
+
+   /* Store output in global memory */
+   g_keys[global_start + get_local_id(0)] = input1;
+   g_keys[global_start + get_local_id(0) + 1] = input2;
+   g_values[global_start + get_local_id(0)] = values1;
+   g_values[global_start + get_local_id(0) + 1] = values2;
+}
+
+/* Perform successive stages of the bitonic sort */
+__kernel void bsort_kv_stage_n(__global float4 *g_keys,
+                               __global uint4 *g_values,
+                               __local float4 *l_keys,
+                               __local uint4 *l_values,
+                               uint stage, uint high_stage) {
+
+   int dir;
+   float4 input1, input2, temp;
+   uint4 values1, values2, v_temp;
+   int4 comp, add3;
+   uint global_start, global_offset;
+
+   add3 = (int4)(4, 5, 6, 7);
+
+   /* Determine location of data in global memory */
+   dir = (get_group_id(0)/high_stage & 1) * -1;
+   global_start = (get_group_id(0) + (get_group_id(0)/stage)*stage) *
+                   get_local_size(0) + get_local_id(0);
+   global_offset = stage * get_local_size(0);
+
+   /* Perform swap */
+   input1 = g_keys[global_start];
+   input2 = g_keys[global_start + global_offset];
+   values1 = g_values[global_start];
+   values2 = g_values[global_start + global_offset];
+   VECTOR_SWAP(input1, values1, input2, values2, dir)
+   g_keys[global_start] = input1;
+   g_keys[global_start + global_offset] = input2;
+   g_values[global_start] = values1;
+   g_values[global_start + global_offset] = values2;
+}
+
+/* Sort the bitonic set */
+__kernel void bsort_kv_merge(__global float4 *g_keys,
+                             __global uint4 *g_values,
+                             __local float4 *l_keys,
+                             __local uint4 *l_values, uint stage, int dir) {
+
+   float4 input1, input2, temp;
+   uint4 values1, values2, v_temp;
+   int4 comp, add3;
+   uint global_start, global_offset;
+
+   add3 = (int4)(4, 5, 6, 7);
+
+   /* Determine location of data in global memory */
+   global_start = (get_group_id(0) + (get_group_id(0)/stage)*stage) *
+                   get_local_size(0) + get_local_id(0);
+   global_offset = stage * get_local_size(0);
+
+   /* Perform swap */
+   input1 = g_keys[global_start];
+   input2 = g_keys[global_start + global_offset];
+   values1 = g_values[global_start];
+   values2 = g_values[global_start + global_offset];
+   VECTOR_SWAP(input1, values1, input2, values2, dir)
+   g_keys[global_start] = input1;
+   g_keys[global_start + global_offset] = input2;
+   g_values[global_start] = values1;
+   g_values[global_start + global_offset] = values2;
+}
+
+/* Perform final step of the bitonic merge */
+__kernel void bsort_kv_merge_last(__global float4 *g_keys,
+                                  __global uint4 *g_values,
+                                  __local float4 *l_keys,
+                                  __local uint4 *l_values, int dir) {
+
+   uint id, global_start, stride;
+   float4 input1, input2, temp;
+   uint4 values1, values2, v_temp;
+   int4 comp;
+
+   uint4 mask1 = (uint4)(1, 0, 3, 2);
+   uint4 mask2 = (uint4)(2, 3, 0, 1);
+
+   int4 add1 = (int4)(1, 1, 3, 3);
+   int4 add2 = (int4)(2, 3, 2, 3);
+   int4 add3 = (int4)(4, 5, 6, 7);
+
+   /* Determine location of data in global memory */
+   id = get_local_id(0);
+   global_start = get_group_id(0) * get_local_size(0) * 2 + id;
+
+   /* Perform initial swap */
+   input1 = g_keys[global_start];
+   input2 = g_keys[global_start + get_local_size(0)];
+   values1 = g_values[global_start];
+   values2 = g_values[global_start + get_local_size(0)];
+   VECTOR_SWAP(input1, values1, input2, values2, dir)
+   l_keys[id] = input1;
+   l_keys[id + get_local_size(0)] = input2;
+   l_values[id] = values1;
+   l_values[id + get_local_size(0)] = values2;
+
+   /* Perform bitonic merge */
+   for(stride = get_local_size(0)/2; stride > 1; stride >>= 1) {
+      barrier(CLK_LOCAL_MEM_FENCE);
+      id = get_local_id(0) + (get_local_id(0)/stride)*stride;
+      VECTOR_SWAP(l_keys[id], l_values[id], l_keys[id + stride],
+                  l_values[id + stride], dir)
+   }
+   barrier(CLK_LOCAL_MEM_FENCE);
+
+   /* Perform final sort */
+   id = get_local_id(0) * 2;
+   input1 = l_keys[id]; input2 = l_keys[id+1];
+   values1 = l_values[id]; values2 = l_values[id+1];
+   VECTOR_SWAP(input1, values1, input2, values2, dir)
+   VECTOR_SORT(input1, values1, dir);
+   VECTOR_SORT(input2, values2, dir);
+
+   /* Store the result to global memory */
+   g_keys[global_start + get_local_id(0)] = input1;
+   g_keys[global_start + get_local_id(0) + 1] = input2;
+   g_values[global_start + get_local_id(0)] = values1;
+   g_values[global_start + get_local_id(0) + 1] = values2;
+}
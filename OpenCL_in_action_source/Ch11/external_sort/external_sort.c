@@ -0,0 +1,559 @@
+#define _CRT_SECURE_NO_WARNINGS
+#define _POSIX_C_SOURCE 200112L
+#define _FILE_OFFSET_BITS 64
+#define PROGRAM_FILE "../radix_sort/radix_sort.cl"
+
+#define INPUT_FILE "keys.bin"
+#define OUTPUT_FILE "sorted.bin"
+#define RUN_FILE "run_%d.tmp"
+#define DEFAULT_KEYS 67108864
+#define CHUNK_KEYS 8388608
+#define RUN_BUFFER_KEYS 65536
+#define OUT_BUFFER_KEYS 1048576
+#define GROUPS_PER_UNIT 8
+#define MAX_LOCAL_SIZE 256
+#define RADIX_BITS 4
+#define RADIX (1 << RADIX_BITS)
+#define EXHAUSTED 0x100000000ULL
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef UNIX
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef MAC
+#include <OpenCL/cl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+/* Find a GPU or CPU associated with the first available platform */
+cl_device_id create_device() {
+
+   cl_platform_id platform;
+   cl_device_id dev;
+   int err;
+
+   /* Identify a platform */
+   err = clGetPlatformIDs(1, &platform, NULL);
+   if(err < 0) {
+      perror("Couldn't identify a platform");
+      exit(1);
+   } 
+
+   /* Access a device */
+   err = clGetDeviceIDs(platform, CL_DEVICE_TYPE_GPU, 1, &dev, NULL);
+   if(err == CL_DEVICE_NOT_FOUND) {
+      err = clGetDeviceIDs(platform, CL_DEVICE_TYPE_CPU, 1, &dev, NULL);
+   }
+   if(err < 0) {
+      perror("Couldn't access any devices");
+      exit(1);   
+   }
+
+   return dev;
+}
+
+/* Create program from a file and compile it */
+cl_program build_program(cl_context ctx, cl_device_id dev, const char* filename) {
+
+   cl_program program;
+   FILE *program_handle;
+   char *program_buffer, *program_log;
+   size_t program_size, log_size;
+   int err;
+
+   /* Read program file and place content into buffer */
+   program_handle = fopen(filename, "r");
+   if(program_handle == NULL) {
+      perror("Couldn't find the program file");
+      exit(1);
+   }
+   fseek(program_handle, 0, SEEK_END);
+   program_size = ftell(program_handle);
+   rewind(program_handle);
+   program_buffer = (char*)malloc(program_size + 1);
+   program_buffer[program_size] = '\0';
+   fread(program_buffer, sizeof(char), program_size, program_handle);
+   fclose(program_handle);
+
+   /* Create program from file */
+   program = clCreateProgramWithSource(ctx, 1, 
+      (const char**)&program_buffer, &program_size, &err);
+   if(err < 0) {
+      perror("Couldn't create the program");
+      exit(1);
+   }
+   free(program_buffer);
+
+   /* Build program */
+   err = clBuildProgram(program, 0, NULL, NULL, NULL, NULL);
+   if(err < 0) {
+
+      /* Find size of log and print to std output */
+      clGetProgramBuildInfo(program, dev, CL_PROGRAM_BUILD_LOG, 
+            0, NULL, &log_size);
+      program_log = (char*) malloc(log_size + 1);
+      program_log[log_size] = '\0';
+      clGetProgramBuildInfo(program, dev, CL_PROGRAM_BUILD_LOG, 
+            log_size + 1, program_log, NULL);
+      printf("%s\n", program_log);
+      free(program_log);
+      exit(1);
+   }
+
+   return program;
+}
+
+/* Read the wall clock in nanoseconds */
+unsigned long long wall_time_ns(void) {
+
+#ifdef UNIX
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#else
+   return (unsigned long long)(1.0e9 * clock()/CLOCKS_PER_SEC);
+#endif
+}
+
+/* Order-independent checksum of the keys, updated one key at a time */
+void add_checksum(cl_ulong* checksum, cl_uint key) {
+
+   checksum[0] += key;
+   checksum[1] += (cl_ulong)key * key;
+}
+
+/* Enqueue the count, scan and scatter passes of Ch11/radix_sort. The 
+   number of passes is even, so the result ends up in keys_buffer */
+void enqueue_radix_sort(cl_command_queue queue, cl_kernel* kernels, 
+      cl_mem keys_buffer, cl_mem temp_buffer, cl_mem hist_buffer,
+      cl_uint num_keys, size_t local_size, cl_uint max_groups) {
+
+   cl_mem buffers[2] = {keys_buffer, temp_buffer};
+   cl_uint shift, num_tiles, tiles_per_group, num_groups, num_entries;
+   size_t global_size;
+   int pass, err;
+
+   /* Give every work-group a contiguous range of whole tiles */
+   num_tiles = (num_keys + local_size - 1)/local_size;
+   tiles_per_group = (num_tiles + max_groups - 1)/max_groups;
+   num_groups = (num_tiles + tiles_per_group - 1)/tiles_per_group;
+   num_entries = RADIX * num_groups;
+   global_size = num_groups * local_size;
+
+   for(shift = 0; shift < 32; shift += RADIX_BITS) {
+      pass = shift/RADIX_BITS;
+
+      /* Set kernel arguments, which are captured at every enqueue */
+      err = clSetKernelArg(kernels[0], 0, sizeof(cl_mem), &buffers[pass%2]);
+      err |= clSetKernelArg(kernels[0], 1, sizeof(cl_uint), &num_keys);
+      err |= clSetKernelArg(kernels[0], 2, sizeof(cl_uint), &shift);
+      err |= clSetKernelArg(kernels[0], 3, sizeof(cl_uint), &tiles_per_group);
+      err |= clSetKernelArg(kernels[0], 4, sizeof(cl_mem), &hist_buffer);
+      err |= clSetKernelArg(kernels[1], 0, sizeof(cl_mem), &hist_buffer);
+      err |= clSetKernelArg(kernels[1], 1, sizeof(cl_uint), &num_entries);
+      err |= clSetKernelArg(kernels[1], 2, local_size * sizeof(cl_uint), NULL);
+      err |= clSetKernelArg(kernels[2], 0, sizeof(cl_mem), &buffers[pass%2]);
+      err |= clSetKernelArg(kernels[2], 1, sizeof(cl_uint), &num_keys);
+      err |= clSetKernelArg(kernels[2], 2, sizeof(cl_uint), &shift);
+      err |= clSetKernelArg(kernels[2], 3, sizeof(cl_uint), &tiles_per_group);
+      err |= clSetKernelArg(kernels[2], 4, sizeof(cl_mem), &hist_buffer);
+      err |= clSetKernelArg(kernels[2], 5, local_size * sizeof(cl_uint), NULL);
+      err |= clSetKernelArg(kernels[2], 6, local_size * sizeof(cl_uint), NULL);
+      err |= clSetKernelArg(kernels[2], 7, sizeof(cl_mem), 
+            &buffers[(pass+1)%2]);
+      if(err < 0) {
+         perror("Couldn't create a kernel argument");
+         exit(1);   
+      }
+
+      err = clEnqueueNDRangeKernel(queue, kernels[0], 1, NULL, &global_size, 
+            &local_size, 0, NULL, NULL);
+      err |= clEnqueueNDRangeKernel(queue, kernels[1], 1, NULL, &local_size, 
+            &local_size, 0, NULL, NULL);
+      err |= clEnqueueNDRangeKernel(queue, kernels[2], 1, NULL, &global_size, 
+            &local_size, 0, NULL, NULL);
+      if(err < 0) {
+         perror("Couldn't enqueue the kernel");
+         exit(1);   
+      }
+   }
+}
+
+/* A sorted run read back from disk through a small buffer */
+typedef struct run_reader {
+   FILE *file;
+   cl_uint *buffer;
+   size_t pos, count;
+} run_reader;
+
+/* Return the next key of a run, or EXHAUSTED after its last key */
+cl_ulong run_key(run_reader* run) {
+
+   if(run->pos == run->count) {
+      run->count = fread(run->buffer, sizeof(cl_uint), RUN_BUFFER_KEYS, 
+            run->file);
+      run->pos = 0;
+      if(run->count == 0)
+         return EXHAUSTED;
+   }
+   return run->buffer[run->pos];
+}
+
+/* Play the matches below node, storing the loser at every internal 
+   node of the tournament tree, and return the winning run */
+int build_tree(int* tree, cl_ulong* heads, int num_runs, int node) {
+
+   int left, right;
+
+   if(node >= num_runs)
+      return node - num_runs;
+   left = build_tree(tree, heads, num_runs, 2*node);
+   right = build_tree(tree, heads, num_runs, 2*node + 1);
+   if(heads[right] < heads[left]) {
+      tree[node] = left;
+      return right;
+   }
+   tree[node] = right;
+   return left;
+}
+
+/* Replay the matches on the path of the last winner once its head has
+   advanced, and return the new winner */
+int replay_tree(int* tree, cl_ulong* heads, int num_runs, int winner) {
+
+   int node, loser;
+
+   for(node = (winner + num_runs)/2; node > 0; node /= 2) {
+      if(heads[tree[node]] < heads[winner]) {
+         loser = winner;
+         winner = tree[node];
+         tree[node] = loser;
+      }
+   }
+   return winner;
+}
+
+/* Write random keys to a new input file */
+void generate_input(const char* name, cl_uint num_keys) {
+
+   FILE *file;
+   cl_uint *block, i, j, count;
+
+   file = fopen(name, "wb");
+   if(file == NULL) {
+      perror("Couldn't create the input file");
+      exit(1);
+   }
+   block = (cl_uint*) malloc(OUT_BUFFER_KEYS * sizeof(cl_uint));
+   srand(time(NULL));
+   for(i=0; i<num_keys; i+=count) {
+      count = num_keys - i < OUT_BUFFER_KEYS ? num_keys - i : OUT_BUFFER_KEYS;
+      for(j=0; j<count; j++) {
+         block[j] = ((cl_uint)rand() << 16) ^ (cl_uint)rand();
+      }
+      fwrite(block, sizeof(cl_uint), count, file);
+   }
+   fclose(file);
+   free(block);
+}
+
+int main(int argc, char** argv) {
+
+   /* OpenCL structures */
+   cl_device_id device;
+   cl_context context;
+   cl_program program;
+   cl_kernel kernels[3];
+   cl_command_queue queues[2];
+   cl_int i, err, slot, num_runs, winner, *tree, check;
+   cl_uint compute_units, max_groups, chunk_keys, count, j;
+   cl_ulong max_alloc, num_keys, offset, written, previous, key;
+   cl_ulong in_checksum[2] = {0, 0}, out_checksum[2] = {0, 0};
+   cl_ulong *heads;
+   size_t local_size;
+   unsigned long long start, run_time, merge_time;
+   const char* kernel_names[3] = {"radix_count", "radix_scan", 
+         "radix_scatter"};
+   const char *input_name, *output_name;
+   char run_name[64];
+
+   /* Data and buffers */
+   FILE *input, *output, *run_file;
+   const cl_uint *source;
+   cl_uint *run_buffers[2], *out_buffer;
+   cl_uint run_counts[2];
+   cl_mem keys_buffers[2], temp_buffers[2], hist_buffers[2];
+   run_reader *runs;
+#ifdef UNIX
+   int fd;
+   struct stat file_stat;
+   const cl_uint *mapping;
+#endif
+
+   /* Open the input, generating it if it doesn't exist */
+   input_name = argc > 1 ? argv[1] : INPUT_FILE;
+   output_name = argc > 2 ? argv[2] : OUTPUT_FILE;
+   input = fopen(input_name, "rb");
+   if(input == NULL) {
+      printf("Generating %u keys in %s\n", DEFAULT_KEYS, input_name);
+      generate_input(input_name, DEFAULT_KEYS);
+      input = fopen(input_name, "rb");
+      if(input == NULL) {
+         perror("Couldn't open the input file");
+         exit(1);
+      }
+   }
+#ifdef UNIX
+   fclose(input);
+   fd = open(input_name, O_RDONLY);
+   if(fd < 0 || fstat(fd, &file_stat) < 0) {
+      perror("Couldn't open the input file");
+      exit(1);
+   }
+   num_keys = file_stat.st_size/sizeof(cl_uint);
+   mapping = (const cl_uint*) mmap(NULL, num_keys * sizeof(cl_uint), 
+         PROT_READ, MAP_PRIVATE, fd, 0);
+   if(mapping == MAP_FAILED) {
+      perror("Couldn't map the input file");
+      exit(1);
+   }
+   posix_madvise((void*)mapping, num_keys * sizeof(cl_uint), 
+         POSIX_MADV_SEQUENTIAL);
+#else
+   fseek(input, 0, SEEK_END);
+   num_keys = ftell(input)/sizeof(cl_uint);
+   rewind(input);
+#endif
+
+   /* Create device and context */
+   device = create_device();
+   err = clGetDeviceInfo(device, CL_DEVICE_MAX_COMPUTE_UNITS, 
+         sizeof(compute_units), &compute_units, NULL);
+   err |= clGetDeviceInfo(device, CL_DEVICE_MAX_MEM_ALLOC_SIZE, 
+         sizeof(max_alloc), &max_alloc, NULL);
+   if(err < 0) {
+      perror("Couldn't obtain device information");
+      exit(1);   
+   }
+   context = clCreateContext(NULL, 1, &device, NULL, NULL, &err);
+   if(err < 0) {
+      perror("Couldn't create a context");
+      exit(1);   
+   }
+
+   /* Build the radix sort program and create kernels */
+   program = build_program(context, device, PROGRAM_FILE);
+   for(i=0; i<3; i++) {
+      kernels[i] = clCreateKernel(program, kernel_names[i], &err);
+      if(err < 0) {
+         perror("Couldn't create a kernel");
+         exit(1);
+      };
+   }
+   err = clGetKernelWorkGroupInfo(kernels[2], device, 
+         CL_KERNEL_WORK_GROUP_SIZE, sizeof(local_size), &local_size, NULL);
+   if(err < 0) {
+      perror("Couldn't find the maximum work-group size");
+      exit(1);   
+   };
+   local_size = (size_t)pow(2, trunc(log2(local_size)));
+   if(local_size > MAX_LOCAL_SIZE)
+      local_size = MAX_LOCAL_SIZE;
+   if(local_size < RADIX) {
+      printf("The radix sort needs %d work-items per group\n", RADIX);
+      exit(1);
+   }
+   max_groups = compute_units * GROUPS_PER_UNIT;
+
+   /* Size the chunks to fit in one buffer */
+   chunk_keys = CHUNK_KEYS;
+   while(chunk_keys * sizeof(cl_uint) > max_alloc)
+      chunk_keys >>= 1;
+   num_runs = (int)((num_keys + chunk_keys - 1)/chunk_keys);
+   printf("%llu keys in %d runs of up to %u keys\n", 
+         (unsigned long long)num_keys, num_runs, chunk_keys);
+
+   /* Two queues and two sets of buffers, so one chunk can be 
+      transferred while the other is sorted */
+   for(slot=0; slot<2; slot++) {
+      queues[slot] = clCreateCommandQueue(context, device, 0, &err);
+      if(err < 0) {
+         perror("Couldn't create a command queue");
+         exit(1);   
+      };
+      keys_buffers[slot] = clCreateBuffer(context, CL_MEM_READ_WRITE, 
+            chunk_keys * sizeof(cl_uint), NULL, &err);
+      temp_buffers[slot] = clCreateBuffer(context, CL_MEM_READ_WRITE, 
+            chunk_keys * sizeof(cl_uint), NULL, &err);
+      hist_buffers[slot] = clCreateBuffer(context, CL_MEM_READ_WRITE, 
+            RADIX * max_groups * sizeof(cl_uint), NULL, &err);
+      if(err < 0) {
+         perror("Couldn't create a buffer");
+         exit(1);   
+      };
+      run_buffers[slot] = (cl_uint*) malloc(chunk_keys * sizeof(cl_uint));
+   }
+
+   /* Phase 1: sort each chunk on the device and write it as a run */
+   start = wall_time_ns();
+   for(i=0; i<=num_runs; i++) {
+
+      /* Start the next chunk */
+      if(i < num_runs) {
+         slot = i%2;
+         offset = (cl_ulong)i * chunk_keys;
+         count = (cl_uint)(num_keys - offset < chunk_keys ? 
+               num_keys - offset : chunk_keys);
+#ifdef UNIX
+         source = mapping + offset;
+#else
+         fread(run_buffers[slot], sizeof(cl_uint), count, input);
+         source = run_buffers[slot];
+#endif
+
+         /* Checksum the input while the device sorts the previous chunk.
+            Without a mapping, the sorted keys are read back into the 
+            same buffer, so this must finish before they are enqueued */
+         for(j=0; j<count; j++) {
+            add_checksum(in_checksum, source[j]);
+         }
+         err = clEnqueueWriteBuffer(queues[slot], keys_buffers[slot], 
+               CL_FALSE, 0, count * sizeof(cl_uint), source, 0, NULL, NULL);
+         if(err < 0) {
+            perror("Couldn't write the buffer");
+            exit(1);   
+         }
+         enqueue_radix_sort(queues[slot], kernels, keys_buffers[slot], 
+               temp_buffers[slot], hist_buffers[slot], count, local_size, 
+               max_groups);
+         err = clEnqueueReadBuffer(queues[slot], keys_buffers[slot], 
+               CL_FALSE, 0, count * sizeof(cl_uint), run_buffers[slot], 
+               0, NULL, NULL);
+         if(err < 0) {
+            perror("Couldn't read the buffer");
+            exit(1);   
+         }
+         clFlush(queues[slot]);
+         run_counts[slot] = count;
+      }
+
+      /* Finish the previous chunk and write its run */
+      if(i > 0) {
+         slot = (i-1)%2;
+         clFinish(queues[slot]);
+         sprintf(run_name, RUN_FILE, i-1);
+         run_file = fopen(run_name, "wb");
+         if(run_file == NULL) {
+            perror("Couldn't create a run file");
+            exit(1);
+         }
+         fwrite(run_buffers[slot], sizeof(cl_uint), run_counts[slot], 
+               run_file);
+         fclose(run_file);
+      }
+   }
+   run_time = wall_time_ns() - start;
+
+   /* Phase 2: merge the runs with a tournament tree */
+   start = wall_time_ns();
+   runs = (run_reader*) malloc(num_runs * sizeof(run_reader));
+   heads = (cl_ulong*) malloc(num_runs * sizeof(cl_ulong));
+   tree = (int*) malloc((num_runs + 1) * sizeof(int));
+   for(i=0; i<num_runs; i++) {
+      sprintf(run_name, RUN_FILE, i);
+      runs[i].file = fopen(run_name, "rb");
+      if(runs[i].file == NULL) {
+         perror("Couldn't open a run file");
+         exit(1);
+      }
+      runs[i].buffer = (cl_uint*) malloc(RUN_BUFFER_KEYS * sizeof(cl_uint));
+      runs[i].pos = 0;
+      runs[i].count = 0;
+      heads[i] = run_key(&runs[i]);
+   }
+   output = fopen(output_name, "wb");
+   if(output == NULL) {
+      perror("Couldn't create the output file");
+      exit(1);
+   }
+   out_buffer = (cl_uint*) malloc(OUT_BUFFER_KEYS * sizeof(cl_uint));
+   check = 1;
+   written = 0;
+   previous = 0;
+   count = 0;
+   winner = num_runs > 0 ? build_tree(tree, heads, num_runs, 1) : 0;
+   while(num_runs > 0 && heads[winner] != EXHAUSTED) {
+      key = heads[winner];
+      if(key < previous)
+         check = 0;
+      previous = key;
+      add_checksum(out_checksum, (cl_uint)key);
+      out_buffer[count++] = (cl_uint)key;
+      if(count == OUT_BUFFER_KEYS) {
+         fwrite(out_buffer, sizeof(cl_uint), count, output);
+         written += count;
+         count = 0;
+      }
+      runs[winner].pos++;
+      heads[winner] = run_key(&runs[winner]);
+      winner = replay_tree(tree, heads, num_runs, winner);
+   }
+   fwrite(out_buffer, sizeof(cl_uint), count, output);
+   written += count;
+   fclose(output);
+   merge_time = wall_time_ns() - start;
+
+   /* Report the throughput of each phase */
+   if(written != num_keys || in_checksum[0] != out_checksum[0] ||
+         in_checksum[1] != out_checksum[1])
+      check = 0;
+   printf("Run formation: %.1f MB/s\n", 
+         1.0e3 * num_keys * sizeof(cl_uint)/run_time);
+   printf("Merge: %.1f MB/s\n", 
+         1.0e3 * num_keys * sizeof(cl_uint)/merge_time);
+   printf("Total: %.1f MB/s\n", 
+         1.0e3 * num_keys * sizeof(cl_uint)/(run_time + merge_time));
+   printf("%s\n", check ? "Check passed." : "Check failed.");
+
+   /* Deallocate resources */
+   for(i=0; i<num_runs; i++) {
+      fclose(runs[i].file);
+      free(runs[i].buffer);
+      sprintf(run_name, RUN_FILE, i);
+      remove(run_name);
+   }
+   for(slot=0; slot<2; slot++) {
+      clReleaseMemObject(keys_buffers[slot]);
+      clReleaseMemObject(temp_buffers[slot]);
+      clReleaseMemObject(hist_buffers[slot]);
+      clReleaseCommandQueue(queues[slot]);
+      free(run_buffers[slot]);
+   }
+   for(i=0; i<3; i++) {
+      clReleaseKernel(kernels[i]);
+   }
+   clReleaseProgram(program);
+   clReleaseContext(context);
+   free(runs);
+   free(heads);
+   free(tree);
+   free(out_buffer);
+#ifdef UNIX
+   munmap((void*)mapping, num_keys * sizeof(cl_uint));
+   close(fd);
+#else
+   fclose(input);
+#endif
+   return 0;
+}
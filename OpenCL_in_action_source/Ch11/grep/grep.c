@@ -0,0 +1,705 @@
+#define _CRT_SECURE_NO_WARNINGS
+#define _POSIX_C_SOURCE 200112L
+#define _FILE_OFFSET_BITS 64
+#define PROGRAM_FILE "grep.cl"
+#define TEXT_FILE "../string_search/kafka.txt"
+
+/* Files are read in chunks of CHUNK_SIZE characters, as in
+   string_search. Each chunk is uploaded with the first OVERLAP
+   characters of the next, so every pattern starting in the chunk can be
+   compared in full */
+#define CHUNK_SIZE 4194304
+#define MAX_PATTERNS 16
+#define MAX_LENGTH 64
+#define OVERLAP (MAX_LENGTH - 1)
+#define GROUPS_PER_UNIT 8
+#define NUM_SHOWN 10
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef UNIX
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef MAC
+#include <OpenCL/cl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+/* The matching lines of a file, numbered from 1, with the first
+   character of each line and the character past its end */
+typedef struct line_list {
+   int count, capacity;
+   cl_ulong *numbers, *starts, *ends;
+} line_list;
+
+/* Find a GPU or CPU associated with the first available platform */
+cl_device_id create_device() {
+
+   cl_platform_id platform;
+   cl_device_id dev;
+   int err;
+
+   /* Identify a platform */
+   err = clGetPlatformIDs(1, &platform, NULL);
+   if(err < 0) {
+      perror("Couldn't identify a platform");
+      exit(1);
+   } 
+
+   /* Access a device */
+   err = clGetDeviceIDs(platform, CL_DEVICE_TYPE_GPU, 1, &dev, NULL);
+   if(err == CL_DEVICE_NOT_FOUND) {
+      err = clGetDeviceIDs(platform, CL_DEVICE_TYPE_CPU, 1, &dev, NULL);
+   }
+   if(err < 0) {
+      perror("Couldn't access any devices");
+      exit(1);   
+   }
+
+   return dev;
+}
+
+/* Create program from a file and compile it */
+cl_program build_program(cl_context ctx, cl_device_id dev, const char* filename) {
+
+   cl_program program;
+   FILE *program_handle;
+   char *program_buffer, *program_log;
+   size_t program_size, log_size;
+   int err;
+
+   /* Read program file and place content into buffer */
+   program_handle = fopen(filename, "r");
+   if(program_handle == NULL) {
+      perror("Couldn't find the program file");
+      exit(1);
+   }
+   fseek(program_handle, 0, SEEK_END);
+   program_size = ftell(program_handle);
+   rewind(program_handle);
+   program_buffer = (char*)malloc(program_size + 1);
+   program_buffer[program_size] = '\0';
+   fread(program_buffer, sizeof(char), program_size, program_handle);
+   fclose(program_handle);
+
+   /* Create program from file */
+   program = clCreateProgramWithSource(ctx, 1, 
+      (const char**)&program_buffer, &program_size, &err);
+   if(err < 0) {
+      perror("Couldn't create the program");
+      exit(1);
+   }
+   free(program_buffer);
+
+   /* Build program */
+   err = clBuildProgram(program, 0, NULL, NULL, NULL, NULL);
+   if(err < 0) {
+
+      /* Find size of log and print to std output */
+      clGetProgramBuildInfo(program, dev, CL_PROGRAM_BUILD_LOG, 
+            0, NULL, &log_size);
+      program_log = (char*) malloc(log_size + 1);
+      program_log[log_size] = '\0';
+      clGetProgramBuildInfo(program, dev, CL_PROGRAM_BUILD_LOG, 
+            log_size + 1, program_log, NULL);
+      printf("%s\n", program_log);
+      free(program_log);
+      exit(1);
+   }
+
+   return program;
+}
+
+/* Read the wall clock in nanoseconds */
+unsigned long long wall_time_ns(void) {
+
+#ifdef UNIX
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#else
+   return (unsigned long long)(1.0e9 * clock()/CLOCKS_PER_SEC);
+#endif
+}
+
+/* A text file read in chunks, through a mapping where available */
+typedef struct text_file {
+   cl_ulong size;
+   int num_chunks;
+   char *buffer;
+#ifdef UNIX
+   int fd;
+   const char *mapping;
+#else
+   FILE *handle;
+#endif
+} text_file;
+
+void open_text(text_file *file, const char *name) {
+
+   FILE *handle;
+#ifdef UNIX
+   struct stat file_stat;
+#endif
+
+   handle = fopen(name, "rb");
+   if(handle == NULL) {
+      perror("Couldn't find the text file");
+      exit(1);
+   }
+#ifdef UNIX
+   fclose(handle);
+   file->fd = open(name, O_RDONLY);
+   if(file->fd < 0 || fstat(file->fd, &file_stat) < 0) {
+      perror("Couldn't open the text file");
+      exit(1);
+   }
+   file->size = file_stat.st_size;
+   file->mapping = (const char*) mmap(NULL, file->size, PROT_READ,
+         MAP_PRIVATE, file->fd, 0);
+   if(file->mapping == MAP_FAILED) {
+      perror("Couldn't map the text file");
+      exit(1);
+   }
+   posix_madvise((void*)file->mapping, file->size, POSIX_MADV_SEQUENTIAL);
+#else
+   file->handle = handle;
+   fseek(handle, 0, SEEK_END);
+   file->size = ftell(handle);
+   rewind(handle);
+#endif
+   file->num_chunks = (int)((file->size + CHUNK_SIZE - 1)/CHUNK_SIZE);
+   file->buffer = (char*) malloc(CHUNK_SIZE + OVERLAP);
+}
+
+/* Find the characters of a chunk and the readable characters after
+   them, and return a pointer to the chunk */
+const char* read_chunk(text_file *file, int chunk, int *num_chars,
+      int *readable) {
+
+   cl_ulong offset = (cl_ulong)chunk * CHUNK_SIZE;
+
+   *num_chars = (int)(file->size - offset < CHUNK_SIZE ?
+         file->size - offset : CHUNK_SIZE);
+   *readable = (int)(file->size - offset < CHUNK_SIZE + OVERLAP ?
+         file->size - offset : CHUNK_SIZE + OVERLAP);
+#ifdef UNIX
+   return file->mapping + offset;
+#else
+   fseek(file->handle, (long)offset, SEEK_SET);
+   fread(file->buffer, sizeof(char), *readable, file->handle);
+   return file->buffer;
+#endif
+}
+
+/* Print the start of a line of the file */
+void print_line(text_file *file, cl_ulong start, cl_ulong end) {
+
+   char text[61];
+   int length = (int)(end - start < 60 ? end - start : 60);
+
+#ifdef UNIX
+   memcpy(text, file->mapping + start, length);
+#else
+   fseek(file->handle, (long)start, SEEK_SET);
+   fread(text, sizeof(char), length, file->handle);
+#endif
+   text[length] = '\0';
+   printf("%s%s\n", text, end - start > 60 ? "..." : "");
+}
+
+void close_text(text_file *file) {
+
+#ifdef UNIX
+   munmap((void*)file->mapping, file->size);
+   close(file->fd);
+#else
+   fclose(file->handle);
+#endif
+   free(file->buffer);
+}
+
+/* Add a line to the list, or extend the last line if it has the same
+   number */
+void add_line(line_list *list, cl_ulong number, cl_ulong start,
+      cl_ulong end) {
+
+   int last = list->count - 1;
+
+   if(last >= 0 && list->numbers[last] == number) {
+      list->ends[last] = end;
+      return;
+   }
+   if(list->count == list->capacity) {
+      list->capacity = list->capacity ? list->capacity * 2 : 1024;
+      list->numbers = (cl_ulong*) realloc(list->numbers,
+            list->capacity * sizeof(cl_ulong));
+      list->starts = (cl_ulong*) realloc(list->starts,
+            list->capacity * sizeof(cl_ulong));
+      list->ends = (cl_ulong*) realloc(list->ends,
+            list->capacity * sizeof(cl_ulong));
+   }
+   list->numbers[list->count] = number;
+   list->starts[list->count] = start;
+   list->ends[list->count] = end;
+   list->count++;
+}
+
+/* Find the matching lines of a file on the device. kernels holds
+   line_count, line_scan, line_mark, hit_count and hit_lines, with the
+   patterns and local memory set. Line numbers and byte ranges are
+   relative to the chunk on the device and made absolute here. Returns
+   the wall time in nanoseconds */
+unsigned long long device_grep(text_file *file, cl_command_queue queue,
+      cl_kernel *kernels, cl_mem text_buffer, cl_mem counts_buffer,
+      cl_mem offsets_buffer, cl_mem ends_buffer, cl_mem hits_buffer,
+      cl_mem lines_buffer, cl_mem ranges_buffer, size_t global_size,
+      size_t local_size, line_list *list) {
+
+   /* line_hits keeps the stamps of earlier chunks and calls */
+   static int stamp = 0;
+
+   unsigned long long start;
+   const char *source;
+   cl_uint *lines, *ranges, ends[2], num_groups, num_lines, hit_groups;
+   cl_ulong offset, line_base = 0, line_start = 0;
+   size_t hit_size;
+   int i, j, err, num_chars, readable, chars_per_item, num_newlines,
+         num_hits;
+
+   lines = (cl_uint*) malloc((CHUNK_SIZE + 1) * sizeof(cl_uint));
+   ranges = (cl_uint*) malloc((CHUNK_SIZE + 1) * 2 * sizeof(cl_uint));
+   num_groups = (cl_uint)(global_size/local_size);
+   list->count = 0;
+
+   start = wall_time_ns();
+   for(i=0; i<file->num_chunks; i++) {
+
+      /* Upload the chunk and number its lines */
+      offset = (cl_ulong)i * CHUNK_SIZE;
+      source = read_chunk(file, i, &num_chars, &readable);
+      chars_per_item = (int)((num_chars + global_size - 1)/global_size);
+      stamp++;
+      err = clEnqueueWriteBuffer(queue, text_buffer, CL_FALSE, 0,
+            readable, source, 0, NULL, NULL);
+      err |= clSetKernelArg(kernels[0], 0, sizeof(cl_mem), &text_buffer);
+      err |= clSetKernelArg(kernels[0], 1, sizeof(int), &chars_per_item);
+      err |= clSetKernelArg(kernels[0], 2, sizeof(int), &num_chars);
+      err |= clSetKernelArg(kernels[0], 4, sizeof(cl_mem), &counts_buffer);
+      err |= clSetKernelArg(kernels[1], 0, sizeof(cl_mem), &counts_buffer);
+      err |= clSetKernelArg(kernels[1], 1, sizeof(cl_uint), &num_groups);
+      err |= clSetKernelArg(kernels[1], 3, sizeof(cl_mem), &offsets_buffer);
+      err |= clEnqueueNDRangeKernel(queue, kernels[0], 1, NULL,
+            &global_size, &local_size, 0, NULL, NULL);
+      err |= clEnqueueNDRangeKernel(queue, kernels[1], 1, NULL,
+            &local_size, &local_size, 0, NULL, NULL);
+      err |= clEnqueueReadBuffer(queue, offsets_buffer, CL_TRUE,
+            num_groups * sizeof(int), sizeof(int), &num_newlines,
+            0, NULL, NULL);
+      if(err < 0) {
+         perror("Couldn't count the lines");
+         exit(1);
+      }
+
+      /* Mark the matching lines */
+      err = clSetKernelArg(kernels[2], 3, sizeof(cl_mem), &text_buffer);
+      err |= clSetKernelArg(kernels[2], 4, sizeof(int), &chars_per_item);
+      err |= clSetKernelArg(kernels[2], 5, sizeof(int), &num_chars);
+      err |= clSetKernelArg(kernels[2], 6, sizeof(int), &readable);
+      err |= clSetKernelArg(kernels[2], 7, sizeof(cl_mem), &offsets_buffer);
+      err |= clSetKernelArg(kernels[2], 9, sizeof(cl_mem), &ends_buffer);
+      err |= clSetKernelArg(kernels[2], 10, sizeof(cl_mem), &hits_buffer);
+      err |= clSetKernelArg(kernels[2], 11, sizeof(int), &stamp);
+      err |= clEnqueueNDRangeKernel(queue, kernels[2], 1, NULL,
+            &global_size, &local_size, 0, NULL, NULL);
+      if(err < 0) {
+         perror("Couldn't mark the lines");
+         exit(1);
+      }
+
+      /* Compact the marked lines in line order */
+      num_lines = num_newlines + 1;
+      hit_groups = (num_lines + (cl_uint)local_size - 1)/(cl_uint)local_size;
+      hit_size = hit_groups * local_size;
+      err = clSetKernelArg(kernels[3], 0, sizeof(cl_mem), &hits_buffer);
+      err |= clSetKernelArg(kernels[3], 1, sizeof(cl_uint), &num_lines);
+      err |= clSetKernelArg(kernels[3], 2, sizeof(int), &stamp);
+      err |= clSetKernelArg(kernels[3], 4, sizeof(cl_mem), &counts_buffer);
+      err |= clSetKernelArg(kernels[4], 0, sizeof(cl_mem), &hits_buffer);
+      err |= clSetKernelArg(kernels[4], 1, sizeof(cl_uint), &num_lines);
+      err |= clSetKernelArg(kernels[4], 2, sizeof(int), &stamp);
+      err |= clSetKernelArg(kernels[4], 3, sizeof(cl_mem), &ends_buffer);
+      err |= clSetKernelArg(kernels[4], 4, sizeof(int), &num_chars);
+      err |= clSetKernelArg(kernels[4], 5, sizeof(cl_mem), &offsets_buffer);
+      err |= clSetKernelArg(kernels[4], 7, sizeof(cl_mem), &lines_buffer);
+      err |= clSetKernelArg(kernels[4], 8, sizeof(cl_mem), &ranges_buffer);
+      err |= clEnqueueNDRangeKernel(queue, kernels[3], 1, NULL,
+            &hit_size, &local_size, 0, NULL, NULL);
+      err |= clSetKernelArg(kernels[1], 1, sizeof(cl_uint), &hit_groups);
+      err |= clEnqueueNDRangeKernel(queue, kernels[1], 1, NULL,
+            &local_size, &local_size, 0, NULL, NULL);
+      err |= clEnqueueNDRangeKernel(queue, kernels[4], 1, NULL,
+            &hit_size, &local_size, 0, NULL, NULL);
+      err |= clEnqueueReadBuffer(queue, offsets_buffer, CL_TRUE,
+            hit_groups * sizeof(int), sizeof(int), &num_hits,
+            0, NULL, NULL);
+      if(err < 0) {
+         perror("Couldn't compact the lines");
+         exit(1);
+      }
+
+      /* Read the matching lines and the first and last newlines */
+      err = 0;
+      if(num_hits > 0) {
+         err |= clEnqueueReadBuffer(queue, lines_buffer, CL_FALSE, 0,
+               num_hits * sizeof(cl_uint), lines, 0, NULL, NULL);
+         err |= clEnqueueReadBuffer(queue, ranges_buffer, CL_FALSE, 0,
+               num_hits * 2 * sizeof(cl_uint), ranges, 0, NULL, NULL);
+      }
+      if(num_newlines > 0) {
+         err |= clEnqueueReadBuffer(queue, ends_buffer, CL_FALSE, 0,
+               sizeof(cl_uint), &ends[0], 0, NULL, NULL);
+         err |= clEnqueueReadBuffer(queue, ends_buffer, CL_FALSE,
+               (num_newlines - 1) * sizeof(cl_uint), sizeof(cl_uint),
+               &ends[1], 0, NULL, NULL);
+      }
+      err |= clFinish(queue);
+      if(err < 0) {
+         perror("Couldn't read the buffer");
+         exit(1);
+      }
+
+      /* The first line of the chunk continues the last line of the
+         previous chunk, which may already be in the list */
+      if(list->count > 0 && list->numbers[list->count - 1] == line_base + 1)
+         list->ends[list->count - 1] = offset +
+               (num_newlines > 0 ? ends[0] : (cl_uint)num_chars);
+      for(j=0; j<num_hits; j++) {
+         add_line(list, line_base + lines[j] + 1,
+               lines[j] > 0 ? offset + ranges[2*j] : line_start,
+               offset + ranges[2*j + 1]);
+      }
+      line_base += num_newlines;
+      if(num_newlines > 0)
+         line_start = offset + ends[1] + 1;
+   }
+   start = wall_time_ns() - start;
+
+   free(lines);
+   free(ranges);
+   return start;
+}
+
+/* Find the matching lines of a file on the host */
+void host_grep(text_file *file, const char **patterns, int num_patterns,
+      line_list *list) {
+
+   const char *text;
+   cl_ulong offset, number = 1, line_start = 0;
+   int i, j, k, p, num_chars, readable, length, hit = 0;
+
+   list->count = 0;
+   for(i=0; i<file->num_chunks; i++) {
+      offset = (cl_ulong)i * CHUNK_SIZE;
+      text = read_chunk(file, i, &num_chars, &readable);
+      for(k=0; k<num_chars; k++) {
+         if(text[k] == '\n') {
+            if(hit)
+               add_line(list, number, line_start, offset + k);
+            number++;
+            line_start = offset + k + 1;
+            hit = 0;
+            continue;
+         }
+         for(p=0; p<num_patterns && !hit; p++) {
+            length = (int)strlen(patterns[p]);
+            for(j=0; j<length && k + j < readable &&
+                  text[k+j] == patterns[p][j]; j++);
+            hit = (j == length);
+         }
+      }
+   }
+   if(hit)
+      add_line(list, number, line_start, file->size);
+}
+
+#ifdef UNIX
+/* Append text to a shell command in single quotes */
+void append_quoted(char *command, const char *text) {
+
+   char *end = command + strlen(command);
+
+   *end++ = '\'';
+   for(; *text; text++) {
+      if(*text == '\'') {
+         strcpy(end, "'\\''");
+         end += 4;
+      }
+      else
+         *end++ = *text;
+   }
+   strcpy(end, "' ");
+}
+
+/* Count the matching lines with GNU grep, or return -1 if it can't be
+   run. time receives the wall time in nanoseconds */
+int gnu_grep(const char *name, const char **patterns, int num_patterns,
+      unsigned long long *time) {
+
+   FILE *pipe;
+   char *command;
+   int i, count = -1;
+
+   command = (char*) malloc(64 + 4 * strlen(name) +
+         num_patterns * (8 + 4 * MAX_LENGTH));
+   strcpy(command, "LC_ALL=C grep -c -F ");
+   for(i=0; i<num_patterns; i++) {
+      strcat(command, "-e ");
+      append_quoted(command, patterns[i]);
+   }
+   append_quoted(command, name);
+
+   *time = wall_time_ns();
+   pipe = popen(command, "r");
+   if(pipe != NULL) {
+      if(fscanf(pipe, "%d", &count) != 1)
+         count = -1;
+      pclose(pipe);
+   }
+   *time = wall_time_ns() - *time;
+   free(command);
+   return count;
+}
+#endif
+
+int main(int argc, char** argv) {
+
+   /* Host/device data structures */
+   cl_device_id device;
+   cl_context context;
+   cl_command_queue queue;
+   cl_int i, err, check;
+
+   /* Program/kernel data structures */
+   cl_program program;
+   cl_kernel kernels[5];
+   size_t global_size, local_size, max_local_size;
+   cl_uint compute_units, max_groups;
+   unsigned long long device_time, host_time;
+   const char* kernel_names[5] = {"line_count", "line_scan", "line_mark",
+         "hit_count", "hit_lines"};
+
+   /* Data and buffers */
+   const char *name, *patterns[MAX_PATTERNS];
+   const char *default_patterns[3] = {"Gregor", "chief clerk", "sister"};
+   char pattern_text[MAX_PATTERNS * MAX_LENGTH];
+   int num_patterns, length, pattern_starts[MAX_PATTERNS + 1], *zeros;
+   text_file file;
+   line_list list, check_list;
+   cl_mem patterns_buffer, starts_buffer, text_buffer, counts_buffer,
+         offsets_buffer, ends_buffer, hits_buffer, lines_buffer,
+         ranges_buffer;
+#ifdef UNIX
+   unsigned long long grep_time;
+   int grep_count;
+#endif
+
+   /* Open the text file and pack the patterns */
+   name = argc > 1 ? argv[1] : TEXT_FILE;
+   open_text(&file, name);
+   num_patterns = 0;
+   for(i=2; i<argc && num_patterns<MAX_PATTERNS; i++) {
+      patterns[num_patterns++] = argv[i];
+   }
+   if(num_patterns == 0) {
+      for(i=0; i<3; i++) {
+         patterns[num_patterns++] = default_patterns[i];
+      }
+   }
+   pattern_starts[0] = 0;
+   for(i=0; i<num_patterns; i++) {
+      length = (int)strlen(patterns[i]);
+      if(length == 0 || length > MAX_LENGTH ||
+            strchr(patterns[i], '\n') != NULL) {
+         printf("Patterns must have 1 to %d characters and no newline\n",
+               MAX_LENGTH);
+         exit(1);
+      }
+      memcpy(pattern_text + pattern_starts[i], patterns[i], length);
+      pattern_starts[i+1] = pattern_starts[i] + length;
+   }
+
+   /* Create device and context */
+   device = create_device();
+   err = clGetDeviceInfo(device, CL_DEVICE_MAX_COMPUTE_UNITS,
+         sizeof(compute_units), &compute_units, NULL);
+   if(err < 0) {
+      perror("Couldn't obtain device information");
+      exit(1);
+   }
+   context = clCreateContext(NULL, 1, &device, NULL, NULL, &err);
+   if(err < 0) {
+      perror("Couldn't create a context");
+      exit(1);
+   }
+
+   /* Build program and create kernels */
+   program = build_program(context, device, PROGRAM_FILE);
+   local_size = 0;
+   for(i=0; i<5; i++) {
+      kernels[i] = clCreateKernel(program, kernel_names[i], &err);
+      if(err < 0) {
+         perror("Couldn't create a kernel");
+         exit(1);
+      };
+      err = clGetKernelWorkGroupInfo(kernels[i], device,
+            CL_KERNEL_WORK_GROUP_SIZE, sizeof(max_local_size),
+            &max_local_size, NULL);
+      if(err < 0) {
+         perror("Couldn't obtain device information");
+         exit(1);
+      }
+      if(local_size == 0 || max_local_size < local_size)
+         local_size = max_local_size;
+   }
+
+   /* Determine a power-of-two local size and the global size */
+   local_size = (size_t)pow(2, trunc(log2(local_size)));
+   global_size = compute_units * GROUPS_PER_UNIT * local_size;
+   max_groups = (CHUNK_SIZE + (cl_uint)local_size)/(cl_uint)local_size;
+   if(max_groups < compute_units * GROUPS_PER_UNIT)
+      max_groups = compute_units * GROUPS_PER_UNIT;
+
+   /* Create buffers. line_hits starts with no stamps */
+   zeros = (int*) calloc(CHUNK_SIZE + 1, sizeof(int));
+   patterns_buffer = clCreateBuffer(context, CL_MEM_READ_ONLY |
+         CL_MEM_COPY_HOST_PTR, pattern_starts[num_patterns], pattern_text,
+         &err);
+   starts_buffer = clCreateBuffer(context, CL_MEM_READ_ONLY |
+         CL_MEM_COPY_HOST_PTR, (num_patterns + 1) * sizeof(int),
+         pattern_starts, &err);
+   text_buffer = clCreateBuffer(context, CL_MEM_READ_ONLY,
+         CHUNK_SIZE + OVERLAP, NULL, &err);
+   counts_buffer = clCreateBuffer(context, CL_MEM_READ_WRITE,
+         max_groups * sizeof(int), NULL, &err);
+   offsets_buffer = clCreateBuffer(context, CL_MEM_READ_WRITE,
+         (max_groups + 1) * sizeof(int), NULL, &err);
+   ends_buffer = clCreateBuffer(context, CL_MEM_READ_WRITE,
+         CHUNK_SIZE * sizeof(cl_uint), NULL, &err);
+   hits_buffer = clCreateBuffer(context, CL_MEM_READ_WRITE |
+         CL_MEM_COPY_HOST_PTR, (CHUNK_SIZE + 1) * sizeof(int), zeros, &err);
+   lines_buffer = clCreateBuffer(context, CL_MEM_WRITE_ONLY,
+         (CHUNK_SIZE + 1) * sizeof(cl_uint), NULL, &err);
+   ranges_buffer = clCreateBuffer(context, CL_MEM_WRITE_ONLY,
+         (CHUNK_SIZE + 1) * 2 * sizeof(cl_uint), NULL, &err);
+   if(err < 0) {
+      perror("Couldn't create a buffer");
+      exit(1);
+   };
+   free(zeros);
+
+   /* Create a command queue */
+   queue = clCreateCommandQueue(context, device, 0, &err);
+   if(err < 0) {
+      perror("Couldn't create a command queue");
+      exit(1);
+   };
+
+   /* Set the arguments that don't change between chunks */
+   err = clSetKernelArg(kernels[0], 3, local_size * sizeof(int), NULL);
+   err |= clSetKernelArg(kernels[1], 2, local_size * sizeof(int), NULL);
+   err |= clSetKernelArg(kernels[2], 0, sizeof(cl_mem), &patterns_buffer);
+   err |= clSetKernelArg(kernels[2], 1, sizeof(cl_mem), &starts_buffer);
+   err |= clSetKernelArg(kernels[2], 2, sizeof(int), &num_patterns);
+   err |= clSetKernelArg(kernels[2], 8, local_size * sizeof(int), NULL);
+   err |= clSetKernelArg(kernels[3], 3, local_size * sizeof(int), NULL);
+   err |= clSetKernelArg(kernels[4], 6, local_size * sizeof(int), NULL);
+   if(err < 0) {
+      perror("Couldn't create a kernel argument");
+      exit(1);
+   };
+
+   /* Find the matching lines on the device and on the host */
+   memset(&list, 0, sizeof(list));
+   memset(&check_list, 0, sizeof(check_list));
+   device_time = device_grep(&file, queue, kernels, text_buffer,
+         counts_buffer, offsets_buffer, ends_buffer, hits_buffer,
+         lines_buffer, ranges_buffer, global_size, local_size, &list);
+   host_time = wall_time_ns();
+   host_grep(&file, patterns, num_patterns, &check_list);
+   host_time = wall_time_ns() - host_time;
+
+   /* Display the first lines */
+   printf("Searching %llu bytes for", (unsigned long long)file.size);
+   for(i=0; i<num_patterns; i++) {
+      printf(" '%s'", patterns[i]);
+   }
+   printf("\n\n");
+   for(i=0; i<list.count && i<NUM_SHOWN; i++) {
+      printf("%llu [%llu, %llu): ", (unsigned long long)list.numbers[i],
+            (unsigned long long)list.starts[i],
+            (unsigned long long)list.ends[i]);
+      print_line(&file, list.starts[i], list.ends[i]);
+   }
+   if(list.count > NUM_SHOWN)
+      printf("...\n");
+
+   /* Compare the lines with the host */
+   check = (list.count == check_list.count);
+   for(i=0; i<list.count && check; i++) {
+      if(list.numbers[i] != check_list.numbers[i] ||
+            list.starts[i] != check_list.starts[i] ||
+            list.ends[i] != check_list.ends[i])
+         check = 0;
+   }
+   printf("\nMatching lines: %d\n", list.count);
+   printf("Device: %.3f GB/s, host: %.3f GB/s\n",
+         (double)file.size/device_time, (double)file.size/host_time);
+
+   /* Compare the count and time with GNU grep */
+#ifdef UNIX
+   grep_count = gnu_grep(name, patterns, num_patterns, &grep_time);
+   if(grep_count >= 0) {
+      printf("GNU grep: %d lines, %.3f GB/s\n", grep_count,
+            (double)file.size/grep_time);
+      if(grep_count != list.count)
+         check = 0;
+   }
+#endif
+   printf("%s\n", check ? "Check passed." : "Check failed.");
+
+   /* Deallocate resources */
+   free(list.numbers);
+   free(list.starts);
+   free(list.ends);
+   free(check_list.numbers);
+   free(check_list.starts);
+   free(check_list.ends);
+   clReleaseMemObject(patterns_buffer);
+   clReleaseMemObject(starts_buffer);
+   clReleaseMemObject(text_buffer);
+   clReleaseMemObject(counts_buffer);
+   clReleaseMemObject(offsets_buffer);
+   clReleaseMemObject(ends_buffer);
+   clReleaseMemObject(hits_buffer);
+   clReleaseMemObject(lines_buffer);
+   clReleaseMemObject(ranges_buffer);
+   for(i=0; i<5; i++) {
+      clReleaseKernel(kernels[i]);
+   }
+   clReleaseCommandQueue(queue);
+   clReleaseProgram(program);
+   clReleaseContext(context);
+   close_text(&file);
+   return 0;
+}
@@ -0,0 +1,190 @@
+/* Every kernel that walks the text gives each work-item the same
+   chars_per_item characters, so the lines counted by line_count are the
+   lines numbered by line_mark. Lines are numbered from 0 within a chunk,
+   and line n ends at the n-th newline. The line after the last newline
+   may continue into the next chunk */
+
+/* Find the characters of this work-item */
+void item_range(int chars_per_item, int num_chars, int *start, int *end) {
+
+   *start = min((int)get_global_id(0) * chars_per_item, num_chars);
+   *end = min(*start + chars_per_item, num_chars);
+}
+
+/* Count the newlines of this work-item */
+int count_newlines(__global char* text, int chars_per_item, int num_chars) {
+
+   int start, end, count = 0;
+
+   item_range(chars_per_item, num_chars, &start, &end);
+   for(int i=start; i<end; i++) {
+      count += (text[i] == '\n');
+   }
+   return count;
+}
+
+/* Return 1 if any pattern starts at i. Pattern p holds the characters
+   from starts[p] to starts[p+1], and only the first readable characters
+   of the text can be compared */
+int find_any(__constant char* patterns, __constant int* starts,
+      int num_patterns, __global char* text, int i, int readable) {
+
+   int j, first, length;
+
+   for(int p=0; p<num_patterns; p++) {
+      first = starts[p];
+      length = starts[p+1] - first;
+      if(text[i] != patterns[first] || i + length > readable)
+         continue;
+      for(j=1; j<length && text[i+j] == patterns[first+j]; j++);
+      if(j == length)
+         return 1;
+   }
+   return 0;
+}
+
+/* Return the sum of the values before this work-item in its group */
+int local_position(int value, __local int* partial_sums) {
+
+   int lid = get_local_id(0);
+   int group_size = get_local_size(0);
+   int i;
+
+   partial_sums[lid] = value;
+   barrier(CLK_LOCAL_MEM_FENCE);
+
+   for(int d = 1; d < group_size; d <<= 1) {
+      i = (lid >= d) ? partial_sums[lid - d] : 0;
+      barrier(CLK_LOCAL_MEM_FENCE);
+      partial_sums[lid] += i;
+      barrier(CLK_LOCAL_MEM_FENCE);
+   }
+   return partial_sums[lid] - value;
+}
+
+/* Add the values of a work-group and store the total in group_counts */
+void group_total(int value, __local int* partial_counts,
+      __global int* group_counts) {
+
+   int lid = get_local_id(0);
+   int group_size = get_local_size(0);
+
+   partial_counts[lid] = value;
+   barrier(CLK_LOCAL_MEM_FENCE);
+
+   for(int i = group_size/2; i>0; i >>= 1) {
+      if(lid < i) {
+         partial_counts[lid] += partial_counts[lid + i];
+      }
+      barrier(CLK_LOCAL_MEM_FENCE);
+   }
+
+   if(lid == 0) {
+      group_counts[get_group_id(0)] = partial_counts[0];
+   }
+}
+
+/* Count the newlines in each work-group */
+__kernel void line_count(__global char* text, int chars_per_item,
+      int num_chars, __local int* partial_counts,
+      __global int* group_counts) {
+
+   group_total(count_newlines(text, chars_per_item, num_chars),
+         partial_counts, group_counts);
+}
+
+/* Exclusive scan of the group counts in a single work-group. The total
+   goes to offsets[num_groups] */
+__kernel void line_scan(__global int* group_counts, uint num_groups,
+      __local int* partial_sums, __global int* offsets) {
+
+   int lid = get_local_id(0);
+   int group_size = get_local_size(0);
+   int running_total = 0, value, i;
+
+   for(uint start = 0; start < num_groups; start += group_size) {
+
+      value = (start + lid < num_groups) ? group_counts[start + lid] : 0;
+      partial_sums[lid] = value;
+      barrier(CLK_LOCAL_MEM_FENCE);
+
+      /* Inclusive scan of this chunk */
+      for(int d = 1; d < group_size; d <<= 1) {
+         i = (lid >= d) ? partial_sums[lid - d] : 0;
+         barrier(CLK_LOCAL_MEM_FENCE);
+         partial_sums[lid] += i;
+         barrier(CLK_LOCAL_MEM_FENCE);
+      }
+
+      if(start + lid < num_groups) {
+         offsets[start + lid] = running_total + partial_sums[lid] - value;
+      }
+      running_total += partial_sums[group_size-1];
+      barrier(CLK_LOCAL_MEM_FENCE);
+   }
+
+   if(lid == 0) {
+      offsets[num_groups] = running_total;
+   }
+}
+
+/* Record where each line ends and mark the lines that contain a pattern
+   by writing stamp to line_hits. The host changes the stamp for every
+   chunk, so line_hits never needs clearing. Once a work-item has marked
+   a line, it only looks for the next newline */
+__kernel void line_mark(__constant char* patterns, __constant int* starts,
+      int num_patterns, __global char* text, int chars_per_item,
+      int num_chars, int readable, __global int* offsets,
+      __local int* partial_sums, __global uint* line_ends,
+      __global int* line_hits, int stamp) {
+
+   int start, end, hit = -1;
+   int line = offsets[get_group_id(0)] + local_position(
+         count_newlines(text, chars_per_item, num_chars), partial_sums);
+
+   item_range(chars_per_item, num_chars, &start, &end);
+   for(int i=start; i<end; i++) {
+      if(text[i] == '\n') {
+         line_ends[line++] = i;
+      }
+      else if(hit != line &&
+            find_any(patterns, starts, num_patterns, text, i, readable)) {
+         line_hits[line] = stamp;
+         hit = line;
+      }
+   }
+}
+
+/* Flag a line marked in this chunk */
+int hit_flag(__global int* line_hits, uint num_lines, int stamp, uint gid) {
+
+   return (gid < num_lines) && (line_hits[gid] == stamp);
+}
+
+/* Count the marked lines in each work-group */
+__kernel void hit_count(__global int* line_hits, uint num_lines,
+      int stamp, __local int* partial_counts, __global int* group_counts) {
+
+   group_total(hit_flag(line_hits, num_lines, stamp, get_global_id(0)),
+         partial_counts, group_counts);
+}
+
+/* Write the number and byte range of every marked line to dense
+   outputs, in line order. ranges holds the first character of each line
+   and the character past its end */
+__kernel void hit_lines(__global int* line_hits, uint num_lines,
+      int stamp, __global uint* line_ends, int num_chars,
+      __global int* offsets, __local int* partial_sums,
+      __global uint* lines, __global uint* ranges) {
+
+   uint gid = get_global_id(0);
+   int flag = hit_flag(line_hits, num_lines, stamp, gid);
+   int pos = offsets[get_group_id(0)] + local_position(flag, partial_sums);
+
+   if(flag) {
+      lines[pos] = gid;
+      ranges[2*pos] = (gid > 0) ? line_ends[gid-1] + 1 : 0;
+      ranges[2*pos + 1] = (gid + 1 < num_lines) ? line_ends[gid] :
+            (uint)num_chars;
+   }
+}
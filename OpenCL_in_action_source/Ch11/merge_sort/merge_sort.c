@@ -0,0 +1,532 @@
+#define _CRT_SECURE_NO_WARNINGS
+#define PROGRAM_FILE "merge_sort.cl"
+#define BSORT_FILE "../bsort/bsort.cl"
+
+#define NUM_SIZES 5
+#define NUM_TYPES 3
+#define ITEMS_PER_WORK_ITEM 4
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef MAC
+#include <OpenCL/cl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+/* Find a GPU or CPU associated with the first available platform */
+cl_device_id create_device() {
+
+   cl_platform_id platform;
+   cl_device_id dev;
+   int err;
+
+   /* Identify a platform */
+   err = clGetPlatformIDs(1, &platform, NULL);
+   if(err < 0) {
+      perror("Couldn't identify a platform");
+      exit(1);
+   } 
+
+   /* Access a device */
+   err = clGetDeviceIDs(platform, CL_DEVICE_TYPE_GPU, 1, &dev, NULL);
+   if(err == CL_DEVICE_NOT_FOUND) {
+      err = clGetDeviceIDs(platform, CL_DEVICE_TYPE_CPU, 1, &dev, NULL);
+   }
+   if(err < 0) {
+      perror("Couldn't access any devices");
+      exit(1);   
+   }
+
+   return dev;
+}
+
+/* Create program from a file and compile it */
+cl_program build_program(cl_context ctx, cl_device_id dev, const char* filename,
+      const char* options) {
+
+   cl_program program;
+   FILE *program_handle;
+   char *program_buffer, *program_log;
+   size_t program_size, log_size;
+   int err;
+
+   /* Read program file and place content into buffer */
+   program_handle = fopen(filename, "r");
+   if(program_handle == NULL) {
+      perror("Couldn't find the program file");
+      exit(1);
+   }
+   fseek(program_handle, 0, SEEK_END);
+   program_size = ftell(program_handle);
+   rewind(program_handle);
+   program_buffer = (char*)malloc(program_size + 1);
+   program_buffer[program_size] = '\0';
+   fread(program_buffer, sizeof(char), program_size, program_handle);
+   fclose(program_handle);
+
+   /* Create program from file */
+   program = clCreateProgramWithSource(ctx, 1, 
+      (const char**)&program_buffer, &program_size, &err);
+   if(err < 0) {
+      perror("Couldn't create the program");
+      exit(1);
+   }
+   free(program_buffer);
+
+   /* Build program */
+   err = clBuildProgram(program, 0, NULL, options, NULL, NULL);
+   if(err < 0) {
+
+      /* Find size of log and print to std output */
+      clGetProgramBuildInfo(program, dev, CL_PROGRAM_BUILD_LOG, 
+            0, NULL, &log_size);
+      program_log = (char*) malloc(log_size + 1);
+      program_log[log_size] = '\0';
+      clGetProgramBuildInfo(program, dev, CL_PROGRAM_BUILD_LOG, 
+            log_size + 1, program_log, NULL);
+      printf("%s\n", program_log);
+      free(program_log);
+      exit(1);
+   }
+
+   return program;
+}
+
+/* Compare floats for qsort */
+int compare_floats(const void* a, const void* b) {
+
+   float value_a = *(const float*)a, value_b = *(const float*)b;
+   return (value_a > value_b) - (value_a < value_b);
+}
+
+/* Compare ints for qsort */
+int compare_ints(const void* a, const void* b) {
+
+   int value_a = *(const int*)a, value_b = *(const int*)b;
+   return (value_a > value_b) - (value_a < value_b);
+}
+
+/* Sort blocks with merge_sort_init, then merge pairs of runs until one
+   run remains. Values are carried when value_buffers isn't NULL. Returns
+   the device time and sets which buffer holds the result */
+cl_ulong merge_sort(cl_command_queue queue, cl_kernel* kernels, 
+      cl_mem* key_buffers, cl_mem* value_buffers, cl_mem splits_buffer,
+      cl_uint num_keys, size_t local_size, int* result) {
+
+   cl_event start_event, end_event;
+   cl_uint run_width, tile_size, num_tiles;
+   cl_ulong time_start, time_end;
+   size_t global_size, tiles_size;
+   int src, err;
+
+   /* Sort blocks of 8 * local_size keys */
+   global_size = (num_keys + 8*local_size - 1)/(8*local_size) * local_size;
+   err = clSetKernelArg(kernels[0], 0, sizeof(cl_mem), &key_buffers[0]);
+   err |= clSetKernelArg(kernels[0], 1, 8*local_size*sizeof(cl_uint), NULL);
+   err |= clSetKernelArg(kernels[0], 2, sizeof(cl_uint), &num_keys);
+   if(value_buffers != NULL) {
+      err |= clSetKernelArg(kernels[0], 3, sizeof(cl_mem), &value_buffers[0]);
+      err |= clSetKernelArg(kernels[0], 4, 8*local_size*sizeof(cl_uint), 
+            NULL);
+   }
+   if(err < 0) {
+      perror("Couldn't create a kernel argument");
+      exit(1);   
+   }
+   err = clEnqueueNDRangeKernel(queue, kernels[0], 1, NULL, &global_size, 
+         &local_size, 0, NULL, &start_event);
+   if(err < 0) {
+      perror("Couldn't enqueue the kernel");
+      exit(1);   
+   }
+   end_event = start_event;
+   clRetainEvent(end_event);
+
+   /* Merge pairs of runs, one output tile per work-group */
+   src = 0;
+   tile_size = ITEMS_PER_WORK_ITEM * local_size;
+   num_tiles = (num_keys + tile_size - 1)/tile_size;
+   tiles_size = (num_tiles + local_size - 1)/local_size * local_size;
+   global_size = num_tiles * local_size;
+   for(run_width = 8*local_size; run_width < num_keys; run_width <<= 1) {
+
+      err = clSetKernelArg(kernels[1], 0, sizeof(cl_mem), &key_buffers[src]);
+      err |= clSetKernelArg(kernels[1], 1, sizeof(cl_uint), &num_keys);
+      err |= clSetKernelArg(kernels[1], 2, sizeof(cl_uint), &run_width);
+      err |= clSetKernelArg(kernels[1], 3, sizeof(cl_uint), &tile_size);
+      err |= clSetKernelArg(kernels[1], 4, sizeof(cl_mem), &splits_buffer);
+      err |= clSetKernelArg(kernels[2], 0, sizeof(cl_mem), &key_buffers[src]);
+      err |= clSetKernelArg(kernels[2], 1, sizeof(cl_uint), &num_keys);
+      err |= clSetKernelArg(kernels[2], 2, sizeof(cl_uint), &run_width);
+      err |= clSetKernelArg(kernels[2], 3, sizeof(cl_mem), &splits_buffer);
+      err |= clSetKernelArg(kernels[2], 4, tile_size * sizeof(cl_uint), NULL);
+      err |= clSetKernelArg(kernels[2], 5, sizeof(cl_mem), 
+            &key_buffers[1-src]);
+      if(value_buffers != NULL) {
+         err |= clSetKernelArg(kernels[1], 5, sizeof(cl_mem), 
+               &value_buffers[src]);
+         err |= clSetKernelArg(kernels[2], 6, sizeof(cl_mem), 
+               &value_buffers[src]);
+         err |= clSetKernelArg(kernels[2], 7, tile_size * sizeof(cl_uint), 
+               NULL);
+         err |= clSetKernelArg(kernels[2], 8, sizeof(cl_mem), 
+               &value_buffers[1-src]);
+      }
+      if(err < 0) {
+         perror("Couldn't create a kernel argument");
+         exit(1);   
+      }
+
+      clReleaseEvent(end_event);
+      err = clEnqueueNDRangeKernel(queue, kernels[1], 1, NULL, &tiles_size, 
+            &local_size, 0, NULL, NULL);
+      err |= clEnqueueNDRangeKernel(queue, kernels[2], 1, NULL, 
+            &global_size, &local_size, 0, NULL, &end_event);
+      if(err < 0) {
+         perror("Couldn't enqueue the kernel");
+         exit(1);   
+      }
+      src = 1 - src;
+   }
+   clFinish(queue);
+
+   clGetEventProfilingInfo(start_event, CL_PROFILING_COMMAND_START,
+         sizeof(time_start), &time_start, NULL);
+   clGetEventProfilingInfo(end_event, CL_PROFILING_COMMAND_END,
+         sizeof(time_end), &time_end, NULL);
+   clReleaseEvent(start_event);
+   clReleaseEvent(end_event);
+   *result = src;
+   return time_end - time_start;
+}
+
+/* Sort floats with the kernels of Ch11/bsort and return the device time */
+cl_ulong bitonic_sort(cl_command_queue queue, cl_kernel* kernels, 
+      cl_mem data_buffer, cl_uint num_floats, size_t local_size) {
+
+   cl_event start_event, end_event;
+   cl_uint stage, high_stage, num_stages, padded_size;
+   cl_ulong time_start, time_end;
+   cl_int i, err, direction = 0;
+   size_t global_size;
+
+   /* Set the data and local memory arguments of every kernel */
+   padded_size = 8;
+   while(padded_size < num_floats) {
+      padded_size <<= 1;
+   }
+   global_size = padded_size/8;
+   if(global_size < local_size) {
+      local_size = global_size;
+   }
+   err = 0;
+   for(i=0; i<5; i++) {
+      err |= clSetKernelArg(kernels[i], 0, sizeof(cl_mem), &data_buffer);
+      err |= clSetKernelArg(kernels[i], 1, 8*local_size*sizeof(float), NULL);
+   }
+   err |= clSetKernelArg(kernels[0], 2, sizeof(cl_uint), &num_floats);
+   err |= clSetKernelArg(kernels[0], 3, sizeof(int), &direction);
+   err |= clSetKernelArg(kernels[1], 3, sizeof(cl_uint), &num_floats);
+   err |= clSetKernelArg(kernels[1], 4, sizeof(int), &direction);
+   err |= clSetKernelArg(kernels[2], 4, sizeof(cl_uint), &num_floats);
+   err |= clSetKernelArg(kernels[2], 5, sizeof(int), &direction);
+   err |= clSetKernelArg(kernels[3], 3, sizeof(int), &direction);
+   err |= clSetKernelArg(kernels[3], 4, sizeof(cl_uint), &num_floats);
+   err |= clSetKernelArg(kernels[4], 2, sizeof(int), &direction);
+   err |= clSetKernelArg(kernels[4], 3, sizeof(cl_uint), &num_floats);
+   if(err < 0) {
+      perror("Couldn't create a kernel argument");
+      exit(1);   
+   }
+
+   /* Enqueue initial sorting kernel */
+   err = clEnqueueNDRangeKernel(queue, kernels[0], 1, NULL, &global_size, 
+         &local_size, 0, NULL, &start_event); 
+
+   /* Execute further stages */
+   num_stages = global_size/local_size;
+   for(high_stage = 2; high_stage < num_stages; high_stage <<= 1) {
+      err |= clSetKernelArg(kernels[1], 2, sizeof(int), &high_stage);      
+      err |= clSetKernelArg(kernels[2], 3, sizeof(int), &high_stage);
+      for(stage = high_stage; stage > 1; stage >>= 1) {
+         err |= clSetKernelArg(kernels[2], 2, sizeof(int), &stage);
+         err |= clEnqueueNDRangeKernel(queue, kernels[2], 1, NULL, 
+               &global_size, &local_size, 0, NULL, NULL); 
+      }
+      err |= clEnqueueNDRangeKernel(queue, kernels[1], 1, NULL, 
+            &global_size, &local_size, 0, NULL, NULL); 
+   }
+
+   /* Perform the bitonic merge */
+   for(stage = num_stages; stage > 1; stage >>= 1) {
+      err |= clSetKernelArg(kernels[3], 2, sizeof(int), &stage);
+      err |= clEnqueueNDRangeKernel(queue, kernels[3], 1, NULL, 
+            &global_size, &local_size, 0, NULL, NULL); 
+   }
+   err |= clEnqueueNDRangeKernel(queue, kernels[4], 1, NULL, 
+         &global_size, &local_size, 0, NULL, &end_event); 
+   if(err < 0) {
+      perror("Couldn't enqueue the kernel");
+      exit(1);   
+   }
+   clFinish(queue);
+
+   clGetEventProfilingInfo(start_event, CL_PROFILING_COMMAND_START,
+         sizeof(time_start), &time_start, NULL);
+   clGetEventProfilingInfo(end_event, CL_PROFILING_COMMAND_END,
+         sizeof(time_end), &time_end, NULL);
+   clReleaseEvent(start_event);
+   clReleaseEvent(end_event);
+   return time_end - time_start;
+}
+
+int main() {
+
+   /* OpenCL structures */
+   cl_device_id device;
+   cl_context context;
+   cl_program programs[NUM_TYPES], bsort_program;
+   cl_kernel kernels[NUM_TYPES][3], bsort_kernels[5];
+   cl_command_queue queue;
+   cl_int i, t, s, err, check, result;
+   cl_uint num_keys;
+   cl_ulong max_alloc, local_mem_size, sort_time;
+   size_t local_size, kernel_size, bsort_local_size;
+   const char* options[NUM_TYPES] = {"", "-DINT_KEYS", "-DKEY_VALUE"};
+   const char* kernel_names[3] = {"merge_sort_init", "merge_partition", 
+         "merge_tiles"};
+   const char* bsort_names[5] = {"bsort_init", "bsort_stage_0", 
+         "bsort_stage_n", "bsort_merge", "bsort_merge_last"};
+
+   /* Data and buffers */
+   float *floats, *float_ref, *float_out;
+   int *ints, *int_ref, *int_out;
+   cl_uint *values, *value_out;
+   char *seen;
+   cl_mem key_buffers[2], value_buffers[2], splits_buffer, bsort_buffer;
+   void *keys, *out;
+
+   /* Awkward and power-of-two sizes */
+   cl_uint sizes[NUM_SIZES] = {1000003, 1048576, 4194304, 16777216, 
+         67108864};
+
+   /* Create device and context */
+   device = create_device();
+   err = clGetDeviceInfo(device, CL_DEVICE_MAX_MEM_ALLOC_SIZE, 
+         sizeof(max_alloc), &max_alloc, NULL);
+   err |= clGetDeviceInfo(device, CL_DEVICE_LOCAL_MEM_SIZE, 
+         sizeof(local_mem_size), &local_mem_size, NULL);
+   if(err < 0) {
+      perror("Couldn't obtain device information");
+      exit(1);   
+   }
+   context = clCreateContext(NULL, 1, &device, NULL, NULL, &err);
+   if(err < 0) {
+      perror("Couldn't create a context");
+      exit(1);   
+   }
+
+   /* Build one program per key type, plus the bitonic sort */
+   local_size = 1024;
+   for(t=0; t<NUM_TYPES; t++) {
+      programs[t] = build_program(context, device, PROGRAM_FILE, options[t]);
+      for(i=0; i<3; i++) {
+         kernels[t][i] = clCreateKernel(programs[t], kernel_names[i], &err);
+         if(err < 0) {
+            perror("Couldn't create a kernel");
+            exit(1);
+         };
+         err = clGetKernelWorkGroupInfo(kernels[t][i], device, 
+               CL_KERNEL_WORK_GROUP_SIZE, sizeof(kernel_size), 
+               &kernel_size, NULL);
+         if(err < 0) {
+            perror("Couldn't find the maximum work-group size");
+            exit(1);   
+         };
+         if(kernel_size < local_size)
+            local_size = kernel_size;
+      }
+   }
+   bsort_program = build_program(context, device, BSORT_FILE, NULL);
+   for(i=0; i<5; i++) {
+      bsort_kernels[i] = clCreateKernel(bsort_program, bsort_names[i], &err);
+      if(err < 0) {
+         perror("Couldn't create a kernel");
+         exit(1);
+      };
+   }
+   err = clGetKernelWorkGroupInfo(bsort_kernels[0], device, 
+         CL_KERNEL_WORK_GROUP_SIZE, sizeof(bsort_local_size), 
+         &bsort_local_size, NULL);
+   if(err < 0) {
+      perror("Couldn't find the maximum work-group size");
+      exit(1);   
+   };
+   bsort_local_size = (size_t)pow(2, trunc(log2(bsort_local_size)));
+
+   /* Fit the keys and values of a block in local memory */
+   local_size = (size_t)pow(2, trunc(log2(local_size)));
+   while(8*local_size*2*sizeof(cl_uint) > local_mem_size)
+      local_size >>= 1;
+
+   /* Create a command queue */
+   queue = clCreateCommandQueue(context, device, 
+         CL_QUEUE_PROFILING_ENABLE, &err);
+   if(err < 0) {
+      perror("Couldn't create a command queue");
+      exit(1);   
+   };
+
+   srand(time(NULL));
+   printf("Keys        Merge float     Merge int       "
+          "Merge key-value Bitonic float\n");
+   for(s=0; s<NUM_SIZES && sizes[s] * sizeof(cl_uint) <= max_alloc; s++) {
+
+      /* Initialize data and the host references */
+      num_keys = sizes[s];
+      floats = (float*) malloc(num_keys * sizeof(float));
+      float_ref = (float*) malloc(num_keys * sizeof(float));
+      float_out = (float*) malloc(num_keys * sizeof(float));
+      ints = (int*) malloc(num_keys * sizeof(int));
+      int_ref = (int*) malloc(num_keys * sizeof(int));
+      int_out = (int*) malloc(num_keys * sizeof(int));
+      values = (cl_uint*) malloc(num_keys * sizeof(cl_uint));
+      value_out = (cl_uint*) malloc(num_keys * sizeof(cl_uint));
+      seen = (char*) malloc(num_keys * sizeof(char));
+      for(i=0; i<num_keys; i++) {
+         floats[i] = 1.0f * rand()/RAND_MAX;
+         float_ref[i] = floats[i];
+         ints[i] = rand() - RAND_MAX/2;
+         int_ref[i] = ints[i];
+         values[i] = i;
+      }
+      qsort(float_ref, num_keys, sizeof(float), compare_floats);
+      qsort(int_ref, num_keys, sizeof(int), compare_ints);
+      printf("%-12u", num_keys);
+
+      /* One split per output tile */
+      splits_buffer = clCreateBuffer(context, CL_MEM_READ_WRITE, 
+            (num_keys/(ITEMS_PER_WORK_ITEM*local_size) + 1) * 
+            sizeof(cl_uint), NULL, &err);
+      if(err < 0) {
+         perror("Couldn't create a buffer");
+         exit(1);   
+      };
+
+      for(t=0; t<NUM_TYPES; t++) {
+         keys = (t == 1) ? (void*)ints : (void*)floats;
+         out = (t == 1) ? (void*)int_out : (void*)float_out;
+
+         /* Create buffers */
+         key_buffers[0] = clCreateBuffer(context, CL_MEM_READ_WRITE | 
+               CL_MEM_COPY_HOST_PTR, num_keys * sizeof(cl_uint), keys, &err);
+         key_buffers[1] = clCreateBuffer(context, CL_MEM_READ_WRITE, 
+               num_keys * sizeof(cl_uint), NULL, &err);
+         if(t == 2) {
+            value_buffers[0] = clCreateBuffer(context, CL_MEM_READ_WRITE | 
+                  CL_MEM_COPY_HOST_PTR, num_keys * sizeof(cl_uint), values, 
+                  &err);
+            value_buffers[1] = clCreateBuffer(context, CL_MEM_READ_WRITE, 
+                  num_keys * sizeof(cl_uint), NULL, &err);
+         }
+         if(err < 0) {
+            perror("Couldn't create a buffer");
+            exit(1);   
+         };
+
+         /* Sort and read the result */
+         sort_time = merge_sort(queue, kernels[t], key_buffers, 
+               t == 2 ? value_buffers : NULL, splits_buffer, num_keys, 
+               local_size, &result);
+         err = clEnqueueReadBuffer(queue, key_buffers[result], CL_TRUE, 0, 
+               num_keys * sizeof(cl_uint), out, 0, NULL, NULL);
+         if(t == 2) {
+            err |= clEnqueueReadBuffer(queue, value_buffers[result], CL_TRUE, 
+                  0, num_keys * sizeof(cl_uint), value_out, 0, NULL, NULL);
+         }
+         if(err < 0) {
+            perror("Couldn't read the buffer");
+            exit(1);   
+         }
+
+         /* Check keys against qsort, and values against their keys */
+         if(t == 1)
+            check = !memcmp(int_out, int_ref, num_keys * sizeof(int));
+         else
+            check = !memcmp(float_out, float_ref, num_keys * sizeof(float));
+         if(t == 2) {
+            memset(seen, 0, num_keys);
+            for(i=0; i<num_keys && check; i++) {
+               if(value_out[i] >= num_keys || seen[value_out[i]] ||
+                     floats[value_out[i]] != float_out[i] ||
+                     (i > 0 && float_out[i] == float_out[i-1] && 
+                     value_out[i] < value_out[i-1]))
+                  check = 0;
+               else
+                  seen[value_out[i]] = 1;
+            }
+         }
+         printf("%-8.1f%-8s", 1.0e3 * num_keys/sort_time, 
+               check ? "passed" : "failed");
+
+         clReleaseMemObject(key_buffers[0]);
+         clReleaseMemObject(key_buffers[1]);
+         if(t == 2) {
+            clReleaseMemObject(value_buffers[0]);
+            clReleaseMemObject(value_buffers[1]);
+         }
+      }
+
+      /* Bitonic sort of the same floats */
+      bsort_buffer = clCreateBuffer(context, CL_MEM_READ_WRITE |
+            CL_MEM_COPY_HOST_PTR, num_keys * sizeof(float), floats, &err);
+      if(err < 0) {
+         perror("Couldn't create a buffer");
+         exit(1);   
+      };
+      sort_time = bitonic_sort(queue, bsort_kernels, bsort_buffer, 
+            num_keys, bsort_local_size);
+      err = clEnqueueReadBuffer(queue, bsort_buffer, CL_TRUE, 0, 
+            num_keys * sizeof(float), float_out, 0, NULL, NULL);
+      if(err < 0) {
+         perror("Couldn't read the buffer");
+         exit(1);   
+      }
+      clReleaseMemObject(bsort_buffer);
+      clReleaseMemObject(splits_buffer);
+      check = !memcmp(float_out, float_ref, num_keys * sizeof(float));
+      printf("%-8.1f%s\n", 1.0e3 * num_keys/sort_time, 
+            check ? "passed" : "failed");
+
+      free(floats);
+      free(float_ref);
+      free(float_out);
+      free(ints);
+      free(int_ref);
+      free(int_out);
+      free(values);
+      free(value_out);
+      free(seen);
+   }
+   printf("Rates in millions of keys per second\n");
+
+   /* Deallocate resources */
+   for(t=0; t<NUM_TYPES; t++) {
+      for(i=0; i<3; i++) {
+         clReleaseKernel(kernels[t][i]);
+      }
+      clReleaseProgram(programs[t]);
+   }
+   for(i=0; i<5; i++) {
+      clReleaseKernel(bsort_kernels[i]);
+   }
+   clReleaseProgram(bsort_program);
+   clReleaseCommandQueue(queue);
+   clReleaseContext(context);
+   return 0;
+}
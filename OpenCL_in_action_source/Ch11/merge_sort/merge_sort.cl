@@ -0,0 +1,373 @@
+/* Keys are floats unless INT_KEYS is defined, and KEY_VALUE carries a
+   uint payload with every key */
+#ifdef INT_KEYS
+#define KEY int
+#define KEY4 int4
+#define KEY_MAX INT_MAX
+#else
+#define KEY float
+#define KEY4 float4
+#define KEY_MAX INFINITY
+#endif
+
+#ifdef KEY_VALUE
+#define LESS(k1, v1, k2, v2) ((k1) < (k2) | ((k1) == (k2) & (v1) < (v2)))
+#define PAYLOAD(statement) statement
+#define VALUE_ARG(arg) , arg
+#else
+#define LESS(k1, v1, k2, v2) ((k1) < (k2))
+#define PAYLOAD(statement)
+#define VALUE_ARG(arg)
+#endif
+
+#define ITEMS_PER_WORK_ITEM 4
+
+/* Sort elements within a vector */
+#define VECTOR_SORT(keys, values, dir)                                      \
+   comp = LESS(keys, values, shuffle(keys, mask2),                          \
+               shuffle(values, mask2)) ^ dir;                               \
+   keys = shuffle(keys, as_uint4(comp * 2 + add2));                         \
+   PAYLOAD(values = shuffle(values, as_uint4(comp * 2 + add2)));            \
+   comp = LESS(keys, values, shuffle(keys, mask1),                          \
+               shuffle(values, mask1)) ^ dir;                               \
+   keys = shuffle(keys, as_uint4(comp + add1));                             \
+   PAYLOAD(values = shuffle(values, as_uint4(comp + add1)));                \
+
+#define VECTOR_SWAP(keys1, values1, keys2, values2, dir)                    \
+   temp = keys1;                                                            \
+   PAYLOAD(v_temp = values1);                                               \
+   comp = (LESS(keys1, values1, keys2, values2) ^ dir) * 4 + add3;          \
+   keys1 = shuffle2(keys1, keys2, as_uint4(comp));                          \
+   PAYLOAD(values1 = shuffle2(values1, values2, as_uint4(comp)));           \
+   keys2 = shuffle2(keys2, temp, as_uint4(comp));                           \
+   PAYLOAD(values2 = shuffle2(values2, v_temp, as_uint4(comp)));            \
+
+/* Read a vector of keys, padding positions past the end */
+KEY4 load_keys(__global KEY4 *g_keys, uint index, uint num_keys) {
+
+   __global KEY *keys = (__global KEY*)g_keys;
+   uint start = index * 4;
+   KEY4 value;
+
+   if(start + 4 <= num_keys)
+      return g_keys[index];
+   value.s0 = (start < num_keys) ? keys[start] : KEY_MAX;
+   value.s1 = (start + 1 < num_keys) ? keys[start + 1] : KEY_MAX;
+   value.s2 = (start + 2 < num_keys) ? keys[start + 2] : KEY_MAX;
+   value.s3 = KEY_MAX;
+   return value;
+}
+
+/* Write a vector of keys, dropping positions past the end */
+void store_keys(KEY4 value, __global KEY4 *g_keys, uint index,
+                uint num_keys) {
+
+   __global KEY *keys = (__global KEY*)g_keys;
+   uint start = index * 4;
+
+   if(start + 4 <= num_keys) {
+      g_keys[index] = value;
+      return;
+   }
+   if(start < num_keys) keys[start] = value.s0;
+   if(start + 1 < num_keys) keys[start + 1] = value.s1;
+   if(start + 2 < num_keys) keys[start + 2] = value.s2;
+}
+
+#ifdef KEY_VALUE
+/* Read a vector of values, padding positions past the end */
+uint4 load_values(__global uint4 *g_values, uint index, uint num_keys) {
+
+   __global uint *values = (__global uint*)g_values;
+   uint start = index * 4;
+   uint4 value;
+
+   if(start + 4 <= num_keys)
+      return g_values[index];
+   value.s0 = (start < num_keys) ? values[start] : UINT_MAX;
+   value.s1 = (start + 1 < num_keys) ? values[start + 1] : UINT_MAX;
+   value.s2 = (start + 2 < num_keys) ? values[start + 2] : UINT_MAX;
+   value.s3 = UINT_MAX;
+   return value;
+}
+
+/* Write a vector of values, dropping positions past the end */
+void store_values(uint4 value, __global uint4 *g_values, uint index,
+                  uint num_keys) {
+
+   __global uint *values = (__global uint*)g_values;
+   uint start = index * 4;
+
+   if(start + 4 <= num_keys) {
+      g_values[index] = value;
+      return;
+   }
+   if(start < num_keys) values[start] = value.s0;
+   if(start + 1 < num_keys) values[start + 1] = value.s1;
+   if(start + 2 < num_keys) values[start + 2] = value.s2;
+}
+#endif
+
+/* Find the direction of a block inside a work-group's sort. The block
+   holding the first padded position always ascends, so the padding
+   stays at the end */
+int block_dir(uint block, uint block_size, uint num_keys) {
+
+   if(block == num_keys/block_size)
+      return 0;
+   if((block ^ 1) == num_keys/block_size)
+      return -1;
+   return (block & 1) * -1;
+}
+
+/* Sort each block of 8 * local_size keys in ascending order with the
+   network of bsort_init */
+__kernel void merge_sort_init(__global KEY4 *g_keys, __local KEY4 *l_keys,
+                              uint num_keys
+                              VALUE_ARG(__global uint4 *g_values)
+                              VALUE_ARG(__local uint4 *l_values)) {
+
+   int dir, dir1, dir2;
+   uint id, global_id, global_start, size, stride;
+   KEY4 input1, input2, temp;
+   uint4 values1, values2, v_temp;
+   int4 comp;
+
+   uint4 mask1 = (uint4)(1, 0, 3, 2);
+   uint4 mask2 = (uint4)(2, 3, 0, 1);
+   uint4 mask3 = (uint4)(3, 2, 1, 0);
+
+   int4 add1 = (int4)(1, 1, 3, 3);
+   int4 add2 = (int4)(2, 3, 2, 3);
+   int4 add3 = (int4)(1, 2, 2, 3);
+
+   id = get_local_id(0) * 2;
+   global_id = get_global_id(0);
+   global_start = get_group_id(0) * get_local_size(0) * 2 + id;
+
+   input1 = load_keys(g_keys, global_start, num_keys);
+   input2 = load_keys(g_keys, global_start+1, num_keys);
+   PAYLOAD(values1 = load_values(g_values, global_start, num_keys));
+   PAYLOAD(values2 = load_values(g_values, global_start+1, num_keys));
+
+   /* Sort input 1 */
+   dir1 = block_dir(global_id * 2, 4, num_keys);
+   comp = LESS(input1, values1, shuffle(input1, mask1),
+               shuffle(values1, mask1)) ^ dir1;
+   input1 = shuffle(input1, as_uint4(comp + add1));
+   PAYLOAD(values1 = shuffle(values1, as_uint4(comp + add1)));
+   comp = LESS(input1, values1, shuffle(input1, mask2),
+               shuffle(values1, mask2)) ^ dir1;
+   input1 = shuffle(input1, as_uint4(comp * 2 + add2));
+   PAYLOAD(values1 = shuffle(values1, as_uint4(comp * 2 + add2)));
+   comp = LESS(input1, values1, shuffle(input1, mask3),
+               shuffle(values1, mask3)) ^ dir1;
+   input1 = shuffle(input1, as_uint4(comp + add3));
+   PAYLOAD(values1 = shuffle(values1, as_uint4(comp + add3)));
+
+   /* Sort input 2 */
+   dir2 = block_dir(global_id * 2 + 1, 4, num_keys);
+   comp = LESS(input2, values2, shuffle(input2, mask1),
+               shuffle(values2, mask1)) ^ dir2;
+   input2 = shuffle(input2, as_uint4(comp + add1));
+   PAYLOAD(values2 = shuffle(values2, as_uint4(comp + add1)));
+   comp = LESS(input2, values2, shuffle(input2, mask2),
+               shuffle(values2, mask2)) ^ dir2;
+   input2 = shuffle(input2, as_uint4(comp * 2 + add2));
+   PAYLOAD(values2 = shuffle(values2, as_uint4(comp * 2 + add2)));
+   comp = LESS(input2, values2, shuffle(input2, mask3),
+               shuffle(values2, mask3)) ^ dir2;
+   input2 = shuffle(input2, as_uint4(comp + add3));
+   PAYLOAD(values2 = shuffle(values2, as_uint4(comp + add3)));
+
+   /* Swap corresponding elements of input 1 and 2 */
+   add3 = (int4)(4, 5, 6, 7);
+   dir = block_dir(global_id, 8, num_keys);
+   VECTOR_SWAP(input1, values1, input2, values2, dir)
+
+   /* Sort data and store in local memory */
+   VECTOR_SORT(input1, values1, dir);
+   VECTOR_SORT(input2, values2, dir);
+   l_keys[id] = input1;
+   l_keys[id+1] = input2;
+   PAYLOAD(l_values[id] = values1);
+   PAYLOAD(l_values[id+1] = values2);
+
+   /* Create bitonic set */
+   for(size = 2; size < get_local_size(0); size <<= 1) {
+      dir = block_dir(global_id/size, size * 8, num_keys);
+
+      for(stride = size; stride > 1; stride >>= 1) {
+         barrier(CLK_LOCAL_MEM_FENCE);
+         id = get_local_id(0) + (get_local_id(0)/stride)*stride;
+         VECTOR_SWAP(l_keys[id], l_values[id], l_keys[id + stride],
+                     l_values[id + stride], dir)
+      }
+
+      barrier(CLK_LOCAL_MEM_FENCE);
+      id = get_local_id(0) * 2;
+      input1 = l_keys[id]; input2 = l_keys[id+1];
+      PAYLOAD(values1 = l_values[id]);
+      PAYLOAD(values2 = l_values[id+1]);
+      VECTOR_SWAP(input1, values1, input2, values2, dir)
+      VECTOR_SORT(input1, values1, dir);
+      VECTOR_SORT(input2, values2, dir);
+      l_keys[id] = input1;
+      l_keys[id+1] = input2;
+      PAYLOAD(l_values[id] = values1);
+      PAYLOAD(l_values[id+1] = values2);
+   }
+
+   /* Perform bitonic merge, ascending in every work-group */
+   dir = 0;
+   for(stride = get_local_size(0); stride > 1; stride >>= 1) {
+      barrier(CLK_LOCAL_MEM_FENCE);
+      id = get_local_id(0) + (get_local_id(0)/stride)*stride;
+      VECTOR_SWAP(l_keys[id], l_values[id], l_keys[id + stride],
+                  l_values[id + stride], dir)
+   }
+   barrier(CLK_LOCAL_MEM_FENCE);
+
+   /* Perform final sort */
+   id = get_local_id(0) * 2;
+   input1 = l_keys[id]; input2 = l_keys[id+1];
+   PAYLOAD(values1 = l_values[id]);
+   PAYLOAD(values2 = l_values[id+1]);
+   VECTOR_SWAP(input1, values1, input2, values2, dir)
+   VECTOR_SORT(input1, values1, dir);
+   VECTOR_SORT(input2, values2, dir);
+   store_keys(input1, g_keys, global_start, num_keys);
+   store_keys(input2, g_keys, global_start+1, num_keys);
+   PAYLOAD(store_values(values1, g_values, global_start, num_keys));
+   PAYLOAD(store_values(values2, g_values, global_start+1, num_keys));
+}
+
+/* Find how many elements of a come first among the first diag elements
+   of the merged output. Ties go to a, so the merge is stable */
+uint merge_path(__global KEY *a_keys VALUE_ARG(__global uint *a_values),
+                uint a_len,
+                __global KEY *b_keys VALUE_ARG(__global uint *b_values),
+                uint b_len, uint diag) {
+
+   uint low = diag > b_len ? diag - b_len : 0;
+   uint high = min(diag, a_len);
+   uint mid;
+
+   while(low < high) {
+      mid = (low + high)/2;
+      if(LESS(b_keys[diag - 1 - mid], b_values[diag - 1 - mid],
+              a_keys[mid], a_values[mid]))
+         high = mid;
+      else
+         low = mid + 1;
+   }
+   return low;
+}
+
+/* The same search over runs held in local memory */
+uint local_merge_path(__local KEY *a_keys VALUE_ARG(__local uint *a_values),
+                      uint a_len,
+                      __local KEY *b_keys VALUE_ARG(__local uint *b_values),
+                      uint b_len, uint diag) {
+
+   uint low = diag > b_len ? diag - b_len : 0;
+   uint high = min(diag, a_len);
+   uint mid;
+
+   while(low < high) {
+      mid = (low + high)/2;
+      if(LESS(b_keys[diag - 1 - mid], b_values[diag - 1 - mid],
+              a_keys[mid], a_values[mid]))
+         high = mid;
+      else
+         low = mid + 1;
+   }
+   return low;
+}
+
+/* Find where every output tile starts in its pair of sorted runs */
+__kernel void merge_partition(__global KEY *keys, uint num_keys,
+                              uint run_width, uint tile_size,
+                              __global uint *splits
+                              VALUE_ARG(__global uint *values)) {
+
+   uint tile = get_global_id(0);
+   uint pos = tile * tile_size;
+   uint pair_start = pos/(2 * run_width) * (2 * run_width);
+   uint a_len = min(run_width, num_keys - pair_start);
+   uint b_len = min(run_width, num_keys - pair_start - a_len);
+
+   if(pos < num_keys) {
+      splits[tile] = merge_path(
+            keys + pair_start VALUE_ARG(values + pair_start), a_len,
+            keys + pair_start + a_len VALUE_ARG(values + pair_start + a_len),
+            b_len, pos - pair_start);
+   }
+}
+
+/* Merge one tile of output per work-group. The tile's slices of both
+   runs are staged in local memory and every work-item merges
+   ITEMS_PER_WORK_ITEM elements from its own merge path */
+__kernel void merge_tiles(__global KEY *keys, uint num_keys,
+                          uint run_width, __global uint *splits,
+                          __local KEY *l_keys, __global KEY *output
+                          VALUE_ARG(__global uint *values)
+                          VALUE_ARG(__local uint *l_values)
+                          VALUE_ARG(__global uint *out_values)) {
+
+   uint lid = get_local_id(0);
+   uint group_size = get_local_size(0);
+   uint tile_size = group_size * ITEMS_PER_WORK_ITEM;
+   uint tile = get_group_id(0);
+   uint pos = tile * tile_size;
+   uint pair_start = pos/(2 * run_width) * (2 * run_width);
+   uint a_len = min(run_width, num_keys - pair_start);
+   uint pair_len = min(2 * run_width, num_keys - pair_start);
+   uint diag_start = pos - pair_start;
+   uint diag_end = min(diag_start + tile_size, pair_len);
+   uint a_start = splits[tile];
+   uint a_end = (diag_end == pair_len) ? a_len : splits[tile + 1];
+   uint a_count = a_end - a_start;
+   uint count = diag_end - diag_start;
+   uint b_start = diag_start - a_start;
+   uint i, j, diag, a, b;
+   KEY key[ITEMS_PER_WORK_ITEM];
+   uint value[ITEMS_PER_WORK_ITEM];
+   int take_a;
+
+   /* Stage the slices of both runs */
+   for(i = lid; i < count; i += group_size) {
+      j = (i < a_count) ? pair_start + a_start + i :
+            pair_start + a_len + b_start + i - a_count;
+      l_keys[i] = keys[j];
+      PAYLOAD(l_values[i] = values[j]);
+   }
+   barrier(CLK_LOCAL_MEM_FENCE);
+
+   /* Merge this work-item's elements */
+   diag = min(lid * ITEMS_PER_WORK_ITEM, count);
+   a = local_merge_path(l_keys VALUE_ARG(l_values), a_count,
+         l_keys + a_count VALUE_ARG(l_values + a_count), count - a_count,
+         diag);
+   b = a_count + diag - a;
+   for(j = 0; j < ITEMS_PER_WORK_ITEM && diag + j < count; j++) {
+      take_a = b >= count || (a < a_count &&
+            !LESS(l_keys[b], l_values[b], l_keys[a], l_values[a]));
+      key[j] = take_a ? l_keys[a] : l_keys[b];
+      PAYLOAD(value[j] = take_a ? l_values[a] : l_values[b]);
+      a += take_a;
+      b += !take_a;
+   }
+   barrier(CLK_LOCAL_MEM_FENCE);
+
+   /* Write the tile through local memory for coalesced stores */
+   for(j = 0; j < ITEMS_PER_WORK_ITEM && diag + j < count; j++) {
+      l_keys[diag + j] = key[j];
+      PAYLOAD(l_values[diag + j] = value[j]);
+   }
+   barrier(CLK_LOCAL_MEM_FENCE);
+   for(i = lid; i < count; i += group_size) {
+      output[pos + i] = l_keys[i];
+      PAYLOAD(out_values[pos + i] = l_values[i]);
+   }
+}
@@ -0,0 +1,610 @@
+#define _CRT_SECURE_NO_WARNINGS
+#define PROGRAM_FILE "radix_sort.cl"
+
+#define BSORT_FILE "../bsort/bsort.cl"
+
+#define TEST_SIZE 1000003
+#define MIN_KEYS 1048576
+#define MAX_KEYS 268435456
+#define GROUPS_PER_UNIT 8
+#define MAX_LOCAL_SIZE 256
+#define RADIX_BITS 4
+#define RADIX (1 << RADIX_BITS)
+#define NUM_KEY_TYPES 6
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef MAC
+#include <OpenCL/cl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+/* Find a GPU or CPU associated with the first available platform */
+cl_device_id create_device() {
+
+   cl_platform_id platform;
+   cl_device_id dev;
+   int err;
+
+   /* Identify a platform */
+   err = clGetPlatformIDs(1, &platform, NULL);
+   if(err < 0) {
+      perror("Couldn't identify a platform");
+      exit(1);
+   } 
+
+   /* Access a device */
+   err = clGetDeviceIDs(platform, CL_DEVICE_TYPE_GPU, 1, &dev, NULL);
+   if(err == CL_DEVICE_NOT_FOUND) {
+      err = clGetDeviceIDs(platform, CL_DEVICE_TYPE_CPU, 1, &dev, NULL);
+   }
+   if(err < 0) {
+      perror("Couldn't access any devices");
+      exit(1);   
+   }
+
+   return dev;
+}
+
+/* Create program from a file and compile it */
+cl_program build_program(cl_context ctx, cl_device_id dev, const char* filename,
+      const char* options) {
+
+   cl_program program;
+   FILE *program_handle;
+   char *program_buffer, *program_log;
+   size_t program_size, log_size;
+   int err;
+
+   /* Read program file and place content into buffer */
+   program_handle = fopen(filename, "r");
+   if(program_handle == NULL) {
+      perror("Couldn't find the program file");
+      exit(1);
+   }
+   fseek(program_handle, 0, SEEK_END);
+   program_size = ftell(program_handle);
+   rewind(program_handle);
+   program_buffer = (char*)malloc(program_size + 1);
+   program_buffer[program_size] = '\0';
+   fread(program_buffer, sizeof(char), program_size, program_handle);
+   fclose(program_handle);
+
+   /* Create program from file */
+   program = clCreateProgramWithSource(ctx, 1, 
+      (const char**)&program_buffer, &program_size, &err);
+   if(err < 0) {
+      perror("Couldn't create the program");
+      exit(1);
+   }
+   free(program_buffer);
+
+   /* Build program */
+   err = clBuildProgram(program, 0, NULL, options, NULL, NULL);
+   if(err < 0) {
+
+      /* Find size of log and print to std output */
+      clGetProgramBuildInfo(program, dev, CL_PROGRAM_BUILD_LOG, 
+            0, NULL, &log_size);
+      program_log = (char*) malloc(log_size + 1);
+      program_log[log_size] = '\0';
+      clGetProgramBuildInfo(program, dev, CL_PROGRAM_BUILD_LOG, 
+            log_size + 1, program_log, NULL);
+      printf("%s\n", program_log);
+      free(program_log);
+      exit(1);
+   }
+
+   return program;
+}
+
+/* Compare keys for qsort */
+int compare_keys(const void* a, const void* b) {
+
+   cl_uint key_a = *(const cl_uint*)a, key_b = *(const cl_uint*)b;
+   return (key_a > key_b) - (key_a < key_b);
+}
+
+/* Compare 64-bit order keys for qsort */
+int compare_order(const void* a, const void* b) {
+
+   cl_ulong key_a = *(const cl_ulong*)a, key_b = *(const cl_ulong*)b;
+   return (key_a > key_b) - (key_a < key_b);
+}
+
+/* Map a key to an unsigned key with the same order, as TO_RADIX does in
+   radix_sort.cl. Types are numbered as in test_key_types */
+cl_ulong order_key(const unsigned char* key, int type) {
+
+   cl_uint bits32;
+   cl_ulong bits64;
+   float value32;
+   double value64;
+
+   if(type < 3) {
+      memcpy(&bits32, key, sizeof(bits32));
+      memcpy(&value32, key, sizeof(value32));
+      if(type == 1)
+         return bits32 ^ 0x80000000;
+      if(type == 2) {
+         if(value32 != value32)
+            return 0xFFFFFFFF;
+         return bits32 ^ ((bits32 >> 31) ? 0xFFFFFFFF : 0x80000000);
+      }
+      return bits32;
+   }
+   memcpy(&bits64, key, sizeof(bits64));
+   memcpy(&value64, key, sizeof(value64));
+   if(type == 4)
+      return bits64 ^ 0x8000000000000000ULL;
+   if(type == 5) {
+      if(value64 != value64)
+         return 0xFFFFFFFFFFFFFFFFULL;
+      return bits64 ^ ((bits64 >> 63) ? 
+            0xFFFFFFFFFFFFFFFFULL : 0x8000000000000000ULL);
+   }
+   return bits64;
+}
+
+/* Sort the keys with one count, scan and scatter pass per digit and
+   return the device time. The number of passes is even, so the result
+   ends up back in keys_buffer. key_size is the size of the keys the
+   program was built for, 4 or 8 bytes */
+cl_ulong radix_sort(cl_command_queue queue, cl_kernel* kernels, 
+      cl_mem keys_buffer, cl_mem temp_buffer, cl_mem hist_buffer,
+      cl_uint num_keys, size_t key_size, size_t local_size, 
+      cl_uint max_groups) {
+
+   cl_event start_event, end_event;
+   cl_mem buffers[2] = {keys_buffer, temp_buffer};
+   cl_uint shift, num_tiles, tiles_per_group, num_groups, num_entries;
+   cl_ulong time_start, time_end;
+   size_t global_size;
+   int pass, err;
+
+   /* Give every work-group a contiguous range of whole tiles */
+   num_tiles = (num_keys + local_size - 1)/local_size;
+   tiles_per_group = (num_tiles + max_groups - 1)/max_groups;
+   num_groups = (num_tiles + tiles_per_group - 1)/tiles_per_group;
+   num_entries = RADIX * num_groups;
+   global_size = num_groups * local_size;
+
+   for(shift = 0; shift < 8 * key_size; shift += RADIX_BITS) {
+      pass = shift/RADIX_BITS;
+
+      /* Set kernel arguments */
+      err = clSetKernelArg(kernels[0], 0, sizeof(cl_mem), &buffers[pass%2]);
+      err |= clSetKernelArg(kernels[0], 1, sizeof(cl_uint), &num_keys);
+      err |= clSetKernelArg(kernels[0], 2, sizeof(cl_uint), &shift);
+      err |= clSetKernelArg(kernels[0], 3, sizeof(cl_uint), &tiles_per_group);
+      err |= clSetKernelArg(kernels[0], 4, sizeof(cl_mem), &hist_buffer);
+      err |= clSetKernelArg(kernels[1], 0, sizeof(cl_mem), &hist_buffer);
+      err |= clSetKernelArg(kernels[1], 1, sizeof(cl_uint), &num_entries);
+      err |= clSetKernelArg(kernels[1], 2, local_size * sizeof(cl_uint), NULL);
+      err |= clSetKernelArg(kernels[2], 0, sizeof(cl_mem), &buffers[pass%2]);
+      err |= clSetKernelArg(kernels[2], 1, sizeof(cl_uint), &num_keys);
+      err |= clSetKernelArg(kernels[2], 2, sizeof(cl_uint), &shift);
+      err |= clSetKernelArg(kernels[2], 3, sizeof(cl_uint), &tiles_per_group);
+      err |= clSetKernelArg(kernels[2], 4, sizeof(cl_mem), &hist_buffer);
+      err |= clSetKernelArg(kernels[2], 5, local_size * key_size, NULL);
+      err |= clSetKernelArg(kernels[2], 6, local_size * sizeof(cl_uint), NULL);
+      err |= clSetKernelArg(kernels[2], 7, sizeof(cl_mem), 
+            &buffers[(pass+1)%2]);
+      if(err < 0) {
+         perror("Couldn't create a kernel argument");
+         exit(1);   
+      }
+
+      /* Count digits, scan the histograms and scatter the keys */
+      err = clEnqueueNDRangeKernel(queue, kernels[0], 1, NULL, &global_size, 
+            &local_size, 0, NULL, shift == 0 ? &start_event : NULL);
+      err |= clEnqueueNDRangeKernel(queue, kernels[1], 1, NULL, &local_size, 
+            &local_size, 0, NULL, NULL);
+      err |= clEnqueueNDRangeKernel(queue, kernels[2], 1, NULL, &global_size, 
+            &local_size, 0, NULL, 
+            shift + RADIX_BITS >= 8 * key_size ? &end_event : NULL);
+      if(err < 0) {
+         perror("Couldn't enqueue the kernel");
+         exit(1);   
+      }
+   }
+   clFinish(queue);
+
+   clGetEventProfilingInfo(start_event, CL_PROFILING_COMMAND_START,
+         sizeof(time_start), &time_start, NULL);
+   clGetEventProfilingInfo(end_event, CL_PROFILING_COMMAND_END,
+         sizeof(time_end), &time_end, NULL);
+   clReleaseEvent(start_event);
+   clReleaseEvent(end_event);
+   return time_end - time_start;
+}
+
+/* Sort floats with the kernels of Ch11/bsort and return the device time */
+cl_ulong bitonic_sort(cl_command_queue queue, cl_kernel* kernels, 
+      cl_mem data_buffer, cl_uint num_floats, size_t local_size) {
+
+   cl_event start_event, end_event;
+   cl_uint stage, high_stage, num_stages, padded_size;
+   cl_ulong time_start, time_end;
+   cl_int i, err, direction = 0;
+   size_t global_size;
+
+   /* Set the data and local memory arguments of every kernel */
+   padded_size = 8;
+   while(padded_size < num_floats) {
+      padded_size <<= 1;
+   }
+   global_size = padded_size/8;
+   if(global_size < local_size) {
+      local_size = global_size;
+   }
+   err = 0;
+   for(i=0; i<5; i++) {
+      err |= clSetKernelArg(kernels[i], 0, sizeof(cl_mem), &data_buffer);
+      err |= clSetKernelArg(kernels[i], 1, 8*local_size*sizeof(float), NULL);
+   }
+   err |= clSetKernelArg(kernels[0], 2, sizeof(cl_uint), &num_floats);
+   err |= clSetKernelArg(kernels[0], 3, sizeof(int), &direction);
+   err |= clSetKernelArg(kernels[1], 3, sizeof(cl_uint), &num_floats);
+   err |= clSetKernelArg(kernels[1], 4, sizeof(int), &direction);
+   err |= clSetKernelArg(kernels[2], 4, sizeof(cl_uint), &num_floats);
+   err |= clSetKernelArg(kernels[2], 5, sizeof(int), &direction);
+   err |= clSetKernelArg(kernels[3], 3, sizeof(int), &direction);
+   err |= clSetKernelArg(kernels[3], 4, sizeof(cl_uint), &num_floats);
+   err |= clSetKernelArg(kernels[4], 2, sizeof(int), &direction);
+   err |= clSetKernelArg(kernels[4], 3, sizeof(cl_uint), &num_floats);
+   if(err < 0) {
+      perror("Couldn't create a kernel argument");
+      exit(1);   
+   }
+
+   /* Enqueue initial sorting kernel */
+   err = clEnqueueNDRangeKernel(queue, kernels[0], 1, NULL, &global_size, 
+         &local_size, 0, NULL, &start_event); 
+
+   /* Execute further stages */
+   num_stages = global_size/local_size;
+   for(high_stage = 2; high_stage < num_stages; high_stage <<= 1) {
+      err |= clSetKernelArg(kernels[1], 2, sizeof(int), &high_stage);      
+      err |= clSetKernelArg(kernels[2], 3, sizeof(int), &high_stage);
+      for(stage = high_stage; stage > 1; stage >>= 1) {
+         err |= clSetKernelArg(kernels[2], 2, sizeof(int), &stage);
+         err |= clEnqueueNDRangeKernel(queue, kernels[2], 1, NULL, 
+               &global_size, &local_size, 0, NULL, NULL); 
+      }
+      err |= clEnqueueNDRangeKernel(queue, kernels[1], 1, NULL, 
+            &global_size, &local_size, 0, NULL, NULL); 
+   }
+
+   /* Perform the bitonic merge */
+   for(stage = num_stages; stage > 1; stage >>= 1) {
+      err |= clSetKernelArg(kernels[3], 2, sizeof(int), &stage);
+      err |= clEnqueueNDRangeKernel(queue, kernels[3], 1, NULL, 
+            &global_size, &local_size, 0, NULL, NULL); 
+   }
+   err |= clEnqueueNDRangeKernel(queue, kernels[4], 1, NULL, 
+         &global_size, &local_size, 0, NULL, &end_event); 
+   if(err < 0) {
+      perror("Couldn't enqueue the kernel");
+      exit(1);   
+   }
+   clFinish(queue);
+
+   clGetEventProfilingInfo(start_event, CL_PROFILING_COMMAND_START,
+         sizeof(time_start), &time_start, NULL);
+   clGetEventProfilingInfo(end_event, CL_PROFILING_COMMAND_END,
+         sizeof(time_end), &time_end, NULL);
+   clReleaseEvent(start_event);
+   clReleaseEvent(end_event);
+   return time_end - time_start;
+}
+
+/* Build the radix sort for each key type, sort TEST_SIZE keys with 
+   special floating-point values mixed in, and compare the order of the
+   result with qsort */
+void test_key_types(cl_context context, cl_device_id device, 
+      cl_command_queue queue, cl_mem hist_buffer, size_t local_size, 
+      cl_uint max_groups) {
+
+   cl_program program;
+   cl_kernel kernels[3];
+   cl_mem keys_buffer, temp_buffer;
+   cl_ulong sort_time, *expected;
+   cl_uint i, b;
+   int type, err, check;
+   size_t size, extensions_size;
+   char *extensions;
+   unsigned char *keys;
+   float value32;
+   double value64;
+   const char* kernel_names[3] = {"radix_count", "radix_scan", 
+         "radix_scatter"};
+   const char* type_names[NUM_KEY_TYPES] = {"uint", "int", "float", 
+         "ulong", "long", "double"};
+   const char* type_options[NUM_KEY_TYPES] = {NULL, "-DKEY_INT", 
+         "-DKEY_FLOAT", "-DKEY_ULONG", "-DKEY_LONG", "-DKEY_DOUBLE"};
+   size_t type_sizes[NUM_KEY_TYPES] = {4, 4, 4, 8, 8, 8};
+   double specials[8] = {0.0, -0.0, INFINITY, -INFINITY, NAN, -NAN, 
+         1.0e-40, -1.0e-40};
+
+   /* Double keys need cl_khr_fp64 */
+   clGetDeviceInfo(device, CL_DEVICE_EXTENSIONS, 0, NULL, &extensions_size);
+   extensions = (char*) malloc(extensions_size + 1);
+   extensions[extensions_size] = '\0';
+   clGetDeviceInfo(device, CL_DEVICE_EXTENSIONS, extensions_size, 
+         extensions, NULL);
+
+   keys = (unsigned char*) malloc(TEST_SIZE * sizeof(cl_ulong));
+   expected = (cl_ulong*) malloc(TEST_SIZE * sizeof(cl_ulong));
+   printf("Type        Rate    Check\n");
+   for(type = 0; type < NUM_KEY_TYPES; type++) {
+      if(type == 5 && strstr(extensions, "cl_khr_fp64") == NULL) {
+         printf("%-12sskipped, no cl_khr_fp64\n", type_names[type]);
+         continue;
+      }
+      size = type_sizes[type];
+
+      /* Random bits, or random values and specials for floating point */
+      for(i=0; i<TEST_SIZE; i++) {
+         for(b=0; b<size; b++) {
+            keys[i*size + b] = rand() & 0xFF;
+         }
+         if(type == 2 || type == 5) {
+            value64 = (i % 64 == 0) ? specials[(i/64) % 8] :
+                  ((double)rand()/RAND_MAX - 0.5) * 1.0e6;
+            value32 = (float)value64;
+            if(type == 2)
+               memcpy(keys + i*size, &value32, size);
+            else
+               memcpy(keys + i*size, &value64, size);
+         }
+         expected[i] = order_key(keys + i*size, type);
+      }
+      qsort(expected, TEST_SIZE, sizeof(cl_ulong), compare_order);
+
+      /* Build a program specialized for the key type */
+      program = build_program(context, device, PROGRAM_FILE, 
+            type_options[type]);
+      for(i=0; i<3; i++) {
+         kernels[i] = clCreateKernel(program, kernel_names[i], &err);
+         if(err < 0) {
+            perror("Couldn't create a kernel");
+            exit(1);
+         };
+      }
+      keys_buffer = clCreateBuffer(context, CL_MEM_READ_WRITE |
+            CL_MEM_COPY_HOST_PTR, TEST_SIZE * size, keys, &err);
+      temp_buffer = clCreateBuffer(context, CL_MEM_READ_WRITE, 
+            TEST_SIZE * size, NULL, &err);
+      if(err < 0) {
+         perror("Couldn't create a buffer");
+         exit(1);   
+      };
+      sort_time = radix_sort(queue, kernels, keys_buffer, temp_buffer, 
+            hist_buffer, TEST_SIZE, size, local_size, max_groups);
+      err = clEnqueueReadBuffer(queue, keys_buffer, CL_TRUE, 0, 
+            TEST_SIZE * size, keys, 0, NULL, NULL);
+      if(err < 0) {
+         perror("Couldn't read the buffer");
+         exit(1);   
+      }
+
+      check = 1;
+      for(i=0; i<TEST_SIZE; i++) {
+         if(order_key(keys + i*size, type) != expected[i]) {
+            check = 0;
+            break;
+         }
+      }
+      printf("%-12s%-8.1f%s\n", type_names[type], 
+            1.0e3 * TEST_SIZE/sort_time, check ? "passed" : "failed");
+
+      clReleaseMemObject(keys_buffer);
+      clReleaseMemObject(temp_buffer);
+      for(i=0; i<3; i++) {
+         clReleaseKernel(kernels[i]);
+      }
+      clReleaseProgram(program);
+   }
+   free(keys);
+   free(expected);
+   free(extensions);
+}
+
+int main() {
+
+   /* OpenCL structures */
+   cl_device_id device;
+   cl_context context;
+   cl_program program, bsort_program;
+   cl_kernel radix_kernels[3], bsort_kernels[5];
+   cl_command_queue queue;
+   cl_int i, err, check;
+   cl_uint num_keys, compute_units, max_groups;
+   cl_ulong max_alloc, radix_time, bsort_time, host_time;
+   size_t local_size, bsort_local_size;
+   clock_t host_start;
+   const char* radix_names[3] = {"radix_count", "radix_scan", 
+         "radix_scatter"};
+   const char* bsort_names[5] = {"bsort_init", "bsort_stage_0", 
+         "bsort_stage_n", "bsort_merge", "bsort_merge_last"};
+
+   /* Data and buffers */
+   cl_uint *keys, *sorted;
+   float *floats;
+   cl_mem keys_buffer, temp_buffer, hist_buffer, float_buffer;
+
+   /* Create device and context */
+   device = create_device();
+   err = clGetDeviceInfo(device, CL_DEVICE_MAX_COMPUTE_UNITS, 
+         sizeof(compute_units), &compute_units, NULL);
+   err |= clGetDeviceInfo(device, CL_DEVICE_MAX_MEM_ALLOC_SIZE, 
+         sizeof(max_alloc), &max_alloc, NULL);
+   if(err < 0) {
+      perror("Couldn't obtain device information");
+      exit(1);   
+   }
+   context = clCreateContext(NULL, 1, &device, NULL, NULL, &err);
+   if(err < 0) {
+      perror("Couldn't create a context");
+      exit(1);   
+   }
+
+   /* Build the radix sort and bitonic sort programs */
+   program = build_program(context, device, PROGRAM_FILE, NULL);
+   bsort_program = build_program(context, device, BSORT_FILE, NULL);
+
+   /* Create kernels */
+   for(i=0; i<3; i++) {
+      radix_kernels[i] = clCreateKernel(program, radix_names[i], &err);
+      if(err < 0) {
+         perror("Couldn't create a kernel");
+         exit(1);
+      };
+   }
+   for(i=0; i<5; i++) {
+      bsort_kernels[i] = clCreateKernel(bsort_program, bsort_names[i], &err);
+      if(err < 0) {
+         perror("Couldn't create a kernel");
+         exit(1);
+      };
+   }
+
+   /* Determine work-group sizes */
+   err = clGetKernelWorkGroupInfo(radix_kernels[2], device, 
+         CL_KERNEL_WORK_GROUP_SIZE, sizeof(local_size), &local_size, NULL);
+   err |= clGetKernelWorkGroupInfo(bsort_kernels[0], device, 
+         CL_KERNEL_WORK_GROUP_SIZE, sizeof(bsort_local_size), 
+         &bsort_local_size, NULL);
+   if(err < 0) {
+      perror("Couldn't find the maximum work-group size");
+      exit(1);   
+   };
+   local_size = (size_t)pow(2, trunc(log2(local_size)));
+   if(local_size > MAX_LOCAL_SIZE)
+      local_size = MAX_LOCAL_SIZE;
+   if(local_size < RADIX) {
+      printf("The radix sort needs %d work-items per group\n", RADIX);
+      exit(1);
+   }
+   bsort_local_size = (size_t)pow(2, trunc(log2(bsort_local_size)));
+   max_groups = compute_units * GROUPS_PER_UNIT;
+
+   /* Create a command queue and the histogram buffer */
+   queue = clCreateCommandQueue(context, device, 
+         CL_QUEUE_PROFILING_ENABLE, &err);
+   if(err < 0) {
+      perror("Couldn't create a command queue");
+      exit(1);   
+   };
+   hist_buffer = clCreateBuffer(context, CL_MEM_READ_WRITE, 
+         RADIX * max_groups * sizeof(cl_uint), NULL, &err);
+   if(err < 0) {
+      perror("Couldn't create a buffer");
+      exit(1);   
+   };
+
+   /* Check an odd size first, then sweep powers of two */
+   srand(time(NULL));
+   printf("Keys        Radix sort      Bitonic sort    qsort\n");
+   for(num_keys = TEST_SIZE; num_keys <= MAX_KEYS && 
+         num_keys * sizeof(cl_uint) <= max_alloc; 
+         num_keys = (num_keys == TEST_SIZE) ? MIN_KEYS : num_keys * 4) {
+
+      keys = (cl_uint*) malloc(num_keys * sizeof(cl_uint));
+      sorted = (cl_uint*) malloc(num_keys * sizeof(cl_uint));
+      floats = (float*) malloc(num_keys * sizeof(float));
+      if(keys == NULL || sorted == NULL || floats == NULL) {
+         printf("Couldn't allocate %u keys on the host\n", num_keys);
+         break;
+      }
+      for(i=0; i<num_keys; i++) {
+         keys[i] = ((cl_uint)rand() << 16) ^ (cl_uint)rand();
+         floats[i] = (float)keys[i];
+      }
+
+      /* Radix sort on the device */
+      keys_buffer = clCreateBuffer(context, CL_MEM_READ_WRITE |
+            CL_MEM_COPY_HOST_PTR, num_keys * sizeof(cl_uint), keys, &err);
+      temp_buffer = clCreateBuffer(context, CL_MEM_READ_WRITE, 
+            num_keys * sizeof(cl_uint), NULL, &err);
+      if(err < 0) {
+         perror("Couldn't create a buffer");
+         exit(1);   
+      };
+      radix_time = radix_sort(queue, radix_kernels, keys_buffer, 
+            temp_buffer, hist_buffer, num_keys, sizeof(cl_uint), local_size,
+            max_groups);
+      err = clEnqueueReadBuffer(queue, keys_buffer, CL_TRUE, 0, 
+            num_keys * sizeof(cl_uint), sorted, 0, NULL, NULL);
+      if(err < 0) {
+         perror("Couldn't read the buffer");
+         exit(1);   
+      }
+      clReleaseMemObject(keys_buffer);
+      clReleaseMemObject(temp_buffer);
+
+      /* qsort on the host, also the reference result */
+      host_start = clock();
+      qsort(keys, num_keys, sizeof(cl_uint), compare_keys);
+      host_time = (cl_ulong)(1.0e9 * (clock() - host_start)/CLOCKS_PER_SEC);
+      check = !memcmp(keys, sorted, num_keys * sizeof(cl_uint));
+      printf("%-12u%-8.1f%-8s", num_keys, 1.0e3 * num_keys/radix_time, 
+            check ? "passed" : "failed");
+
+      /* Bitonic sort of the same keys as floats */
+      float_buffer = clCreateBuffer(context, CL_MEM_READ_WRITE |
+            CL_MEM_COPY_HOST_PTR, num_keys * sizeof(float), floats, &err);
+      if(err < 0) {
+         perror("Couldn't create a buffer");
+         exit(1);   
+      };
+      bsort_time = bitonic_sort(queue, bsort_kernels, float_buffer, 
+            num_keys, bsort_local_size);
+      err = clEnqueueReadBuffer(queue, float_buffer, CL_TRUE, 0, 
+            num_keys * sizeof(float), floats, 0, NULL, NULL);
+      if(err < 0) {
+         perror("Couldn't read the buffer");
+         exit(1);   
+      }
+      clReleaseMemObject(float_buffer);
+      check = 1;
+      for(i=1; i<num_keys; i++) {
+         if(floats[i] < floats[i-1]) {
+            check = 0;
+            break;
+         }
+      }
+      printf("%-8.1f%-8s", 1.0e3 * num_keys/bsort_time, 
+            check ? "passed" : "failed");
+      printf("%.1f\n", 1.0e3 * num_keys/host_time);
+
+      free(keys);
+      free(sorted);
+      free(floats);
+   }
+   printf("Rates in millions of keys per second\n");
+
+   /* Every key type at the odd size */
+   test_key_types(context, device, queue, hist_buffer, local_size, 
+         max_groups);
+
+   /* Deallocate resources */
+   for(i=0; i<3; i++) {
+      clReleaseKernel(radix_kernels[i]);
+   }
+   for(i=0; i<5; i++) {
+      clReleaseKernel(bsort_kernels[i]);
+   }
+   clReleaseMemObject(hist_buffer);
+   clReleaseCommandQueue(queue);
+   clReleaseProgram(program);
+   clReleaseProgram(bsort_program);
+   clReleaseContext(context);
+   return 0;
+}
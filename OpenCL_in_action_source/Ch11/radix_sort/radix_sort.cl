@@ -0,0 +1,202 @@
+#define RADIX_BITS 4
+#define RADIX (1 << RADIX_BITS)
+#define DIGIT(key, shift) ((uint)((key) >> (shift)) & (RADIX - 1))
+
+/* Keys are uint unless the program is built with -DKEY_INT, -DKEY_FLOAT,
+   -DKEY_ULONG, -DKEY_LONG or -DKEY_DOUBLE. The passes work on unsigned 
+   radix keys with the same order: signed keys flip the sign bit, and
+   floating-point keys flip the sign bit of positive values and every 
+   bit of negative ones. All NaNs map to the largest radix key, so they
+   sort last and are written back as one canonical NaN */
+#if defined(KEY_ULONG) || defined(KEY_LONG) || defined(KEY_DOUBLE)
+#define KEY_BITS 64
+#define RADIX_KEY ulong
+#else
+#define KEY_BITS 32
+#define RADIX_KEY uint
+#endif
+#define RADIX_MAX ((RADIX_KEY)0 - 1)
+
+#if defined(KEY_INT)
+#define KEY int
+#define TO_RADIX(key) (as_uint(key) ^ 0x80000000)
+#define FROM_RADIX(bits) as_int((bits) ^ 0x80000000)
+#elif defined(KEY_FLOAT)
+#define KEY float
+#define TO_RADIX(key) (isnan(key) ? RADIX_MAX : as_uint(key) ^ \
+      ((as_uint(key) >> 31) ? 0xFFFFFFFF : 0x80000000))
+#define FROM_RADIX(bits) as_float((bits) ^ \
+      (((bits) >> 31) ? 0x80000000 : 0xFFFFFFFF))
+#elif defined(KEY_ULONG)
+#define KEY ulong
+#define TO_RADIX(key) (key)
+#define FROM_RADIX(bits) (bits)
+#elif defined(KEY_LONG)
+#define KEY long
+#define TO_RADIX(key) (as_ulong(key) ^ 0x8000000000000000UL)
+#define FROM_RADIX(bits) as_long((bits) ^ 0x8000000000000000UL)
+#elif defined(KEY_DOUBLE)
+#pragma OPENCL EXTENSION cl_khr_fp64 : enable
+#define KEY double
+#define TO_RADIX(key) (isnan(key) ? RADIX_MAX : as_ulong(key) ^ \
+      ((as_ulong(key) >> 63) ? 0xFFFFFFFFFFFFFFFFUL : 0x8000000000000000UL))
+#define FROM_RADIX(bits) as_double((bits) ^ \
+      (((bits) >> 63) ? 0x8000000000000000UL : 0xFFFFFFFFFFFFFFFFUL))
+#else
+#define KEY uint
+#define TO_RADIX(key) (key)
+#define FROM_RADIX(bits) (bits)
+#endif
+
+/* KEY_VALUE carries a uint payload with every key */
+#ifdef KEY_VALUE
+#define PAYLOAD(statement) statement
+#define VALUE_ARG(arg) , arg
+#else
+#define PAYLOAD(statement)
+#define VALUE_ARG(arg)
+#endif
+
+/* Each work-group sorts a contiguous range of tiles, one key per 
+   work-item per tile, so every group writes its keys in order */
+__kernel void radix_count(__global KEY* keys, uint num_keys, uint shift,
+      uint tiles_per_group, __global uint* histograms) {
+
+   __local uint l_hist[RADIX];
+   uint lid = get_local_id(0);
+   uint start = get_group_id(0) * tiles_per_group * get_local_size(0);
+   uint end = min(start + tiles_per_group * (uint)get_local_size(0), 
+         num_keys);
+
+   if(lid < RADIX) {
+      l_hist[lid] = 0;
+   }
+   barrier(CLK_LOCAL_MEM_FENCE);
+
+   for(uint i = start + lid; i < end; i += get_local_size(0)) {
+      atomic_inc(&l_hist[DIGIT(TO_RADIX(keys[i]), shift)]);
+   }
+   barrier(CLK_LOCAL_MEM_FENCE);
+
+   /* Digit-major layout, so one scan yields every group's offsets */
+   if(lid < RADIX) {
+      histograms[lid * get_num_groups(0) + get_group_id(0)] = l_hist[lid];
+   }
+}
+
+/* Exclusive scan of the histograms in a single work-group */
+__kernel void radix_scan(__global uint* histograms, uint num_entries,
+      __local uint* partial_sums) {
+
+   uint lid = get_local_id(0);
+   uint group_size = get_local_size(0);
+   uint running_total = 0, value, i;
+
+   for(uint start = 0; start < num_entries; start += group_size) {
+
+      value = (start + lid < num_entries) ? histograms[start + lid] : 0;
+      partial_sums[lid] = value;
+      barrier(CLK_LOCAL_MEM_FENCE);
+
+      /* Inclusive scan of this chunk */
+      for(uint d = 1; d < group_size; d <<= 1) {
+         i = (lid >= d) ? partial_sums[lid - d] : 0;
+         barrier(CLK_LOCAL_MEM_FENCE);
+         partial_sums[lid] += i;
+         barrier(CLK_LOCAL_MEM_FENCE);
+      }
+
+      if(start + lid < num_entries) {
+         histograms[start + lid] = running_total + partial_sums[lid] - value;
+      }
+      running_total += partial_sums[group_size-1];
+      barrier(CLK_LOCAL_MEM_FENCE);
+   }
+}
+
+/* Stable split of the keys in local memory by one bit */
+void split_bit(__local RADIX_KEY* l_keys, __local uint* l_scan, uint bit
+      VALUE_ARG(__local uint* l_values)) {
+
+   uint lid = get_local_id(0);
+   uint group_size = get_local_size(0);
+   RADIX_KEY key = l_keys[lid];
+   PAYLOAD(uint value = l_values[lid]);
+   uint zero = !((key >> bit) & 1);
+   uint i, zeros_before, total_zeros;
+
+   l_scan[lid] = zero;
+   barrier(CLK_LOCAL_MEM_FENCE);
+   for(uint d = 1; d < group_size; d <<= 1) {
+      i = (lid >= d) ? l_scan[lid - d] : 0;
+      barrier(CLK_LOCAL_MEM_FENCE);
+      l_scan[lid] += i;
+      barrier(CLK_LOCAL_MEM_FENCE);
+   }
+   zeros_before = l_scan[lid] - zero;
+   total_zeros = l_scan[group_size - 1];
+   barrier(CLK_LOCAL_MEM_FENCE);
+
+   i = zero ? zeros_before : total_zeros + lid - zeros_before;
+   l_keys[i] = key;
+   PAYLOAD(l_values[i] = value);
+   barrier(CLK_LOCAL_MEM_FENCE);
+}
+
+/* Sort each tile by digit in local memory, then write every digit's
+   keys as one contiguous run */
+__kernel void radix_scatter(__global KEY* keys, uint num_keys, uint shift,
+      uint tiles_per_group, __global uint* histograms, 
+      __local RADIX_KEY* l_keys, __local uint* l_scan, __global KEY* sorted
+      VALUE_ARG(__global uint* values) VALUE_ARG(__local uint* l_values)
+      VALUE_ARG(__global uint* sorted_values)) {
+
+   __local uint l_offsets[RADIX], l_begin[RADIX], l_end[RADIX];
+   uint lid = get_local_id(0);
+   uint group_size = get_local_size(0);
+   uint start = get_group_id(0) * tiles_per_group * group_size;
+   uint end = min(start + tiles_per_group * group_size, num_keys);
+   RADIX_KEY key;
+   uint digit, b;
+
+   if(lid < RADIX) {
+      l_offsets[lid] = histograms[lid * get_num_groups(0) + 
+            get_group_id(0)];
+   }
+
+   for(uint tile = start; tile < end; tile += group_size) {
+
+      /* Keys past the end sort to the back of the last tile */
+      l_keys[lid] = (tile + lid < end) ? 
+            TO_RADIX(keys[tile + lid]) : RADIX_MAX;
+      PAYLOAD(l_values[lid] = (tile + lid < end) ? values[tile + lid] : 0);
+      if(lid < RADIX) {
+         l_begin[lid] = 0;
+         l_end[lid] = 0;
+      }
+      barrier(CLK_LOCAL_MEM_FENCE);
+      for(b = 0; b < RADIX_BITS; b++) {
+         split_bit(l_keys, l_scan, shift + b VALUE_ARG(l_values));
+      }
+
+      /* Find where each digit's run starts and ends in the tile */
+      key = l_keys[lid];
+      digit = DIGIT(key, shift);
+      if(lid == 0 || DIGIT(l_keys[lid-1], shift) != digit)
+         l_begin[digit] = lid;
+      if(lid == group_size-1 || DIGIT(l_keys[lid+1], shift) != digit)
+         l_end[digit] = lid + 1;
+      barrier(CLK_LOCAL_MEM_FENCE);
+
+      if(tile + lid < end) {
+         sorted[l_offsets[digit] + lid - l_begin[digit]] = FROM_RADIX(key);
+         PAYLOAD(sorted_values[l_offsets[digit] + lid - l_begin[digit]] = 
+               l_values[lid]);
+      }
+      barrier(CLK_LOCAL_MEM_FENCE);
+
+      if(lid < RADIX) {
+         l_offsets[lid] += l_end[lid] - l_begin[lid];
+      }
+   }
+}
@@ -0,0 +1,358 @@
+#define _CRT_SECURE_NO_WARNINGS
+#define PROGRAM_FILE "segmented_sort.cl"
+
+#define NUM_SEGMENTS 1048576
+#define SMALL_SEGMENT 16
+#define NUM_BINS 7
+#define TEAM_GROUP_SIZE 128
+#define SMALL_GROUP_SIZE 64
+
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef MAC
+#include <OpenCL/cl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+/* Find a GPU or CPU associated with the first available platform */
+cl_device_id create_device() {
+
+   cl_platform_id platform;
+   cl_device_id dev;
+   int err;
+
+   /* Identify a platform */
+   err = clGetPlatformIDs(1, &platform, NULL);
+   if(err < 0) {
+      perror("Couldn't identify a platform");
+      exit(1);
+   } 
+
+   /* Access a device */
+   err = clGetDeviceIDs(platform, CL_DEVICE_TYPE_GPU, 1, &dev, NULL);
+   if(err == CL_DEVICE_NOT_FOUND) {
+      err = clGetDeviceIDs(platform, CL_DEVICE_TYPE_CPU, 1, &dev, NULL);
+   }
+   if(err < 0) {
+      perror("Couldn't access any devices");
+      exit(1);   
+   }
+
+   return dev;
+}
+
+/* Create program from a file and compile it */
+cl_program build_program(cl_context ctx, cl_device_id dev, const char* filename) {
+
+   cl_program program;
+   FILE *program_handle;
+   char *program_buffer, *program_log;
+   size_t program_size, log_size;
+   int err;
+
+   /* Read program file and place content into buffer */
+   program_handle = fopen(filename, "r");
+   if(program_handle == NULL) {
+      perror("Couldn't find the program file");
+      exit(1);
+   }
+   fseek(program_handle, 0, SEEK_END);
+   program_size = ftell(program_handle);
+   rewind(program_handle);
+   program_buffer = (char*)malloc(program_size + 1);
+   program_buffer[program_size] = '\0';
+   fread(program_buffer, sizeof(char), program_size, program_handle);
+   fclose(program_handle);
+
+   /* Create program from file */
+   program = clCreateProgramWithSource(ctx, 1, 
+      (const char**)&program_buffer, &program_size, &err);
+   if(err < 0) {
+      perror("Couldn't create the program");
+      exit(1);
+   }
+   free(program_buffer);
+
+   /* Build program */
+   err = clBuildProgram(program, 0, NULL, NULL, NULL, NULL);
+   if(err < 0) {
+
+      /* Find size of log and print to std output */
+      clGetProgramBuildInfo(program, dev, CL_PROGRAM_BUILD_LOG, 
+            0, NULL, &log_size);
+      program_log = (char*) malloc(log_size + 1);
+      program_log[log_size] = '\0';
+      clGetProgramBuildInfo(program, dev, CL_PROGRAM_BUILD_LOG, 
+            log_size + 1, program_log, NULL);
+      printf("%s\n", program_log);
+      free(program_log);
+      exit(1);
+   }
+
+   return program;
+}
+
+/* Compare floats for qsort */
+int compare_floats(const void* a, const void* b) {
+
+   float value_a = *(const float*)a, value_b = *(const float*)b;
+   return (value_a > value_b) - (value_a < value_b);
+}
+
+/* Pick a segment length: mostly short segments, some medium and a few
+   up to the largest bin */
+cl_uint segment_length() {
+
+   int r = rand() % 100;
+
+   if(r < 70)
+      return 8 + rand() % 9;
+   if(r < 95)
+      return 17 + rand() % 112;
+   return 129 + rand() % 896;
+}
+
+int main() {
+
+   /* OpenCL structures */
+   cl_device_id device;
+   cl_context context;
+   cl_program program;
+   cl_kernel kernels[3];
+   cl_command_queue queue;
+   cl_event start_event, end_event;
+   cl_int i, err, check;
+   cl_uint num_segments, num_floats, bin, team_size, teams_per_group;
+   cl_uint *offsets, bin_counts[NUM_BINS], bin_starts[NUM_BINS];
+   cl_ulong max_alloc, time_start, time_end;
+   size_t local_size, global_size, max_local_size;
+   clock_t host_start;
+   double device_time, host_time;
+   const char* kernel_names[3] = {"bin_segments", "sort_small", 
+         "sort_teams"};
+
+   /* Data and buffers */
+   float *data, *sorted;
+   cl_mem data_buffer, offsets_buffer, bin_buffer, ids_buffer;
+
+   /* Create device and context */
+   device = create_device();
+   err = clGetDeviceInfo(device, CL_DEVICE_MAX_MEM_ALLOC_SIZE, 
+         sizeof(max_alloc), &max_alloc, NULL);
+   if(err < 0) {
+      perror("Couldn't obtain device information");
+      exit(1);   
+   }
+   context = clCreateContext(NULL, 1, &device, NULL, NULL, &err);
+   if(err < 0) {
+      perror("Couldn't create a context");
+      exit(1);   
+   }
+
+   /* Build program and create kernels */
+   program = build_program(context, device, PROGRAM_FILE);
+   for(i=0; i<3; i++) {
+      kernels[i] = clCreateKernel(program, kernel_names[i], &err);
+      if(err < 0) {
+         perror("Couldn't create a kernel");
+         exit(1);
+      };
+   }
+
+   /* The largest bin needs one work-group of TEAM_GROUP_SIZE */
+   err = clGetKernelWorkGroupInfo(kernels[2], device, 
+         CL_KERNEL_WORK_GROUP_SIZE, sizeof(max_local_size), 
+         &max_local_size, NULL);
+   if(err < 0) {
+      perror("Couldn't find the maximum work-group size");
+      exit(1);   
+   };
+   if(max_local_size < TEAM_GROUP_SIZE) {
+      printf("The largest segments need %d work-items per group\n", 
+            TEAM_GROUP_SIZE);
+      exit(1);
+   }
+
+   /* Generate segments of random floats, fewer if they don't fit */
+   srand(time(NULL));
+   num_segments = NUM_SEGMENTS;
+   offsets = (cl_uint*) malloc((num_segments + 1) * sizeof(cl_uint));
+   do {
+      offsets[0] = 0;
+      for(i=0; i<num_segments; i++) {
+         offsets[i+1] = offsets[i] + segment_length();
+      }
+      num_floats = offsets[num_segments];
+      if(num_floats * sizeof(float) > max_alloc || 
+            NUM_BINS * num_segments * sizeof(cl_uint) > max_alloc)
+         num_segments /= 2;
+   } while(num_floats * sizeof(float) > max_alloc || 
+         NUM_BINS * num_segments * sizeof(cl_uint) > max_alloc);
+
+   /* Every segment must fit in the largest bin */
+   for(i=0; i<num_segments; i++) {
+      if(offsets[i+1] - offsets[i] > SMALL_SEGMENT << (NUM_BINS - 1)) {
+         printf("Segments can hold at most %d floats\n", 
+               SMALL_SEGMENT << (NUM_BINS - 1));
+         exit(1);
+      }
+   }
+   data = (float*) malloc(num_floats * sizeof(float));
+   sorted = (float*) malloc(num_floats * sizeof(float));
+   for(i=0; i<num_floats; i++) {
+      data[i] = (float)rand()/RAND_MAX * 2000.0f - 1000.0f;
+   }
+   memcpy(sorted, data, num_floats * sizeof(float));
+
+   /* Create buffers */
+   memset(bin_counts, 0, sizeof(bin_counts));
+   data_buffer = clCreateBuffer(context, CL_MEM_READ_WRITE |
+         CL_MEM_COPY_HOST_PTR, num_floats * sizeof(float), data, &err);
+   offsets_buffer = clCreateBuffer(context, CL_MEM_READ_ONLY |
+         CL_MEM_COPY_HOST_PTR, (num_segments + 1) * sizeof(cl_uint), 
+         offsets, &err);
+   bin_buffer = clCreateBuffer(context, CL_MEM_READ_WRITE |
+         CL_MEM_COPY_HOST_PTR, sizeof(bin_counts), bin_counts, &err);
+   ids_buffer = clCreateBuffer(context, CL_MEM_READ_WRITE, 
+         NUM_BINS * num_segments * sizeof(cl_uint), NULL, &err);
+   if(err < 0) {
+      perror("Couldn't create a buffer");
+      exit(1);   
+   };
+
+   /* Create a command queue */
+   queue = clCreateCommandQueue(context, device, 
+         CL_QUEUE_PROFILING_ENABLE, &err);
+   if(err < 0) {
+      perror("Couldn't create a command queue");
+      exit(1);   
+   };
+
+   /* Create kernel arguments */
+   err = clSetKernelArg(kernels[0], 0, sizeof(cl_mem), &offsets_buffer);
+   err |= clSetKernelArg(kernels[0], 1, sizeof(cl_uint), &num_segments);
+   err |= clSetKernelArg(kernels[0], 2, sizeof(cl_mem), &bin_buffer);
+   err |= clSetKernelArg(kernels[0], 3, sizeof(cl_mem), &ids_buffer);
+   for(i=1; i<3; i++) {
+      err |= clSetKernelArg(kernels[i], 0, sizeof(cl_mem), &data_buffer);
+      err |= clSetKernelArg(kernels[i], 1, sizeof(cl_mem), &offsets_buffer);
+      err |= clSetKernelArg(kernels[i], 2, sizeof(cl_mem), &ids_buffer);
+   }
+   err |= clSetKernelArg(kernels[2], 6, 8 * TEAM_GROUP_SIZE * sizeof(float),
+         NULL);
+   if(err < 0) {
+      perror("Couldn't create a kernel argument");
+      exit(1);   
+   }
+
+   /* Gather the segment IDs of each bin in one launch. The host only
+      reads the counts back to size the sorting launches */
+   local_size = TEAM_GROUP_SIZE;
+   global_size = (num_segments + local_size - 1)/local_size * local_size;
+   err = clEnqueueNDRangeKernel(queue, kernels[0], 1, NULL, &global_size, 
+         &local_size, 0, NULL, &start_event);
+   err |= clEnqueueReadBuffer(queue, bin_buffer, CL_TRUE, 0, 
+         sizeof(bin_counts), bin_counts, 0, NULL, NULL);
+   if(err < 0) {
+      perror("Couldn't bin the segments");
+      exit(1);   
+   }
+   for(bin=0; bin<NUM_BINS; bin++) {
+      bin_starts[bin] = bin * num_segments;
+   }
+
+   /* Sort small segments one per work-item, the rest one per team */
+   end_event = start_event;
+   clRetainEvent(end_event);
+   for(bin=0; bin<NUM_BINS; bin++) {
+      if(bin_counts[bin] == 0)
+         continue;
+      clReleaseEvent(end_event);
+      if(bin == 0) {
+         local_size = SMALL_GROUP_SIZE;
+         global_size = (bin_counts[0] + local_size - 1)/local_size * 
+               local_size;
+         err = clSetKernelArg(kernels[1], 3, sizeof(cl_uint), &bin_starts[0]);
+         err |= clSetKernelArg(kernels[1], 4, sizeof(cl_uint), 
+               &bin_counts[0]);
+         err |= clEnqueueNDRangeKernel(queue, kernels[1], 1, NULL, 
+               &global_size, &local_size, 0, NULL, &end_event);
+      }
+      else {
+         team_size = (SMALL_SEGMENT << bin)/8;
+         teams_per_group = TEAM_GROUP_SIZE/team_size;
+         local_size = TEAM_GROUP_SIZE;
+         global_size = (bin_counts[bin] + teams_per_group - 1)/
+               teams_per_group * local_size;
+         err = clSetKernelArg(kernels[2], 3, sizeof(cl_uint), 
+               &bin_starts[bin]);
+         err |= clSetKernelArg(kernels[2], 4, sizeof(cl_uint), 
+               &bin_counts[bin]);
+         err |= clSetKernelArg(kernels[2], 5, sizeof(cl_uint), &team_size);
+         err |= clEnqueueNDRangeKernel(queue, kernels[2], 1, NULL, 
+               &global_size, &local_size, 0, NULL, &end_event);
+      }
+      if(err < 0) {
+         perror("Couldn't enqueue the kernel");
+         exit(1);   
+      }
+   }
+   err = clEnqueueReadBuffer(queue, data_buffer, CL_TRUE, 0, 
+         num_floats * sizeof(float), data, 0, NULL, NULL);
+   if(err < 0) {
+      perror("Couldn't read the buffer");
+      exit(1);   
+   }
+   clGetEventProfilingInfo(start_event, CL_PROFILING_COMMAND_START,
+         sizeof(time_start), &time_start, NULL);
+   clGetEventProfilingInfo(end_event, CL_PROFILING_COMMAND_END,
+         sizeof(time_end), &time_end, NULL);
+   device_time = 1.0e-6 * (time_end - time_start);
+
+   /* Sort each segment with qsort on the host and compare */
+   host_start = clock();
+   for(i=0; i<num_segments; i++) {
+      qsort(sorted + offsets[i], offsets[i+1] - offsets[i], sizeof(float), 
+            compare_floats);
+   }
+   host_time = 1.0e3 * (clock() - host_start)/CLOCKS_PER_SEC;
+   check = !memcmp(data, sorted, num_floats * sizeof(float));
+
+   /* Display the bins and timing */
+   printf("%u segments, %u floats\n", num_segments, num_floats);
+   printf("Lengths     Work-items  Segments\n");
+   for(bin=0; bin<NUM_BINS; bin++) {
+      printf("%4u-%-7u%-12u%u\n", bin ? (SMALL_SEGMENT << (bin-1)) + 1 : 0,
+            SMALL_SEGMENT << bin, bin ? (SMALL_SEGMENT << bin)/8 : 1, 
+            bin_counts[bin]);
+   }
+   printf("Device: %.3f ms, %.1f million segments/s\n", device_time, 
+         1.0e-3 * num_segments/device_time);
+   printf("qsort:  %.3f ms, %.1f million segments/s\n", host_time, 
+         1.0e-3 * num_segments/host_time);
+   printf("%s\n", check ? "Check passed." : "Check failed.");
+
+   /* Deallocate resources */
+   clReleaseEvent(start_event);
+   clReleaseEvent(end_event);
+   clReleaseMemObject(data_buffer);
+   clReleaseMemObject(offsets_buffer);
+   clReleaseMemObject(bin_buffer);
+   clReleaseMemObject(ids_buffer);
+   for(i=0; i<3; i++) {
+      clReleaseKernel(kernels[i]);
+   }
+   clReleaseCommandQueue(queue);
+   clReleaseProgram(program);
+   clReleaseContext(context);
+   free(offsets);
+   free(data);
+   free(sorted);
+   return 0;
+}
@@ -0,0 +1,241 @@
+#define UP 0
+#define DOWN -1
+
+/* Segments of up to SMALL_SEGMENT floats are sorted by one work-item.
+   Each further bin doubles the segment size and the team of work-items
+   that sorts it, up to SMALL_SEGMENT << (NUM_BINS - 1) floats */
+#define SMALL_SEGMENT 16
+#define NUM_BINS 7
+
+/* Sort elements in a vector */
+#define SORT_VECTOR(input, dir)                                   \
+   comp = input < shuffle(input, mask1) ^ dir;                    \
+   input = shuffle(input, as_uint4(comp + add1));                 \
+   comp = input < shuffle(input, mask2) ^ dir;                    \
+   input = shuffle(input, as_uint4(comp * 2 + add2));             \
+   comp = input < shuffle(input, mask3) ^ dir;                    \
+   input = shuffle(input, as_uint4(comp + add3));                 \
+
+/* Sort elements between two vectors */
+#define SWAP_VECTORS(input1, input2, dir)                         \
+   temp = input1;                                                 \
+   comp = (input1 < input2 ^ dir) * 4 + add4;                     \
+   input1 = shuffle2(input1, input2, as_uint4(comp));             \
+   input2 = shuffle2(input2, temp, as_uint4(comp));               \
+
+/* Sort eight elements held in two vectors, as in bsort8 */
+#define SORT_EIGHT(input1, input2, dir)                           \
+   SORT_VECTOR(input1, UP)                                        \
+   SORT_VECTOR(input2, DOWN)                                      \
+   SWAP_VECTORS(input1, input2, dir)                              \
+   SORT_VECTOR(input1, dir)                                       \
+   SORT_VECTOR(input2, dir)                                       \
+
+/* Read a vector of a segment, padding positions past its end */
+float4 load_segment(__global float *data, uint start, uint count,
+                    uint index) {
+
+   uint first = index * 4;
+   float4 value;
+
+   if(first + 4 <= count)
+      return vload4(0, data + start + first);
+   value.s0 = (first < count) ? data[start + first] : INFINITY;
+   value.s1 = (first + 1 < count) ? data[start + first + 1] : INFINITY;
+   value.s2 = (first + 2 < count) ? data[start + first + 2] : INFINITY;
+   value.s3 = INFINITY;
+   return value;
+}
+
+/* Write a vector of a segment, dropping positions past its end */
+void store_segment(float4 value, __global float *data, uint start,
+                   uint count, uint index) {
+
+   uint first = index * 4;
+
+   if(first + 4 <= count) {
+      vstore4(value, 0, data + start + first);
+      return;
+   }
+   if(first < count) data[start + first] = value.s0;
+   if(first + 1 < count) data[start + first + 1] = value.s1;
+   if(first + 2 < count) data[start + first + 2] = value.s2;
+}
+
+/* Find the bin of a segment from its length. The host rejects
+   segments longer than the largest bin, and the bin is clamped so that
+   l_count is never indexed past its end */
+uint segment_bin(uint count) {
+
+   uint bin = 0, size = SMALL_SEGMENT;
+
+   while(size < count && bin < NUM_BINS - 1) {
+      size <<= 1;
+      bin++;
+   }
+   return bin;
+}
+
+/* Write the ID of every segment into its bin in one launch. Bin b takes
+   num_segments entries of segment_ids from b * num_segments, and
+   bin_counts, cleared by the host, serves as the cursor of each bin.
+   Each group reserves space in every bin once */
+__kernel void bin_segments(__global uint *offsets, uint num_segments,
+                           __global uint *bin_counts,
+                           __global uint *segment_ids) {
+
+   __local uint l_count[NUM_BINS], l_start[NUM_BINS];
+   uint lid = get_local_id(0), id = get_global_id(0);
+   uint bin = 0, slot = 0;
+
+   if(lid < NUM_BINS)
+      l_count[lid] = 0;
+   barrier(CLK_LOCAL_MEM_FENCE);
+
+   if(id < num_segments) {
+      bin = segment_bin(offsets[id+1] - offsets[id]);
+      slot = atomic_inc(&l_count[bin]);
+   }
+   barrier(CLK_LOCAL_MEM_FENCE);
+
+   if(lid < NUM_BINS)
+      l_start[lid] = lid * num_segments +
+            atomic_add(&bin_counts[lid], l_count[lid]);
+   barrier(CLK_LOCAL_MEM_FENCE);
+
+   if(id < num_segments)
+      segment_ids[l_start[bin] + slot] = id;
+}
+
+/* Sort each small segment in one work-item with the bsort8 network,
+   merging two sorted runs of eight into sixteen */
+__kernel void sort_small(__global float *data, __global uint *offsets,
+                         __global uint *segment_ids, uint first_id,
+                         uint num_ids) {
+
+   uint id, start, count;
+   float4 input1, input2, input3, input4, temp;
+   int4 comp;
+
+   uint4 mask1 = (uint4)(1, 0, 3, 2);
+   uint4 mask2 = (uint4)(2, 3, 0, 1);
+   uint4 mask3 = (uint4)(3, 2, 1, 0);
+
+   int4 add1 = (int4)(1, 1, 3, 3);
+   int4 add2 = (int4)(2, 3, 2, 3);
+   int4 add3 = (int4)(1, 2, 2, 3);
+   int4 add4 = (int4)(4, 5, 6, 7);
+
+   if(get_global_id(0) >= num_ids)
+      return;
+   id = segment_ids[first_id + get_global_id(0)];
+   start = offsets[id];
+   count = offsets[id+1] - start;
+
+   input1 = load_segment(data, start, count, 0);
+   input2 = load_segment(data, start, count, 1);
+   if(count <= 8) {
+      SORT_EIGHT(input1, input2, UP)
+   }
+   else {
+      input3 = load_segment(data, start, count, 2);
+      input4 = load_segment(data, start, count, 3);
+      SORT_EIGHT(input1, input2, UP)
+      SORT_EIGHT(input3, input4, DOWN)
+
+      /* Merge the bitonic set of sixteen */
+      SWAP_VECTORS(input1, input3, UP)
+      SWAP_VECTORS(input2, input4, UP)
+      SWAP_VECTORS(input1, input2, UP)
+      SWAP_VECTORS(input3, input4, UP)
+      SORT_VECTOR(input1, UP)
+      SORT_VECTOR(input2, UP)
+      SORT_VECTOR(input3, UP)
+      SORT_VECTOR(input4, UP)
+      store_segment(input3, data, start, count, 2);
+      store_segment(input4, data, start, count, 3);
+   }
+   store_segment(input1, data, start, count, 0);
+   store_segment(input2, data, start, count, 1);
+}
+
+/* Sort the 8 * team_size floats that a team holds two vectors per
+   work-item into ascending order in l_data, as bsort_init does for a
+   whole work-group */
+void sort_team(float4 input1, float4 input2, __local float4 *l_data,
+               uint tid, uint team_size) {
+
+   int dir;
+   uint id, size, stride;
+   float4 temp;
+   int4 comp;
+
+   uint4 mask1 = (uint4)(1, 0, 3, 2);
+   uint4 mask2 = (uint4)(2, 3, 0, 1);
+   uint4 mask3 = (uint4)(3, 2, 1, 0);
+
+   int4 add1 = (int4)(1, 1, 3, 3);
+   int4 add2 = (int4)(2, 3, 2, 3);
+   int4 add3 = (int4)(1, 2, 2, 3);
+   int4 add4 = (int4)(4, 5, 6, 7);
+
+   /* Sort eight elements, alternating directions across the team */
+   id = tid * 2;
+   dir = (tid & 1) * DOWN;
+   SORT_EIGHT(input1, input2, dir)
+   l_data[id] = input1;
+   l_data[id+1] = input2;
+
+   /* Create bitonic set */
+   for(size = 2; size <= team_size; size <<= 1) {
+      dir = (size == team_size) ? UP : ((tid/size) & 1) * DOWN;
+
+      for(stride = size; stride > 1; stride >>= 1) {
+         barrier(CLK_LOCAL_MEM_FENCE);
+         id = tid + (tid/stride)*stride;
+         SWAP_VECTORS(l_data[id], l_data[id + stride], dir)
+      }
+
+      barrier(CLK_LOCAL_MEM_FENCE);
+      id = tid * 2;
+      input1 = l_data[id]; input2 = l_data[id+1];
+      SWAP_VECTORS(input1, input2, dir)
+      SORT_VECTOR(input1, dir)
+      SORT_VECTOR(input2, dir)
+      l_data[id] = input1;
+      l_data[id+1] = input2;
+   }
+   barrier(CLK_LOCAL_MEM_FENCE);
+}
+
+/* Sort one segment per team of team_size work-items, taking the bin's
+   segment IDs from first_id. The work-group holds
+   get_local_size(0)/team_size teams, each with its own part of l_data,
+   and the largest bin uses the whole group as one team */
+__kernel void sort_teams(__global float *data, __global uint *offsets,
+                         __global uint *segment_ids, uint first_id,
+                         uint num_ids, uint team_size,
+                         __local float4 *l_data) {
+
+   uint team, tid, index, id, start = 0, count = 0;
+   __local float4 *l_team;
+   float4 input1, input2;
+
+   team = get_local_id(0)/team_size;
+   tid = get_local_id(0) % team_size;
+   index = get_group_id(0) * (get_local_size(0)/team_size) + team;
+   l_team = l_data + team * team_size * 2;
+
+   /* Teams past the last segment still take part in the barriers */
+   if(index < num_ids) {
+      id = segment_ids[first_id + index];
+      start = offsets[id];
+      count = offsets[id+1] - start;
+   }
+   input1 = load_segment(data, start, count, tid * 2);
+   input2 = load_segment(data, start, count, tid * 2 + 1);
+
+   sort_team(input1, input2, l_team, tid, team_size);
+   store_segment(l_team[tid * 2], data, start, count, tid * 2);
+   store_segment(l_team[tid * 2 + 1], data, start, count, tid * 2 + 1);
+}
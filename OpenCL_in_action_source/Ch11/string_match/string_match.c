@@ -0,0 +1,319 @@
+#define _CRT_SECURE_NO_WARNINGS
+#define PROGRAM_FILE "../string_search/string_search.cl"
+#define KERNEL_FUNC "string_match"
+#define TEXT_FILE "../string_search/kafka.txt"
+
+/* MATCH_CHARS must match string_search.cl. MAX_MATCHES is kept small so
+   the search is continued several times */
+#define MATCH_CHARS 8
+#define NO_MATCH 0xFFFFFFFF
+#define MAX_MATCHES 256
+#define OVERLAP 3
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef MAC
+#include <OpenCL/cl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+/* Find a GPU or CPU associated with the first available platform */
+cl_device_id create_device() {
+
+   cl_platform_id platform;
+   cl_device_id dev;
+   int err;
+
+   /* Identify a platform */
+   err = clGetPlatformIDs(1, &platform, NULL);
+   if(err < 0) {
+      perror("Couldn't identify a platform");
+      exit(1);
+   } 
+
+   /* Access a device */
+   err = clGetDeviceIDs(platform, CL_DEVICE_TYPE_GPU, 1, &dev, NULL);
+   if(err == CL_DEVICE_NOT_FOUND) {
+      err = clGetDeviceIDs(platform, CL_DEVICE_TYPE_CPU, 1, &dev, NULL);
+   }
+   if(err < 0) {
+      perror("Couldn't access any devices");
+      exit(1);   
+   }
+
+   return dev;
+}
+
+/* Create program from a file and compile it */
+cl_program build_program(cl_context ctx, cl_device_id dev, const char* filename) {
+
+   cl_program program;
+   FILE *program_handle;
+   char *program_buffer, *program_log;
+   size_t program_size, log_size;
+   int err;
+
+   /* Read program file and place content into buffer */
+   program_handle = fopen(filename, "r");
+   if(program_handle == NULL) {
+      perror("Couldn't find the program file");
+      exit(1);
+   }
+   fseek(program_handle, 0, SEEK_END);
+   program_size = ftell(program_handle);
+   rewind(program_handle);
+   program_buffer = (char*)malloc(program_size + 1);
+   program_buffer[program_size] = '\0';
+   fread(program_buffer, sizeof(char), program_size, program_handle);
+   fclose(program_handle);
+
+   /* Create program from file */
+   program = clCreateProgramWithSource(ctx, 1, 
+      (const char**)&program_buffer, &program_size, &err);
+   if(err < 0) {
+      perror("Couldn't create the program");
+      exit(1);
+   }
+   free(program_buffer);
+
+   /* Build program */
+   err = clBuildProgram(program, 0, NULL, NULL, NULL, NULL);
+   if(err < 0) {
+
+      /* Find size of log and print to std output */
+      clGetProgramBuildInfo(program, dev, CL_PROGRAM_BUILD_LOG, 
+            0, NULL, &log_size);
+      program_log = (char*) malloc(log_size + 1);
+      program_log[log_size] = '\0';
+      clGetProgramBuildInfo(program, dev, CL_PROGRAM_BUILD_LOG, 
+            log_size + 1, program_log, NULL);
+      printf("%s\n", program_log);
+      free(program_log);
+      exit(1);
+   }
+
+   return program;
+}
+
+/* Return the elapsed time of an event in nanoseconds */
+cl_ulong event_time(cl_event event) {
+
+   cl_ulong time_start, time_end;
+
+   clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_START,
+         sizeof(time_start), &time_start, NULL);
+   clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_END,
+         sizeof(time_end), &time_end, NULL);
+   clReleaseEvent(event);
+   return time_end - time_start;
+}
+
+/* Order matches by offset for qsort */
+int compare_matches(const void* a, const void* b) {
+
+   const cl_uint *match_a = (const cl_uint*)a, *match_b = (const cl_uint*)b;
+   return (match_a[0] > match_b[0]) - (match_a[0] < match_b[0]);
+}
+
+int main(int argc, char** argv) {
+
+   /* OpenCL structures */
+   cl_device_id device;
+   cl_context context;
+   cl_program program;
+   cl_kernel kernel;
+   cl_command_queue queue;
+   cl_event prof_event;
+   cl_int i, j, err, check, launches;
+   size_t local_size, max_local_size, global_size;
+   cl_ulong local_mem_size, total_time;
+
+   /* Data and buffers */
+   char pattern[16] = {'t','h','a','t','w','i','t','h',
+         'h','a','v','e','f','r','o','m'};
+   const char *text_name;
+   FILE *text_handle;
+   char *text;
+   cl_uint *matches, *found, *check_matches, state[2], tile_size, 
+         max_matches, num_found, num_checked, read_count;
+   int text_size, cursor;
+   cl_mem text_buffer, matches_buffer, state_buffer;
+
+   /* Read text file and place content into buffer, followed by OVERLAP
+      characters of padding */
+   text_name = argc > 1 ? argv[1] : TEXT_FILE;
+   text_handle = fopen(text_name, "rb");
+   if(text_handle == NULL) {
+      perror("Couldn't find the text file");
+      exit(1);
+   }
+   fseek(text_handle, 0, SEEK_END);
+   text_size = ftell(text_handle);
+   rewind(text_handle);
+   text = (char*)calloc(text_size + OVERLAP, sizeof(char));
+   fread(text, sizeof(char), text_size, text_handle);
+   fclose(text_handle);
+
+   /* Create device and context */
+   device = create_device();
+   err = clGetDeviceInfo(device, CL_DEVICE_LOCAL_MEM_SIZE, 
+         sizeof(local_mem_size), &local_mem_size, NULL);
+   if(err < 0) {
+      perror("Couldn't obtain device information");
+      exit(1);   
+   }
+   context = clCreateContext(NULL, 1, &device, NULL, NULL, &err);
+   if(err < 0) {
+      perror("Couldn't create a context");
+      exit(1);   
+   }
+
+   /* Build program and create a kernel */
+   program = build_program(context, device, PROGRAM_FILE);
+   kernel = clCreateKernel(program, KERNEL_FUNC, &err);
+   if(err < 0) {
+      perror("Couldn't create a kernel");
+      exit(1);
+   };
+   err = clGetKernelWorkGroupInfo(kernel, device, 
+         CL_KERNEL_WORK_GROUP_SIZE, sizeof(local_size), &local_size, NULL);
+   if(err < 0) {
+      perror("Couldn't obtain device information");
+      exit(1);   
+   }
+
+   /* Each work-item needs room for MATCH_CHARS matches in local memory,
+      next to the group's count and base */
+   max_local_size = (size_t)((local_mem_size - 2 * sizeof(cl_uint))/
+         (MATCH_CHARS * 2 * sizeof(cl_uint)));
+   if(local_size > max_local_size)
+      local_size = max_local_size;
+
+   /* Group 0 owns the first tile_size entries, and every launch must 
+      have room for at least one more group */
+   tile_size = (cl_uint)local_size * MATCH_CHARS;
+   max_matches = MAX_MATCHES;
+   if(max_matches < 2 * tile_size)
+      max_matches = 2 * tile_size;
+   matches = (cl_uint*) malloc(max_matches * 2 * sizeof(cl_uint));
+   found = (cl_uint*) malloc((text_size + 1) * 2 * sizeof(cl_uint));
+   check_matches = (cl_uint*) malloc((text_size + 1) * 2 * sizeof(cl_uint));
+
+   /* Create buffers */
+   text_buffer = clCreateBuffer(context, CL_MEM_READ_ONLY |
+         CL_MEM_COPY_HOST_PTR, text_size + OVERLAP, text, &err);
+   matches_buffer = clCreateBuffer(context, CL_MEM_WRITE_ONLY, 
+         max_matches * 2 * sizeof(cl_uint), NULL, &err);
+   state_buffer = clCreateBuffer(context, CL_MEM_READ_WRITE, 
+         sizeof(state), NULL, &err);
+   if(err < 0) {
+      perror("Couldn't create a buffer");
+      exit(1);   
+   };
+
+   /* Create kernel arguments that don't change between launches */
+   err = clSetKernelArg(kernel, 0, sizeof(pattern), pattern);
+   err |= clSetKernelArg(kernel, 1, sizeof(cl_mem), &text_buffer);
+   err |= clSetKernelArg(kernel, 3, sizeof(int), &text_size);
+   err |= clSetKernelArg(kernel, 4, tile_size * 2 * sizeof(cl_uint), NULL);
+   err |= clSetKernelArg(kernel, 5, sizeof(cl_mem), &matches_buffer);
+   err |= clSetKernelArg(kernel, 6, sizeof(cl_uint), &max_matches);
+   err |= clSetKernelArg(kernel, 7, sizeof(cl_mem), &state_buffer);
+   if(err < 0) {
+      perror("Couldn't create a kernel argument");
+      exit(1);   
+   };
+
+   /* Create a command queue */
+   queue = clCreateCommandQueue(context, device, 
+         CL_QUEUE_PROFILING_ENABLE, &err);
+   if(err < 0) {
+      perror("Couldn't create a command queue");
+      exit(1);   
+   };
+
+   /* Search from the cursor until the whole text has been searched */
+   cursor = 0;
+   num_found = 0;
+   launches = 0;
+   total_time = 0;
+   while(cursor < text_size) {
+      state[0] = tile_size;
+      state[1] = (cl_uint)text_size;
+      global_size = (text_size - cursor + tile_size - 1)/tile_size * 
+            local_size;
+      err = clEnqueueWriteBuffer(queue, state_buffer, CL_FALSE, 0, 
+            sizeof(state), state, 0, NULL, NULL);
+      err |= clSetKernelArg(kernel, 2, sizeof(int), &cursor);
+      err |= clEnqueueNDRangeKernel(queue, kernel, 1, NULL, &global_size, 
+            &local_size, 0, NULL, &prof_event);
+      if(err < 0) {
+         perror("Couldn't enqueue the kernel");
+         exit(1);   
+      }
+      err = clEnqueueReadBuffer(queue, state_buffer, CL_TRUE, 0, 
+            sizeof(state), state, 0, NULL, NULL);
+      read_count = state[0] < max_matches ? state[0] : max_matches;
+      err |= clEnqueueReadBuffer(queue, matches_buffer, CL_TRUE, 0, 
+            read_count * 2 * sizeof(cl_uint), matches, 0, NULL, NULL);
+      if(err < 0) {
+         perror("Couldn't read the buffer");
+         exit(1);   
+      }
+      total_time += event_time(prof_event);
+      launches++;
+
+      /* Keep the matches before the continuation cursor. The rest are
+         found again by the next launch */
+      for(j=0; j<(cl_int)read_count; j++) {
+         if(matches[j*2] < state[1]) {
+            found[num_found*2] = matches[j*2];
+            found[num_found*2 + 1] = matches[j*2 + 1];
+            num_found++;
+         }
+      }
+      cursor = (int)state[1];
+   }
+   qsort(found, num_found, 2 * sizeof(cl_uint), compare_matches);
+
+   /* Check the matches on the host. Each position reports the first
+      word that matches there */
+   num_checked = 0;
+   for(i=0; i<text_size; i++) {
+      for(j=0; j<4; j++) {
+         if(memcmp(text + i, pattern + j*4, 4) == 0) {
+            check_matches[num_checked*2] = i;
+            check_matches[num_checked*2 + 1] = j;
+            num_checked++;
+            break;
+         }
+      }
+   }
+   check = (num_found == num_checked) && memcmp(found, check_matches, 
+         num_found * 2 * sizeof(cl_uint)) == 0;
+
+   printf("Found %u matches in %d launches with room for %u matches\n", 
+         num_found, launches, max_matches);
+   for(i=0; i<5 && i<(cl_int)num_found; i++) {
+      printf("Offset %u: '%.4s'\n", found[i*2], pattern + found[i*2 + 1]*4);
+   }
+   printf("%s\n", check ? "Check passed." : "Check failed.");
+   printf("Search time = %lu\n", total_time);
+
+   /* Deallocate resources */
+   clReleaseMemObject(text_buffer);
+   clReleaseMemObject(matches_buffer);
+   clReleaseMemObject(state_buffer);
+   clReleaseKernel(kernel);
+   clReleaseCommandQueue(queue);
+   clReleaseProgram(program);
+   clReleaseContext(context);
+   free(text);
+   free(matches);
+   free(found);
+   free(check_matches);
+   return 0;
+}
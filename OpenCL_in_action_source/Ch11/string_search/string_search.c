@@ -1,11 +1,31 @@
 #define _CRT_SECURE_NO_WARNINGS
+#define _POSIX_C_SOURCE 200112L
+#define _FILE_OFFSET_BITS 64
 #define PROGRAM_FILE "string_search.cl"
 #define KERNEL_FUNC "string_search"
+#define ATOMIC_FUNC "string_search_atomic"
 #define TEXT_FILE "kafka.txt"
 
+/* Files are searched in chunks of CHUNK_SIZE characters. Each chunk is
+   uploaded with the first OVERLAP characters of the next: the length of
+   the longest pattern minus one, and one more for the whole-word check */
+#define CHUNK_SIZE 67108864
+#define OVERLAP 4
+#define NUM_MODES 4
+
+#include <ctype.h>
+#include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
+
+#ifdef UNIX
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 #ifdef MAC
 #include <OpenCL/cl.h>
@@ -13,33 +33,13 @@
 #include <CL/cl.h>
 #endif
 
-int main() {
+/* Find a GPU or CPU associated with the first available platform */
+cl_device_id create_device() {
 
-   /* Host/device data structures */
    cl_platform_id platform;
-   cl_device_id device;
-   cl_context context;
-   cl_command_queue queue;
-   cl_int err;
-
-   /* Program/kernel data structures */
-   cl_program program;
-   FILE *program_handle;
-   char *program_buffer, *program_log;
-   size_t program_size, log_size;
-   cl_kernel kernel;
-   size_t offset = 0;
-   size_t global_size, local_size;
+   cl_device_id dev;
+   int err;
 
-   /* Data and buffers */
-   char pattern[16] = "thatwithhavefrom";
-   FILE *text_handle;
-   char *text;
-   size_t text_size;
-   int chars_per_item;
-   int result[4] = {0, 0, 0, 0};
-   cl_mem text_buffer, result_buffer;
-   
    /* Identify a platform */
    err = clGetPlatformIDs(1, &platform, NULL);
    if(err < 0) {
@@ -48,28 +48,30 @@ int main() {
    } 
 
    /* Access a device */
-   err = clGetDeviceIDs(platform, CL_DEVICE_TYPE_GPU, 1, &device, NULL);
+   err = clGetDeviceIDs(platform, CL_DEVICE_TYPE_GPU, 1, &dev, NULL);
+   if(err == CL_DEVICE_NOT_FOUND) {
+      err = clGetDeviceIDs(platform, CL_DEVICE_TYPE_CPU, 1, &dev, NULL);
+   }
    if(err < 0) {
       perror("Couldn't access any devices");
       exit(1);   
    }
 
-   /* Determine global size and local size */
-   clGetDeviceInfo(device, CL_DEVICE_MAX_COMPUTE_UNITS, 		
-      sizeof(global_size), &global_size, NULL);	
-   clGetDeviceInfo(device, CL_DEVICE_MAX_WORK_GROUP_SIZE, 		
-      sizeof(local_size), &local_size, NULL);
-   global_size *= local_size;
+   return dev;
+}
 
-   /* Create a context */
-   context = clCreateContext(NULL, 1, &device, NULL, NULL, &err);
-   if(err < 0) {
-      perror("Couldn't create a context");
-      exit(1);   
-   }
+/* Create program from a file and compile it */
+cl_program build_program(cl_context ctx, cl_device_id dev, const char* filename,
+      const char* options) {
+
+   cl_program program;
+   FILE *program_handle;
+   char *program_buffer, *program_log;
+   size_t program_size, log_size;
+   int err;
 
    /* Read program file and place content into buffer */
-   program_handle = fopen(PROGRAM_FILE, "r");
+   program_handle = fopen(filename, "r");
    if(program_handle == NULL) {
       perror("Couldn't find the program file");
       exit(1);
@@ -77,26 +79,13 @@ int main() {
    fseek(program_handle, 0, SEEK_END);
    program_size = ftell(program_handle);
    rewind(program_handle);
-   program_buffer = (char*)calloc(program_size+1, sizeof(char));
+   program_buffer = (char*)malloc(program_size + 1);
+   program_buffer[program_size] = '\0';
    fread(program_buffer, sizeof(char), program_size, program_handle);
    fclose(program_handle);
 
-   /* Read text file and place content into buffer */
-   text_handle = fopen(TEXT_FILE, "r");
-   if(text_handle == NULL) {
-      perror("Couldn't find the text file");
-      exit(1);
-   }
-   fseek(text_handle, 0, SEEK_END);
-   text_size = ftell(text_handle)-1;
-   rewind(text_handle);
-   text = (char*)calloc(text_size, sizeof(char));
-   fread(text, sizeof(char), text_size, text_handle);
-   fclose(text_handle);
-   chars_per_item = text_size / global_size + 1;
-
    /* Create program from file */
-   program = clCreateProgramWithSource(context, 1, 
+   program = clCreateProgramWithSource(ctx, 1, 
       (const char**)&program_buffer, &program_size, &err);
    if(err < 0) {
       perror("Couldn't create the program");
@@ -105,84 +94,416 @@ int main() {
    free(program_buffer);
 
    /* Build program */
-   err = clBuildProgram(program, 0, NULL, NULL, NULL, NULL);
+   err = clBuildProgram(program, 0, NULL, options, NULL, NULL);
    if(err < 0) {
-            
+
       /* Find size of log and print to std output */
-      clGetProgramBuildInfo(program, device, CL_PROGRAM_BUILD_LOG, 
+      clGetProgramBuildInfo(program, dev, CL_PROGRAM_BUILD_LOG, 
             0, NULL, &log_size);
-      program_log = (char*) calloc(log_size+1, sizeof(char));
-      clGetProgramBuildInfo(program, device, CL_PROGRAM_BUILD_LOG, 
-            log_size+1, program_log, NULL);
+      program_log = (char*) malloc(log_size + 1);
+      program_log[log_size] = '\0';
+      clGetProgramBuildInfo(program, dev, CL_PROGRAM_BUILD_LOG, 
+            log_size + 1, program_log, NULL);
       printf("%s\n", program_log);
       free(program_log);
       exit(1);
    }
 
-   /* Create a kernel */
-   kernel = clCreateKernel(program, KERNEL_FUNC, &err);
-   if(err < 0) {
-      perror("Couldn't create a kernel");
+   return program;
+}
+
+/* Read the wall clock in nanoseconds */
+unsigned long long wall_time_ns(void) {
+
+#ifdef UNIX
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#else
+   return (unsigned long long)(1.0e9 * clock()/CLOCKS_PER_SEC);
+#endif
+}
+
+/* A text file read in chunks, through a mapping where available */
+typedef struct text_file {
+   cl_ulong size;
+   int num_chunks;
+   char *buffers[2];
+#ifdef UNIX
+   int fd;
+   const char *mapping;
+#else
+   FILE *handle;
+#endif
+} text_file;
+
+void open_text(text_file *file, const char *name) {
+
+   FILE *handle;
+#ifdef UNIX
+   struct stat file_stat;
+#endif
+
+   handle = fopen(name, "rb");
+   if(handle == NULL) {
+      perror("Couldn't find the text file");
       exit(1);
-   };
+   }
+#ifdef UNIX
+   fclose(handle);
+   file->fd = open(name, O_RDONLY);
+   if(file->fd < 0 || fstat(file->fd, &file_stat) < 0) {
+      perror("Couldn't open the text file");
+      exit(1);
+   }
+   file->size = file_stat.st_size;
+   file->mapping = (const char*) mmap(NULL, file->size, PROT_READ, 
+         MAP_PRIVATE, file->fd, 0);
+   if(file->mapping == MAP_FAILED) {
+      perror("Couldn't map the text file");
+      exit(1);
+   }
+   posix_madvise((void*)file->mapping, file->size, POSIX_MADV_SEQUENTIAL);
+#else
+   file->handle = handle;
+   fseek(handle, 0, SEEK_END);
+   file->size = ftell(handle);
+   rewind(handle);
+#endif
+   file->num_chunks = (int)((file->size + CHUNK_SIZE - 1)/CHUNK_SIZE);
+   file->buffers[0] = (char*) malloc(CHUNK_SIZE + OVERLAP + 1);
+   file->buffers[1] = (char*) malloc(CHUNK_SIZE + OVERLAP + 1);
+}
+
+/* Find the characters of a chunk, the readable characters after them
+   and the character before them, and return a pointer to the chunk.
+   Without a mapping, chunks alternate between the two buffers so one
+   can be read while the other is being written to the device */
+const char* read_chunk(text_file *file, int chunk, int *num_chars, 
+      int *readable, char *previous) {
+
+   cl_ulong offset = (cl_ulong)chunk * CHUNK_SIZE;
+   int before = (offset > 0);
+
+   *num_chars = (int)(file->size - offset < CHUNK_SIZE ? 
+         file->size - offset : CHUNK_SIZE);
+   *readable = (int)(file->size - offset < CHUNK_SIZE + OVERLAP ? 
+         file->size - offset : CHUNK_SIZE + OVERLAP);
+#ifdef UNIX
+   *previous = before ? file->mapping[offset - 1] : 0;
+   return file->mapping + offset;
+#else
+   fseek(file->handle, (long)(offset - before), SEEK_SET);
+   fread(file->buffers[chunk%2], sizeof(char), *readable + before, 
+         file->handle);
+   *previous = before ? file->buffers[chunk%2][0] : 0;
+   return file->buffers[chunk%2] + before;
+#endif
+}
+
+void close_text(text_file *file) {
+
+#ifdef UNIX
+   munmap((void*)file->mapping, file->size);
+   close(file->fd);
+#else
+   fclose(file->handle);
+#endif
+   free(file->buffers[0]);
+   free(file->buffers[1]);
+}
+
+/* Search the file with a kernel whose pattern and local memory are set.
+   Each chunk is uploaded while the device searches the previous one, 
+   and the counts of both slots are added into result. Returns the wall
+   time in nanoseconds */
+unsigned long long stream_search(text_file *file, cl_command_queue *queues,
+      cl_kernel kernel, cl_mem *text_mems, cl_mem *result_mems, 
+      size_t global_size, size_t local_size, int *result) {
+
+   static const char zeros[OVERLAP] = {0};
+   unsigned long long start;
+   const char *source;
+   int i, j, slot, err, num_chars, readable, chars_per_item, 
+         results[4] = {0, 0, 0, 0};
+   char previous;
+
+   for(slot=0; slot<2; slot++) {
+      err = clEnqueueWriteBuffer(queues[slot], result_mems[slot], CL_TRUE,
+            0, sizeof(results), results, 0, NULL, NULL);
+      if(err < 0) {
+         perror("Couldn't write the buffer");
+         exit(1);   
+      }
+   }
+
+   start = wall_time_ns();
+   for(i=0; i<=file->num_chunks; i++) {
+
+      /* Start the next chunk */
+      if(i < file->num_chunks) {
+         slot = i%2;
+         source = read_chunk(file, i, &num_chars, &readable, &previous);
+         err = clEnqueueWriteBuffer(queues[slot], text_mems[slot], 
+               CL_FALSE, 0, readable, source, 0, NULL, NULL);
+
+         /* Pad the end of the file so it can't match */
+         if(readable < num_chars + OVERLAP)
+            err |= clEnqueueWriteBuffer(queues[slot], text_mems[slot], 
+                  CL_FALSE, readable, num_chars + OVERLAP - readable, 
+                  zeros, 0, NULL, NULL);
+         if(err < 0) {
+            perror("Couldn't write the buffer");
+            exit(1);   
+         }
+
+         chars_per_item = (int)((num_chars + global_size - 1)/global_size);
+         err = clSetKernelArg(kernel, 1, sizeof(cl_mem), &text_mems[slot]);
+         err |= clSetKernelArg(kernel, 2, sizeof(int), &chars_per_item);
+         err |= clSetKernelArg(kernel, 3, sizeof(int), &num_chars);
+         err |= clSetKernelArg(kernel, 5, sizeof(cl_mem), &result_mems[slot]);
+         err |= clSetKernelArg(kernel, 6, sizeof(char), &previous);
+         if(err < 0) {
+            perror("Couldn't create a kernel argument");
+            exit(1);   
+         };
+         err = clEnqueueNDRangeKernel(queues[slot], kernel, 1, NULL, 
+               &global_size, &local_size, 0, NULL, NULL); 
+         if(err < 0) {
+            perror("Couldn't enqueue the kernel");
+            printf("Error code: %d\n", err);
+            exit(1);   
+         }
+         clFlush(queues[slot]);
+      }
+
+      /* Finish the previous chunk before its buffer is reused */
+      if(i > 0)
+         clFinish(queues[(i-1)%2]);
+   }
+   start = wall_time_ns() - start;
+
+   /* Read and combine the results of both slots */
+   for(j=0; j<4; j++) {
+      result[j] = 0;
+   }
+   for(slot=0; slot<2; slot++) {
+      err = clEnqueueReadBuffer(queues[slot], result_mems[slot], CL_TRUE, 
+            0, sizeof(results), results, 0, NULL, NULL);
+      if(err < 0) {
+         perror("Couldn't read the buffer");
+         exit(1);   
+      }
+      for(j=0; j<4; j++) {
+         result[j] += results[j];
+      }
+   }
+   return start;
+}
+
+/* Check for a letter or digit, as IS_WORD does */
+int is_word(char c) {
+   return (unsigned char)c < 128 && isalnum((unsigned char)c);
+}
+
+/* Count the patterns in the file on the host */
+void host_search(text_file *file, const char *pattern, int ignore_case,
+      int whole_word, int *result) {
+
+   const char *text;
+   char previous;
+   int i, j, k, l, num_chars, readable;
+
+   for(j=0; j<4; j++) {
+      result[j] = 0;
+   }
+   for(i=0; i<file->num_chunks; i++) {
+      text = read_chunk(file, i, &num_chars, &readable, &previous);
+      for(k=0; k<num_chars && k + 4 <= readable; k++) {
+         if(whole_word && ((k > 0 ? is_word(text[k-1]) : is_word(previous))
+               || (k + 4 < readable && is_word(text[k+4]))))
+            continue;
+         for(j=0; j<4; j++) {
+            for(l=0; l<4; l++) {
+               if(ignore_case ? tolower((unsigned char)text[k+l]) != 
+                     pattern[j*4 + l] : text[k+l] != pattern[j*4 + l])
+                  break;
+            }
+            if(l == 4)
+               result[j]++;
+         }
+      }
+   }
+}
+
+int main(int argc, char** argv) {
+
+   /* Host/device data structures */
+   cl_device_id device;
+   cl_context context;
+   cl_command_queue queues[2];
+   cl_int i, j, err, slot, check;
+
+   /* Program/kernel data structures */
+   cl_program program, mode_programs[NUM_MODES];
+   cl_kernel kernel, atomic_kernel, mode_kernels[NUM_MODES];
+   size_t global_size, local_size;
+   cl_uint compute_units;
+   unsigned long long search_time, atomic_time;
+   const char *modes[NUM_MODES] = {"", "-DIGNORE_CASE", "-DWHOLE_WORD",
+         "-DIGNORE_CASE -DWHOLE_WORD"};
+
+   /* Data and buffers. The second set of patterns is common in English 
+      text, so the local atomics of string_search_atomic collide often */
+   char patterns[2][16] = {{'t','h','a','t','w','i','t','h',
+         'h','a','v','e','f','r','o','m'},
+         {'t','h','e',' ',' ','t','h','e','a','n','d',' ',
+         'i','n','g',' '}};
+   text_file file;
+   int result[4], atomic_result[4], check_result[4];
+   cl_mem text_mems[2], result_mems[2];
 
-   /* Create buffers to hold the text characters and count */
-   text_buffer = clCreateBuffer(context, CL_MEM_READ_ONLY |
-         CL_MEM_COPY_HOST_PTR, text_size, text, &err);
+   /* Open the text file */
+   open_text(&file, argc > 1 ? argv[1] : TEXT_FILE);
+
+   /* Create device and context */
+   device = create_device();
+   err = clGetDeviceInfo(device, CL_DEVICE_MAX_COMPUTE_UNITS, 
+         sizeof(compute_units), &compute_units, NULL);
    if(err < 0) {
-      perror("Couldn't create a buffer");
+      perror("Couldn't obtain device information");
       exit(1);   
-   };
-   result_buffer = clCreateBuffer(context, CL_MEM_READ_WRITE |
-         CL_MEM_COPY_HOST_PTR, sizeof(result), result, NULL);
-
-   /* Create kernel argument */
-   err = clSetKernelArg(kernel, 0, sizeof(pattern), pattern);
-   err |= clSetKernelArg(kernel, 1, sizeof(cl_mem), &text_buffer);
-   err |= clSetKernelArg(kernel, 2, sizeof(chars_per_item), &chars_per_item);
-   err |= clSetKernelArg(kernel, 3, 4 * sizeof(int), NULL);
-   err |= clSetKernelArg(kernel, 4, sizeof(cl_mem), &result_buffer);
+   }
+   context = clCreateContext(NULL, 1, &device, NULL, NULL, &err);
    if(err < 0) {
-      printf("Couldn't set a kernel argument");
+      perror("Couldn't create a context");
       exit(1);   
-   };
+   }
 
-   /* Create a command queue */
-   queue = clCreateCommandQueue(context, device, 0, &err);
+   /* Build program and create kernels */
+   program = build_program(context, device, PROGRAM_FILE, NULL);
+   kernel = clCreateKernel(program, KERNEL_FUNC, &err);
    if(err < 0) {
-      perror("Couldn't create a command queue");
-      exit(1);   
+      perror("Couldn't create a kernel");
+      exit(1);
    };
-
-   /* Enqueue kernel */
-   err = clEnqueueNDRangeKernel(queue, kernel, 1, &offset, &global_size, 
-         &local_size, 0, NULL, NULL); 
+   atomic_kernel = clCreateKernel(program, ATOMIC_FUNC, &err);
    if(err < 0) {
-      perror("Couldn't enqueue the kernel");
-      printf("Error code: %d\n", err);
-      exit(1);   
+      perror("Couldn't create a kernel");
+      exit(1);
+   };
+   for(i=0; i<NUM_MODES; i++) {
+      mode_programs[i] = build_program(context, device, PROGRAM_FILE, 
+            modes[i]);
+      mode_kernels[i] = clCreateKernel(mode_programs[i], KERNEL_FUNC, &err);
+      if(err < 0) {
+         perror("Couldn't create a kernel");
+         exit(1);
+      };
    }
 
-   /* Read and print the result */
-   err = clEnqueueReadBuffer(queue, result_buffer, CL_TRUE, 0, 
-      sizeof(result), &result, 0, NULL, NULL);
+   /* Determine global size and a power-of-two local size */
+   err = clGetKernelWorkGroupInfo(kernel, device, 
+         CL_KERNEL_WORK_GROUP_SIZE, sizeof(local_size), &local_size, NULL);
    if(err < 0) {
-      perror("Couldn't read the buffer");
+      perror("Couldn't obtain device information");
       exit(1);   
    }
+   local_size = (size_t)pow(2, trunc(log2(local_size)));
+   global_size = compute_units * local_size;
+
+   /* Create a queue and buffers for each of the two chunks in flight */
+   for(slot=0; slot<2; slot++) {
+      queues[slot] = clCreateCommandQueue(context, device, 0, &err);
+      if(err < 0) {
+         perror("Couldn't create a command queue");
+         exit(1);   
+      };
+      text_mems[slot] = clCreateBuffer(context, CL_MEM_READ_ONLY, 
+            CHUNK_SIZE + OVERLAP, NULL, &err);
+      result_mems[slot] = clCreateBuffer(context, CL_MEM_READ_WRITE, 
+            sizeof(result), NULL, &err);
+      if(err < 0) {
+         perror("Couldn't create a buffer");
+         exit(1);   
+      };
+   }
 
-   printf("\nResults: \n");
-   printf("Number of occurrences of 'that': %d\n", result[0]);
-   printf("Number of occurrences of 'with': %d\n", result[1]);
-   printf("Number of occurrences of 'have': %d\n", result[2]);
-   printf("Number of occurrences of 'from': %d\n", result[3]);
+   /* Search for both sets of patterns with both kernels */
+   check = 1;
+   for(i=0; i<2; i++) {
+      err = clSetKernelArg(kernel, 0, sizeof(patterns[i]), patterns[i]);
+      err |= clSetKernelArg(kernel, 4, local_size * 4 * sizeof(int), NULL);
+      err |= clSetKernelArg(atomic_kernel, 0, sizeof(patterns[i]), 
+            patterns[i]);
+      err |= clSetKernelArg(atomic_kernel, 4, 4 * sizeof(int), NULL);
+      if(err < 0) {
+         perror("Couldn't create a kernel argument");
+         exit(1);   
+      };
+      search_time = stream_search(&file, queues, kernel, text_mems, 
+            result_mems, global_size, local_size, result);
+      atomic_time = stream_search(&file, queues, atomic_kernel, text_mems, 
+            result_mems, global_size, local_size, atomic_result);
+      host_search(&file, patterns[i], 0, 0, check_result);
+
+      printf("\nResults: \n");
+      for(j=0; j<4; j++) {
+         printf("Number of occurrences of '%.4s': %d\n", 
+               patterns[i] + j*4, result[j]);
+         if(result[j] != check_result[j] || 
+               atomic_result[j] != check_result[j])
+            check = 0;
+      }
+      printf("Private counters: %.3f GB/s, local atomics: %.3f GB/s, "
+            "speedup %.2f\n", (double)file.size/search_time, 
+            (double)file.size/atomic_time, (double)atomic_time/search_time);
+   }
+
+   /* Search for the first set of patterns in each mode */
+   printf("\n%-28s%11s%11s%11s%11s%9s\n", "Mode", "that", "with", "have",
+         "from", "GB/s");
+   for(i=0; i<NUM_MODES; i++) {
+      err = clSetKernelArg(mode_kernels[i], 0, sizeof(patterns[0]), 
+            patterns[0]);
+      err |= clSetKernelArg(mode_kernels[i], 4, 
+            local_size * 4 * sizeof(int), NULL);
+      if(err < 0) {
+         perror("Couldn't create a kernel argument");
+         exit(1);   
+      };
+      search_time = stream_search(&file, queues, mode_kernels[i], 
+            text_mems, result_mems, global_size, local_size, result);
+      host_search(&file, patterns[0], strstr(modes[i], "IGNORE_CASE") != 
+            NULL, strstr(modes[i], "WHOLE_WORD") != NULL, check_result);
+      printf("%-28s%11d%11d%11d%11d%9.3f\n", i ? modes[i] : "(none)", 
+            result[0], result[1], result[2], result[3], 
+            (double)file.size/search_time);
+      for(j=0; j<4; j++) {
+         if(result[j] != check_result[j])
+            check = 0;
+      }
+   }
+
+   printf("\nSearched %llu bytes in %d chunks\n", 
+         (unsigned long long)file.size, file.num_chunks);
+   printf("%s\n", check ? "Check passed." : "Check failed.");
 
    /* Deallocate resources */
-   clReleaseMemObject(result_buffer);
-   clReleaseMemObject(text_buffer);
+   for(slot=0; slot<2; slot++) {
+      clReleaseMemObject(result_mems[slot]);
+      clReleaseMemObject(text_mems[slot]);
+      clReleaseCommandQueue(queues[slot]);
+   }
+   for(i=0; i<NUM_MODES; i++) {
+      clReleaseKernel(mode_kernels[i]);
+      clReleaseProgram(mode_programs[i]);
+   }
    clReleaseKernel(kernel);
-   clReleaseCommandQueue(queue);
+   clReleaseKernel(atomic_kernel);
    clReleaseProgram(program);
    clReleaseContext(context);
+   close_text(&file);
    return 0;
 }
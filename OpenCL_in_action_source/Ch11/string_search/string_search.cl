@@ -1,48 +1,132 @@
-__kernel void string_search(char16 pattern, __global char* text,
-     int chars_per_item, __local int* local_result, 
-     __global int* global_result) {
+/* Search modes are chosen at build time. -DIGNORE_CASE folds ASCII
+   letters to lower case and -DWHOLE_WORD only counts matches with no
+   letter or digit on either side */
+#define FOLD(v) ((v) | (((v) >= 'A') & ((v) <= 'Z') & 0x20))
+#define IS_WORD(v) ((((v) | 0x20) >= 'a' & ((v) | 0x20) <= 'z') | \
+                    ((v) >= '0' & (v) <= '9'))
+
+/* Return 1 in each lane of the result whose pattern starts at i. before
+   is the character before i */
+int4 find_words(char16 pattern, __global char* text, int i, char before) {
 
+   char4 text_word;
    char16 text_vector, check_vector;
+   int boundary = 1;
+
+   /* load the four characters at i into every part of the vector */
+   text_word = vload4(0, text + i);
+   text_vector = (char16)(text_word, text_word, text_word, text_word);
+#ifdef IGNORE_CASE
+   text_vector = FOLD(text_vector);
+#endif
+
+   /* compare text vector and pattern */
+   check_vector = text_vector == pattern;
+
+#ifdef WHOLE_WORD
+   boundary = !any(IS_WORD((char2)(before, text[i + 4])));
+#endif
+
+   return (int4)(all(check_vector.s0123), all(check_vector.s4567),
+         all(check_vector.s89AB), all(check_vector.sCDEF)) & boundary;
+}
+
+/* Each match is counted by the work-item holding its first character.
+   Only the first num_chars characters are searched, and the text must
+   hold four readable characters past them: the overlap with the next
+   chunk, or padding at the end of the file. previous is the character
+   before the chunk, or 0 at the start of the file.
+
+   Every work-item counts in private memory. The counts are combined with
+   a tree reduction in local_result, which holds one int4 per work-item,
+   and each group adds them to global_result with one atomic per pattern.
+   The local size must be a power of two */
+__kernel void string_search(char16 pattern, __global char* text,
+     int chars_per_item, int num_chars, __local int4* local_result, 
+     __global int* global_result, char previous) {
+
+   int4 count = (int4)(0);
+   uint lid = get_local_id(0);
+   char before;
+
+   int item_offset = min((int)get_global_id(0) * chars_per_item, num_chars);
+   int item_end = min(item_offset + chars_per_item, num_chars);
+
+#ifdef IGNORE_CASE
+   pattern = FOLD(pattern);
+#endif
+   before = (item_offset > 0) ? text[item_offset - 1] : previous;
+
+   /* Count 'that', 'with', 'have' and 'from' */
+   for(int i=item_offset; i<item_end; i++) {
+      count += find_words(pattern, text, i, before);
+#ifdef WHOLE_WORD
+      before = text[i];
+#endif
+   }
+
+   /* Add the counts of the group */
+   local_result[lid] = count;
+   for(uint stride = get_local_size(0)/2; stride > 0; stride >>= 1) {
+      barrier(CLK_LOCAL_MEM_FENCE);
+      if(lid < stride)
+         local_result[lid] += local_result[lid + stride];
+   }
+
+   /* Perform global reduction */
+   if(lid == 0) {
+      count = local_result[0];
+      atomic_add(global_result, count.s0);
+      atomic_add(global_result + 1, count.s1);
+      atomic_add(global_result + 2, count.s2);
+      atomic_add(global_result + 3, count.s3);
+   }
+}
+
+/* The same search with every match counted by a local atomic, which
+   serializes the work-items on frequent patterns. local_result holds
+   four ints */
+__kernel void string_search_atomic(char16 pattern, __global char* text,
+     int chars_per_item, int num_chars, __local int* local_result, 
+     __global int* global_result, char previous) {
+
+   int4 found;
+   char before;
 
    /* initialize local data */
-   local_result[0] = 0;
-   local_result[1] = 0;
-   local_result[2] = 0;
-   local_result[3] = 0;
+   if(get_local_id(0) < 4)
+      local_result[get_local_id(0)] = 0;
 
    /* Make sure previous processing has completed */
    barrier(CLK_LOCAL_MEM_FENCE);
 
-   int item_offset = get_global_id(0) * chars_per_item;
-
-   /* Iterate through characters in text */
-   for(int i=item_offset; i<item_offset + chars_per_item; i++) {
+   int item_offset = min((int)get_global_id(0) * chars_per_item, num_chars);
+   int item_end = min(item_offset + chars_per_item, num_chars);
 
-      /* load global text into private buffer */
-      text_vector = vload16(0, text + i);
+#ifdef IGNORE_CASE
+   pattern = FOLD(pattern);
+#endif
+   before = (item_offset > 0) ? text[item_offset - 1] : previous;
 
-      /* compare text vector and pattern */
-      check_vector = text_vector == pattern;
+   /* Iterate through characters in text */
+   for(int i=item_offset; i<item_end; i++) {
+      found = find_words(pattern, text, i, before);
+#ifdef WHOLE_WORD
+      before = text[i];
+#endif
 
-      /* Check for 'that' */
-      if(all(check_vector.s0123))
+      if(found.s0)
          atomic_inc(local_result);
-
-      /* Check for 'with' */
-      if(all(check_vector.s4567))
+      if(found.s1)
          atomic_inc(local_result + 1);
-
-      /* Check for 'have' */
-      if(all(check_vector.s89AB))
+      if(found.s2)
          atomic_inc(local_result + 2);
-
-      /* Check for 'from' */
-      if(all(check_vector.sCDEF))
+      if(found.s3)
          atomic_inc(local_result + 3);
    }
 
    /* Make sure local processing has completed */
-   barrier(CLK_GLOBAL_MEM_FENCE);
+   barrier(CLK_LOCAL_MEM_FENCE);
 
    /* Perform global reduction */
    if(get_local_id(0) == 0) {
@@ -52,3 +136,74 @@ __kernel void string_search(char16 pattern, __global char* text,
       atomic_add(global_result + 3, local_result[3]);
    }
 }
+
+/* Characters searched per work-item by string_match. Each position
+   records at most one match, the first of the four words found there, so
+   a group finds at most get_local_size(0) * MATCH_CHARS matches even if
+   the pattern repeats a word */
+#define MATCH_CHARS 8
+#define NO_MATCH 0xFFFFFFFF
+
+/* Record the offset and pattern ID of every match from cursor on. Each
+   group collects its matches in l_matches and reserves room for all of
+   them in matches with one global atomic on state[0]. Group 0 always
+   writes to the first get_local_size(0) * MATCH_CHARS entries, which the
+   host reserves in advance. A group that doesn't fit in max_matches
+   marks its entries with NO_MATCH and lowers the continuation cursor in
+   state[1] to its first character, so the host can search again from
+   there */
+__kernel void string_match(char16 pattern, __global char* text,
+     int cursor, int num_chars, __local uint2* l_matches, 
+     __global uint2* matches, uint max_matches, __global uint* state) {
+
+   __local uint l_count, l_base;
+   char4 text_word;
+   char16 text_vector, check_vector;
+   uint lid, count, base, tile_size, i;
+   int start, pos, id;
+
+   lid = get_local_id(0);
+   if(lid == 0)
+      l_count = 0;
+   barrier(CLK_LOCAL_MEM_FENCE);
+
+   /* Collect the group's matches in local memory */
+   tile_size = get_local_size(0) * MATCH_CHARS;
+   start = cursor + get_group_id(0) * tile_size;
+   for(pos=start + lid; pos<min(start + (int)tile_size, num_chars); 
+         pos+=get_local_size(0)) {
+
+      text_word = vload4(0, text + pos);
+      text_vector = (char16)(text_word, text_word, text_word, text_word);
+      check_vector = text_vector == pattern;
+
+      id = all(check_vector.s0123) ? 0 : all(check_vector.s4567) ? 1 :
+            all(check_vector.s89AB) ? 2 : all(check_vector.sCDEF) ? 3 : -1;
+      if(id >= 0)
+         l_matches[atomic_inc(&l_count)] = (uint2)(pos, id);
+   }
+   barrier(CLK_LOCAL_MEM_FENCE);
+
+   /* Reserve space for them with one global atomic */
+   count = l_count;
+   if(lid == 0)
+      l_base = (get_group_id(0) == 0) ? 0 : atomic_add(state, count);
+   barrier(CLK_LOCAL_MEM_FENCE);
+   base = l_base;
+
+   if(get_group_id(0) == 0) {
+      for(i=lid; i<tile_size; i+=get_local_size(0))
+         matches[i] = (i < count) ? l_matches[i] : (uint2)(NO_MATCH, 0);
+   }
+   else if(base + count <= max_matches) {
+      for(i=lid; i<count; i+=get_local_size(0))
+         matches[base + i] = l_matches[i];
+   }
+   else {
+      if(lid == 0)
+         atomic_min(state + 1, (uint)start);
+      for(i=base + lid; i<min(base + count, max_matches); 
+            i+=get_local_size(0))
+         matches[i] = (uint2)(NO_MATCH, 0);
+   }
+}
@@ -0,0 +1,671 @@
+#define _CRT_SECURE_NO_WARNINGS
+#define _POSIX_C_SOURCE 200112L
+#define PROGRAM_FILE "suffix_array.cl"
+#define RADIX_FILE "../radix_sort/radix_sort.cl"
+#define TEXT_FILE "../string_search/kafka.txt"
+
+/* The text holds NUM_CHARS characters made of random lines of the text
+   file, so it repeats phrases without repeating whole pages */
+#define NUM_CHARS 100000000
+#define NUM_QUERIES 262144
+#define MIN_QUERY 4
+#define MAX_QUERY 32
+#define NUM_SCANNED 4
+#define GROUPS_PER_UNIT 8
+#define MAX_LOCAL_SIZE 256
+#define RADIX_BITS 4
+#define RADIX (1 << RADIX_BITS)
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef MAC
+#include <OpenCL/cl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+/* Find a GPU or CPU associated with the first available platform */
+cl_device_id create_device() {
+
+   cl_platform_id platform;
+   cl_device_id dev;
+   int err;
+
+   /* Identify a platform */
+   err = clGetPlatformIDs(1, &platform, NULL);
+   if(err < 0) {
+      perror("Couldn't identify a platform");
+      exit(1);
+   } 
+
+   /* Access a device */
+   err = clGetDeviceIDs(platform, CL_DEVICE_TYPE_GPU, 1, &dev, NULL);
+   if(err == CL_DEVICE_NOT_FOUND) {
+      err = clGetDeviceIDs(platform, CL_DEVICE_TYPE_CPU, 1, &dev, NULL);
+   }
+   if(err < 0) {
+      perror("Couldn't access any devices");
+      exit(1);   
+   }
+
+   return dev;
+}
+
+/* Create program from a file and compile it */
+cl_program build_program(cl_context ctx, cl_device_id dev, const char* filename,
+      const char* options) {
+
+   cl_program program;
+   FILE *program_handle;
+   char *program_buffer, *program_log;
+   size_t program_size, log_size;
+   int err;
+
+   /* Read program file and place content into buffer */
+   program_handle = fopen(filename, "r");
+   if(program_handle == NULL) {
+      perror("Couldn't find the program file");
+      exit(1);
+   }
+   fseek(program_handle, 0, SEEK_END);
+   program_size = ftell(program_handle);
+   rewind(program_handle);
+   program_buffer = (char*)malloc(program_size + 1);
+   program_buffer[program_size] = '\0';
+   fread(program_buffer, sizeof(char), program_size, program_handle);
+   fclose(program_handle);
+
+   /* Create program from file */
+   program = clCreateProgramWithSource(ctx, 1, 
+      (const char**)&program_buffer, &program_size, &err);
+   if(err < 0) {
+      perror("Couldn't create the program");
+      exit(1);
+   }
+   free(program_buffer);
+
+   /* Build program */
+   err = clBuildProgram(program, 0, NULL, options, NULL, NULL);
+   if(err < 0) {
+
+      /* Find size of log and print to std output */
+      clGetProgramBuildInfo(program, dev, CL_PROGRAM_BUILD_LOG, 
+            0, NULL, &log_size);
+      program_log = (char*) malloc(log_size + 1);
+      program_log[log_size] = '\0';
+      clGetProgramBuildInfo(program, dev, CL_PROGRAM_BUILD_LOG, 
+            log_size + 1, program_log, NULL);
+      printf("%s\n", program_log);
+      free(program_log);
+      exit(1);
+   }
+
+   return program;
+}
+/* Read the wall clock in nanoseconds */
+unsigned long long wall_time_ns(void) {
+
+#ifdef UNIX
+   struct timespec ts;
+
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#else
+   return (unsigned long long)(1.0e9 * clock()/CLOCKS_PER_SEC);
+#endif
+}
+
+/* Sort the keys with the radix sort of Ch11/radix_sort, built with
+   KEY_VALUE, carrying each key's suffix. Only the low key_bits bits are
+   sorted, a multiple of 8 so that the keys and suffixes end up in
+   keys_buffers[0] and sa_buffers[0] */
+void radix_sort(cl_command_queue queue, cl_kernel* kernels,
+      cl_mem* keys_buffers, cl_mem* sa_buffers, cl_mem hist_buffer,
+      cl_uint num_keys, cl_uint key_bits, size_t local_size,
+      cl_uint max_groups) {
+
+   cl_uint shift, num_tiles, tiles_per_group, num_groups, num_entries;
+   size_t global_size;
+   int pass, err;
+
+   /* Give every work-group a contiguous range of whole tiles */
+   num_tiles = (num_keys + local_size - 1)/local_size;
+   tiles_per_group = (num_tiles + max_groups - 1)/max_groups;
+   num_groups = (num_tiles + tiles_per_group - 1)/tiles_per_group;
+   num_entries = RADIX * num_groups;
+   global_size = num_groups * local_size;
+
+   for(shift = 0; shift < key_bits; shift += RADIX_BITS) {
+      pass = shift/RADIX_BITS;
+
+      /* Set kernel arguments */
+      err = clSetKernelArg(kernels[0], 0, sizeof(cl_mem),
+            &keys_buffers[pass%2]);
+      err |= clSetKernelArg(kernels[0], 1, sizeof(cl_uint), &num_keys);
+      err |= clSetKernelArg(kernels[0], 2, sizeof(cl_uint), &shift);
+      err |= clSetKernelArg(kernels[0], 3, sizeof(cl_uint), &tiles_per_group);
+      err |= clSetKernelArg(kernels[0], 4, sizeof(cl_mem), &hist_buffer);
+      err |= clSetKernelArg(kernels[1], 0, sizeof(cl_mem), &hist_buffer);
+      err |= clSetKernelArg(kernels[1], 1, sizeof(cl_uint), &num_entries);
+      err |= clSetKernelArg(kernels[1], 2, local_size * sizeof(cl_uint), NULL);
+      err |= clSetKernelArg(kernels[2], 0, sizeof(cl_mem),
+            &keys_buffers[pass%2]);
+      err |= clSetKernelArg(kernels[2], 1, sizeof(cl_uint), &num_keys);
+      err |= clSetKernelArg(kernels[2], 2, sizeof(cl_uint), &shift);
+      err |= clSetKernelArg(kernels[2], 3, sizeof(cl_uint), &tiles_per_group);
+      err |= clSetKernelArg(kernels[2], 4, sizeof(cl_mem), &hist_buffer);
+      err |= clSetKernelArg(kernels[2], 5, local_size * sizeof(cl_uint), NULL);
+      err |= clSetKernelArg(kernels[2], 6, local_size * sizeof(cl_uint), NULL);
+      err |= clSetKernelArg(kernels[2], 7, sizeof(cl_mem),
+            &keys_buffers[(pass+1)%2]);
+      err |= clSetKernelArg(kernels[2], 8, sizeof(cl_mem),
+            &sa_buffers[pass%2]);
+      err |= clSetKernelArg(kernels[2], 9, local_size * sizeof(cl_uint), NULL);
+      err |= clSetKernelArg(kernels[2], 10, sizeof(cl_mem),
+            &sa_buffers[(pass+1)%2]);
+      if(err < 0) {
+         perror("Couldn't create a kernel argument");
+         exit(1);
+      }
+
+      /* Count digits, scan the histograms and scatter keys and suffixes */
+      err = clEnqueueNDRangeKernel(queue, kernels[0], 1, NULL, &global_size,
+            &local_size, 0, NULL, NULL);
+      err |= clEnqueueNDRangeKernel(queue, kernels[1], 1, NULL, &local_size,
+            &local_size, 0, NULL, NULL);
+      err |= clEnqueueNDRangeKernel(queue, kernels[2], 1, NULL, &global_size,
+            &local_size, 0, NULL, NULL);
+      if(err < 0) {
+         perror("Couldn't enqueue the kernel");
+         exit(1);
+      }
+   }
+}
+
+/* Enqueue a kernel with one work-item per character */
+void enqueue_chars(cl_command_queue queue, cl_kernel kernel,
+      cl_uint num_chars, size_t local_size) {
+
+   size_t global_size = (num_chars + local_size - 1)/local_size * local_size;
+   int err;
+
+   err = clEnqueueNDRangeKernel(queue, kernel, 1, NULL, &global_size,
+         &local_size, 0, NULL, NULL);
+   if(err < 0) {
+      perror("Couldn't enqueue the kernel");
+      exit(1);
+   }
+}
+
+/* Compare the suffixes at a and b */
+int compare_suffixes(const unsigned char *text, cl_uint num_chars,
+      cl_uint a, cl_uint b) {
+
+   while(a < num_chars && b < num_chars) {
+      if(text[a] != text[b])
+         return text[a] < text[b] ? -1 : 1;
+      a++;
+      b++;
+   }
+   return (a < num_chars) - (b < num_chars);
+}
+
+/* Check whether the suffix at pos starts with a query */
+int starts_with(const unsigned char *text, cl_uint num_chars, cl_uint pos,
+      const unsigned char *query, cl_uint length) {
+
+   return pos + length <= num_chars &&
+         memcmp(text + pos, query, length) == 0;
+}
+
+int main(int argc, char** argv) {
+
+   /* OpenCL structures */
+   cl_device_id device;
+   cl_context context;
+   cl_program program, radix_program;
+   cl_kernel init_kernel, second_kernel, first_kernel, flags_kernel,
+         count_kernel, scan_kernel, scatter_kernel, find_kernel,
+         radix_kernels[3];
+   cl_command_queue queue;
+   cl_event event;
+   cl_int i, err, check;
+   cl_uint compute_units, max_groups, num_chars, num_groups, key_bits,
+         bits, h, num_ranks, num_rounds, num_queries, num_found;
+   cl_ulong max_alloc, time_start, time_end, build_bytes, query_bytes;
+   size_t local_size, global_size, max_local_size;
+   unsigned long long build_time, scan_time;
+   const char* radix_names[3] = {"radix_count", "radix_scan",
+         "radix_scatter"};
+
+   /* Data and buffers */
+   FILE *handle;
+   unsigned char *source, *text, *queries, *marks;
+   size_t source_size, num_lines, line, length;
+   size_t *line_starts;
+   cl_uint *sa, *query_starts, *ranges, pos, first, count, scanned;
+   cl_mem text_buffer, rank_buffer, keys_buffers[2], sa_buffers[2],
+         hist_buffer, counts_buffer, offsets_buffer, queries_buffer,
+         starts_buffer, ranges_buffer;
+
+   /* Read the text file and find its lines */
+   handle = fopen(argc > 1 ? argv[1] : TEXT_FILE, "rb");
+   if(handle == NULL) {
+      perror("Couldn't find the text file");
+      exit(1);
+   }
+   fseek(handle, 0, SEEK_END);
+   source_size = ftell(handle);
+   rewind(handle);
+   source = (unsigned char*) malloc(source_size + 1);
+   fread(source, sizeof(char), source_size, handle);
+   fclose(handle);
+   if(source_size == 0) {
+      printf("The text file is empty\n");
+      exit(1);
+   }
+   line_starts = (size_t*) malloc((source_size + 1) * sizeof(size_t));
+   num_lines = 0;
+   for(length=0; length<source_size; length++) {
+      if(length == 0 || source[length-1] == '\n')
+         line_starts[num_lines++] = length;
+   }
+   line_starts[num_lines] = source_size;
+
+   /* Fill the text with random lines */
+   num_chars = argc > 2 ? (cl_uint)strtoul(argv[2], NULL, 10) : NUM_CHARS;
+   if(num_chars < MAX_QUERY) {
+      printf("The text needs at least %d characters\n", MAX_QUERY);
+      exit(1);
+   }
+   srand(time(NULL));
+   text = (unsigned char*) malloc(num_chars);
+   for(pos=0; pos<num_chars; pos+=(cl_uint)length) {
+      line = (((size_t)rand() << 16) ^ (size_t)rand()) % num_lines;
+      length = line_starts[line+1] - line_starts[line];
+      if(length > num_chars - pos)
+         length = num_chars - pos;
+      memcpy(text + pos, source + line_starts[line], length);
+   }
+   free(source);
+   free(line_starts);
+
+   /* Take queries from the text, and change one character of every
+      fourth query so that most of those aren't found */
+   num_queries = NUM_QUERIES;
+   queries = (unsigned char*) malloc(num_queries * MAX_QUERY);
+   query_starts = (cl_uint*) malloc((num_queries + 1) * sizeof(cl_uint));
+   ranges = (cl_uint*) malloc(num_queries * 2 * sizeof(cl_uint));
+   query_starts[0] = 0;
+   for(i=0; i<(cl_int)num_queries; i++) {
+      length = MIN_QUERY + rand() % (MAX_QUERY - MIN_QUERY + 1);
+      pos = (((cl_uint)rand() << 16) ^ (cl_uint)rand()) %
+            (num_chars - (cl_uint)length + 1);
+      memcpy(queries + query_starts[i], text + pos, length);
+      if(i % 4 == 3)
+         queries[query_starts[i] + rand() % length] = 'A' + rand() % 26;
+      query_starts[i+1] = query_starts[i] + (cl_uint)length;
+   }
+
+   /* Create device and context */
+   device = create_device();
+   err = clGetDeviceInfo(device, CL_DEVICE_MAX_COMPUTE_UNITS,
+         sizeof(compute_units), &compute_units, NULL);
+   err |= clGetDeviceInfo(device, CL_DEVICE_MAX_MEM_ALLOC_SIZE,
+         sizeof(max_alloc), &max_alloc, NULL);
+   if(err < 0) {
+      perror("Couldn't obtain device information");
+      exit(1);
+   }
+   if(num_chars * sizeof(cl_uint) > max_alloc) {
+      printf("The suffix array doesn't fit in one buffer\n");
+      exit(1);
+   }
+   context = clCreateContext(NULL, 1, &device, NULL, NULL, &err);
+   if(err < 0) {
+      perror("Couldn't create a context");
+      exit(1);
+   }
+
+   /* Build programs and create kernels */
+   program = build_program(context, device, PROGRAM_FILE, NULL);
+   radix_program = build_program(context, device, RADIX_FILE,
+         "-DKEY_VALUE");
+   init_kernel = clCreateKernel(program, "init_ranks", &err);
+   if(err < 0) {
+      perror("Couldn't create a kernel");
+      exit(1);
+   };
+   second_kernel = clCreateKernel(program, "second_keys", &err);
+   if(err < 0) {
+      perror("Couldn't create a kernel");
+      exit(1);
+   };
+   first_kernel = clCreateKernel(program, "first_keys", &err);
+   if(err < 0) {
+      perror("Couldn't create a kernel");
+      exit(1);
+   };
+   flags_kernel = clCreateKernel(program, "rank_flags", &err);
+   if(err < 0) {
+      perror("Couldn't create a kernel");
+      exit(1);
+   };
+   count_kernel = clCreateKernel(program, "rank_count", &err);
+   if(err < 0) {
+      perror("Couldn't create a kernel");
+      exit(1);
+   };
+   scan_kernel = clCreateKernel(program, "rank_scan", &err);
+   if(err < 0) {
+      perror("Couldn't create a kernel");
+      exit(1);
+   };
+   scatter_kernel = clCreateKernel(program, "rank_scatter", &err);
+   if(err < 0) {
+      perror("Couldn't create a kernel");
+      exit(1);
+   };
+   find_kernel = clCreateKernel(program, "find_ranges", &err);
+   if(err < 0) {
+      perror("Couldn't create a kernel");
+      exit(1);
+   };
+   for(i=0; i<3; i++) {
+      radix_kernels[i] = clCreateKernel(radix_program, radix_names[i], &err);
+      if(err < 0) {
+         perror("Couldn't create a kernel");
+         exit(1);
+      };
+   }
+
+   /* Determine a power-of-two local size */
+   err = clGetKernelWorkGroupInfo(radix_kernels[2], device,
+         CL_KERNEL_WORK_GROUP_SIZE, sizeof(local_size), &local_size, NULL);
+   err |= clGetKernelWorkGroupInfo(scatter_kernel, device,
+         CL_KERNEL_WORK_GROUP_SIZE, sizeof(max_local_size),
+         &max_local_size, NULL);
+   if(err < 0) {
+      perror("Couldn't find the maximum work-group size");
+      exit(1);
+   };
+   if(max_local_size < local_size)
+      local_size = max_local_size;
+   local_size = (size_t)pow(2, trunc(log2(local_size)));
+   if(local_size > MAX_LOCAL_SIZE)
+      local_size = MAX_LOCAL_SIZE;
+   if(local_size < RADIX) {
+      printf("The radix sort needs %d work-items per group\n", RADIX);
+      exit(1);
+   }
+   max_groups = compute_units * GROUPS_PER_UNIT;
+   num_groups = (num_chars + (cl_uint)local_size - 1)/(cl_uint)local_size;
+
+   /* Create a command queue and buffers */
+   queue = clCreateCommandQueue(context, device,
+         CL_QUEUE_PROFILING_ENABLE, &err);
+   if(err < 0) {
+      perror("Couldn't create a command queue");
+      exit(1);
+   };
+   text_buffer = clCreateBuffer(context, CL_MEM_READ_ONLY |
+         CL_MEM_COPY_HOST_PTR, num_chars, text, &err);
+   rank_buffer = clCreateBuffer(context, CL_MEM_READ_WRITE,
+         num_chars * sizeof(cl_uint), NULL, &err);
+   for(i=0; i<2; i++) {
+      keys_buffers[i] = clCreateBuffer(context, CL_MEM_READ_WRITE,
+            num_chars * sizeof(cl_uint), NULL, &err);
+      sa_buffers[i] = clCreateBuffer(context, CL_MEM_READ_WRITE,
+            num_chars * sizeof(cl_uint), NULL, &err);
+   }
+   hist_buffer = clCreateBuffer(context, CL_MEM_READ_WRITE,
+         RADIX * max_groups * sizeof(cl_uint), NULL, &err);
+   counts_buffer = clCreateBuffer(context, CL_MEM_READ_WRITE,
+         num_groups * sizeof(int), NULL, &err);
+   offsets_buffer = clCreateBuffer(context, CL_MEM_READ_WRITE,
+         (num_groups + 1) * sizeof(int), NULL, &err);
+   if(err < 0) {
+      perror("Couldn't create a buffer");
+      exit(1);
+   };
+   build_bytes = num_chars * (1 + 5 * sizeof(cl_uint)) +
+         (RADIX * max_groups + 2 * num_groups + 1) * sizeof(cl_uint);
+   query_bytes = num_chars * (1 + sizeof(cl_uint));
+
+   /* Set the arguments that don't change between rounds. rank_flags
+      writes its flags to the free key buffer */
+   err = clSetKernelArg(init_kernel, 0, sizeof(cl_mem), &text_buffer);
+   err |= clSetKernelArg(init_kernel, 1, sizeof(cl_uint), &num_chars);
+   err |= clSetKernelArg(init_kernel, 2, sizeof(cl_mem), &rank_buffer);
+   err |= clSetKernelArg(second_kernel, 0, sizeof(cl_mem), &rank_buffer);
+   err |= clSetKernelArg(second_kernel, 1, sizeof(cl_uint), &num_chars);
+   err |= clSetKernelArg(second_kernel, 3, sizeof(cl_mem), &keys_buffers[0]);
+   err |= clSetKernelArg(second_kernel, 4, sizeof(cl_mem), &sa_buffers[0]);
+   err |= clSetKernelArg(first_kernel, 0, sizeof(cl_mem), &rank_buffer);
+   err |= clSetKernelArg(first_kernel, 1, sizeof(cl_mem), &sa_buffers[0]);
+   err |= clSetKernelArg(first_kernel, 2, sizeof(cl_uint), &num_chars);
+   err |= clSetKernelArg(first_kernel, 3, sizeof(cl_mem), &keys_buffers[0]);
+   err |= clSetKernelArg(flags_kernel, 0, sizeof(cl_mem), &keys_buffers[0]);
+   err |= clSetKernelArg(flags_kernel, 1, sizeof(cl_mem), &sa_buffers[0]);
+   err |= clSetKernelArg(flags_kernel, 2, sizeof(cl_mem), &rank_buffer);
+   err |= clSetKernelArg(flags_kernel, 3, sizeof(cl_uint), &num_chars);
+   err |= clSetKernelArg(flags_kernel, 5, sizeof(cl_mem), &keys_buffers[1]);
+   err |= clSetKernelArg(count_kernel, 0, sizeof(cl_mem), &keys_buffers[1]);
+   err |= clSetKernelArg(count_kernel, 1, sizeof(cl_uint), &num_chars);
+   err |= clSetKernelArg(count_kernel, 2, local_size * sizeof(int), NULL);
+   err |= clSetKernelArg(count_kernel, 3, sizeof(cl_mem), &counts_buffer);
+   err |= clSetKernelArg(scan_kernel, 0, sizeof(cl_mem), &counts_buffer);
+   err |= clSetKernelArg(scan_kernel, 1, sizeof(cl_uint), &num_groups);
+   err |= clSetKernelArg(scan_kernel, 2, local_size * sizeof(int), NULL);
+   err |= clSetKernelArg(scan_kernel, 3, sizeof(cl_mem), &offsets_buffer);
+   err |= clSetKernelArg(scatter_kernel, 0, sizeof(cl_mem), &keys_buffers[1]);
+   err |= clSetKernelArg(scatter_kernel, 1, sizeof(cl_mem), &sa_buffers[0]);
+   err |= clSetKernelArg(scatter_kernel, 2, sizeof(cl_uint), &num_chars);
+   err |= clSetKernelArg(scatter_kernel, 3, sizeof(cl_mem), &offsets_buffer);
+   err |= clSetKernelArg(scatter_kernel, 4, local_size * sizeof(int), NULL);
+   err |= clSetKernelArg(scatter_kernel, 5, sizeof(cl_mem), &rank_buffer);
+   if(err < 0) {
+      perror("Couldn't create a kernel argument");
+      exit(1);
+   };
+
+   /* Rank the suffixes by three characters, then double the length of
+      the ranked prefixes until every rank is distinct. The keys of the
+      first round take 28 bits, later ones are at most num_chars */
+   for(bits = 1; bits < 32 && ((cl_uint)1 << bits) <= num_chars; bits++);
+   build_time = wall_time_ns();
+   enqueue_chars(queue, init_kernel, num_chars, local_size);
+   key_bits = 28;
+   num_rounds = 0;
+   for(h = 3; ; h *= 2) {
+      key_bits = (key_bits + 7)/8 * 8;
+      err = clSetKernelArg(second_kernel, 2, sizeof(cl_uint), &h);
+      err |= clSetKernelArg(flags_kernel, 4, sizeof(cl_uint), &h);
+      if(err < 0) {
+         perror("Couldn't create a kernel argument");
+         exit(1);
+      };
+
+      /* Sort by the second rank, then stably by the first */
+      enqueue_chars(queue, second_kernel, num_chars, local_size);
+      radix_sort(queue, radix_kernels, keys_buffers, sa_buffers,
+            hist_buffer, num_chars, key_bits, local_size, max_groups);
+      enqueue_chars(queue, first_kernel, num_chars, local_size);
+      radix_sort(queue, radix_kernels, keys_buffers, sa_buffers,
+            hist_buffer, num_chars, key_bits, local_size, max_groups);
+
+      /* Rank the sorted pairs */
+      enqueue_chars(queue, flags_kernel, num_chars, local_size);
+      enqueue_chars(queue, count_kernel, num_chars, local_size);
+      err = clEnqueueNDRangeKernel(queue, scan_kernel, 1, NULL, &local_size,
+            &local_size, 0, NULL, NULL);
+      if(err < 0) {
+         perror("Couldn't enqueue the kernel");
+         exit(1);
+      }
+      enqueue_chars(queue, scatter_kernel, num_chars, local_size);
+      err = clEnqueueReadBuffer(queue, offsets_buffer, CL_TRUE,
+            num_groups * sizeof(int), sizeof(cl_uint), &num_ranks,
+            0, NULL, NULL);
+      if(err < 0) {
+         perror("Couldn't read the buffer");
+         exit(1);
+      }
+      num_rounds++;
+      if(num_ranks == num_chars)
+         break;
+      key_bits = bits;
+   }
+   build_time = wall_time_ns() - build_time;
+
+   /* Only the text and the suffix array are needed for queries */
+   clReleaseMemObject(rank_buffer);
+   clReleaseMemObject(keys_buffers[0]);
+   clReleaseMemObject(keys_buffers[1]);
+   clReleaseMemObject(sa_buffers[1]);
+   clReleaseMemObject(hist_buffer);
+   clReleaseMemObject(counts_buffer);
+   clReleaseMemObject(offsets_buffer);
+
+   /* Answer every query with one work-item */
+   queries_buffer = clCreateBuffer(context, CL_MEM_READ_ONLY |
+         CL_MEM_COPY_HOST_PTR, query_starts[num_queries], queries, &err);
+   starts_buffer = clCreateBuffer(context, CL_MEM_READ_ONLY |
+         CL_MEM_COPY_HOST_PTR, (num_queries + 1) * sizeof(cl_uint),
+         query_starts, &err);
+   ranges_buffer = clCreateBuffer(context, CL_MEM_WRITE_ONLY,
+         num_queries * 2 * sizeof(cl_uint), NULL, &err);
+   if(err < 0) {
+      perror("Couldn't create a buffer");
+      exit(1);
+   };
+   err = clSetKernelArg(find_kernel, 0, sizeof(cl_mem), &text_buffer);
+   err |= clSetKernelArg(find_kernel, 1, sizeof(cl_uint), &num_chars);
+   err |= clSetKernelArg(find_kernel, 2, sizeof(cl_mem), &sa_buffers[0]);
+   err |= clSetKernelArg(find_kernel, 3, sizeof(cl_mem), &queries_buffer);
+   err |= clSetKernelArg(find_kernel, 4, sizeof(cl_mem), &starts_buffer);
+   err |= clSetKernelArg(find_kernel, 5, sizeof(cl_uint), &num_queries);
+   err |= clSetKernelArg(find_kernel, 6, sizeof(cl_mem), &ranges_buffer);
+   if(err < 0) {
+      perror("Couldn't create a kernel argument");
+      exit(1);
+   };
+   global_size = (num_queries + local_size - 1)/local_size * local_size;
+   err = clEnqueueNDRangeKernel(queue, find_kernel, 1, NULL, &global_size,
+         &local_size, 0, NULL, &event);
+   if(err < 0) {
+      perror("Couldn't enqueue the kernel");
+      exit(1);
+   }
+
+   /* Read the ranges and the suffix array */
+   sa = (cl_uint*) malloc(num_chars * sizeof(cl_uint));
+   err = clEnqueueReadBuffer(queue, ranges_buffer, CL_TRUE, 0,
+         num_queries * 2 * sizeof(cl_uint), ranges, 0, NULL, NULL);
+   err |= clEnqueueReadBuffer(queue, sa_buffers[0], CL_TRUE, 0,
+         num_chars * sizeof(cl_uint), sa, 0, NULL, NULL);
+   if(err < 0) {
+      perror("Couldn't read the buffer");
+      exit(1);
+   }
+   clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_START,
+         sizeof(time_start), &time_start, NULL);
+   clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_END,
+         sizeof(time_end), &time_end, NULL);
+   clReleaseEvent(event);
+
+   /* Check that the array is a permutation in suffix order */
+   check = 1;
+   marks = (unsigned char*) calloc(num_chars, 1);
+   for(pos=0; pos<num_chars && check; pos++) {
+      if(sa[pos] >= num_chars || marks[sa[pos]])
+         check = 0;
+      else
+         marks[sa[pos]] = 1;
+      if(pos > 0 && compare_suffixes(text, num_chars, sa[pos-1],
+            sa[pos]) >= 0)
+         check = 0;
+   }
+   free(marks);
+
+   /* Check that each range holds exactly the suffixes that start with
+      its query */
+   num_found = 0;
+   for(i=0; i<(cl_int)num_queries && check; i++) {
+      first = ranges[2*i];
+      count = ranges[2*i + 1];
+      length = query_starts[i+1] - query_starts[i];
+      num_found += (count > 0);
+      if(first > num_chars || count > num_chars - first ||
+            (count > 0 && (!starts_with(text, num_chars, sa[first],
+            queries + query_starts[i], (cl_uint)length) ||
+            !starts_with(text, num_chars, sa[first + count - 1],
+            queries + query_starts[i], (cl_uint)length))) ||
+            (first > 0 && starts_with(text, num_chars, sa[first - 1],
+            queries + query_starts[i], (cl_uint)length)) ||
+            (first + count < num_chars && starts_with(text, num_chars,
+            sa[first + count], queries + query_starts[i], (cl_uint)length)))
+         check = 0;
+   }
+
+   /* Count the first queries by scanning the whole text */
+   scan_time = wall_time_ns();
+   for(i=0; i<NUM_SCANNED && check; i++) {
+      length = query_starts[i+1] - query_starts[i];
+      scanned = 0;
+      for(pos=0; pos + length <= num_chars; pos++) {
+         scanned += (memcmp(text + pos, queries + query_starts[i],
+               length) == 0);
+      }
+      if(scanned != ranges[2*i + 1])
+         check = 0;
+   }
+   scan_time = (wall_time_ns() - scan_time)/NUM_SCANNED;
+
+   printf("Suffix array of %u characters built in %u rounds\n",
+         num_chars, num_rounds);
+   printf("Build time: %.3f s, %.1f million characters/s\n",
+         build_time * 1.0e-9, num_chars * 1.0e3/build_time);
+   printf("Device memory: %.1f MB to build (%.1f bytes/character), "
+         "%.1f MB to query\n", build_bytes/1048576.0,
+         (double)build_bytes/num_chars, query_bytes/1048576.0);
+   printf("Queries: %u of %d to %d characters, %u found\n",
+         num_queries, MIN_QUERY, MAX_QUERY, num_found);
+   printf("Query time: %.3f ms, %.0f queries/s\n",
+         (time_end - time_start) * 1.0e-6,
+         num_queries * 1.0e9/(time_end - time_start));
+   printf("Scanning the text: %.3f ms per query\n", scan_time * 1.0e-6);
+   printf("%s\n", check ? "Check passed." : "Check failed.");
+
+   /* Deallocate resources */
+   free(text);
+   free(queries);
+   free(query_starts);
+   free(ranges);
+   free(sa);
+   clReleaseMemObject(text_buffer);
+   clReleaseMemObject(sa_buffers[0]);
+   clReleaseMemObject(queries_buffer);
+   clReleaseMemObject(starts_buffer);
+   clReleaseMemObject(ranges_buffer);
+   clReleaseKernel(init_kernel);
+   clReleaseKernel(second_kernel);
+   clReleaseKernel(first_kernel);
+   clReleaseKernel(flags_kernel);
+   clReleaseKernel(count_kernel);
+   clReleaseKernel(scan_kernel);
+   clReleaseKernel(scatter_kernel);
+   clReleaseKernel(find_kernel);
+   for(i=0; i<3; i++) {
+      clReleaseKernel(radix_kernels[i]);
+   }
+   clReleaseCommandQueue(queue);
+   clReleaseProgram(program);
+   clReleaseProgram(radix_program);
+   clReleaseContext(context);
+   return 0;
+}
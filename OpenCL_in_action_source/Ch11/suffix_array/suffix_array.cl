@@ -0,0 +1,213 @@
+/* The suffix array is built by prefix doubling. After each round,
+   rank[i] orders the suffix at i by its first 2h characters, so sorting
+   the suffixes by the pair (rank[i], rank[i+h]) orders them by 4h
+   characters. The pairs are sorted with two stable passes of the Ch11
+   radix sort, first by the second rank and then by the first */
+
+/* Rank every suffix by its first three characters. Characters count
+   from 1 so that the end of the text sorts before any of them */
+__kernel void init_ranks(__global uchar* text, uint num_chars,
+      __global uint* rank) {
+
+   uint i = get_global_id(0);
+   uint c0, c1, c2;
+
+   if(i >= num_chars)
+      return;
+   c0 = text[i] + 1;
+   c1 = (i + 1 < num_chars) ? text[i+1] + 1 : 0;
+   c2 = (i + 2 < num_chars) ? text[i+2] + 1 : 0;
+   rank[i] = (c0 << 18) | (c1 << 9) | c2;
+}
+
+/* Start every round from the suffixes in text order, keyed by the rank
+   h characters on, or 0 past the end of the text */
+__kernel void second_keys(__global uint* rank, uint num_chars, uint h,
+      __global uint* keys, __global uint* sa) {
+
+   uint i = get_global_id(0);
+
+   if(i >= num_chars)
+      return;
+   keys[i] = (i + h < num_chars) ? rank[i + h] + 1 : 0;
+   sa[i] = i;
+}
+
+/* Key the suffixes, sorted by their second rank, by their first rank */
+__kernel void first_keys(__global uint* rank, __global uint* sa,
+      uint num_chars, __global uint* keys) {
+
+   uint j = get_global_id(0);
+
+   if(j < num_chars)
+      keys[j] = rank[sa[j]];
+}
+
+/* Flag every suffix whose rank pair differs from the one before it.
+   keys holds the first ranks in sorted order */
+__kernel void rank_flags(__global uint* keys, __global uint* sa,
+      __global uint* rank, uint num_chars, uint h, __global uint* flags) {
+
+   uint j = get_global_id(0);
+   uint i, prev;
+
+   if(j >= num_chars)
+      return;
+   if(j == 0) {
+      flags[j] = 1;
+      return;
+   }
+   i = sa[j] + h;
+   prev = sa[j-1] + h;
+   flags[j] = (keys[j] != keys[j-1]) ||
+         ((i < num_chars) ? rank[i] + 1 : 0) !=
+         ((prev < num_chars) ? rank[prev] + 1 : 0);
+}
+
+/* Return the number of flags before this work-item in its group */
+int local_position(int flag, __local int* partial_sums) {
+
+   int lid = get_local_id(0);
+   int group_size = get_local_size(0);
+   int i;
+
+   partial_sums[lid] = flag;
+   barrier(CLK_LOCAL_MEM_FENCE);
+
+   for(int d = 1; d < group_size; d <<= 1) {
+      i = (lid >= d) ? partial_sums[lid - d] : 0;
+      barrier(CLK_LOCAL_MEM_FENCE);
+      partial_sums[lid] += i;
+      barrier(CLK_LOCAL_MEM_FENCE);
+   }
+   return partial_sums[lid] - flag;
+}
+
+/* Count the flags in each work-group */
+__kernel void rank_count(__global uint* flags, uint num_chars,
+      __local int* partial_counts, __global int* group_counts) {
+
+   int lid = get_local_id(0);
+   int group_size = get_local_size(0);
+   uint gid = get_global_id(0);
+
+   partial_counts[lid] = (gid < num_chars) ? flags[gid] : 0;
+   barrier(CLK_LOCAL_MEM_FENCE);
+
+   for(int i = group_size/2; i>0; i >>= 1) {
+      if(lid < i) {
+         partial_counts[lid] += partial_counts[lid + i];
+      }
+      barrier(CLK_LOCAL_MEM_FENCE);
+   }
+
+   if(lid == 0) {
+      group_counts[get_group_id(0)] = partial_counts[0];
+   }
+}
+
+/* Exclusive scan of the group counts in a single work-group. The total,
+   the number of distinct ranks, goes to offsets[num_groups] */
+__kernel void rank_scan(__global int* group_counts, uint num_groups,
+      __local int* partial_sums, __global int* offsets) {
+
+   int lid = get_local_id(0);
+   int group_size = get_local_size(0);
+   int running_total = 0, value, i;
+
+   for(uint start = 0; start < num_groups; start += group_size) {
+
+      value = (start + lid < num_groups) ? group_counts[start + lid] : 0;
+      partial_sums[lid] = value;
+      barrier(CLK_LOCAL_MEM_FENCE);
+
+      /* Inclusive scan of this chunk */
+      for(int d = 1; d < group_size; d <<= 1) {
+         i = (lid >= d) ? partial_sums[lid - d] : 0;
+         barrier(CLK_LOCAL_MEM_FENCE);
+         partial_sums[lid] += i;
+         barrier(CLK_LOCAL_MEM_FENCE);
+      }
+
+      if(start + lid < num_groups) {
+         offsets[start + lid] = running_total + partial_sums[lid] - value;
+      }
+      running_total += partial_sums[group_size-1];
+      barrier(CLK_LOCAL_MEM_FENCE);
+   }
+
+   if(lid == 0) {
+      offsets[num_groups] = running_total;
+   }
+}
+
+/* Give every suffix the number of flags up to its position, minus one,
+   as its new rank. rank_flags has read every old rank by now */
+__kernel void rank_scatter(__global uint* flags, __global uint* sa,
+      uint num_chars, __global int* offsets, __local int* partial_sums,
+      __global uint* rank) {
+
+   uint gid = get_global_id(0);
+   int flag = (gid < num_chars) ? flags[gid] : 0;
+   int pos = offsets[get_group_id(0)] + local_position(flag, partial_sums);
+
+   if(gid < num_chars)
+      rank[sa[gid]] = pos + flag - 1;
+}
+
+/* Compare the first length characters of the suffix at pos with a
+   query. A suffix that ends first sorts before the query */
+int compare_suffix(__global uchar* text, uint num_chars, uint pos,
+      __global uchar* query, uint length) {
+
+   for(uint k = 0; k < length; k++) {
+      if(pos + k >= num_chars)
+         return -1;
+      if(text[pos + k] != query[k])
+         return (text[pos + k] < query[k]) ? -1 : 1;
+   }
+   return 0;
+}
+
+/* Find the suffixes that start with each query with two binary
+   searches, one query per work-item. Query q holds the characters from
+   starts[q] to starts[q+1], and ranges receives the position of its
+   first suffix in the array and the number of suffixes */
+__kernel void find_ranges(__global uchar* text, uint num_chars,
+      __global uint* sa, __global uchar* queries, __global uint* starts,
+      uint num_queries, __global uint* ranges) {
+
+   uint q = get_global_id(0);
+   uint low, high, mid, first, length;
+   __global uchar* query;
+
+   if(q >= num_queries)
+      return;
+   query = queries + starts[q];
+   length = starts[q+1] - starts[q];
+
+   /* First suffix not below the query */
+   low = 0;
+   high = num_chars;
+   while(low < high) {
+      mid = low + (high - low)/2;
+      if(compare_suffix(text, num_chars, sa[mid], query, length) < 0)
+         low = mid + 1;
+      else
+         high = mid;
+   }
+   first = low;
+
+   /* First suffix above the query */
+   high = num_chars;
+   while(low < high) {
+      mid = low + (high - low)/2;
+      if(compare_suffix(text, num_chars, sa[mid], query, length) <= 0)
+         low = mid + 1;
+      else
+         high = mid;
+   }
+
+   ranges[2*q] = first;
+   ranges[2*q + 1] = low - first;
+}
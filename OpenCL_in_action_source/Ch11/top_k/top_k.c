@@ -0,0 +1,551 @@
+#define _CRT_SECURE_NO_WARNINGS
+#define PROGRAM_FILE "top_k.cl"
+#define BSORT_FILE "../bsort/bsort.cl"
+
+#define K 100
+#define TEST_SIZE 1000003
+#define MIN_FLOATS 1048576
+#define MAX_FLOATS 67108864
+#define GROUPS_PER_UNIT 8
+#define MAX_LOCAL_SIZE 256
+#define MERGE_FANIN 8
+#define SELECT_BITS 8
+#define SELECT_RADIX (1 << SELECT_BITS)
+#define NUM_QUANTILES 5
+
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef MAC
+#include <OpenCL/cl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+/* Find a GPU or CPU associated with the first available platform */
+cl_device_id create_device() {
+
+   cl_platform_id platform;
+   cl_device_id dev;
+   int err;
+
+   /* Identify a platform */
+   err = clGetPlatformIDs(1, &platform, NULL);
+   if(err < 0) {
+      perror("Couldn't identify a platform");
+      exit(1);
+   } 
+
+   /* Access a device */
+   err = clGetDeviceIDs(platform, CL_DEVICE_TYPE_GPU, 1, &dev, NULL);
+   if(err == CL_DEVICE_NOT_FOUND) {
+      err = clGetDeviceIDs(platform, CL_DEVICE_TYPE_CPU, 1, &dev, NULL);
+   }
+   if(err < 0) {
+      perror("Couldn't access any devices");
+      exit(1);   
+   }
+
+   return dev;
+}
+
+/* Create program from a file and compile it */
+cl_program build_program(cl_context ctx, cl_device_id dev, const char* filename) {
+
+   cl_program program;
+   FILE *program_handle;
+   char *program_buffer, *program_log;
+   size_t program_size, log_size;
+   int err;
+
+   /* Read program file and place content into buffer */
+   program_handle = fopen(filename, "r");
+   if(program_handle == NULL) {
+      perror("Couldn't find the program file");
+      exit(1);
+   }
+   fseek(program_handle, 0, SEEK_END);
+   program_size = ftell(program_handle);
+   rewind(program_handle);
+   program_buffer = (char*)malloc(program_size + 1);
+   program_buffer[program_size] = '\0';
+   fread(program_buffer, sizeof(char), program_size, program_handle);
+   fclose(program_handle);
+
+   /* Create program from file */
+   program = clCreateProgramWithSource(ctx, 1, 
+      (const char**)&program_buffer, &program_size, &err);
+   if(err < 0) {
+      perror("Couldn't create the program");
+      exit(1);
+   }
+   free(program_buffer);
+
+   /* Build program */
+   err = clBuildProgram(program, 0, NULL, NULL, NULL, NULL);
+   if(err < 0) {
+
+      /* Find size of log and print to std output */
+      clGetProgramBuildInfo(program, dev, CL_PROGRAM_BUILD_LOG, 
+            0, NULL, &log_size);
+      program_log = (char*) malloc(log_size + 1);
+      program_log[log_size] = '\0';
+      clGetProgramBuildInfo(program, dev, CL_PROGRAM_BUILD_LOG, 
+            log_size + 1, program_log, NULL);
+      printf("%s\n", program_log);
+      free(program_log);
+      exit(1);
+   }
+
+   return program;
+}
+
+/* Compare floats for qsort */
+int compare_floats(const void* a, const void* b) {
+
+   float value_a = *(const float*)a, value_b = *(const float*)b;
+   return (value_a > value_b) - (value_a < value_b);
+}
+
+/* Find the largest 8 * local_size floats. The first launch reduces every
+   group's range of tiles to one descending list, and each further launch
+   merges MERGE_FANIN lists, until one list remains. Returns the device 
+   time and sets which candidate buffer holds the list */
+cl_ulong top_k(cl_command_queue queue, cl_kernel kernel, cl_mem data_buffer,
+      cl_mem* candidate_buffers, cl_uint num_floats, size_t local_size, 
+      cl_uint max_groups, int* result) {
+
+   cl_event start_event, end_event;
+   cl_uint tile_size, num_tiles, tiles_per_group, num_groups;
+   cl_ulong time_start, time_end;
+   cl_mem input;
+   size_t global_size;
+   int dst, err;
+
+   tile_size = 8 * local_size;
+   num_tiles = (num_floats + tile_size - 1)/tile_size;
+   tiles_per_group = (num_tiles + max_groups - 1)/max_groups;
+   input = data_buffer;
+   dst = 0;
+   while(1) {
+      num_groups = (num_tiles + tiles_per_group - 1)/tiles_per_group;
+      global_size = num_groups * local_size;
+
+      err = clSetKernelArg(kernel, 0, sizeof(cl_mem), &input);
+      err |= clSetKernelArg(kernel, 1, sizeof(cl_uint), &num_floats);
+      err |= clSetKernelArg(kernel, 2, sizeof(cl_uint), &tiles_per_group);
+      err |= clSetKernelArg(kernel, 3, 2 * tile_size * sizeof(float), NULL);
+      err |= clSetKernelArg(kernel, 4, sizeof(cl_mem), 
+            &candidate_buffers[dst]);
+      if(err < 0) {
+         perror("Couldn't create a kernel argument");
+         exit(1);   
+      }
+
+      if(input == data_buffer) {
+         err = clEnqueueNDRangeKernel(queue, kernel, 1, NULL, &global_size, 
+               &local_size, 0, NULL, &start_event);
+         end_event = start_event;
+         clRetainEvent(end_event);
+      }
+      else {
+         clReleaseEvent(end_event);
+         err = clEnqueueNDRangeKernel(queue, kernel, 1, NULL, &global_size, 
+               &local_size, 0, NULL, &end_event);
+      }
+      if(err < 0) {
+         perror("Couldn't enqueue the kernel");
+         exit(1);   
+      }
+      if(num_groups == 1)
+         break;
+
+      /* Every list becomes one tile of the next launch */
+      input = candidate_buffers[dst];
+      num_floats = num_groups * tile_size;
+      num_tiles = num_groups;
+      tiles_per_group = MERGE_FANIN;
+      dst = 1 - dst;
+   }
+   clFinish(queue);
+
+   clGetEventProfilingInfo(start_event, CL_PROFILING_COMMAND_START,
+         sizeof(time_start), &time_start, NULL);
+   clGetEventProfilingInfo(end_event, CL_PROFILING_COMMAND_END,
+         sizeof(time_end), &time_end, NULL);
+   clReleaseEvent(start_event);
+   clReleaseEvent(end_event);
+   *result = dst;
+   return time_end - time_start;
+}
+
+/* Find the float of the given rank in ascending order by radix select,
+   with one count and one bin selection per 8-bit digit of the key. 
+   Returns the device time */
+cl_ulong nth_element(cl_command_queue queue, cl_kernel* kernels, 
+      cl_mem data_buffer, cl_mem state_buffer, cl_mem hist_buffer, 
+      cl_uint num_floats, cl_uint rank, size_t local_size, 
+      cl_uint max_groups, float* value) {
+
+   cl_event start_event, end_event;
+   cl_uint state[2], shift, num_tiles, tiles_per_group, num_groups;
+   cl_ulong time_start, time_end;
+   size_t global_size;
+   int err;
+
+   /* The state holds the key prefix found so far and the rank left */
+   state[0] = 0;
+   state[1] = rank;
+   err = clEnqueueWriteBuffer(queue, state_buffer, CL_TRUE, 0, 
+         sizeof(state), state, 0, NULL, NULL);
+   if(err < 0) {
+      perror("Couldn't write the buffer");
+      exit(1);   
+   }
+
+   num_tiles = (num_floats + local_size - 1)/local_size;
+   tiles_per_group = (num_tiles + max_groups - 1)/max_groups;
+   num_groups = (num_tiles + tiles_per_group - 1)/tiles_per_group;
+   global_size = num_groups * local_size;
+   err = clSetKernelArg(kernels[0], 0, sizeof(cl_mem), &data_buffer);
+   err |= clSetKernelArg(kernels[0], 1, sizeof(cl_uint), &num_floats);
+   err |= clSetKernelArg(kernels[0], 3, sizeof(cl_uint), &tiles_per_group);
+   err |= clSetKernelArg(kernels[0], 4, sizeof(cl_mem), &state_buffer);
+   err |= clSetKernelArg(kernels[0], 5, sizeof(cl_mem), &hist_buffer);
+   err |= clSetKernelArg(kernels[1], 1, sizeof(cl_mem), &state_buffer);
+   err |= clSetKernelArg(kernels[1], 2, sizeof(cl_mem), &hist_buffer);
+   if(err < 0) {
+      perror("Couldn't create a kernel argument");
+      exit(1);   
+   }
+
+   /* Select the digits from the most significant down */
+   for(shift = 32; shift > 0; ) {
+      shift -= SELECT_BITS;
+      err = clSetKernelArg(kernels[0], 2, sizeof(cl_uint), &shift);
+      err |= clSetKernelArg(kernels[1], 0, sizeof(cl_uint), &shift);
+      err |= clEnqueueNDRangeKernel(queue, kernels[0], 1, NULL, 
+            &global_size, &local_size, 0, NULL, 
+            (shift == 32 - SELECT_BITS) ? &start_event : NULL);
+      err |= clEnqueueTask(queue, kernels[1], 0, NULL, 
+            (shift == 0) ? &end_event : NULL);
+      if(err < 0) {
+         perror("Couldn't enqueue the kernel");
+         exit(1);   
+      }
+   }
+   err = clEnqueueReadBuffer(queue, state_buffer, CL_TRUE, 0, 
+         sizeof(state), state, 0, NULL, NULL);
+   if(err < 0) {
+      perror("Couldn't read the buffer");
+      exit(1);   
+   }
+
+   /* Undo the order-preserving transform */
+   state[0] ^= (state[0] >> 31) ? 0x80000000 : 0xFFFFFFFF;
+   memcpy(value, &state[0], sizeof(float));
+
+   clGetEventProfilingInfo(start_event, CL_PROFILING_COMMAND_START,
+         sizeof(time_start), &time_start, NULL);
+   clGetEventProfilingInfo(end_event, CL_PROFILING_COMMAND_END,
+         sizeof(time_end), &time_end, NULL);
+   clReleaseEvent(start_event);
+   clReleaseEvent(end_event);
+   return time_end - time_start;
+}
+
+/* Sort floats with the kernels of Ch11/bsort and return the device time */
+cl_ulong bitonic_sort(cl_command_queue queue, cl_kernel* kernels, 
+      cl_mem data_buffer, cl_uint num_floats, size_t local_size) {
+
+   cl_event start_event, end_event;
+   cl_uint stage, high_stage, num_stages, padded_size;
+   cl_ulong time_start, time_end;
+   cl_int i, err, direction = 0;
+   size_t global_size;
+
+   /* Set the data and local memory arguments of every kernel */
+   padded_size = 8;
+   while(padded_size < num_floats) {
+      padded_size <<= 1;
+   }
+   global_size = padded_size/8;
+   if(global_size < local_size) {
+      local_size = global_size;
+   }
+   err = 0;
+   for(i=0; i<5; i++) {
+      err |= clSetKernelArg(kernels[i], 0, sizeof(cl_mem), &data_buffer);
+      err |= clSetKernelArg(kernels[i], 1, 8*local_size*sizeof(float), NULL);
+   }
+   err |= clSetKernelArg(kernels[0], 2, sizeof(cl_uint), &num_floats);
+   err |= clSetKernelArg(kernels[0], 3, sizeof(int), &direction);
+   err |= clSetKernelArg(kernels[1], 3, sizeof(cl_uint), &num_floats);
+   err |= clSetKernelArg(kernels[1], 4, sizeof(int), &direction);
+   err |= clSetKernelArg(kernels[2], 4, sizeof(cl_uint), &num_floats);
+   err |= clSetKernelArg(kernels[2], 5, sizeof(int), &direction);
+   err |= clSetKernelArg(kernels[3], 3, sizeof(int), &direction);
+   err |= clSetKernelArg(kernels[3], 4, sizeof(cl_uint), &num_floats);
+   err |= clSetKernelArg(kernels[4], 2, sizeof(int), &direction);
+   err |= clSetKernelArg(kernels[4], 3, sizeof(cl_uint), &num_floats);
+   if(err < 0) {
+      perror("Couldn't create a kernel argument");
+      exit(1);   
+   }
+
+   /* Enqueue initial sorting kernel */
+   err = clEnqueueNDRangeKernel(queue, kernels[0], 1, NULL, &global_size, 
+         &local_size, 0, NULL, &start_event); 
+
+   /* Execute further stages */
+   num_stages = global_size/local_size;
+   for(high_stage = 2; high_stage < num_stages; high_stage <<= 1) {
+      err |= clSetKernelArg(kernels[1], 2, sizeof(int), &high_stage);      
+      err |= clSetKernelArg(kernels[2], 3, sizeof(int), &high_stage);
+      for(stage = high_stage; stage > 1; stage >>= 1) {
+         err |= clSetKernelArg(kernels[2], 2, sizeof(int), &stage);
+         err |= clEnqueueNDRangeKernel(queue, kernels[2], 1, NULL, 
+               &global_size, &local_size, 0, NULL, NULL); 
+      }
+      err |= clEnqueueNDRangeKernel(queue, kernels[1], 1, NULL, 
+            &global_size, &local_size, 0, NULL, NULL); 
+   }
+
+   /* Perform the bitonic merge */
+   for(stage = num_stages; stage > 1; stage >>= 1) {
+      err |= clSetKernelArg(kernels[3], 2, sizeof(int), &stage);
+      err |= clEnqueueNDRangeKernel(queue, kernels[3], 1, NULL, 
+            &global_size, &local_size, 0, NULL, NULL); 
+   }
+   err |= clEnqueueNDRangeKernel(queue, kernels[4], 1, NULL, 
+         &global_size, &local_size, 0, NULL, &end_event); 
+   if(err < 0) {
+      perror("Couldn't enqueue the kernel");
+      exit(1);   
+   }
+   clFinish(queue);
+
+   clGetEventProfilingInfo(start_event, CL_PROFILING_COMMAND_START,
+         sizeof(time_start), &time_start, NULL);
+   clGetEventProfilingInfo(end_event, CL_PROFILING_COMMAND_END,
+         sizeof(time_end), &time_end, NULL);
+   clReleaseEvent(start_event);
+   clReleaseEvent(end_event);
+   return time_end - time_start;
+}
+
+int main() {
+
+   /* OpenCL structures */
+   cl_device_id device;
+   cl_context context;
+   cl_program program, bsort_program;
+   cl_kernel top_kernel, select_kernels[2], bsort_kernels[5];
+   cl_command_queue queue;
+   cl_int i, j, err, result, top_check, select_check, bsort_check;
+   cl_uint num_floats, compute_units, max_groups, list_size, rank;
+   cl_ulong max_alloc, top_time, select_time, bsort_time;
+   size_t top_local_size, select_local_size, bsort_local_size;
+   float value;
+   double quantiles[NUM_QUANTILES] = {0.0, 0.01, 0.5, 0.99, 1.0};
+   const char* select_names[2] = {"select_count", "select_bin"};
+   const char* bsort_names[5] = {"bsort_init", "bsort_stage_0", 
+         "bsort_stage_n", "bsort_merge", "bsort_merge_last"};
+
+   /* Data and buffers */
+   float *data, *sorted, *top;
+   cl_uint zeros[SELECT_RADIX];
+   cl_mem data_buffer, candidate_buffers[2], state_buffer, hist_buffer;
+
+   /* Create device and context */
+   device = create_device();
+   err = clGetDeviceInfo(device, CL_DEVICE_MAX_COMPUTE_UNITS, 
+         sizeof(compute_units), &compute_units, NULL);
+   err |= clGetDeviceInfo(device, CL_DEVICE_MAX_MEM_ALLOC_SIZE, 
+         sizeof(max_alloc), &max_alloc, NULL);
+   if(err < 0) {
+      perror("Couldn't obtain device information");
+      exit(1);   
+   }
+   context = clCreateContext(NULL, 1, &device, NULL, NULL, &err);
+   if(err < 0) {
+      perror("Couldn't create a context");
+      exit(1);   
+   }
+
+   /* Build the selection and bitonic sort programs */
+   program = build_program(context, device, PROGRAM_FILE);
+   bsort_program = build_program(context, device, BSORT_FILE);
+
+   /* Create kernels */
+   top_kernel = clCreateKernel(program, "top_k", &err);
+   if(err < 0) {
+      perror("Couldn't create a kernel");
+      exit(1);
+   };
+   for(i=0; i<2; i++) {
+      select_kernels[i] = clCreateKernel(program, select_names[i], &err);
+      if(err < 0) {
+         perror("Couldn't create a kernel");
+         exit(1);
+      };
+   }
+   for(i=0; i<5; i++) {
+      bsort_kernels[i] = clCreateKernel(bsort_program, bsort_names[i], &err);
+      if(err < 0) {
+         perror("Couldn't create a kernel");
+         exit(1);
+      };
+   }
+
+   /* Determine work-group sizes. Each top_k group keeps a list of 
+      8 * local_size floats, the smallest power of two holding K */
+   err = clGetKernelWorkGroupInfo(top_kernel, device, 
+         CL_KERNEL_WORK_GROUP_SIZE, sizeof(top_local_size), 
+         &top_local_size, NULL);
+   err |= clGetKernelWorkGroupInfo(select_kernels[0], device, 
+         CL_KERNEL_WORK_GROUP_SIZE, sizeof(select_local_size), 
+         &select_local_size, NULL);
+   err |= clGetKernelWorkGroupInfo(bsort_kernels[0], device, 
+         CL_KERNEL_WORK_GROUP_SIZE, sizeof(bsort_local_size), 
+         &bsort_local_size, NULL);
+   if(err < 0) {
+      perror("Couldn't find the maximum work-group size");
+      exit(1);   
+   };
+   list_size = 16;
+   while(list_size < K) {
+      list_size <<= 1;
+   }
+   if(list_size/8 > top_local_size) {
+      printf("A top-%d list needs %u work-items per group\n", K, 
+            list_size/8);
+      exit(1);
+   }
+   top_local_size = list_size/8;
+   select_local_size = (size_t)pow(2, trunc(log2(select_local_size)));
+   if(select_local_size > MAX_LOCAL_SIZE)
+      select_local_size = MAX_LOCAL_SIZE;
+   bsort_local_size = (size_t)pow(2, trunc(log2(bsort_local_size)));
+   max_groups = compute_units * GROUPS_PER_UNIT;
+
+   /* Create a command queue and the buffers reused for every size */
+   queue = clCreateCommandQueue(context, device, 
+         CL_QUEUE_PROFILING_ENABLE, &err);
+   if(err < 0) {
+      perror("Couldn't create a command queue");
+      exit(1);   
+   };
+   memset(zeros, 0, sizeof(zeros));
+   hist_buffer = clCreateBuffer(context, CL_MEM_READ_WRITE | 
+         CL_MEM_COPY_HOST_PTR, sizeof(zeros), zeros, &err);
+   state_buffer = clCreateBuffer(context, CL_MEM_READ_WRITE, 
+         2 * sizeof(cl_uint), NULL, &err);
+   for(i=0; i<2; i++) {
+      candidate_buffers[i] = clCreateBuffer(context, CL_MEM_READ_WRITE, 
+            max_groups * list_size * sizeof(float), NULL, &err);
+   }
+   if(err < 0) {
+      perror("Couldn't create a buffer");
+      exit(1);   
+   };
+   top = (float*) malloc(list_size * sizeof(float));
+
+   /* Check an odd size first, then sweep powers of two */
+   srand(time(NULL));
+   printf("%-12s%6s%-4d  %-8s%10s  %-8s%12s  %s\n", "Floats", "Top-", K, 
+         "Check", "Quantiles", "Check", "Bitonic sort", "Check");
+   for(num_floats = TEST_SIZE; num_floats <= MAX_FLOATS && 
+         num_floats * sizeof(float) <= max_alloc; 
+         num_floats = (num_floats == TEST_SIZE) ? MIN_FLOATS : num_floats * 4) {
+
+      data = (float*) malloc(num_floats * sizeof(float));
+      sorted = (float*) malloc(num_floats * sizeof(float));
+      if(data == NULL || sorted == NULL) {
+         printf("Couldn't allocate %u floats on the host\n", num_floats);
+         break;
+      }
+      for(i=0; i<num_floats; i++) {
+         data[i] = (float)rand()/RAND_MAX * 2000.0f - 1000.0f;
+      }
+      memcpy(sorted, data, num_floats * sizeof(float));
+      qsort(sorted, num_floats, sizeof(float), compare_floats);
+      data_buffer = clCreateBuffer(context, CL_MEM_READ_WRITE |
+            CL_MEM_COPY_HOST_PTR, num_floats * sizeof(float), data, &err);
+      if(err < 0) {
+         perror("Couldn't create a buffer");
+         exit(1);   
+      };
+
+      /* Top-k, compared with the end of the host sort */
+      top_time = top_k(queue, top_kernel, data_buffer, candidate_buffers, 
+            num_floats, top_local_size, max_groups, &result);
+      err = clEnqueueReadBuffer(queue, candidate_buffers[result], CL_TRUE, 
+            0, K * sizeof(float), top, 0, NULL, NULL);
+      if(err < 0) {
+         perror("Couldn't read the buffer");
+         exit(1);   
+      }
+      top_check = 1;
+      for(i=0; i<K; i++) {
+         if(top[i] != sorted[num_floats-1-i]) {
+            top_check = 0;
+            break;
+         }
+      }
+
+      /* Minimum, percentiles, median and maximum by radix select */
+      select_time = 0;
+      select_check = 1;
+      for(j=0; j<NUM_QUANTILES; j++) {
+         rank = (cl_uint)(quantiles[j] * (num_floats - 1));
+         select_time += nth_element(queue, select_kernels, data_buffer, 
+               state_buffer, hist_buffer, num_floats, rank, 
+               select_local_size, max_groups, &value);
+         if(value != sorted[rank])
+            select_check = 0;
+      }
+
+      /* Full bitonic sort of the same data, compared with the host sort */
+      bsort_time = bitonic_sort(queue, bsort_kernels, data_buffer, 
+            num_floats, bsort_local_size);
+      err = clEnqueueReadBuffer(queue, data_buffer, CL_TRUE, 0, 
+            num_floats * sizeof(float), data, 0, NULL, NULL);
+      if(err < 0) {
+         perror("Couldn't read the buffer");
+         exit(1);   
+      }
+      clReleaseMemObject(data_buffer);
+      bsort_check = (memcmp(data, sorted, num_floats * sizeof(float)) == 0);
+
+      printf("%-12u%10.3f  %-8s%10.3f  %-8s%12.3f  %s\n", num_floats, 
+            1.0e-6 * top_time, top_check ? "passed" : "failed", 
+            1.0e-6 * select_time, select_check ? "passed" : "failed", 
+            1.0e-6 * bsort_time, bsort_check ? "passed" : "failed");
+      free(data);
+      free(sorted);
+   }
+   printf("Times in milliseconds, %d quantiles per size\n", NUM_QUANTILES);
+
+   /* Deallocate resources */
+   free(top);
+   clReleaseKernel(top_kernel);
+   for(i=0; i<2; i++) {
+      clReleaseKernel(select_kernels[i]);
+      clReleaseMemObject(candidate_buffers[i]);
+   }
+   for(i=0; i<5; i++) {
+      clReleaseKernel(bsort_kernels[i]);
+   }
+   clReleaseMemObject(hist_buffer);
+   clReleaseMemObject(state_buffer);
+   clReleaseCommandQueue(queue);
+   clReleaseProgram(program);
+   clReleaseProgram(bsort_program);
+   clReleaseContext(context);
+   return 0;
+}
@@ -0,0 +1,264 @@
+#define SELECT_BITS 8
+#define SELECT_RADIX (1 << SELECT_BITS)
+
+/* Sort elements within a vector */
+#define VECTOR_SORT(input, dir)                                   \
+   comp = input < shuffle(input, mask2) ^ dir;                    \
+   input = shuffle(input, as_uint4(comp * 2 + add2));             \
+   comp = input < shuffle(input, mask1) ^ dir;                    \
+   input = shuffle(input, as_uint4(comp + add1));                 \
+
+#define VECTOR_SWAP(input1, input2, dir)                          \
+   temp = input1;                                                 \
+   comp = (input1 < input2 ^ dir) * 4 + add3;                     \
+   input1 = shuffle2(input1, input2, as_uint4(comp));             \
+   input2 = shuffle2(input2, temp, as_uint4(comp));               \
+
+/* Read a vector, padding positions past the end of the data */
+float4 load_data(__global float4 *g_data, uint index, uint num_floats,
+                 float pad) {
+
+   __global float *data = (__global float*)g_data;
+   uint start = index * 4;
+   float4 value;
+
+   if(start + 4 <= num_floats)
+      return g_data[index];
+   value.s0 = (start < num_floats) ? data[start] : pad;
+   value.s1 = (start + 1 < num_floats) ? data[start + 1] : pad;
+   value.s2 = (start + 2 < num_floats) ? data[start + 2] : pad;
+   value.s3 = pad;
+   return value;
+}
+
+/* Sort the 8 * local_size floats held two vectors per work-item, as in
+   bsort_init, and store them in l_data in direction dir */
+void sort_tile(float4 input1, float4 input2, __local float4 *l_data,
+               int dir) {
+
+   int block_dir;
+   uint id, lid, size, stride;
+   float4 temp;
+   int4 comp;
+
+   uint4 mask1 = (uint4)(1, 0, 3, 2);
+   uint4 mask2 = (uint4)(2, 3, 0, 1);
+   uint4 mask3 = (uint4)(3, 2, 1, 0);
+
+   int4 add1 = (int4)(1, 1, 3, 3);
+   int4 add2 = (int4)(2, 3, 2, 3);
+   int4 add3 = (int4)(1, 2, 2, 3);
+
+   lid = get_local_id(0);
+   id = lid * 2;
+
+   /* Sort input 1 ascending and input 2 descending */
+   comp = input1 < shuffle(input1, mask1);
+   input1 = shuffle(input1, as_uint4(comp + add1));
+   comp = input1 < shuffle(input1, mask2);
+   input1 = shuffle(input1, as_uint4(comp * 2 + add2));
+   comp = input1 < shuffle(input1, mask3);
+   input1 = shuffle(input1, as_uint4(comp + add3));
+
+   comp = input2 < shuffle(input2, mask1) ^ -1;
+   input2 = shuffle(input2, as_uint4(comp + add1));
+   comp = input2 < shuffle(input2, mask2) ^ -1;
+   input2 = shuffle(input2, as_uint4(comp * 2 + add2));
+   comp = input2 < shuffle(input2, mask3) ^ -1;
+   input2 = shuffle(input2, as_uint4(comp + add3));
+
+   /* Swap corresponding elements of input 1 and 2 */
+   add3 = (int4)(4, 5, 6, 7);
+   block_dir = (get_local_size(0) == 1) ? dir : (lid & 1) * -1;
+   VECTOR_SWAP(input1, input2, block_dir)
+   VECTOR_SORT(input1, block_dir);
+   VECTOR_SORT(input2, block_dir);
+   l_data[id] = input1;
+   l_data[id+1] = input2;
+
+   /* Create bitonic set */
+   for(size = 2; size < get_local_size(0); size <<= 1) {
+      block_dir = ((lid/size) & 1) * -1;
+
+      for(stride = size; stride > 1; stride >>= 1) {
+         barrier(CLK_LOCAL_MEM_FENCE);
+         id = lid + (lid/stride)*stride;
+         VECTOR_SWAP(l_data[id], l_data[id + stride], block_dir)
+      }
+
+      barrier(CLK_LOCAL_MEM_FENCE);
+      id = lid * 2;
+      input1 = l_data[id]; input2 = l_data[id+1];
+      VECTOR_SWAP(input1, input2, block_dir)
+      VECTOR_SORT(input1, block_dir);
+      VECTOR_SORT(input2, block_dir);
+      l_data[id] = input1;
+      l_data[id+1] = input2;
+   }
+
+   /* Perform bitonic merge in the requested direction */
+   if(get_local_size(0) > 1) {
+      for(stride = get_local_size(0); stride > 1; stride >>= 1) {
+         barrier(CLK_LOCAL_MEM_FENCE);
+         id = lid + (lid/stride)*stride;
+         VECTOR_SWAP(l_data[id], l_data[id + stride], dir)
+      }
+      barrier(CLK_LOCAL_MEM_FENCE);
+
+      id = lid * 2;
+      input1 = l_data[id]; input2 = l_data[id+1];
+      VECTOR_SWAP(input1, input2, dir)
+      VECTOR_SORT(input1, dir);
+      VECTOR_SORT(input2, dir);
+      l_data[id] = input1;
+      l_data[id+1] = input2;
+   }
+}
+
+/* Keep the larger of each pair from a descending list and an ascending
+   tile, which leaves the top values of both as a bitonic set, then sort
+   that set back into descending order */
+void merge_top(__local float4 *l_best, __local float4 *l_tile) {
+
+   int dir = -1;
+   uint id, lid, stride;
+   float4 input1, input2, temp;
+   int4 comp;
+
+   uint4 mask1 = (uint4)(1, 0, 3, 2);
+   uint4 mask2 = (uint4)(2, 3, 0, 1);
+
+   int4 add1 = (int4)(1, 1, 3, 3);
+   int4 add2 = (int4)(2, 3, 2, 3);
+   int4 add3 = (int4)(4, 5, 6, 7);
+
+   lid = get_local_id(0);
+   id = lid * 2;
+   l_best[id] = max(l_best[id], l_tile[id]);
+   l_best[id+1] = max(l_best[id+1], l_tile[id+1]);
+
+   for(stride = get_local_size(0); stride > 1; stride >>= 1) {
+      barrier(CLK_LOCAL_MEM_FENCE);
+      id = lid + (lid/stride)*stride;
+      VECTOR_SWAP(l_best[id], l_best[id + stride], dir)
+   }
+   barrier(CLK_LOCAL_MEM_FENCE);
+
+   id = lid * 2;
+   input1 = l_best[id]; input2 = l_best[id+1];
+   VECTOR_SWAP(input1, input2, dir)
+   VECTOR_SORT(input1, dir);
+   VECTOR_SORT(input2, dir);
+   l_best[id] = input1;
+   l_best[id+1] = input2;
+}
+
+/* Each work-group keeps the largest 8 * local_size values of a range of
+   tiles in descending order. Running it again on the output merges the
+   lists of several groups, so repeated launches form a merge tree */
+__kernel void top_k(__global float4 *data, uint num_floats,
+                    uint tiles_per_group, __local float4 *l_data,
+                    __global float4 *output) {
+
+   __local int l_found;
+   __local float4 *l_best, *l_tile;
+   uint id, lid, tile, end, num_tiles, index;
+   float threshold = -INFINITY;
+   float4 input1, input2;
+
+   lid = get_local_id(0);
+   id = lid * 2;
+   l_best = l_data;
+   l_tile = l_data + get_local_size(0) * 2;
+   l_best[id] = (float4)(-INFINITY);
+   l_best[id+1] = (float4)(-INFINITY);
+
+   num_tiles = (num_floats + get_local_size(0) * 8 - 1)/
+         (get_local_size(0) * 8);
+   tile = get_group_id(0) * tiles_per_group;
+   end = min(tile + tiles_per_group, num_tiles);
+   for(; tile < end; tile++) {
+      index = tile * get_local_size(0) * 2 + id;
+      input1 = load_data(data, index, num_floats, -INFINITY);
+      input2 = load_data(data, index+1, num_floats, -INFINITY);
+
+      /* Skip tiles with nothing above the current k-th largest value */
+      if(lid == 0)
+         l_found = 0;
+      barrier(CLK_LOCAL_MEM_FENCE);
+      if(any(input1 > threshold) || any(input2 > threshold))
+         l_found = 1;
+      barrier(CLK_LOCAL_MEM_FENCE);
+
+      if(l_found) {
+         sort_tile(input1, input2, l_tile, 0);
+         barrier(CLK_LOCAL_MEM_FENCE);
+         merge_top(l_best, l_tile);
+         barrier(CLK_LOCAL_MEM_FENCE);
+         threshold = l_best[get_local_size(0) * 2 - 1].s3;
+      }
+      barrier(CLK_LOCAL_MEM_FENCE);
+   }
+
+   output[get_group_id(0) * get_local_size(0) * 2 + id] = l_best[id];
+   output[get_group_id(0) * get_local_size(0) * 2 + id + 1] = l_best[id+1];
+}
+
+/* Map a float to a uint with the same ordering */
+uint float_key(float value) {
+
+   uint key = as_uint(value);
+   return key ^ (-(int)(key >> 31) | 0x80000000);
+}
+
+/* Count the digits at shift of the keys whose higher digits match the
+   prefix chosen so far, one global atomic per bin per group */
+__kernel void select_count(__global float *data, uint num_floats,
+                           uint shift, uint tiles_per_group,
+                           __global uint *state, __global uint *histogram) {
+
+   __local uint l_hist[SELECT_RADIX];
+   uint lid, start, end, key, i;
+   uint prefix = state[0];
+   uint mask = (shift + SELECT_BITS < 32) ?
+         0xFFFFFFFF << (shift + SELECT_BITS) : 0;
+
+   lid = get_local_id(0);
+   for(i = lid; i < SELECT_RADIX; i += get_local_size(0)) {
+      l_hist[i] = 0;
+   }
+   barrier(CLK_LOCAL_MEM_FENCE);
+
+   start = get_group_id(0) * tiles_per_group * get_local_size(0);
+   end = min(start + tiles_per_group * (uint)get_local_size(0), num_floats);
+   for(i = start + lid; i < end; i += get_local_size(0)) {
+      key = float_key(data[i]);
+      if((key & mask) == prefix)
+         atomic_inc(&l_hist[(key >> shift) & (SELECT_RADIX - 1)]);
+   }
+   barrier(CLK_LOCAL_MEM_FENCE);
+
+   for(i = lid; i < SELECT_RADIX; i += get_local_size(0)) {
+      if(l_hist[i] > 0)
+         atomic_add(&histogram[i], l_hist[i]);
+   }
+}
+
+/* Find the bin holding the remaining rank, add its digit to the prefix
+   and clear the histogram for the next pass */
+__kernel void select_bin(uint shift, __global uint *state,
+                         __global uint *histogram) {
+
+   uint bin = 0, rank = state[1];
+
+   while(bin < SELECT_RADIX - 1 && histogram[bin] <= rank) {
+      rank -= histogram[bin];
+      bin++;
+   }
+   state[0] |= bin << shift;
+   state[1] = rank;
+
+   for(bin = 0; bin < SELECT_RADIX; bin++) {
+      histogram[bin] = 0;
+   }
+}
@@ -0,0 +1,485 @@
+#define _CRT_SECURE_NO_WARNINGS
+#define PROGRAM_FILE "unique.cl"
+#define RADIX_FILE "../radix_sort/radix_sort.cl"
+
+#define NUM_KEYS 4194304
+#define NUM_DISTINCT 100000
+#define GROUPS_PER_UNIT 8
+#define MAX_LOCAL_SIZE 256
+#define RADIX_BITS 4
+#define RADIX (1 << RADIX_BITS)
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifdef MAC
+#include <OpenCL/cl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+/* Find a GPU or CPU associated with the first available platform */
+cl_device_id create_device() {
+
+   cl_platform_id platform;
+   cl_device_id dev;
+   int err;
+
+   /* Identify a platform */
+   err = clGetPlatformIDs(1, &platform, NULL);
+   if(err < 0) {
+      perror("Couldn't identify a platform");
+      exit(1);
+   } 
+
+   /* Access a device */
+   err = clGetDeviceIDs(platform, CL_DEVICE_TYPE_GPU, 1, &dev, NULL);
+   if(err == CL_DEVICE_NOT_FOUND) {
+      err = clGetDeviceIDs(platform, CL_DEVICE_TYPE_CPU, 1, &dev, NULL);
+   }
+   if(err < 0) {
+      perror("Couldn't access any devices");
+      exit(1);   
+   }
+
+   return dev;
+}
+
+/* Create program from a file and compile it */
+cl_program build_program(cl_context ctx, cl_device_id dev, const char* filename) {
+
+   cl_program program;
+   FILE *program_handle;
+   char *program_buffer, *program_log;
+   size_t program_size, log_size;
+   int err;
+
+   /* Read program file and place content into buffer */
+   program_handle = fopen(filename, "r");
+   if(program_handle == NULL) {
+      perror("Couldn't find the program file");
+      exit(1);
+   }
+   fseek(program_handle, 0, SEEK_END);
+   program_size = ftell(program_handle);
+   rewind(program_handle);
+   program_buffer = (char*)malloc(program_size + 1);
+   program_buffer[program_size] = '\0';
+   fread(program_buffer, sizeof(char), program_size, program_handle);
+   fclose(program_handle);
+
+   /* Create program from file */
+   program = clCreateProgramWithSource(ctx, 1, 
+      (const char**)&program_buffer, &program_size, &err);
+   if(err < 0) {
+      perror("Couldn't create the program");
+      exit(1);
+   }
+   free(program_buffer);
+
+   /* Build program */
+   err = clBuildProgram(program, 0, NULL, NULL, NULL, NULL);
+   if(err < 0) {
+
+      /* Find size of log and print to std output */
+      clGetProgramBuildInfo(program, dev, CL_PROGRAM_BUILD_LOG, 
+            0, NULL, &log_size);
+      program_log = (char*) malloc(log_size + 1);
+      program_log[log_size] = '\0';
+      clGetProgramBuildInfo(program, dev, CL_PROGRAM_BUILD_LOG, 
+            log_size + 1, program_log, NULL);
+      printf("%s\n", program_log);
+      free(program_log);
+      exit(1);
+   }
+
+   return program;
+}
+
+/* Compare keys for qsort */
+int compare_keys(const void* a, const void* b) {
+
+   cl_uint key_a = *(const cl_uint*)a, key_b = *(const cl_uint*)b;
+   return (key_a > key_b) - (key_a < key_b);
+}
+
+/* Sort the keys with one count, scan and scatter pass per digit and
+   return the device time. The number of passes is even, so the result
+   ends up back in keys_buffer. key_size is the size of the keys the
+   program was built for, 4 or 8 bytes */
+cl_ulong radix_sort(cl_command_queue queue, cl_kernel* kernels, 
+      cl_mem keys_buffer, cl_mem temp_buffer, cl_mem hist_buffer,
+      cl_uint num_keys, size_t key_size, size_t local_size, 
+      cl_uint max_groups) {
+
+   cl_event start_event, end_event;
+   cl_mem buffers[2] = {keys_buffer, temp_buffer};
+   cl_uint shift, num_tiles, tiles_per_group, num_groups, num_entries;
+   cl_ulong time_start, time_end;
+   size_t global_size;
+   int pass, err;
+
+   /* Give every work-group a contiguous range of whole tiles */
+   num_tiles = (num_keys + local_size - 1)/local_size;
+   tiles_per_group = (num_tiles + max_groups - 1)/max_groups;
+   num_groups = (num_tiles + tiles_per_group - 1)/tiles_per_group;
+   num_entries = RADIX * num_groups;
+   global_size = num_groups * local_size;
+
+   for(shift = 0; shift < 8 * key_size; shift += RADIX_BITS) {
+      pass = shift/RADIX_BITS;
+
+      /* Set kernel arguments */
+      err = clSetKernelArg(kernels[0], 0, sizeof(cl_mem), &buffers[pass%2]);
+      err |= clSetKernelArg(kernels[0], 1, sizeof(cl_uint), &num_keys);
+      err |= clSetKernelArg(kernels[0], 2, sizeof(cl_uint), &shift);
+      err |= clSetKernelArg(kernels[0], 3, sizeof(cl_uint), &tiles_per_group);
+      err |= clSetKernelArg(kernels[0], 4, sizeof(cl_mem), &hist_buffer);
+      err |= clSetKernelArg(kernels[1], 0, sizeof(cl_mem), &hist_buffer);
+      err |= clSetKernelArg(kernels[1], 1, sizeof(cl_uint), &num_entries);
+      err |= clSetKernelArg(kernels[1], 2, local_size * sizeof(cl_uint), NULL);
+      err |= clSetKernelArg(kernels[2], 0, sizeof(cl_mem), &buffers[pass%2]);
+      err |= clSetKernelArg(kernels[2], 1, sizeof(cl_uint), &num_keys);
+      err |= clSetKernelArg(kernels[2], 2, sizeof(cl_uint), &shift);
+      err |= clSetKernelArg(kernels[2], 3, sizeof(cl_uint), &tiles_per_group);
+      err |= clSetKernelArg(kernels[2], 4, sizeof(cl_mem), &hist_buffer);
+      err |= clSetKernelArg(kernels[2], 5, local_size * key_size, NULL);
+      err |= clSetKernelArg(kernels[2], 6, local_size * sizeof(cl_uint), NULL);
+      err |= clSetKernelArg(kernels[2], 7, sizeof(cl_mem), 
+            &buffers[(pass+1)%2]);
+      if(err < 0) {
+         perror("Couldn't create a kernel argument");
+         exit(1);   
+      }
+
+      /* Count digits, scan the histograms and scatter the keys */
+      err = clEnqueueNDRangeKernel(queue, kernels[0], 1, NULL, &global_size, 
+            &local_size, 0, NULL, shift == 0 ? &start_event : NULL);
+      err |= clEnqueueNDRangeKernel(queue, kernels[1], 1, NULL, &local_size, 
+            &local_size, 0, NULL, NULL);
+      err |= clEnqueueNDRangeKernel(queue, kernels[2], 1, NULL, &global_size, 
+            &local_size, 0, NULL, 
+            shift + RADIX_BITS >= 8 * key_size ? &end_event : NULL);
+      if(err < 0) {
+         perror("Couldn't enqueue the kernel");
+         exit(1);   
+      }
+   }
+   clFinish(queue);
+
+   clGetEventProfilingInfo(start_event, CL_PROFILING_COMMAND_START,
+         sizeof(time_start), &time_start, NULL);
+   clGetEventProfilingInfo(end_event, CL_PROFILING_COMMAND_END,
+         sizeof(time_end), &time_end, NULL);
+   clReleaseEvent(start_event);
+   clReleaseEvent(end_event);
+   return time_end - time_start;
+}
+
+/* Return the elapsed time of an event in nanoseconds */
+cl_ulong event_time(cl_event event) {
+
+   cl_ulong time_start, time_end;
+
+   clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_START,
+         sizeof(time_start), &time_start, NULL);
+   clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_END,
+         sizeof(time_end), &time_end, NULL);
+   clReleaseEvent(event);
+   return time_end - time_start;
+}
+
+int main() {
+
+   /* OpenCL structures */
+   cl_device_id device;
+   cl_context context;
+   cl_program program, radix_program;
+   cl_kernel count_kernel, scan_kernel, unique_kernel, starts_kernel,
+         lengths_kernel, radix_kernels[3];
+   cl_command_queue queue;
+   cl_event prof_event, scan_event;
+   cl_int i, err, check;
+   cl_uint compute_units, max_groups;
+   size_t local_size, radix_local_size, global_size;
+   const char* radix_names[3] = {"radix_count", "radix_scan", 
+         "radix_scatter"};
+
+   /* Data and buffers */
+   cl_uint *keys, *unique, *run_keys, *run_lengths, *check_keys, 
+         *check_lengths, num_keys, num_groups;
+   int num_unique, num_check, j;
+   cl_mem keys_buffer, temp_buffer, hist_buffer, counts_buffer, 
+         offsets_buffer, unique_buffer, run_keys_buffer, starts_buffer, 
+         lengths_buffer;
+   cl_ulong sort_time, scan_time, unique_time, rle_time;
+
+   /* Initialize keys with many repeats */
+   keys = (cl_uint*) malloc(NUM_KEYS * sizeof(cl_uint));
+   unique = (cl_uint*) malloc(NUM_KEYS * sizeof(cl_uint));
+   run_keys = (cl_uint*) malloc(NUM_KEYS * sizeof(cl_uint));
+   run_lengths = (cl_uint*) malloc(NUM_KEYS * sizeof(cl_uint));
+   check_keys = (cl_uint*) malloc(NUM_KEYS * sizeof(cl_uint));
+   check_lengths = (cl_uint*) malloc(NUM_KEYS * sizeof(cl_uint));
+   srand(time(NULL));
+   for(i=0; i<NUM_KEYS; i++) {
+      keys[i] = (((cl_uint)rand() << 16) ^ (cl_uint)rand()) % NUM_DISTINCT;
+   }
+
+   /* Create device and context */
+   device = create_device();
+   err = clGetDeviceInfo(device, CL_DEVICE_MAX_COMPUTE_UNITS, 
+         sizeof(compute_units), &compute_units, NULL);
+   if(err < 0) {
+      perror("Couldn't obtain device information");
+      exit(1);   
+   }
+   context = clCreateContext(NULL, 1, &device, NULL, NULL, &err);
+   if(err < 0) {
+      perror("Couldn't create a context");
+      exit(1);   
+   }
+
+   /* Build programs and create kernels */
+   program = build_program(context, device, PROGRAM_FILE);
+   radix_program = build_program(context, device, RADIX_FILE);
+   count_kernel = clCreateKernel(program, "unique_count", &err);
+   if(err < 0) {
+      perror("Couldn't create a kernel");
+      exit(1);
+   };
+   scan_kernel = clCreateKernel(program, "unique_scan", &err);
+   if(err < 0) {
+      perror("Couldn't create a kernel");
+      exit(1);
+   };
+   unique_kernel = clCreateKernel(program, "unique_keys", &err);
+   if(err < 0) {
+      perror("Couldn't create a kernel");
+      exit(1);
+   };
+   starts_kernel = clCreateKernel(program, "rle_starts", &err);
+   if(err < 0) {
+      perror("Couldn't create a kernel");
+      exit(1);
+   };
+   lengths_kernel = clCreateKernel(program, "rle_lengths", &err);
+   if(err < 0) {
+      perror("Couldn't create a kernel");
+      exit(1);
+   };
+   for(i=0; i<3; i++) {
+      radix_kernels[i] = clCreateKernel(radix_program, radix_names[i], &err);
+      if(err < 0) {
+         perror("Couldn't create a kernel");
+         exit(1);
+      };
+   }
+
+   /* Determine power-of-two local sizes */
+   err = clGetKernelWorkGroupInfo(unique_kernel, device, 
+         CL_KERNEL_WORK_GROUP_SIZE, sizeof(local_size), &local_size, NULL);
+   err |= clGetKernelWorkGroupInfo(radix_kernels[2], device, 
+         CL_KERNEL_WORK_GROUP_SIZE, sizeof(radix_local_size), 
+         &radix_local_size, NULL);
+   if(err < 0) {
+      perror("Couldn't obtain device information");
+      exit(1);   
+   }
+   local_size = (size_t)pow(2, trunc(log2(local_size)));
+   radix_local_size = (size_t)pow(2, trunc(log2(radix_local_size)));
+   if(radix_local_size > MAX_LOCAL_SIZE)
+      radix_local_size = MAX_LOCAL_SIZE;
+   if(radix_local_size < RADIX) {
+      printf("The radix sort needs %d work-items per group\n", RADIX);
+      exit(1);
+   }
+   max_groups = compute_units * GROUPS_PER_UNIT;
+   num_keys = NUM_KEYS;
+   num_groups = (num_keys + local_size - 1)/local_size;
+   global_size = num_groups * local_size;
+
+   /* Create buffers */
+   keys_buffer = clCreateBuffer(context, CL_MEM_READ_WRITE |
+         CL_MEM_COPY_HOST_PTR, NUM_KEYS * sizeof(cl_uint), keys, &err);
+   temp_buffer = clCreateBuffer(context, CL_MEM_READ_WRITE, 
+         NUM_KEYS * sizeof(cl_uint), NULL, &err);
+   hist_buffer = clCreateBuffer(context, CL_MEM_READ_WRITE, 
+         RADIX * max_groups * sizeof(cl_uint), NULL, &err);
+   counts_buffer = clCreateBuffer(context, CL_MEM_READ_WRITE, 
+         num_groups * sizeof(int), NULL, &err);
+   offsets_buffer = clCreateBuffer(context, CL_MEM_READ_WRITE, 
+         (num_groups + 1) * sizeof(int), NULL, &err);
+   unique_buffer = clCreateBuffer(context, CL_MEM_WRITE_ONLY, 
+         NUM_KEYS * sizeof(cl_uint), NULL, &err);
+   run_keys_buffer = clCreateBuffer(context, CL_MEM_WRITE_ONLY, 
+         NUM_KEYS * sizeof(cl_uint), NULL, &err);
+   starts_buffer = clCreateBuffer(context, CL_MEM_READ_WRITE, 
+         NUM_KEYS * sizeof(cl_uint), NULL, &err);
+   lengths_buffer = clCreateBuffer(context, CL_MEM_WRITE_ONLY, 
+         NUM_KEYS * sizeof(cl_uint), NULL, &err);
+   if(err < 0) {
+      perror("Couldn't create a buffer");
+      exit(1);   
+   };
+
+   /* Create a command queue */
+   queue = clCreateCommandQueue(context, device, 
+         CL_QUEUE_PROFILING_ENABLE, &err);
+   if(err < 0) {
+      perror("Couldn't create a command queue");
+      exit(1);   
+   };
+
+   /* Sort the keys on the device, leaving them in keys_buffer */
+   sort_time = radix_sort(queue, radix_kernels, keys_buffer, temp_buffer, 
+         hist_buffer, num_keys, sizeof(cl_uint), radix_local_size, 
+         max_groups);
+
+   /* Set kernel arguments */
+   err = clSetKernelArg(count_kernel, 0, sizeof(cl_mem), &keys_buffer);
+   err |= clSetKernelArg(count_kernel, 1, sizeof(cl_uint), &num_keys);
+   err |= clSetKernelArg(count_kernel, 2, local_size * sizeof(int), NULL);
+   err |= clSetKernelArg(count_kernel, 3, sizeof(cl_mem), &counts_buffer);
+   err |= clSetKernelArg(scan_kernel, 0, sizeof(cl_mem), &counts_buffer);
+   err |= clSetKernelArg(scan_kernel, 1, sizeof(cl_uint), &num_groups);
+   err |= clSetKernelArg(scan_kernel, 2, local_size * sizeof(int), NULL);
+   err |= clSetKernelArg(scan_kernel, 3, sizeof(cl_mem), &offsets_buffer);
+   err |= clSetKernelArg(unique_kernel, 0, sizeof(cl_mem), &keys_buffer);
+   err |= clSetKernelArg(unique_kernel, 1, sizeof(cl_uint), &num_keys);
+   err |= clSetKernelArg(unique_kernel, 2, sizeof(cl_mem), &offsets_buffer);
+   err |= clSetKernelArg(unique_kernel, 3, local_size * sizeof(int), NULL);
+   err |= clSetKernelArg(unique_kernel, 4, sizeof(cl_mem), &unique_buffer);
+   err |= clSetKernelArg(starts_kernel, 0, sizeof(cl_mem), &keys_buffer);
+   err |= clSetKernelArg(starts_kernel, 1, sizeof(cl_uint), &num_keys);
+   err |= clSetKernelArg(starts_kernel, 2, sizeof(cl_mem), &offsets_buffer);
+   err |= clSetKernelArg(starts_kernel, 3, local_size * sizeof(int), NULL);
+   err |= clSetKernelArg(starts_kernel, 4, sizeof(cl_mem), &run_keys_buffer);
+   err |= clSetKernelArg(starts_kernel, 5, sizeof(cl_mem), &starts_buffer);
+   err |= clSetKernelArg(lengths_kernel, 0, sizeof(cl_mem), &starts_buffer);
+   err |= clSetKernelArg(lengths_kernel, 1, sizeof(cl_uint), &num_keys);
+   err |= clSetKernelArg(lengths_kernel, 2, sizeof(cl_mem), &offsets_buffer);
+   err |= clSetKernelArg(lengths_kernel, 3, sizeof(cl_uint), &num_groups);
+   err |= clSetKernelArg(lengths_kernel, 4, sizeof(cl_mem), &lengths_buffer);
+   if(err < 0) {
+      perror("Couldn't create a kernel argument");
+      exit(1);   
+   }
+
+   /* unique_count: count run heads per group and scan the counts, which
+      leaves the number of unique keys on the device */
+   err = clEnqueueNDRangeKernel(queue, count_kernel, 1, NULL, &global_size, 
+         &local_size, 0, NULL, &prof_event);
+   err |= clEnqueueNDRangeKernel(queue, scan_kernel, 1, NULL, &local_size, 
+         &local_size, 0, NULL, &scan_event);
+   if(err < 0) {
+      perror("Couldn't enqueue the kernel");
+      exit(1);   
+   }
+   clFinish(queue);
+   scan_time = event_time(prof_event) + event_time(scan_event);
+
+   /* unique: copy the head of every run */
+   err = clEnqueueNDRangeKernel(queue, unique_kernel, 1, NULL, &global_size, 
+         &local_size, 0, NULL, &prof_event);
+   if(err < 0) {
+      perror("Couldn't enqueue the kernel");
+      exit(1);   
+   }
+   clFinish(queue);
+   unique_time = event_time(prof_event);
+
+   /* Run-length encoding: keys and starts, then lengths */
+   err = clEnqueueNDRangeKernel(queue, starts_kernel, 1, NULL, &global_size, 
+         &local_size, 0, NULL, &prof_event);
+   err |= clEnqueueNDRangeKernel(queue, lengths_kernel, 1, NULL, 
+         &global_size, &local_size, 0, NULL, &scan_event);
+   if(err < 0) {
+      perror("Couldn't enqueue the kernel");
+      exit(1);   
+   }
+   clFinish(queue);
+   rle_time = event_time(prof_event) + event_time(scan_event);
+
+   /* Read the count and the dense outputs */
+   err = clEnqueueReadBuffer(queue, offsets_buffer, CL_TRUE, 
+         num_groups * sizeof(int), sizeof(int), &num_unique, 0, NULL, NULL);
+   err |= clEnqueueReadBuffer(queue, unique_buffer, CL_TRUE, 0, 
+         num_unique * sizeof(cl_uint), unique, 0, NULL, NULL);
+   err |= clEnqueueReadBuffer(queue, run_keys_buffer, CL_TRUE, 0, 
+         num_unique * sizeof(cl_uint), run_keys, 0, NULL, NULL);
+   err |= clEnqueueReadBuffer(queue, lengths_buffer, CL_TRUE, 0, 
+         num_unique * sizeof(cl_uint), run_lengths, 0, NULL, NULL);
+   if(err < 0) {
+      perror("Couldn't read the buffer");
+      exit(1);   
+   }
+   printf("%d unique keys in %d keys\n", num_unique, NUM_KEYS);
+
+   /* Find the runs of the keys sorted on the host */
+   qsort(keys, NUM_KEYS, sizeof(cl_uint), compare_keys);
+   num_check = 0;
+   for(i=0; i<NUM_KEYS; i++) {
+      if(i == 0 || keys[i] != keys[i-1]) {
+         check_keys[num_check] = keys[i];
+         check_lengths[num_check++] = 1;
+      }
+      else {
+         check_lengths[num_check-1]++;
+      }
+   }
+
+   /* Check the unique keys and the runs separately */
+   check = (num_unique == num_check);
+   for(j=0; check && j<num_unique; j++) {
+      if(unique[j] != check_keys[j])
+         check = 0;
+   }
+   printf("unique: %s\n", check ? "Check passed." : "Check failed.");
+   check = (num_unique == num_check);
+   for(j=0; check && j<num_unique; j++) {
+      if(run_keys[j] != check_keys[j] || run_lengths[j] != check_lengths[j])
+         check = 0;
+   }
+   printf("run-length encoding: %s\n", 
+         check ? "Check passed." : "Check failed.");
+
+   /* Display timing */
+   printf("Radix sort time = %lu\n", sort_time);
+   printf("Count and scan time = %lu\n", scan_time);
+   printf("Unique time = %lu\n", unique_time);
+   printf("Run-length encoding time = %lu\n", rle_time);
+
+   /* Deallocate resources */
+   clReleaseMemObject(keys_buffer);
+   clReleaseMemObject(temp_buffer);
+   clReleaseMemObject(hist_buffer);
+   clReleaseMemObject(counts_buffer);
+   clReleaseMemObject(offsets_buffer);
+   clReleaseMemObject(unique_buffer);
+   clReleaseMemObject(run_keys_buffer);
+   clReleaseMemObject(starts_buffer);
+   clReleaseMemObject(lengths_buffer);
+   clReleaseKernel(count_kernel);
+   clReleaseKernel(scan_kernel);
+   clReleaseKernel(unique_kernel);
+   clReleaseKernel(starts_kernel);
+   clReleaseKernel(lengths_kernel);
+   for(i=0; i<3; i++) {
+      clReleaseKernel(radix_kernels[i]);
+   }
+   clReleaseCommandQueue(queue);
+   clReleaseProgram(program);
+   clReleaseProgram(radix_program);
+   clReleaseContext(context);
+   free(keys);
+   free(unique);
+   free(run_keys);
+   free(run_lengths);
+   free(check_keys);
+   free(check_lengths);
+   return 0;
+}
@@ -0,0 +1,130 @@
+/* Keys are compared as 32-bit patterns, so uint, int and float keys 
+   from the Ch11 sorters all work. Equal floats with different bits, 
+   such as -0.0 and 0.0, start separate runs, as they sort apart */
+
+/* Flag the first key of every run of equal keys */
+int head_flag(__global uint* keys, uint num_keys, uint gid) {
+
+   if(gid >= num_keys)
+      return 0;
+   return (gid == 0) || (keys[gid] != keys[gid-1]);
+}
+
+/* Return the number of run heads before this work-item */
+int local_position(int flag, __local int* partial_sums) {
+
+   int lid = get_local_id(0);
+   int group_size = get_local_size(0);
+   int i;
+
+   partial_sums[lid] = flag;
+   barrier(CLK_LOCAL_MEM_FENCE);
+
+   for(int d = 1; d < group_size; d <<= 1) {
+      i = (lid >= d) ? partial_sums[lid - d] : 0;
+      barrier(CLK_LOCAL_MEM_FENCE);
+      partial_sums[lid] += i;
+      barrier(CLK_LOCAL_MEM_FENCE);
+   }
+   return partial_sums[lid] - flag;
+}
+
+/* Count the run heads in each work-group */
+__kernel void unique_count(__global uint* keys, uint num_keys,
+      __local int* partial_counts, __global int* group_counts) {
+
+   int lid = get_local_id(0);
+   int group_size = get_local_size(0);
+
+   partial_counts[lid] = head_flag(keys, num_keys, get_global_id(0));
+   barrier(CLK_LOCAL_MEM_FENCE);
+
+   for(int i = group_size/2; i>0; i >>= 1) {
+      if(lid < i) {
+         partial_counts[lid] += partial_counts[lid + i];
+      }
+      barrier(CLK_LOCAL_MEM_FENCE);
+   }
+
+   if(lid == 0) {
+      group_counts[get_group_id(0)] = partial_counts[0];
+   }
+}
+
+/* Exclusive scan of the group counts in a single work-group. The total,
+   the number of unique keys, goes to offsets[num_groups] */
+__kernel void unique_scan(__global int* group_counts, uint num_groups,
+      __local int* partial_sums, __global int* offsets) {
+
+   int lid = get_local_id(0);
+   int group_size = get_local_size(0);
+   int running_total = 0, value, i;
+
+   for(uint start = 0; start < num_groups; start += group_size) {
+
+      value = (start + lid < num_groups) ? group_counts[start + lid] : 0;
+      partial_sums[lid] = value;
+      barrier(CLK_LOCAL_MEM_FENCE);
+
+      /* Inclusive scan of this chunk */
+      for(int d = 1; d < group_size; d <<= 1) {
+         i = (lid >= d) ? partial_sums[lid - d] : 0;
+         barrier(CLK_LOCAL_MEM_FENCE);
+         partial_sums[lid] += i;
+         barrier(CLK_LOCAL_MEM_FENCE);
+      }
+
+      if(start + lid < num_groups) {
+         offsets[start + lid] = running_total + partial_sums[lid] - value;
+      }
+      running_total += partial_sums[group_size-1];
+      barrier(CLK_LOCAL_MEM_FENCE);
+   }
+
+   if(lid == 0) {
+      offsets[num_groups] = running_total;
+   }
+}
+
+/* Copy the first key of every run to a dense output */
+__kernel void unique_keys(__global uint* keys, uint num_keys,
+      __global int* offsets, __local int* partial_sums, 
+      __global uint* output) {
+
+   uint gid = get_global_id(0);
+   int flag = head_flag(keys, num_keys, gid);
+   int pos = offsets[get_group_id(0)] + local_position(flag, partial_sums);
+
+   if(flag) {
+      output[pos] = keys[gid];
+   }
+}
+
+/* Write the key and the start of every run to dense outputs */
+__kernel void rle_starts(__global uint* keys, uint num_keys,
+      __global int* offsets, __local int* partial_sums, 
+      __global uint* run_keys, __global uint* run_starts) {
+
+   uint gid = get_global_id(0);
+   int flag = head_flag(keys, num_keys, gid);
+   int pos = offsets[get_group_id(0)] + local_position(flag, partial_sums);
+
+   if(flag) {
+      run_keys[pos] = keys[gid];
+      run_starts[pos] = gid;
+   }
+}
+
+/* Find each run's length from the start of the next run. The number of
+   runs is read from the device, so the launch covers every key */
+__kernel void rle_lengths(__global uint* run_starts, uint num_keys,
+      __global int* offsets, uint num_groups, __global uint* run_lengths) {
+
+   uint run = get_global_id(0);
+   uint num_runs = offsets[num_groups];
+
+   if(run < num_runs) {
+      run_lengths[run] = ((run + 1 < num_runs) ? run_starts[run + 1] : 
+            num_keys) - run_starts[run];
+   }
+}
@@ -0,0 +1,407 @@
+#define _CRT_SECURE_NO_WARNINGS
+#define PROGRAM_FILE "word_count.cl"
+#define TEXT_FILE "../string_search/kafka.txt"
+
+#define TABLE_SIZE 1048576
+#define TOP_N 16
+#define EMPTY 0xFFFFFFFF
+#define GROUPS_PER_UNIT 8
+#define MAX_LOCAL_SIZE 256
+#define TOP_LOCAL_SIZE 64
+
+#include <ctype.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef MAC
+#include <OpenCL/cl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+/* Find a GPU or CPU associated with the first available platform */
+cl_device_id create_device() {
+
+   cl_platform_id platform;
+   cl_device_id dev;
+   int err;
+
+   /* Identify a platform */
+   err = clGetPlatformIDs(1, &platform, NULL);
+   if(err < 0) {
+      perror("Couldn't identify a platform");
+      exit(1);
+   } 
+
+   /* Access a device */
+   err = clGetDeviceIDs(platform, CL_DEVICE_TYPE_GPU, 1, &dev, NULL);
+   if(err == CL_DEVICE_NOT_FOUND) {
+      err = clGetDeviceIDs(platform, CL_DEVICE_TYPE_CPU, 1, &dev, NULL);
+   }
+   if(err < 0) {
+      perror("Couldn't access any devices");
+      exit(1);   
+   }
+
+   return dev;
+}
+
+/* Create program from a file and compile it */
+cl_program build_program(cl_context ctx, cl_device_id dev, const char* filename) {
+
+   cl_program program;
+   FILE *program_handle;
+   char *program_buffer, *program_log;
+   size_t program_size, log_size;
+   int err;
+
+   /* Read program file and place content into buffer */
+   program_handle = fopen(filename, "r");
+   if(program_handle == NULL) {
+      perror("Couldn't find the program file");
+      exit(1);
+   }
+   fseek(program_handle, 0, SEEK_END);
+   program_size = ftell(program_handle);
+   rewind(program_handle);
+   program_buffer = (char*)malloc(program_size + 1);
+   program_buffer[program_size] = '\0';
+   fread(program_buffer, sizeof(char), program_size, program_handle);
+   fclose(program_handle);
+
+   /* Create program from file */
+   program = clCreateProgramWithSource(ctx, 1, 
+      (const char**)&program_buffer, &program_size, &err);
+   if(err < 0) {
+      perror("Couldn't create the program");
+      exit(1);
+   }
+   free(program_buffer);
+
+   /* Build program */
+   err = clBuildProgram(program, 0, NULL, NULL, NULL, NULL);
+   if(err < 0) {
+
+      /* Find size of log and print to std output */
+      clGetProgramBuildInfo(program, dev, CL_PROGRAM_BUILD_LOG, 
+            0, NULL, &log_size);
+      program_log = (char*) malloc(log_size + 1);
+      program_log[log_size] = '\0';
+      clGetProgramBuildInfo(program, dev, CL_PROGRAM_BUILD_LOG, 
+            log_size + 1, program_log, NULL);
+      printf("%s\n", program_log);
+      free(program_log);
+      exit(1);
+   }
+
+   return program;
+}
+
+/* Return the elapsed time of an event in nanoseconds */
+cl_ulong event_time(cl_event event) {
+
+   cl_ulong time_start, time_end;
+
+   clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_START,
+         sizeof(time_start), &time_start, NULL);
+   clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_END,
+         sizeof(time_end), &time_end, NULL);
+   clReleaseEvent(event);
+   return time_end - time_start;
+}
+
+/* Words are runs of ASCII letters and digits, compared without case */
+int is_word(unsigned char c) {
+   return c < 128 && isalnum(c);
+}
+
+/* Find a word in the host's table, inserting it if it isn't there, and
+   return its slot */
+cl_uint find_word(const unsigned char *text, size_t text_size, 
+      cl_uint offset, cl_uint length, cl_uint *keys, cl_uint *num_words) {
+
+   cl_uint hash = 2166136261u, slot, key, i;
+
+   for(i=0; i<length; i++) {
+      hash = (hash ^ (cl_uint)tolower(text[offset + i])) * 16777619u;
+   }
+   slot = hash & (TABLE_SIZE - 1);
+   while(1) {
+      key = keys[slot];
+      if(key == EMPTY) {
+         keys[slot] = offset;
+         (*num_words)++;
+         return slot;
+      }
+      for(i=0; i<length && key + i < text_size; i++) {
+         if(tolower(text[offset + i]) != tolower(text[key + i]))
+            break;
+      }
+      if(i == length && (key + length == text_size || 
+            !is_word(text[key + length])))
+         return slot;
+      slot = (slot + 1) & (TABLE_SIZE - 1);
+   }
+}
+
+/* Order (count, slot) pairs by descending count for qsort */
+int compare_counts(const void* a, const void* b) {
+
+   const cl_uint *pair_a = (const cl_uint*)a, *pair_b = (const cl_uint*)b;
+   return (pair_a[0] < pair_b[0]) - (pair_a[0] > pair_b[0]);
+}
+
+int main(int argc, char** argv) {
+
+   /* OpenCL structures */
+   cl_device_id device;
+   cl_context context;
+   cl_program program;
+   cl_kernel count_kernel, slots_kernel, merge_kernel;
+   cl_command_queue queue;
+   cl_event prof_event, merge_event;
+   cl_int i, err, check;
+   cl_uint compute_units, num_groups, table_size, table_mask, 
+         chars_per_item, num_entries, key, length, slot, j;
+   size_t local_size, top_local_size, global_size, top_global_size;
+   cl_ulong count_time, top_time;
+
+   /* Data and buffers */
+   const char *text_name;
+   char word[32];
+   FILE *text_handle;
+   unsigned char *text;
+   cl_uint text_size, stats[3] = {0, 0, 0}, check_stats[2] = {0, 0};
+   cl_uint *keys, *counts, *check_keys, *check_counts, *pairs, top[2*TOP_N];
+   cl_mem text_buffer, keys_buffer, counts_buffer, stats_buffer,
+         candidates_buffer, top_buffer;
+
+   /* Read text file and place content into buffer */
+   text_name = argc > 1 ? argv[1] : TEXT_FILE;
+   text_handle = fopen(text_name, "rb");
+   if(text_handle == NULL) {
+      perror("Couldn't find the text file");
+      exit(1);
+   }
+   fseek(text_handle, 0, SEEK_END);
+   text_size = ftell(text_handle);
+   rewind(text_handle);
+   text = (unsigned char*)malloc(text_size);
+   fread(text, sizeof(char), text_size, text_handle);
+   fclose(text_handle);
+
+   /* Create device and context */
+   device = create_device();
+   err = clGetDeviceInfo(device, CL_DEVICE_MAX_COMPUTE_UNITS, 
+         sizeof(compute_units), &compute_units, NULL);
+   if(err < 0) {
+      perror("Couldn't obtain device information");
+      exit(1);   
+   }
+   context = clCreateContext(NULL, 1, &device, NULL, NULL, &err);
+   if(err < 0) {
+      perror("Couldn't create a context");
+      exit(1);   
+   }
+
+   /* Build program and create kernels */
+   program = build_program(context, device, PROGRAM_FILE);
+   count_kernel = clCreateKernel(program, "count_words", &err);
+   if(err < 0) {
+      perror("Couldn't create a kernel");
+      exit(1);
+   };
+   slots_kernel = clCreateKernel(program, "top_slots", &err);
+   if(err < 0) {
+      perror("Couldn't create a kernel");
+      exit(1);
+   };
+   merge_kernel = clCreateKernel(program, "top_merge", &err);
+   if(err < 0) {
+      perror("Couldn't create a kernel");
+      exit(1);
+   };
+
+   /* Determine work sizes. The top-N kernels need a power-of-two local 
+      size with room for TOP_N pairs per work-item */
+   err = clGetKernelWorkGroupInfo(count_kernel, device, 
+         CL_KERNEL_WORK_GROUP_SIZE, sizeof(local_size), &local_size, NULL);
+   err |= clGetKernelWorkGroupInfo(slots_kernel, device, 
+         CL_KERNEL_WORK_GROUP_SIZE, sizeof(top_local_size), 
+         &top_local_size, NULL);
+   if(err < 0) {
+      perror("Couldn't obtain device information");
+      exit(1);   
+   }
+   if(local_size > MAX_LOCAL_SIZE)
+      local_size = MAX_LOCAL_SIZE;
+   top_local_size = (size_t)pow(2, trunc(log2(top_local_size)));
+   if(top_local_size > TOP_LOCAL_SIZE)
+      top_local_size = TOP_LOCAL_SIZE;
+   num_groups = compute_units * GROUPS_PER_UNIT;
+   global_size = num_groups * local_size;
+   top_global_size = num_groups * top_local_size;
+   chars_per_item = (cl_uint)((text_size + global_size - 1)/global_size);
+   table_size = TABLE_SIZE;
+   table_mask = TABLE_SIZE - 1;
+   num_entries = num_groups * TOP_N;
+
+   /* Create buffers. Empty slots hold EMPTY keys */
+   keys = (cl_uint*) malloc(TABLE_SIZE * sizeof(cl_uint));
+   memset(keys, 0xFF, TABLE_SIZE * sizeof(cl_uint));
+   counts = (cl_uint*) calloc(TABLE_SIZE, sizeof(cl_uint));
+   text_buffer = clCreateBuffer(context, CL_MEM_READ_ONLY |
+         CL_MEM_COPY_HOST_PTR, text_size, text, &err);
+   keys_buffer = clCreateBuffer(context, CL_MEM_READ_WRITE |
+         CL_MEM_COPY_HOST_PTR, TABLE_SIZE * sizeof(cl_uint), keys, &err);
+   counts_buffer = clCreateBuffer(context, CL_MEM_READ_WRITE |
+         CL_MEM_COPY_HOST_PTR, TABLE_SIZE * sizeof(cl_uint), counts, &err);
+   stats_buffer = clCreateBuffer(context, CL_MEM_READ_WRITE |
+         CL_MEM_COPY_HOST_PTR, sizeof(stats), stats, &err);
+   candidates_buffer = clCreateBuffer(context, CL_MEM_READ_WRITE, 
+         num_entries * 2 * sizeof(cl_uint), NULL, &err);
+   top_buffer = clCreateBuffer(context, CL_MEM_WRITE_ONLY, 
+         TOP_N * 2 * sizeof(cl_uint), NULL, &err);
+   if(err < 0) {
+      perror("Couldn't create a buffer");
+      exit(1);   
+   };
+
+   /* Create kernel arguments */
+   err = clSetKernelArg(count_kernel, 0, sizeof(cl_mem), &text_buffer);
+   err |= clSetKernelArg(count_kernel, 1, sizeof(cl_uint), &text_size);
+   err |= clSetKernelArg(count_kernel, 2, sizeof(cl_uint), &chars_per_item);
+   err |= clSetKernelArg(count_kernel, 3, sizeof(cl_mem), &keys_buffer);
+   err |= clSetKernelArg(count_kernel, 4, sizeof(cl_mem), &counts_buffer);
+   err |= clSetKernelArg(count_kernel, 5, sizeof(cl_uint), &table_mask);
+   err |= clSetKernelArg(count_kernel, 6, sizeof(cl_mem), &stats_buffer);
+   err |= clSetKernelArg(slots_kernel, 0, sizeof(cl_mem), &counts_buffer);
+   err |= clSetKernelArg(slots_kernel, 1, sizeof(cl_uint), &table_size);
+   err |= clSetKernelArg(slots_kernel, 2, 
+         top_local_size * TOP_N * 2 * sizeof(cl_uint), NULL);
+   err |= clSetKernelArg(slots_kernel, 3, sizeof(cl_mem), &candidates_buffer);
+   err |= clSetKernelArg(merge_kernel, 0, sizeof(cl_mem), &candidates_buffer);
+   err |= clSetKernelArg(merge_kernel, 1, sizeof(cl_uint), &num_entries);
+   err |= clSetKernelArg(merge_kernel, 2, 
+         top_local_size * TOP_N * 2 * sizeof(cl_uint), NULL);
+   err |= clSetKernelArg(merge_kernel, 3, sizeof(cl_mem), &top_buffer);
+   if(err < 0) {
+      perror("Couldn't create a kernel argument");
+      exit(1);   
+   }
+
+   /* Create a command queue */
+   queue = clCreateCommandQueue(context, device, 
+         CL_QUEUE_PROFILING_ENABLE, &err);
+   if(err < 0) {
+      perror("Couldn't create a command queue");
+      exit(1);   
+   };
+
+   /* Count the words */
+   err = clEnqueueNDRangeKernel(queue, count_kernel, 1, NULL, &global_size, 
+         &local_size, 0, NULL, &prof_event);
+   if(err < 0) {
+      perror("Couldn't enqueue the kernel");
+      exit(1);   
+   }
+   clFinish(queue);
+   count_time = event_time(prof_event);
+
+   /* Find the most frequent words: TOP_N per group, then TOP_N overall */
+   err = clEnqueueNDRangeKernel(queue, slots_kernel, 1, NULL, 
+         &top_global_size, &top_local_size, 0, NULL, &prof_event);
+   err |= clEnqueueNDRangeKernel(queue, merge_kernel, 1, NULL, 
+         &top_local_size, &top_local_size, 0, NULL, &merge_event);
+   if(err < 0) {
+      perror("Couldn't enqueue the kernel");
+      exit(1);   
+   }
+   clFinish(queue);
+   top_time = event_time(prof_event) + event_time(merge_event);
+
+   /* Read the results */
+   err = clEnqueueReadBuffer(queue, stats_buffer, CL_TRUE, 0, 
+         sizeof(stats), stats, 0, NULL, NULL);
+   err |= clEnqueueReadBuffer(queue, top_buffer, CL_TRUE, 0, 
+         sizeof(top), top, 0, NULL, NULL);
+   err |= clEnqueueReadBuffer(queue, keys_buffer, CL_TRUE, 0, 
+         TABLE_SIZE * sizeof(cl_uint), keys, 0, NULL, NULL);
+   if(err < 0) {
+      perror("Couldn't read the buffer");
+      exit(1);   
+   }
+   if(stats[2]) {
+      printf("The hash table is full\n");
+      exit(1);
+   }
+
+   /* Count the words on the host */
+   check_keys = (cl_uint*) malloc(TABLE_SIZE * sizeof(cl_uint));
+   memset(check_keys, 0xFF, TABLE_SIZE * sizeof(cl_uint));
+   check_counts = (cl_uint*) calloc(TABLE_SIZE, sizeof(cl_uint));
+   for(key=0; key<text_size; key++) {
+      if(!is_word(text[key]) || (key > 0 && is_word(text[key-1])))
+         continue;
+      for(length=0; key + length < text_size && is_word(text[key + length]);
+            length++);
+      slot = find_word(text, text_size, key, length, check_keys, 
+            &check_stats[0]);
+      check_counts[slot]++;
+      check_stats[1]++;
+   }
+   pairs = (cl_uint*) malloc(TABLE_SIZE * 2 * sizeof(cl_uint));
+   for(slot=0; slot<TABLE_SIZE; slot++) {
+      pairs[slot*2] = check_counts[slot];
+      pairs[slot*2 + 1] = slot;
+   }
+   qsort(pairs, TABLE_SIZE, 2 * sizeof(cl_uint), compare_counts);
+
+   /* Check the totals, the order of the counts and the count of each 
+      word against the host. The list ends with EMPTY slots if the text
+      holds fewer than TOP_N distinct words */
+   printf("%u words, %u distinct\n", stats[1], stats[0]);
+   check = (stats[0] == check_stats[0] && stats[1] == check_stats[1]);
+   for(i=0; i<TOP_N && top[i*2 + 1] != EMPTY; i++) {
+      key = keys[top[i*2 + 1]];
+      for(length=0; key + length < text_size && is_word(text[key + length]);
+            length++);
+      for(j=0; j<length && j<sizeof(word) - 1; j++) {
+         word[j] = (char)tolower(text[key + j]);
+      }
+      word[j] = '\0';
+      printf("%-16s %u\n", word, top[i*2]);
+      slot = find_word(text, text_size, key, length, check_keys, 
+            &check_stats[0]);
+      if(top[i*2] != pairs[i*2] || top[i*2] != check_counts[slot])
+         check = 0;
+   }
+   if(i < TOP_N && pairs[i*2] > 0)
+      check = 0;
+   printf("%s\n", check ? "Check passed." : "Check failed.");
+   printf("Count time = %lu\n", count_time);
+   printf("Top-%d time = %lu\n", TOP_N, top_time);
+
+   /* Deallocate resources */
+   clReleaseMemObject(text_buffer);
+   clReleaseMemObject(keys_buffer);
+   clReleaseMemObject(counts_buffer);
+   clReleaseMemObject(stats_buffer);
+   clReleaseMemObject(candidates_buffer);
+   clReleaseMemObject(top_buffer);
+   clReleaseKernel(count_kernel);
+   clReleaseKernel(slots_kernel);
+   clReleaseKernel(merge_kernel);
+   clReleaseCommandQueue(queue);
+   clReleaseProgram(program);
+   clReleaseContext(context);
+   free(text);
+   free(keys);
+   free(counts);
+   free(check_keys);
+   free(check_counts);
+   free(pairs);
+   return 0;
+}
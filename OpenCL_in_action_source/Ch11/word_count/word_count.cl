@@ -0,0 +1,155 @@
+#define EMPTY 0xFFFFFFFF
+#define TOP_N 16
+
+/* Words are runs of ASCII letters and digits, compared without case */
+int is_word(uchar c) {
+   return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || 
+         (c >= '0' && c <= '9');
+}
+
+uchar fold(uchar c) {
+   return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+}
+
+/* Check whether the word of length characters at offset matches the
+   word stored at key */
+int same_word(__global uchar *text, uint text_size, uint offset,
+              uint length, uint key) {
+
+   for(uint i = 0; i < length; i++) {
+      if(key + i >= text_size || fold(text[offset + i]) != fold(text[key + i]))
+         return 0;
+   }
+   return key + length == text_size || !is_word(text[key + length]);
+}
+
+/* Count the words of the text in an open-addressing hash table. keys
+   holds the offset of the first occurrence the table saw, claimed with
+   atomic_cmpxchg, and counts holds the number of occurrences. Each word
+   is counted by the work-item holding its first character, which reads
+   past the end of its slice to finish the word. stats holds the number
+   of distinct words, the number of words, and a flag set if the table
+   is full */
+__kernel void count_words(__global uchar *text, uint text_size,
+                          uint chars_per_item, __global uint *keys,
+                          __global uint *counts, uint table_mask,
+                          __global uint *stats) {
+
+   uint i, end, length, hash, slot, key, probe, total = 0;
+
+   i = min((uint)get_global_id(0) * chars_per_item, text_size);
+   end = min(i + chars_per_item, text_size);
+   for(; i < end; i++) {
+
+      /* Find the start of a word and hash it with FNV-1a */
+      if(!is_word(text[i]) || (i > 0 && is_word(text[i-1])))
+         continue;
+      hash = 2166136261;
+      for(length = 0; i + length < text_size && is_word(text[i + length]);
+            length++)
+         hash = (hash ^ fold(text[i + length])) * 16777619;
+      total++;
+
+      /* Probe until the word is found or an empty slot is claimed */
+      slot = hash & table_mask;
+      for(probe = 0; probe <= table_mask; probe++) {
+         key = keys[slot];
+         if(key == EMPTY) {
+            key = atomic_cmpxchg(&keys[slot], EMPTY, i);
+            if(key == EMPTY) {
+               atomic_inc(&stats[0]);
+               break;
+            }
+         }
+         if(same_word(text, text_size, i, length, key))
+            break;
+         slot = (slot + 1) & table_mask;
+      }
+      if(probe > table_mask)
+         stats[2] = 1;
+      else
+         atomic_inc(&counts[slot]);
+      i += length;
+   }
+   atomic_add(&stats[1], total);
+}
+
+/* Order (count, slot) pairs by count, then by slot */
+int greater(uint2 a, uint2 b) {
+   return a.x > b.x || (a.x == b.x && a.y < b.y);
+}
+
+/* Insert a pair into a descending list of TOP_N pairs */
+void insert_top(uint2 *top, uint2 entry) {
+
+   int j = TOP_N - 1;
+
+   if(!greater(entry, top[j]))
+      return;
+   while(j > 0 && greater(entry, top[j-1])) {
+      top[j] = top[j-1];
+      j--;
+   }
+   top[j] = entry;
+}
+
+/* Merge the lists of the work-items in l_top, which holds TOP_N pairs
+   per work-item, and write the group's list. The local size must be a
+   power of two */
+void merge_top(uint2 *top, __local uint2 *l_top, __global uint2 *output) {
+
+   uint lid, stride, j, a, b;
+   __local uint2 *list_a, *list_b;
+
+   lid = get_local_id(0);
+   for(j = 0; j < TOP_N; j++)
+      l_top[lid * TOP_N + j] = top[j];
+
+   for(stride = get_local_size(0)/2; stride > 0; stride >>= 1) {
+      barrier(CLK_LOCAL_MEM_FENCE);
+      if(lid < stride) {
+         list_a = l_top + lid * TOP_N;
+         list_b = l_top + (lid + stride) * TOP_N;
+         a = 0; b = 0;
+         for(j = 0; j < TOP_N; j++)
+            top[j] = greater(list_b[b], list_a[a]) ? list_b[b++] : 
+                  list_a[a++];
+         for(j = 0; j < TOP_N; j++)
+            list_a[j] = top[j];
+      }
+   }
+   barrier(CLK_LOCAL_MEM_FENCE);
+
+   if(lid < TOP_N)
+      output[get_group_id(0) * TOP_N + lid] = l_top[lid];
+}
+
+/* Find the TOP_N largest counts of the table in each group */
+__kernel void top_slots(__global uint *counts, uint table_size,
+                        __local uint2 *l_top, __global uint2 *output) {
+
+   uint2 top[TOP_N];
+   uint i;
+
+   for(i = 0; i < TOP_N; i++)
+      top[i] = (uint2)(0, EMPTY);
+   for(i = get_global_id(0); i < table_size; i += get_global_size(0)) {
+      if(counts[i] > 0)
+         insert_top(top, (uint2)(counts[i], i));
+   }
+   merge_top(top, l_top, output);
+}
+
+/* Merge the lists of several groups into one list per group */
+__kernel void top_merge(__global uint2 *entries, uint num_entries,
+                        __local uint2 *l_top, __global uint2 *output) {
+
+   uint2 top[TOP_N];
+   uint i;
+
+   for(i = 0; i < TOP_N; i++)
+      top[i] = (uint2)(0, EMPTY);
+   for(i = get_global_id(0); i < num_entries; i += get_global_size(0))
+      insert_top(top, entries[i]);
+   merge_top(top, l_top, output);
+}